@@ -23,7 +23,7 @@ import argparse
 
 parser = argparse.ArgumentParser(description="Diff MIPS assembly.")
 
-start_argument = parser.add_argument("start", help="Function name or address to start diffing from.")
+start_argument = parser.add_argument("start", nargs="?", help="Function name or address to start diffing from.")
 if argcomplete:
     def complete_symbol(**kwargs):
         prefix = kwargs["prefix"]
@@ -178,6 +178,22 @@ parser.add_argument(
     choices=["levenshtein", "difflib"],
     help="Diff algorithm to use.",
 )
+parser.add_argument(
+    "--batch",
+    dest="batch",
+    metavar="FILE_OR_FUNCS",
+    help="Print a one-line score for every function in a source or .o file (e.g. src/map.c), "
+    "or in a comma-separated list of names, instead of showing a diff. The images are "
+    "disassembled once per run and cached in .diff_cache.",
+)
+parser.add_argument(
+    "-j",
+    "--jobs",
+    dest="jobs",
+    type=int,
+    default=None,
+    help="Processes to diff with in --batch mode, default one per CPU.",
+)
 parser.add_argument(
     "--max-size",
     "--max-lines",
@@ -493,6 +509,153 @@ def dump_binary():
     )
 
 
+def search_map_file_functions(objfile):
+    """Returns (name, rom start, rom end) for every function in an object's .text, in order."""
+    if not mapfile:
+        fail("No map file configured; cannot list functions.")
+
+    try:
+        with open(mapfile) as f:
+            lines = f.read().split("\n")
+    except Exception:
+        fail(f"Failed to open map file {mapfile} for reading.")
+
+    funcs = []
+    cur_objfile = None
+    text_end = None
+    ram_to_rom = None
+    last_line = ""
+    for line in lines:
+        if "load address" in line:
+            tokens = last_line.split() + line.split()
+            ram_to_rom = int(tokens[5], 0) - int(tokens[1], 0)
+        tokens = line.split()
+        if line.startswith(" .text") and len(tokens) >= 4:
+            cur_objfile = tokens[3]
+            text_end = int(tokens[1], 0) + int(tokens[2], 0)
+        elif line.startswith(" ") and not line.startswith("  .") and len(tokens) == 2 and tokens[0].startswith("0x"):
+            if cur_objfile == objfile and ram_to_rom is not None:
+                funcs.append([tokens[1], int(tokens[0], 0) + ram_to_rom, text_end + ram_to_rom])
+        elif line.startswith(" ."):
+            cur_objfile = None
+        last_line = line
+
+    # Each function runs up to the next one
+    for i in range(len(funcs) - 1):
+        funcs[i][2] = funcs[i + 1][1]
+    return [tuple(f) for f in funcs if f[2] > f[1]]
+
+
+def run_objdump_cached(flags, target):
+    """run_objdump for a whole image range, cached by the image's size and mtime."""
+    import hashlib
+
+    st = os.stat(target)
+    key = hashlib.sha1(repr((objdump_executable, arch_flags, flags, os.path.abspath(target), st.st_size, st.st_mtime)).encode()).hexdigest()
+    cache_path = os.path.join(".diff_cache", key + ".txt")
+    if os.path.isfile(cache_path):
+        with open(cache_path) as f:
+            return f.read()
+
+    out = run_objdump((flags, target, None))
+    os.makedirs(".diff_cache", exist_ok=True)
+    tmp = cache_path + f".{os.getpid()}"
+    with open(tmp, "w") as f:
+        f.write(out)
+    os.replace(tmp, cache_path)
+    return out
+
+
+def dump_binary_range(img, start, end):
+    """
+    Disassembles [start, end) of img once, returning its header and a sorted
+    list of (address, line) to slice functions out of.
+    """
+    objdump_flags = ["-Dz", "-bbinary", "-mmips", "-EB", f"--start-address={start}", f"--stop-address={end}"]
+    lines = run_objdump_cached(objdump_flags, img).split("\n")
+    rows = []
+    for line in lines[7:]:
+        addr = line.split(":", 1)[0].strip()
+        if addr and all(c in string.hexdigits for c in addr):
+            rows.append((int(addr, 16), line))
+    return lines[:7], rows
+
+
+def slice_dump(header, rows, start, end):
+    import bisect
+
+    lo = bisect.bisect_left(rows, (start, ""))
+    hi = bisect.bisect_left(rows, (end, ""))
+    return "\n".join(header + [line for _, line in rows[lo:hi]] + [""])
+
+
+BATCH_WEIGHTS = {"i": 1, "s": 1, "r": 1, "|": 2, "<": 2, ">": 2}
+re_ansi = re.compile(r"\x1b\[[0-9;]*m")
+
+
+def score_function(item):
+    name, basedump, mydump = item
+    score = 0
+    mismatches = 0
+    total = 0
+    for line in do_diff(basedump, mydump):
+        if line.base is None:
+            continue
+        total += 1
+        prefix = re_ansi.sub("", line.fmt2)[:1]
+        if prefix in BATCH_WEIGHTS:
+            score += BATCH_WEIGHTS[prefix]
+            mismatches += 1
+    return name, score, mismatches, total
+
+
+def run_batch():
+    if not baseimg or not myimg:
+        fail("Missing myimg/baseimg in config.")
+
+    target = args.batch
+    if target.endswith(".c") or target.endswith(".s"):
+        target = "build/" + target[:-2] + ".o"
+
+    if target.endswith(".o"):
+        funcs = search_map_file_functions(target)
+        if args.make:
+            run_make(myimg)
+    else:
+        if args.make:
+            run_make(myimg)
+        funcs = []
+        for name in target.split(","):
+            objfile, _ = search_map_file(name)
+            found = [f for f in search_map_file_functions(objfile) if f[0] == name] if objfile else []
+            if not found:
+                fail(f"Not able to find function {name} in map file.")
+            funcs.append(found[0])
+    if not funcs:
+        fail(f"No functions found for {args.batch}.")
+
+    # One disassembly of each image covers every function
+    start = min(f[1] for f in funcs)
+    end = max(f[2] for f in funcs)
+    base_header, base_rows = dump_binary_range(baseimg, start + base_shift, end + base_shift)
+    my_header, my_rows = dump_binary_range(myimg, start, end)
+
+    items = [
+        (name, slice_dump(base_header, base_rows, s + base_shift, e + base_shift), slice_dump(my_header, my_rows, s, e))
+        for name, s, e in funcs
+    ]
+
+    import multiprocessing
+
+    with multiprocessing.Pool(args.jobs) as pool:
+        results = pool.map(score_function, items)
+
+    width = max(len(r[0]) for r in results)
+    for name, score, mismatches, total in results:
+        status = "OK" if score == 0 else f"score {score}"
+        print(f"{name.ljust(width)}  {status:>12}  {mismatches}/{total} lines differ")
+
+
 # Alignment with ANSI colors is broken, let's fix it.
 def ansi_ljust(s, width):
     needed = width - ansiwrap.ansilen(s)
@@ -1216,6 +1379,12 @@ class Display:
 
 
 def main():
+    if args.batch is not None:
+        run_batch()
+        return
+    if args.start is None:
+        fail("A function name or start address is required.")
+
     if args.diff_elf_symbol:
         make_target, basecmd, mycmd = dump_elf()
     elif args.diff_obj:
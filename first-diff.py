@@ -1,6 +1,8 @@
 #!/usr/bin/env python3
 import os.path
 import argparse
+import bisect
+import hashlib
 from subprocess import check_call
 
 # TODO: -S argument for shifted ROMs
@@ -57,6 +59,18 @@ parser.add_argument(
 parser.add_argument(
     "-d", "--diff", action="store_true", help="run ./diff.py on the result"
 )
+parser.add_argument(
+    "-a",
+    "--all",
+    action="store_true",
+    help="list every differing function with byte counts, grouped by splat segment",
+)
+parser.add_argument(
+    "--block-size",
+    type=lambda x: int(x, 0),
+    default=0x10000,
+    help="block size to hash before bisecting in --all mode (default 0x10000)",
+)
 args = parser.parse_args()
 diff_count = args.count
 
@@ -246,6 +260,117 @@ if args.by_name:
             print("function", args.by_name, "not found")
     exit()
 
+# Hashing whole blocks first means matching regions cost one digest each; only
+# mismatching blocks are bisected down to LEAF_SIZE and then walked by word.
+LEAF_SIZE = 0x100
+
+
+def diff_ranges(lo, hi, out):
+    if hashlib.md5(mybin[lo:hi]).digest() == hashlib.md5(basebin[lo:hi]).digest():
+        return
+    if hi - lo > LEAF_SIZE:
+        mid = lo + (((hi - lo) // 2) & ~3)
+        diff_ranges(lo, mid, out)
+        diff_ranges(mid, hi, out)
+        return
+    for i in range(lo, hi, 4):
+        if mybin[i : i + 4] == basebin[i : i + 4]:
+            continue
+        if out and out[-1][1] == i:
+            out[-1][1] = i + 4
+        else:
+            out.append([i, i + 4])
+
+
+def find_diff_ranges(size, block_size):
+    out = []
+    for lo in range(0, size, block_size):
+        diff_ranges(lo, min(lo + block_size, size), out)
+    return out
+
+
+def parse_splat_segments(fname="splat.yaml"):
+    # Flattened (rom start, label) list of top-level segments and their
+    # subsections, sorted by ROM start.
+    import yaml
+
+    with open(fname) as f:
+        config = yaml.safe_load(f)
+    segs = []
+    for seg in config.get("segments", []):
+        if isinstance(seg, dict):
+            start = seg.get("start")
+            name = seg.get("name", seg.get("type", "?"))
+            subs = seg.get("subsections") or seg.get("subsegments") or []
+        elif isinstance(seg, list) and len(seg) >= 1:
+            start = seg[0]
+            name = seg[2] if len(seg) > 2 else (seg[1] if len(seg) > 1 else "?")
+            subs = []
+        else:
+            continue
+        if not isinstance(start, int):
+            continue
+        segs.append((start, name))
+        for sub in subs:
+            if not isinstance(sub, list) or not sub or not isinstance(sub[0], int):
+                continue
+            kind = sub[1] if len(sub) > 1 else "?"
+            subname = sub[2] if len(sub) > 2 else f"{sub[0]:X}"
+            segs.append((sub[0], f"{name}/{subname} ({kind})"))
+    segs.sort()
+    return segs
+
+
+def report_all_diffs():
+    size = min(len(mybin), len(basebin))
+    ranges = find_diff_ranges(size, args.block_size)
+    if len(mybin) != len(basebin):
+        print(f"ROM sizes differ: {hex(len(mybin))} vs {hex(len(basebin))}")
+    if not ranges:
+        print("No differences within the common length.")
+        return
+
+    syms = sorted(
+        (rom, name, file) for name, (rom, file, _, _) in parse_map(mymap).items()
+    )
+    sym_starts = [s[0] for s in syms]
+    try:
+        segs = parse_splat_segments()
+    except Exception as e:
+        print(f"(could not read splat.yaml: {e})")
+        segs = []
+    seg_starts = [s[0] for s in segs]
+
+    # (segment, file, function) -> [differing bytes, first ROM addr]
+    counts = {}
+    total = 0
+    for lo, hi in ranges:
+        for i in range(lo, hi):
+            if mybin[i] == basebin[i]:
+                continue
+            total += 1
+            s = bisect.bisect_right(sym_starts, i) - 1
+            fn, file = (syms[s][1], syms[s][2]) if s >= 0 else ("<start of rom>", "<no file>")
+            g = bisect.bisect_right(seg_starts, i) - 1
+            seg = segs[g][1] if g >= 0 else "<no segment>"
+            entry = counts.setdefault((seg, file, fn), [0, i])
+            entry[0] += 1
+
+    print(
+        f"{total} differing byte(s) in {len(ranges)} range(s), {len(counts)} function(s):"
+    )
+    last_seg = None
+    for (seg, file, fn), (n, first) in sorted(counts.items(), key=lambda kv: kv[1][1]):
+        if seg != last_seg:
+            print(f"{seg}:")
+            last_seg = seg
+        print(f"  {fn:40} {n:6} byte(s)  first at rom 0x{first:06x}  ({file})")
+
+
+if args.all:
+    report_all_diffs()
+    exit()
+
 found_instr_diff = []
 map_search_diff = []
 diffs = 0
@@ -36,22 +36,39 @@
 
 typedef unsigned char			u8;	/* unsigned  8-bit */
 typedef unsigned short			u16;	/* unsigned 16-bit */
+#ifdef __LP64__
+/* Host builds (make host), where long is 64-bit */
+typedef unsigned int			u32;	/* unsigned 32-bit */
+#else
 typedef unsigned long			u32;	/* unsigned 32-bit */
+#endif
 typedef unsigned long long		u64;	/* unsigned 64-bit */
 
 typedef signed char			s8;	/* signed  8-bit */
 typedef short				s16;	/* signed 16-bit */
+#ifdef __LP64__
+typedef int				s32;	/* signed 32-bit */
+#else
 typedef long				s32;	/* signed 32-bit */
+#endif
 typedef long long			s64;	/* signed 64-bit */
 
 typedef volatile unsigned char		vu8;	/* unsigned  8-bit */
 typedef volatile unsigned short		vu16;	/* unsigned 16-bit */
+#ifdef __LP64__
+typedef volatile unsigned int		vu32;	/* unsigned 32-bit */
+#else
 typedef volatile unsigned long		vu32;	/* unsigned 32-bit */
+#endif
 typedef volatile unsigned long long	vu64;	/* unsigned 64-bit */
 
 typedef volatile signed char		vs8;	/* signed  8-bit */
 typedef volatile short			vs16;	/* signed 16-bit */
+#ifdef __LP64__
+typedef volatile int			vs32;	/* signed 32-bit */
+#else
 typedef volatile long			vs32;	/* signed 32-bit */
+#endif
 typedef volatile long long		vs64;	/* signed 64-bit */
 
 typedef float				f32;	/* single prec floating point */
@@ -63,7 +63,9 @@ typedef struct UnkStruct80014614 {
     /* 0x04 */ void (*withFourArgs)(s32, s32, s32, s32);
     /* 0x04 */ void (*withFiveArgs)(s32, s32, s32, s32, u16);
     } unk4;
-    /* 0x08 */ char unk_00 [0x80];
+    /* 0x08 */ char unk_00 [0x1C - 0x08];
+    /* 0x1C */ void (*unk1C)(Gfx **gdl);
+    /* 0x20 */ char unk_20 [0x88 - 0x20];
     /* 0x88 */ s32 (*unk_88)(void);
 } UnkStruct80014614;
 
@@ -8,8 +8,32 @@
 void bootproc(void);
 void idle(void * arg);
 void mainproc(void * arg);
+u32 checksum_bytes(const u8 *start, const u8 *end, u32 sum);
+s32 checksum_job_start(s32 *record);
+s32 checksum_job_done(s32 *record);
+void checksum_jobs_tick(void);
 
 void test_write(void);
+void dbg_boot_times_print(void);
+void dbg_frame_times_print(void);
+void frame_pacing_set_fixed_step(u8 stepRetraces, u8 maxSteps);
+void dl_buffers_set_chaining(s32 enable);
+void dl_buffers_check(void);
+void dl_buffers_end_frame(void);
+Gfx *dl_buffers_submit_end(void);
+void dl_buffers_reset_peaks(void);
+void dl_tag(Gfx *gdl, s32 tag, char *file);
+void dl_tag_continue(Gfx *from, Gfx *to);
+void dl_tag_end_frame(Gfx *gdl);
+s32 dl_tag_get_range(s32 index, Gfx **start, Gfx **end, s32 *tag);
+void prof_draw(Gfx **gdl);
+void bench_start(BenchPath *path);
+s32 bench_is_running(void);
+void bench_record_begin(f32 mapX, f32 mapZ, s32 mapArg);
+BenchPath *bench_record_key(SRT *camera, s32 frames);
+void telemetry_set_enabled(s32 enabled);
+void telemetry_capture_dl(s32 frames);
+void telemetry_set_sink(s32 sink);
 void init_memory(void);
 void main_no_expPak(void);
 void main_expPak(void);
@@ -24,15 +48,40 @@ void * func_80023914(void);
 void some_crash_setter(DLLInst arg0[], s32 arg1);
 
 s32 read_file_region(u32 id, void *dst, u32 offset, s32 size);
+u32 get_file_rom_addr(u32 id, u32 offset);
+void romcopy_set_config(s32 chunkSize, s32 depth);
+void dcache_inval_dma(void *dst, s32 size, void *overwrite, s32 overwriteSize);
+void romcopy_dma(u32 romAddr, u8 *dst, s32 size, void *overwrite, s32 overwriteSize);
+
+s32 inflate_buffer(u8 *src, s32 srcSize, u8 *dst, s32 dstSize);
+void inflate_reset_timing(void);
+void inflate_get_timing(OSTime *total, u32 *bytesIn);
+void render_list_get_stats(s32 *blockItems, s32 *actorItems, s32 *blocks);
+void dbg_texture_transcode_print(void);
 
 void free(void* p);
 DLLFile * dll_load_from_tab(u16, u32 *);
 void dll_relocate(DLLFile* dll);
+void dll_preload(DLLPreload *list, s32 count);
+void dbg_dll_preload_print(void);
+void dbg_dll_residency_print(void);
+u32 *dll_load_lazy(u16 id, u16 exportCount);
 
 void *malloc(s32 arg0, s32 arg1, s32 arg2);
 void _bcopy(const void *src,void *dst,int length);
 
 void matrix_from_srt(MtxF *mf, SRT *srt);
+void camera_set_override(SRT *srt);
+s32 particle_emitter_add(Gfx *setup, s32 priority, Vec3f *accel);
+void particle_emitter_set_origin(s32 id, Vec3f *origin);
+void particle_emitter_remove(s32 id);
+s32 particle_spawn(s32 id, Vec3f *pos, Vec3f *vel, f32 size, s32 life, u32 color);
+void particle_update(s32 ticks);
+void particle_draw(Gfx **gdl, Mtx **rspMtxs, Vtx **vtxs);
+
+void vec3_batch_add_with_scale(f32 *x, f32 *y, f32 *z, f32 *vx, f32 *vy, f32 *vz, f32 scale, s32 count);
+
+
 
 // theta: [-32768..32768) => [-pi..pi)
 // returns: [-65536..65536] => [-1..1]
@@ -26,6 +26,122 @@ typedef struct
 /*000C*/	Vec3f transl;
 } SRT;
 
+#define BENCH_MAX_KEYS 16
+
+typedef struct
+{
+/*0000*/    SRT srt; // Camera position and angles
+/*0018*/    u16 frames; // To get from this key to the next
+/*001A*/    u16 unused1A;
+} BenchKey;
+
+// A reproducible benchmark workload, see bench_start
+typedef struct
+{
+/*0000*/    f32 mapX; // Where to warp to first
+/*0004*/    f32 mapZ;
+/*0008*/    s32 mapArg;
+/*000C*/    s32 keyCount;
+/*0010*/    BenchKey keys[BENCH_MAX_KEYS];
+} BenchPath;
+
+// Microseconds, per frame of a benchmark run
+typedef struct
+{
+/*0000*/    u32 frames;
+/*0004*/    u32 slowFrames; // Over 1/30th of a second of CPU, RSP or RDP time
+/*0008*/    u32 cpuTotal;
+/*000C*/    u32 cpuMax;
+/*0010*/    u32 rspTotal;
+/*0014*/    u32 rspMax;
+/*0018*/    u32 rdpTotal;
+/*001C*/    u32 rdpMax;
+} BenchStats;
+
+// Where a thread was when prof_sampler's timer went off
+typedef struct
+{
+/*0000*/    u32 pc;
+/*0004*/    u32 thread; // OSThread id of the thread that was running
+} ProfSample;
+
+// What prof_sampler saw one thread doing, in samples. Times are samples times
+// the sampling interval.
+typedef struct
+{
+/*0000*/    u32 id;
+/*0004*/    s32 priority;
+/*0008*/    u32 running;    // The thread that was running
+/*000C*/    u32 ready;      // Could run, but a higher priority thread was
+/*0010*/    u32 blocked;    // Waiting on a message queue, mostly in osRecvMesg
+/*0014*/    u32 switches;   // Running after another thread was on the sample before
+/*0018*/    u32 inverted;   // Blocked while a lower priority thread other than idle ran
+/*001C*/    u32 queue;      // The OSThread queue it was last blocked on, in an OSMesgQueue
+} ProfThreadStats;
+
+// A stack stack_watch poisoned, see stack_get_stats
+typedef struct
+{
+/*0000*/    u32 id;     // OSThread id of the thread it's for
+/*0004*/    u32 size;
+/*0008*/    u32 peak;   // The most of it the thread has used, in bytes
+} StackStats;
+
+// Bytes checksum_jobs_tick sums each frame, across all jobs
+#define CHECKSUM_BYTES_PER_FRAME 0x4000
+#define CHECKSUM_JOBS_MAX 4
+
+// A func_80001178 record being summed a slice per frame, see checksum_job_start
+typedef struct ChecksumJob
+{
+/*0000*/    s32 *record;    // NULL if the slot is free
+/*0004*/    s32 *range;     // Start and end of the range being summed
+/*0008*/    u8 *ptr;        // Next byte, NULL once past the last range
+/*000C*/    u32 sum;
+} ChecksumJob;
+
+// Where telemetry packets go, see telemetry_set_sink
+enum TelemetrySink {
+    TELEMETRY_SINK_HOST,        // osWriteHost, read by a development host
+    TELEMETRY_SINK_ISVIEWER     // Hex lines on the IS-Viewer, printed by emulators
+};
+
+// The frame buffers game_tick fills: gMainDL (D_800AE680), D_800AE690, D_800AE6A0, D_800AE6B0
+enum DLBuffer {
+    DL_BUFFER_GFX,
+    DL_BUFFER_MTX,
+    DL_BUFFER_VTX,
+    DL_BUFFER_6B0,
+
+    DL_BUFFER_COUNT
+};
+
+// Bytes, see dl_buffers_end_frame
+typedef struct
+{
+/*0000*/    u32 size[DL_BUFFER_COUNT];  // Of each half of the double buffer
+/*0010*/    u32 used[DL_BUFFER_COUNT];  // Last frame, chained chunks included
+/*0020*/    u32 peak[DL_BUFFER_COUNT];  // Since dl_buffers_reset_peaks
+/*0030*/    u32 chunks[DL_BUFFER_COUNT]; // Chunks chained on since dl_buffers_reset_peaks
+/*0040*/    u32 overflows;               // Checks that found a buffer full and couldn't chain
+} DLBufferStats;
+
+
+// Display list subsystems counted by dl_tag
+enum DLTag {
+    DL_TAG_SETUP,
+    DL_TAG_WORLD,   // func_80037A14, the render list included
+    DL_TAG_DLL,     // D_8008C974
+    DL_TAG_SUBTITLES,
+    DL_TAG_OVERLAYS,
+    DL_TAG_FINISH,
+
+    DL_TAG_COUNT
+};
+
+// Ranges kept per frame for the per-file breakdown, counts are kept regardless
+#define DL_TAG_MAX_RANGES 256
+
 typedef struct Texture
 {
 /*0000*/	u8 width;
@@ -49,6 +165,23 @@ typedef struct Texture
 /*001F*/	u8 maskt;
 } Texture; // Size: 0x20, followed by texture data
 
+// What texture_transcode does with large RGBA textures as they load
+enum TextureTranscode {
+    TEXTURE_TRANSCODE_OFF,
+    TEXTURE_TRANSCODE_REPORT,   // Only count the ones that could be smaller
+    TEXTURE_TRANSCODE_ON
+};
+
+// Textures texture_transcode looked at since boot, see dbg_texture_transcode_print
+typedef struct TextureTranscodeStats
+{
+/*0000*/    u32 seen;       // Large enough to look at
+/*0004*/    u32 ci4;        // RGBA16 with 16 colors or fewer
+/*0008*/    u32 i8;         // RGBA16 with only opaque greys, but more than 16
+/*000C*/    u32 rgba32;     // RGBA32 that would fit either without loss, not converted
+/*0010*/    u32 bytesSaved; // By the RGBA16 ones
+} TextureTranscodeStats;
+
 typedef struct
 {
 /*0000*/    u8 unk_0x0;
@@ -316,6 +449,12 @@ typedef struct
 /*000C*/	u32 * end;
 } DLLInst;
 
+typedef struct
+{
+/*0000*/	u16 id;
+/*0002*/	u16 exportCount;
+} DLLPreload;
+
 typedef void (*DLLFunc)(u32 a);
 
 typedef struct
@@ -479,6 +618,12 @@ extern float delayFloat;
 extern float delayFloatMirror;
 extern float inverseDelay; // 1/delayByte
 extern float inverseDelayMirror; // why the mirrors, if they aren't used?
+extern f32 gSimInterpAlpha; // see frame_pacing_set_fixed_step
+extern Mtx *D_800AE690;
+extern Vtx *D_800AE6A0;
+extern u8 *D_800AE6B0;
+extern DLBufferStats gDLBufferStats;
+extern u32 gDLTagBytes[DL_TAG_COUNT];
 
 extern struct TActor * object_pointer_array[]; //first is always player character.
 extern u16 objectCount;
@@ -496,4 +641,7 @@ extern s32 gLoadedDLLCount;
 
 extern DLLTab * gFile_DLLS_TAB;
 
+extern s8 gTextureTranscode;
+extern TextureTranscodeStats gTextureTranscodeStats;
+
 #endif
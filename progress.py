@@ -2,11 +2,12 @@
 #!/usr/bin/env python3
 
 import argparse
-import git
+import json
 import os
+import re
+import struct
 import subprocess
 import sys
-from colour import Color
 
 def set_version(version):
     global script_dir, root_dir, asm_dir, build_dir, elf_path
@@ -16,7 +17,7 @@ def set_version(version):
     build_dir = os.path.join(root_dir, "build")
     elf_path = os.path.join(build_dir, "dino.elf")
 
-def get_func_sizes():
+def get_func_sizes_objdump():
     try:
         result = subprocess.run(['objdump', '-x', elf_path], stdout=subprocess.PIPE)
         nm_lines = result.stdout.decode().split("\n")
@@ -37,6 +38,108 @@ def get_func_sizes():
 
     return sizes, total
 
+SHT_SYMTAB = 2
+STT_FUNC = 2
+
+def read_elf_funcs(path):
+    """Returns (name, address, size) for every function symbol in a 32-bit ELF."""
+    with open(path, "rb") as f:
+        data = f.read()
+
+    if data[:4] != b"\x7fELF" or data[4] != 1:
+        raise ValueError(f"{path} is not a 32-bit ELF")
+    endian = ">" if data[5] == 2 else "<"
+
+    shoff, = struct.unpack_from(endian + "I", data, 0x20)
+    shentsize, shnum = struct.unpack_from(endian + "HH", data, 0x2E)
+
+    sections = [struct.unpack_from(endian + "IIIIIIIIII", data, shoff + i * shentsize) for i in range(shnum)]
+
+    funcs = []
+    for sh_name, sh_type, sh_flags, sh_addr, sh_offset, sh_size, sh_link, sh_info, sh_addralign, sh_entsize in sections:
+        if sh_type != SHT_SYMTAB:
+            continue
+        strtab_offset = sections[sh_link][4]
+        for off in range(sh_offset, sh_offset + sh_size, sh_entsize):
+            st_name, st_value, st_size, st_info = struct.unpack_from(endian + "IIIB", data, off)
+            if st_info & 0xF != STT_FUNC:
+                continue
+            end = data.index(b"\0", strtab_offset + st_name)
+            funcs.append((data[strtab_offset + st_name:end].decode(), st_value, st_size))
+
+    return funcs
+
+MAP_TEXT_RE = re.compile(r"^ \.text\s+0x([0-9a-fA-F]+)\s+0x([0-9a-fA-F]+)\s+(\S+\.o)$")
+MAP_TEXT_WRAPPED_RE = re.compile(r"^\s+0x([0-9a-fA-F]+)\s+0x([0-9a-fA-F]+)\s+(\S+\.o)$")
+
+def read_map_text_ranges(path):
+    """Returns (start, end, object) for every object's .text in a GNU ld map."""
+    ranges = []
+    wrapped = False
+
+    with open(path) as f:
+        for line in f:
+            line = line.rstrip("\n")
+            m = MAP_TEXT_WRAPPED_RE.match(line) if wrapped else MAP_TEXT_RE.match(line)
+            wrapped = line == " .text"
+            if m and int(m.group(2), 16) != 0:
+                start = int(m.group(1), 16)
+                ranges.append((start, start + int(m.group(2), 16), m.group(3)))
+
+    ranges.sort()
+    return ranges
+
+def object_source(obj):
+    # build/src/main.o -> src/main.c, build/asm/foo.o -> asm/foo.s
+    path = os.path.relpath(obj, "build") if obj.startswith("build") else obj
+    return os.path.splitext(path)[0]
+
+def load_funcs(cache_path):
+    """
+    Returns the ELF's functions as (name, size, file) with file None when the
+    map doesn't place it, cached by the modification times of the ELF and map.
+    """
+    map_path = os.path.join(build_dir, "dino.map")
+    key = [os.path.getmtime(elf_path), os.path.getsize(elf_path),
+           os.path.getmtime(map_path) if os.path.exists(map_path) else None]
+
+    if os.path.exists(cache_path):
+        try:
+            with open(cache_path) as f:
+                cache = json.load(f)
+            if cache["key"] == key:
+                return cache["funcs"]
+        except (ValueError, KeyError):
+            pass
+
+    ranges = read_map_text_ranges(map_path) if os.path.exists(map_path) else []
+    starts = [r[0] for r in ranges]
+
+    import bisect
+    funcs = []
+    for name, addr, size in read_elf_funcs(elf_path):
+        i = bisect.bisect_right(starts, addr) - 1
+        file = object_source(ranges[i][2]) if i >= 0 and addr < ranges[i][1] else None
+        funcs.append((name, size, file))
+
+    with open(cache_path, "w") as f:
+        json.dump({"key": key, "funcs": funcs}, f)
+
+    return funcs
+
+def get_func_sizes():
+    if not os.path.exists(elf_path):
+        print(f"Error: {elf_path} doesn't exist - make sure that the project is built")
+        sys.exit(1)
+
+    sizes = {}
+    total = 0
+    for name, size, file in load_funcs(os.path.join(build_dir, "progress_cache.json")):
+        total += size
+        sizes[name] = size
+
+    return sizes, total
+
 def get_nonmatching_funcs():
     funcs = set()
 
@@ -63,13 +166,48 @@ def get_funcs_sizes(sizes, matchings, nonmatchings):
 
     return msize, nmsize
 
+def get_nonmatching_funcs_by_file():
+    # asm/nonmatchings/<file>/<func>.s
+    by_file = {}
+
+    for root, dirs, files in os.walk(asm_dir):
+        for f in files:
+            if f.endswith(".s"):
+                by_file.setdefault(os.path.relpath(root, asm_dir), set()).add(f[:-2])
+
+    return by_file
+
+def file_report(funcs):
+    """Per-file and per-subsystem (directory) progress, in bytes and functions."""
+    nonmatching = get_nonmatching_funcs_by_file()
+    files = {}
+
+    for name, size, file in funcs:
+        file = file or "(unknown)"
+        stats = files.setdefault(file, {"funcs": 0, "matching_funcs": 0, "size": 0, "matching_size": 0})
+        stats["funcs"] += 1
+        stats["size"] += size
+
+        # Nonmatching asm is split by file name alone
+        if name not in nonmatching.get(os.path.basename(file), ()):
+            stats["matching_funcs"] += 1
+            stats["matching_size"] += size
+
+    subsystems = {}
+    for file, stats in files.items():
+        sub = subsystems.setdefault(os.path.dirname(file) or ".", {"funcs": 0, "matching_funcs": 0, "size": 0, "matching_size": 0})
+        for k in sub:
+            sub[k] += stats[k]
+
+    return files, subsystems
+
 def lerp(a, b, alpha):
     return a + (b - a) * alpha
 
 def main(args):
     set_version(args.version)
 
-    func_sizes, total_size = get_func_sizes()
+    func_sizes, total_size = get_func_sizes_objdump() if args.objdump else get_func_sizes()
     all_funcs = set(func_sizes.keys())
 
     nonmatching_funcs = get_nonmatching_funcs()
@@ -84,7 +222,19 @@ def main(args):
         funcs_matching_ratio = (len(matching_funcs) / len(all_funcs)) * 100
         matching_ratio = (matching_size / total_size) * 100
 
-    if args.csv:
+    if args.json:
+        files, subsystems = file_report(load_funcs(os.path.join(build_dir, "progress_cache.json")))
+        print(json.dumps({
+            "funcs": len(all_funcs),
+            "matching_funcs": len(matching_funcs),
+            "size": total_size,
+            "matching_size": matching_size,
+            "subsystems": subsystems,
+            "files": files,
+        }, indent=1, sort_keys=True))
+    elif args.csv:
+        import git
+
         version = 1
         git_object = git.Repo().head.object
         timestamp = str(git_object.committed_date)
@@ -93,7 +243,7 @@ def main(args):
                     str(len(matching_funcs)), str(total_size), str(nonmatching_size), str(matching_size)]
         print(",".join(csv_list))
     elif args.shield_json:
-        import json
+        from colour import Color
 
         # https://shields.io/endpoint
         color = Color("#50ca22", hue=lerp(0, 105/255, matching_ratio / 100))
@@ -115,6 +265,8 @@ if __name__ == "__main__":
     parser.add_argument("version", default="current", nargs="?")
     parser.add_argument("--csv", action="store_true")
     parser.add_argument("--shield-json", action="store_true")
+    parser.add_argument("--json", action="store_true", help="per-file and per-subsystem progress")
+    parser.add_argument("--objdump", action="store_true", help="read sizes through objdump, as before")
     args = parser.parse_args()
 
     main(args)
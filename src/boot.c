@@ -1,4 +1,5 @@
 #include "common.h"
+#include "crash.h"
 
 #pragma GLOBAL_ASM("asm/nonmatchings/boot/func_80000B40.s")
 
@@ -22,6 +23,10 @@ void idle(void * arg)
 
     gMainThreadStack[1024] = 0;
     gMainThreadStack[0] = 0;
+#ifdef NON_MATCHING
+    // Above the timer tick's word at the bottom
+    stack_watch(3, &gMainThreadStack[1], (MAIN_THREAD_SIZE - 1) * sizeof(u64));
+#endif
 
     osStartThread(&gMainThread);
     osSetThreadPri(NULL, OS_PRIORITY_IDLE);
@@ -34,6 +39,155 @@ void thread_timer_tick(void) {
     ++gMainThreadStack[0];
 }
 
+#ifdef NON_MATCHING
+// Words summed into 16 bit lanes before they could overflow, 0xffff / (2 * 0xff)
+#define CHECKSUM_LANE_WORDS 128
+
+static ChecksumJob sChecksumJobs[CHECKSUM_JOBS_MAX];
+
+/**
+ * Adds up the bytes in [start, end), a word at a time with bytes at each end
+ * that aren't aligned. The same as summing them one by one.
+ */
+u32 checksum_bytes(const u8 *start, const u8 *end, u32 sum)
+{
+    const u32 *word;
+    const u32 *wordEnd;
+    const u32 *laneEnd;
+    u32 lanes;
+    u32 w;
+
+    while (start < end && ((u32)start & 3)) {
+        sum += *start++;
+    }
+
+    word = (const u32*)start;
+    wordEnd = (const u32*)((u32)end & ~3);
+    while (word < wordEnd)
+    {
+        laneEnd = word + CHECKSUM_LANE_WORDS < wordEnd ? word + CHECKSUM_LANE_WORDS : wordEnd;
+        lanes = 0;
+        while (word < laneEnd)
+        {
+            w = *word++;
+            lanes += (w & 0x00ff00ff) + ((w >> 8) & 0x00ff00ff);
+        }
+        sum += (lanes & 0xffff) + (lanes >> 16);
+    }
+
+    start = (const u8*)word;
+    while (start < end) {
+        sum += *start++;
+    }
+
+    return sum;
+}
+
+/**
+ * Sums the ranges in a func_80001178 record a slice per frame instead, see
+ * checksum_jobs_tick. The record is filled in as func_80001178 would once
+ * they're all done.
+ *
+ * @returns FALSE if there are too many running already.
+ */
+s32 checksum_job_start(s32 *record)
+{
+    s32 i;
+
+    for (i = 0; i < CHECKSUM_JOBS_MAX; i++)
+    {
+        if (sChecksumJobs[i].record == NULL)
+        {
+            *record = 1;
+            sChecksumJobs[i].record = record;
+            sChecksumJobs[i].range = &record[2];
+            sChecksumJobs[i].ptr = (u8*)record[2];
+            sChecksumJobs[i].sum = 0;
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+/**
+ * @returns Whether the record is done, or was never started.
+ */
+s32 checksum_job_done(s32 *record)
+{
+    s32 i;
+
+    for (i = 0; i < CHECKSUM_JOBS_MAX; i++)
+    {
+        if (sChecksumJobs[i].record == record) {
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+void checksum_jobs_tick(void)
+{
+    ChecksumJob *job;
+    u32 budget;
+    u8 *end;
+    s32 i;
+
+    budget = CHECKSUM_BYTES_PER_FRAME;
+    for (i = 0; i < CHECKSUM_JOBS_MAX && budget != 0; i++)
+    {
+        job = &sChecksumJobs[i];
+        if (job->record == NULL) {
+            continue;
+        }
+
+        while (job->ptr != NULL && budget != 0)
+        {
+            if (job->ptr >= (u8*)job->range[1])
+            {
+                job->range += 2;
+                job->ptr = (u8*)job->range[0];
+                continue;
+            }
+
+            end = (u8*)job->range[1];
+            if ((u32)(end - job->ptr) > budget) {
+                end = job->ptr + budget;
+            }
+
+            job->sum = checksum_bytes(job->ptr, end, job->sum);
+            budget -= end - job->ptr;
+            job->ptr = end;
+        }
+
+        if (job->ptr == NULL)
+        {
+            if (job->record[0] == 1) {
+                job->record[0] = 2;
+                job->record[1] = job->sum;
+            }
+            job->record = NULL;
+        }
+    }
+}
+
+void func_80001178(s32 a0, s32 *a1)
+{
+    s32 *range;
+    u32 count;
+
+    count = 0;
+    for (range = &a1[2]; range[0] != 0; range += 2) {
+        count = checksum_bytes((u8*)range[0], (u8*)range[1], count);
+    }
+
+    if (a1[0] == 1) {
+        a1[0] = 2;
+        a1[1] = count;
+    }
+}
+#else
 void func_80001178(s32 a0, s32 *a1)
 {
     u8  *ptr1;
@@ -63,6 +217,7 @@ void func_80001178(s32 a0, s32 *a1)
             ;
     }
 }
+#endif
 
 void func_800011F4(s32 a0, s32 *a1)
 {
@@ -45,6 +45,9 @@ void start_crash_thread(OSSched* scheduler) {
 
     func_8005D410(videoMode, scheduler, TRUE);
 
+#ifdef NON_MATCHING
+    stack_watch(CRASH_THREAD_ID, &gCrashThreadStack[0], OS_MIN_STACKSIZE);
+#endif
     osCreateThread(
         /*t*/       &gCrashThread, 
         /*id*/      CRASH_THREAD_ID, 
@@ -136,3 +139,274 @@ void stop_active_app_threads_2() {
 #endif
 
 #pragma GLOBAL_ASM("asm/nonmatchings/crash/func_80037678.s")
+
+#ifdef NON_MATCHING
+// Above every game thread so it runs as soon as its timer goes off, below the crash thread
+#define PROF_SAMPLER_PRI OS_PRIORITY_APPMAX
+#define PROF_SAMPLER_STACK_SIZE 0x400
+// Power of two, about 10 frames of samples at 100 per frame
+#define PROF_SAMPLER_BUFFER_LENGTH 1024
+// Threads prof_threads_get keeps totals for, more than the game creates
+#define PROF_MAX_THREADS 16
+
+s32 func_with_status_reg(void);
+void set_status_reg(s32);
+
+u32 gProfSamplerDropped;
+u32 gProfSamplerUsec;
+
+static OSThread sProfSamplerThread;
+static u64 sProfSamplerStack[PROF_SAMPLER_STACK_SIZE / sizeof(u64)];
+static OSMesgQueue sProfSamplerQueue;
+static OSMesg sProfSamplerQueueBuffer[1];
+static OSTimer sProfSamplerTimer;
+static OSTime sProfSamplerInterval;     // 0 once stopped
+static s8 sProfSamplerArmed;            // sProfSamplerTimer is set and not yet received
+static s8 sProfSamplerCreated;
+static ProfSample sProfSamples[PROF_SAMPLER_BUFFER_LENGTH];
+static u32 sProfSamplesHead;            // Written by the sampler thread only
+static u32 sProfSamplesTail;            // Written by prof_sampler_take only
+static OSThread *sProfThreads[PROF_MAX_THREADS];
+static ProfThreadStats sProfThreadStats[PROF_MAX_THREADS];
+static s32 sProfThreadCount;
+static OSThread *sProfLastRunning;
+
+static ProfThreadStats *prof_threads_find(OSThread *thread) {
+    s32 i;
+
+    for (i = 0; i < sProfThreadCount; i++) {
+        if (sProfThreads[i] == thread) {
+            return &sProfThreadStats[i];
+        }
+    }
+
+    if (sProfThreadCount == PROF_MAX_THREADS) {
+        return NULL;
+    }
+
+    sProfThreads[sProfThreadCount] = thread;
+    bzero(&sProfThreadStats[sProfThreadCount], sizeof(ProfThreadStats));
+    sProfThreadStats[sProfThreadCount].id = thread->id;
+    return &sProfThreadStats[sProfThreadCount++];
+}
+
+/**
+ * Counts what every thread was doing when running was preempted. A thread blocked
+ * while a lower priority one ran is waiting on something that one, or one it
+ * waits on in turn, has to do first: a priority inversion if so.
+ */
+static void prof_threads_census(OSThread *running) {
+    OSThread *thread;
+    ProfThreadStats *stats;
+
+    for (thread = __osGetActiveQueue(); thread->priority != -1; thread = thread->tlnext) {
+        if (thread == &sProfSamplerThread || (stats = prof_threads_find(thread)) == NULL) {
+            continue;
+        }
+
+        stats->priority = thread->priority;
+        if (thread == running) {
+            stats->running++;
+            if (sProfLastRunning != running) {
+                stats->switches++;
+            }
+        } else if (thread->state == OS_STATE_RUNNABLE) {
+            stats->ready++;
+        } else if (thread->state == OS_STATE_WAITING) {
+            stats->blocked++;
+            stats->queue = (u32)thread->queue;
+            if (running != NULL && running->priority < thread->priority && running->priority > OS_PRIORITY_IDLE) {
+                stats->inverted++;
+            }
+        }
+    }
+
+    sProfLastRunning = running;
+}
+
+/**
+ * Records the thread the sampler preempted: the highest priority one that can
+ * run, as the scheduler would have picked it. Its context holds the PC it was
+ * interrupted at, as the crash screen prints for faulted threads.
+ */
+static void prof_sampler_sample() {
+    OSThread *thread;
+    OSThread *running = NULL;
+    ProfSample *sample;
+    s32 sr = func_with_status_reg();
+
+    for (thread = __osGetActiveQueue(); thread->priority != -1; thread = thread->tlnext) {
+        if (thread != &sProfSamplerThread && thread->state == OS_STATE_RUNNABLE &&
+            (running == NULL || thread->priority > running->priority)) {
+            running = thread;
+        }
+    }
+
+    if (running != NULL) {
+        if (sProfSamplesHead - sProfSamplesTail == PROF_SAMPLER_BUFFER_LENGTH) {
+            gProfSamplerDropped++;
+        } else {
+            sample = &sProfSamples[sProfSamplesHead % PROF_SAMPLER_BUFFER_LENGTH];
+            sample->pc = running->context.pc;
+            sample->thread = running->id;
+            sProfSamplesHead++;
+        }
+    }
+
+    prof_threads_census(running);
+
+    set_status_reg(sr);
+}
+
+static void prof_sampler_entry(void *arg) {
+    OSMesgQueue *queue = (OSMesgQueue *)arg;
+    OSMesg msg;
+
+    while (TRUE) {
+        osRecvMesg(queue, &msg, OS_MESG_BLOCK);
+
+        // There's no osStopTimer, so each sample sets a one shot timer for the next
+        if (sProfSamplerInterval == 0) {
+            sProfSamplerArmed = FALSE;
+            continue;
+        }
+
+        prof_sampler_sample();
+        osSetTimer(&sProfSamplerTimer, sProfSamplerInterval, 0, queue, NULL);
+    }
+}
+
+void prof_sampler_start(u32 usec) {
+    if (!sProfSamplerCreated) {
+        osCreateMesgQueue(&sProfSamplerQueue, &sProfSamplerQueueBuffer[0], 1);
+        osCreateThread(
+            /*t*/       &sProfSamplerThread,
+            /*id*/      PROF_SAMPLER_THREAD_ID,
+            /*entry*/   &prof_sampler_entry,
+            /*arg*/     &sProfSamplerQueue,
+            /*sp*/      &sProfSamplerStack[PROF_SAMPLER_STACK_SIZE / sizeof(u64)],
+            /*pri*/     PROF_SAMPLER_PRI
+        );
+        osStartThread(&sProfSamplerThread);
+        sProfSamplerCreated = TRUE;
+    }
+
+    if (sProfSamplerInterval == 0) {
+        gProfSamplerDropped = 0;
+        sProfThreadCount = 0;
+        sProfLastRunning = NULL;
+    }
+    gProfSamplerUsec = usec != 0 ? usec : 1;
+    sProfSamplerInterval = OS_USEC_TO_CYCLES(gProfSamplerUsec);
+
+    if (!sProfSamplerArmed) {
+        sProfSamplerArmed = TRUE;
+        osSetTimer(&sProfSamplerTimer, sProfSamplerInterval, 0, &sProfSamplerQueue, NULL);
+    }
+}
+
+void prof_sampler_stop() {
+    sProfSamplerInterval = 0;
+    gProfSamplerUsec = 0;
+}
+
+s32 prof_sampler_take(ProfSample *out, s32 max) {
+    s32 count = 0;
+
+    while (count < max && sProfSamplesTail != sProfSamplesHead) {
+        out[count++] = sProfSamples[sProfSamplesTail % PROF_SAMPLER_BUFFER_LENGTH];
+        sProfSamplesTail++;
+    }
+
+    return count;
+}
+s32 prof_threads_get(ProfThreadStats *out, s32 max) {
+    s32 sr = func_with_status_reg();
+    s32 count = sProfThreadCount < max ? sProfThreadCount : max;
+
+    bcopy(sProfThreadStats, out, count * sizeof(ProfThreadStats));
+    set_status_reg(sr);
+
+    return count;
+}
+
+// Stacks stack_watch can be given, one per thread
+#define STACK_MAX_WATCHED 8
+// What init_memory fills memory with, and stack_watch fills a stack with
+#define STACK_POISON 0xFFFFFFFF
+
+typedef struct {
+    u32 *base;      // Lowest word of the stack, the last one a thread would use
+    u32 words;
+    u32 untouched;  // Words from base still holding STACK_POISON at the last scan
+    u32 id;
+} StackWatch;
+
+static StackWatch sStackWatches[STACK_MAX_WATCHED];
+static s32 sStackWatchCount;
+
+void stack_watch(u32 id, void *base, u32 size) {
+    StackWatch *watch;
+    u32 *word;
+    s32 i;
+
+    for (i = 0; i < sStackWatchCount; i++) {
+        if (sStackWatches[i].base == base) {
+            break;
+        }
+    }
+
+    if (i == STACK_MAX_WATCHED) {
+        return;
+    }
+
+    watch = &sStackWatches[i];
+    watch->base = (u32 *)base;
+    watch->words = size / sizeof(u32);
+    watch->untouched = watch->words;
+    watch->id = id;
+
+    for (word = watch->base; word < watch->base + watch->words; word++) {
+        *word = STACK_POISON;
+    }
+
+    if (i == sStackWatchCount) {
+        sStackWatchCount++;
+    }
+}
+
+/**
+ * Stacks grow down, so everything from a stack's base up to the lowest word its
+ * thread has ever written is still poison. That run only gets shorter, so each
+ * scan only has to look at what was left of it last time.
+ */
+void stack_scan() {
+    StackWatch *watch;
+    u32 untouched;
+    s32 i;
+
+    for (i = 0; i < sStackWatchCount; i++) {
+        watch = &sStackWatches[i];
+
+        untouched = 0;
+        while (untouched < watch->untouched && watch->base[untouched] == STACK_POISON) {
+            untouched++;
+        }
+
+        watch->untouched = untouched;
+    }
+}
+
+s32 stack_get_stats(StackStats *out, s32 max) {
+    s32 count = sStackWatchCount < max ? sStackWatchCount : max;
+    s32 i;
+
+    for (i = 0; i < count; i++) {
+        out[i].id = sStackWatches[i].id;
+        out[i].size = sStackWatches[i].words * sizeof(u32);
+        out[i].peak = (sStackWatches[i].words - sStackWatches[i].untouched) * sizeof(u32);
+    }
+
+    return count;
+}
+#endif
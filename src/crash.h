@@ -4,7 +4,60 @@
 #include "ultra64.h"
 
 #define CRASH_THREAD_ID 0x64
+#define PROF_SAMPLER_THREAD_ID 0x65
 
 void start_crash_thread(OSSched* scheduler);
 
+/**
+ * Starts sampling the PC of whichever thread is running every usec microseconds,
+ * or changes the interval if already running. See prof_sampler_take.
+ */
+void prof_sampler_start(u32 usec);
+
+/**
+ * Stops sampling after the sample already due.
+ */
+void prof_sampler_stop();
+
+/**
+ * Moves up to max of the oldest samples not taken yet into out.
+ *
+ * @returns The count moved.
+ */
+s32 prof_sampler_take(ProfSample *out, s32 max);
+
+/**
+ * Copies up to max of the per thread totals gathered with the samples, one for
+ * each thread seen since prof_sampler_start, into out.
+ *
+ * @returns The count copied.
+ */
+s32 prof_threads_get(ProfThreadStats *out, s32 max);
+
+/**
+ * Fills the size bytes of stack at base with poison so stack_scan can find how
+ * deep its thread has gone. Call before the thread starts, watching a stack again
+ * starts it over.
+ */
+void stack_watch(u32 id, void *base, u32 size);
+
+/**
+ * Updates the deepest use of each watched stack. Cheap once stacks have been
+ * used, but it reads every untouched word, so call it every so often.
+ */
+void stack_scan();
+
+/**
+ * Copies up to max watched stacks' sizes and deepest use as of the last
+ * stack_scan into out.
+ *
+ * @returns The count copied.
+ */
+s32 stack_get_stats(StackStats *out, s32 max);
+
+// Samples lost to a full buffer since prof_sampler_start
+extern u32 gProfSamplerDropped;
+// Microseconds between samples, 0 while stopped
+extern u32 gProfSamplerUsec;
+
 #endif
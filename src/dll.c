@@ -1,9 +1,20 @@
 #include "common.h"
+#include "filesystem.h"
 
 #define MAX_LOADED_DLLS 128
+#define DLL_EXPORTS_UNKNOWN 0xFFFF
 
 extern u32* gFile_DLLSIMPORTTAB;
 
+#ifdef NON_MATCHING
+// Only read while relocating a DLL, so it is left in ROM, see dll_imports_open
+static RomTable sDLLImports;
+
+static s32 dll_relocate_checked(DLLFile* dll);
+s32 func_with_status_reg(void);
+void set_status_reg(s32);
+#endif
+
 // close
 #if 1
 #pragma GLOBAL_ASM("asm/nonmatchings/dll/init_dll_system.s")
@@ -46,6 +57,693 @@ DLLInst * func_8000BDE8(u32 * arg0) {
 
 #pragma GLOBAL_ASM("asm/nonmatchings/dll/dll_load_deferred.s")
 
+#ifdef NON_MATCHING
+extern u32 gDLLCount;
+
+// Per DLL id, kept apart from DLLInst since its 16 byte layout is relied on by slot math
+typedef struct DLLStats {
+/*0000*/ u32 loadCount;   // Loads from nothing, not reference count increments
+/*0004*/ u32 unloadCount;
+/*0008*/ u32 loadUs;      // Cumulative
+/*000C*/ u32 bytes;       // Cumulative
+} DLLStats;
+
+// Slot in gLoadedDLLList for each DLL id, -1 if not loaded
+static s16 *sDLLSlotById;
+static DLLStats *sDLLStats;
+// Export count from each DLL's header, once one of its images has been seen
+static u16 *sDLLExportCounts;
+// Free slots below gLoadedDLLCount, may hold stale entries (checked when popped)
+static u8 sDLLFreeSlots[MAX_LOADED_DLLS];
+static s32 sDLLFreeSlotCount;
+static s32 sDLLIndexReady;
+
+// Any of the tables may fail to allocate, each one only backs a shortcut, so
+// without it the old scans and unknown export counts are used instead
+static void dll_index_init(void)
+{
+    s32 i;
+
+    sDLLIndexReady = TRUE;
+
+    sDLLSlotById = malloc(gDLLCount * sizeof(s16), 4, 0);
+    if (sDLLSlotById != NULL) {
+        for (i = 0; i < (s32)gDLLCount; i++) {
+            sDLLSlotById[i] = -1;
+        }
+    }
+
+    sDLLStats = malloc(gDLLCount * sizeof(DLLStats), 4, 0);
+    if (sDLLStats != NULL) {
+        bzero(sDLLStats, gDLLCount * sizeof(DLLStats));
+    }
+
+    sDLLExportCounts = malloc(gDLLCount * sizeof(u16), 4, 0);
+    if (sDLLExportCounts != NULL) {
+        for (i = 0; i < (s32)gDLLCount; i++) {
+            sDLLExportCounts[i] = DLL_EXPORTS_UNKNOWN;
+        }
+    }
+
+    sDLLFreeSlotCount = 0;
+    for (i = 0; i < gLoadedDLLCount; i++)
+    {
+        if (gLoadedDLLList[i].id == 0xFFFFFFFF) {
+            sDLLFreeSlots[sDLLFreeSlotCount++] = i;
+        } else if (sDLLSlotById != NULL && gLoadedDLLList[i].id < gDLLCount) {
+            sDLLSlotById[gLoadedDLLList[i].id] = i;
+        }
+    }
+}
+
+static void dll_note_export_count(u32 id, DLLFile *dll)
+{
+    if (sDLLExportCounts != NULL && id < gDLLCount) {
+        sDLLExportCounts[id] = dll->exportCount;
+    }
+}
+
+// Whether a request for exportCount exports is known to fail, without touching ROM
+static s32 dll_exports_short(u32 id, u16 exportCount)
+{
+    if (!sDLLIndexReady) {
+        dll_index_init();
+    }
+    if (id >= gDLLCount || sDLLExportCounts == NULL || sDLLExportCounts[id] == DLL_EXPORTS_UNKNOWN) {
+        return FALSE;
+    }
+
+    return sDLLExportCounts[id] < exportCount;
+}
+
+static s32 dll_index_find(u32 id)
+{
+    s32 slot;
+
+    if (!sDLLIndexReady) {
+        dll_index_init();
+    }
+    if (sDLLSlotById == NULL) {
+        for (slot = 0; slot < gLoadedDLLCount; slot++)
+        {
+            if (gLoadedDLLList[slot].id == id) {
+                return slot;
+            }
+        }
+        return -1;
+    }
+    if (id >= gDLLCount) {
+        return -1;
+    }
+
+    // Cheap to check, and keeps the table honest if a slot is freed behind its back
+    slot = sDLLSlotById[id];
+    if (slot != -1 && (slot >= gLoadedDLLCount || gLoadedDLLList[slot].id != id)) {
+        slot = sDLLSlotById[id] = -1;
+    }
+
+    return slot;
+}
+
+/**
+ * @returns A free slot in gLoadedDLLList, growing the list if needed, or -1 if it is full.
+ *
+ * @details Only unloads that go through dll_index_remove push their slot, so an
+ * empty stack still falls back to scanning for holes freed some other way.
+ */
+static s32 dll_index_alloc_slot(void)
+{
+    s32 slot;
+
+    while (sDLLFreeSlotCount != 0)
+    {
+        slot = sDLLFreeSlots[--sDLLFreeSlotCount];
+        if (slot < gLoadedDLLCount && gLoadedDLLList[slot].id == 0xFFFFFFFF) {
+            return slot;
+        }
+    }
+
+    for (slot = 0; slot < gLoadedDLLCount; slot++)
+    {
+        if (gLoadedDLLList[slot].id == 0xFFFFFFFF) {
+            return slot;
+        }
+    }
+
+    if (gLoadedDLLCount == MAX_LOADED_DLLS) {
+        return -1;
+    }
+
+    return gLoadedDLLCount++;
+}
+
+static void dll_index_insert(u32 id, s32 slot)
+{
+    if (sDLLSlotById != NULL && id < gDLLCount) {
+        sDLLSlotById[id] = slot;
+    }
+}
+
+// Called once the slot's DLL is unloaded
+static void dll_index_remove(s32 slot)
+{
+    s32 i;
+
+    if (sDLLSlotById != NULL && gLoadedDLLList[slot].id < gDLLCount) {
+        sDLLSlotById[gLoadedDLLList[slot].id] = -1;
+    }
+    gLoadedDLLList[slot].id = 0xFFFFFFFF;
+
+    if (sDLLFreeSlotCount == MAX_LOADED_DLLS)
+    {
+        // Only stale entries can fill it, start over from the list
+        sDLLFreeSlotCount = 0;
+        for (i = 0; i < gLoadedDLLCount; i++)
+        {
+            if (gLoadedDLLList[i].id == 0xFFFFFFFF) {
+                sDLLFreeSlots[sDLLFreeSlotCount++] = i;
+            }
+        }
+        return;
+    }
+
+    sDLLFreeSlots[sDLLFreeSlotCount++] = slot;
+}
+
+#define DLL_CACHE_ENTRIES 32
+
+enum DLLCacheState {
+    DLL_CACHE_FREE,
+    DLL_CACHE_LOADED,   // In use, the snapshot is kept for when it unloads
+    DLL_CACHE_RESIDENT, // Unloaded, image kept as it was relocated
+    DLL_CACHE_TAKEN     // Handed back to dll_load, not yet in a slot
+};
+
+// A relocated DLL image kept across unloads. Code and relocated rodata never change
+// after dll_relocate, so only .data needs restoring from the snapshot and .bss clearing.
+typedef struct DLLCacheEntry {
+/*0000*/ DLLFile *image;
+/*0004*/ u8 *dataCopy;
+/*0008*/ u32 dataSize;
+/*000C*/ u32 totalSize;
+/*0010*/ u32 lastUse;
+/*0014*/ u16 id;
+/*0016*/ u8 state;
+} DLLCacheEntry;
+
+// 0 disables the cache
+u32 gDLLCacheBudget = 0x20000;
+
+static DLLCacheEntry sDLLCache[DLL_CACHE_ENTRIES];
+static u32 sDLLCacheBytes;
+static u32 sDLLCacheClock;
+
+static u32 dll_get_bss_size(u32 id)
+{
+    return (&gFile_DLLS_TAB->entries[id + 1] - 2)->bssSize;
+}
+
+static DLLCacheEntry *dll_cache_find(u32 id)
+{
+    s32 i;
+
+    for (i = 0; i < DLL_CACHE_ENTRIES; i++)
+    {
+        if (sDLLCache[i].state != DLL_CACHE_FREE && sDLLCache[i].id == id) {
+            return &sDLLCache[i];
+        }
+    }
+
+    return NULL;
+}
+
+static void dll_cache_release(DLLCacheEntry *entry)
+{
+    sDLLCacheBytes -= entry->dataSize;
+    if (entry->state == DLL_CACHE_RESIDENT) {
+        sDLLCacheBytes -= entry->totalSize;
+        free(entry->image);
+    }
+
+    free(entry->dataCopy);
+    entry->state = DLL_CACHE_FREE;
+}
+
+/**
+ * Drops least recently used images until bytes more fit in the budget.
+ * Entries of loaded DLLs only go once no resident images are left.
+ */
+static s32 dll_cache_make_room(u32 bytes, DLLCacheEntry *keep)
+{
+    DLLCacheEntry *oldest;
+    s32 pass;
+    s32 i;
+
+    for (pass = DLL_CACHE_RESIDENT; sDLLCacheBytes + bytes > gDLLCacheBudget; )
+    {
+        oldest = NULL;
+        for (i = 0; i < DLL_CACHE_ENTRIES; i++)
+        {
+            if (sDLLCache[i].state == pass && &sDLLCache[i] != keep &&
+                    (oldest == NULL || sDLLCache[i].lastUse < oldest->lastUse)) {
+                oldest = &sDLLCache[i];
+            }
+        }
+
+        if (oldest != NULL) {
+            dll_cache_release(oldest);
+        } else if (pass == DLL_CACHE_RESIDENT) {
+            pass = DLL_CACHE_LOADED;
+        } else {
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+// Called once a freshly loaded DLL has its slot
+static void dll_cache_snapshot(u32 id, DLLFile *dll, u32 totalSize)
+{
+    DLLCacheEntry *entry;
+    u32 dataSize;
+    s32 i;
+
+    entry = dll_cache_find(id);
+    if (entry != NULL)
+    {
+        if (entry->state == DLL_CACHE_TAKEN && entry->image == dll) {
+            entry->state = DLL_CACHE_LOADED;
+            entry->lastUse = ++sDLLCacheClock;
+            return;
+        }
+        dll_cache_release(entry);
+    }
+
+    dataSize = totalSize - dll_get_bss_size(id) - dll->data;
+    if (gDLLCacheBudget == 0 || !dll_cache_make_room(dataSize, NULL)) {
+        return;
+    }
+
+    for (i = 0; i < DLL_CACHE_ENTRIES; i++)
+    {
+        if (sDLLCache[i].state == DLL_CACHE_FREE) {
+            break;
+        }
+    }
+    if (i == DLL_CACHE_ENTRIES) {
+        return;
+    }
+
+    entry = &sDLLCache[i];
+    entry->dataCopy = malloc(dataSize, 4, 0);
+    if (entry->dataCopy == NULL) {
+        return;
+    }
+
+    bcopy((u8*)dll + dll->data, entry->dataCopy, dataSize);
+    entry->image = dll;
+    entry->dataSize = dataSize;
+    entry->totalSize = totalSize;
+    entry->id = id;
+    entry->state = DLL_CACHE_LOADED;
+    entry->lastUse = ++sDLLCacheClock;
+    sDLLCacheBytes += dataSize;
+}
+
+/**
+ * Called when a DLL unloads, after its dtor.
+ *
+ * @returns TRUE if the cache kept the image, which the caller must then leave alone.
+ */
+static s32 dll_cache_keep(u32 id, DLLFile *dll)
+{
+    DLLCacheEntry *entry;
+
+    entry = dll_cache_find(id);
+    if (entry == NULL || entry->state != DLL_CACHE_LOADED || entry->image != dll) {
+        return FALSE;
+    }
+
+    if (!dll_cache_make_room(entry->totalSize, entry)) {
+        dll_cache_release(entry);
+        return FALSE;
+    }
+
+    entry->state = DLL_CACHE_RESIDENT;
+    entry->lastUse = ++sDLLCacheClock;
+    sDLLCacheBytes += entry->totalSize;
+
+    return TRUE;
+}
+
+/**
+ * @returns A cached image of the DLL, back in its just-relocated state, or NULL.
+ */
+static DLLFile *dll_cache_take(u32 id, u32 *totalSize)
+{
+    DLLCacheEntry *entry;
+    DLLFile *dll;
+    u32 fileSize;
+
+    entry = dll_cache_find(id);
+    if (entry == NULL || entry->state != DLL_CACHE_RESIDENT) {
+        return NULL;
+    }
+
+    dll = entry->image;
+    fileSize = dll->data + entry->dataSize;
+    bcopy(entry->dataCopy, (u8*)dll + dll->data, entry->dataSize);
+    if (entry->totalSize > fileSize) {
+        bzero((u8*)dll + fileSize, entry->totalSize - fileSize);
+    }
+
+    sDLLCacheBytes -= entry->totalSize;
+    entry->state = DLL_CACHE_TAKEN;
+    *totalSize = entry->totalSize;
+
+    return dll;
+}
+
+#define DLL_MAX_PRELOAD 48
+
+typedef struct DLLPreloadItem {
+/*0000*/ DLLFile *dll;
+/*0004*/ u32 offset;
+/*0008*/ u32 dataSize;
+/*000C*/ u32 bssSize;
+/*0010*/ s32 handle;
+/*0014*/ u16 id;
+/*0016*/ u16 exportCount;
+} DLLPreloadItem;
+
+typedef struct DLLPreloadTiming {
+/*0000*/ u32 bytes;
+/*0004*/ u32 waitUs;  // Blocked on its DMA
+/*0008*/ u32 relocUs;
+/*000C*/ u16 id;
+} DLLPreloadTiming;
+
+void dummied_print_func(const char *fmt, ...);
+
+static DLLPreloadTiming sDLLPreloadTimes[DLL_MAX_PRELOAD];
+static s32 sDLLPreloadCount;
+
+// Same bank remapping as dll_load
+static u16 dll_resolve_id(u16 id)
+{
+    if (id >= 0x8000) {
+        return id - 0x8000 + gFile_DLLS_TAB->bank2;
+    } else if (id >= 0x2000) {
+        return id - 0x2000 + gFile_DLLS_TAB->bank1 + 1;
+    } else if (id >= 0x1000) {
+        return id - 0x1000 + gFile_DLLS_TAB->bank0 + 1;
+    }
+
+    return id;
+}
+
+// Relocates a preloaded image and parks it in the cache for dll_load to take
+static void dll_preload_finish(DLLPreloadItem *item, DLLPreloadTiming *timing)
+{
+    DLLCacheEntry *entry;
+    OSTime start;
+
+    start = osGetTime();
+    read_file_async_wait(item->handle);
+    timing->waitUs = OS_CYCLES_TO_USEC(osGetTime() - start);
+
+    start = osGetTime();
+    dll_note_export_count(item->id, item->dll);
+    if (item->dll->exportCount < item->exportCount) {
+        free(item->dll);
+        return;
+    }
+
+    if (item->bssSize != 0) {
+        bzero((u8*)item->dll + item->dataSize, item->bssSize);
+    }
+    if (!dll_relocate_checked(item->dll)) {
+        free(item->dll);
+        return;
+    }
+    osInvalICache(item->dll, 0x4000);
+    osInvalDCache(item->dll, 0x4000);
+    timing->relocUs = OS_CYCLES_TO_USEC(osGetTime() - start);
+
+    dll_cache_snapshot(item->id, item->dll, item->dataSize + item->bssSize);
+    entry = dll_cache_find(item->id);
+    if (entry == NULL || entry->image != item->dll) {
+        free(item->dll);
+        return;
+    }
+
+    entry->state = DLL_CACHE_RESIDENT;
+    sDLLCacheBytes += entry->totalSize;
+}
+
+void dll_preload(DLLPreload *list, s32 count)
+{
+    DLLPreloadItem items[DLL_MAX_PRELOAD];
+    DLLPreloadItem tmp;
+    DLLTabEntry *entry;
+    u32 budget;
+    s32 n;
+    s32 i;
+    s32 j;
+
+    // The images are handed over through the cache
+    if (gDLLCacheBudget == 0) {
+        return;
+    }
+    if (!sDLLIndexReady) {
+        dll_index_init();
+    }
+
+    n = 0;
+    for (i = 0; i < count && n < DLL_MAX_PRELOAD; i++)
+    {
+        items[n].id = dll_resolve_id(list[i].id);
+        items[n].exportCount = list[i].exportCount;
+        if (dll_index_find(items[n].id) != -1 || dll_cache_find(items[n].id) != NULL) {
+            continue;
+        }
+        if (dll_exports_short(items[n].id, items[n].exportCount)) {
+            continue;
+        }
+
+        entry = &gFile_DLLS_TAB->entries[items[n].id + 1] - 2;
+        items[n].offset = entry->offset;
+        items[n].dataSize = entry[1].offset - entry->offset;
+        items[n].bssSize = entry->bssSize;
+        n++;
+    }
+
+    // In ROM order, so the reads run back to back
+    for (i = 1; i < n; i++)
+    {
+        tmp = items[i];
+        for (j = i; j > 0 && items[j - 1].offset > tmp.offset; j--) {
+            items[j] = items[j - 1];
+        }
+        items[j] = tmp;
+    }
+
+    // Nothing may be evicted before dll_load takes it, which brings the total back down
+    budget = gDLLCacheBudget;
+    gDLLCacheBudget = 0xFFFFFFFF;
+
+    // Keep one read streaming while the previous image relocates
+    sDLLPreloadCount = 0;
+    j = 0;
+    for (i = 0; i <= n; i++)
+    {
+        if (i < n)
+        {
+            items[i].dll = malloc(items[i].dataSize + items[i].bssSize, 4, 0);
+            items[i].handle = items[i].dll != NULL ?
+                read_file_region_async(DLLS_BIN, items[i].dll, items[i].offset, items[i].dataSize, NULL) :
+                FILE_READ_INVALID_HANDLE;
+            if (items[i].handle == FILE_READ_INVALID_HANDLE && items[i].dll != NULL) {
+                free(items[i].dll);
+                items[i].dll = NULL;
+            }
+        }
+
+        for (; j < i; j++)
+        {
+            if (items[j].dll == NULL) {
+                continue;
+            }
+
+            sDLLPreloadTimes[sDLLPreloadCount].id = items[j].id;
+            sDLLPreloadTimes[sDLLPreloadCount].bytes = items[j].dataSize;
+            dll_preload_finish(&items[j], &sDLLPreloadTimes[sDLLPreloadCount]);
+            sDLLPreloadCount++;
+        }
+    }
+
+    gDLLCacheBudget = budget;
+}
+
+static void dll_stats_note_load(u32 id, u32 bytes, OSTime start)
+{
+    if (sDLLStats != NULL && id < gDLLCount) {
+        sDLLStats[id].loadCount++;
+        sDLLStats[id].bytes += bytes;
+        sDLLStats[id].loadUs += OS_CYCLES_TO_USEC(osGetTime() - start);
+    }
+}
+
+static void dll_stats_note_unload(u32 id)
+{
+    if (sDLLStats != NULL && id < gDLLCount) {
+        sDLLStats[id].unloadCount++;
+    }
+}
+
+/**
+ * Lists resident DLLs, largest first, with their reference counts and how often
+ * each has been loaded and unloaded so far.
+ */
+void dbg_dll_residency_print(void)
+{
+    DLLInst *list;
+    u8 order[MAX_LOADED_DLLS];
+    u32 count;
+    u32 size;
+    u32 id;
+    s32 n;
+    s32 i;
+    s32 j;
+    u8 tmp;
+
+    list = func_8000BDE8(&count);
+
+    n = 0;
+    for (i = 0; i < (s32)count; i++)
+    {
+        if (list[i].id != 0xFFFFFFFF) {
+            order[n++] = i;
+        }
+    }
+
+    for (i = 1; i < n; i++)
+    {
+        tmp = order[i];
+        size = list[tmp].end - list[tmp].exports;
+        for (j = i; j > 0 && (u32)(list[order[j - 1]].end - list[order[j - 1]].exports) < size; j--) {
+            order[j] = order[j - 1];
+        }
+        order[j] = tmp;
+    }
+
+    for (i = 0; i < n; i++)
+    {
+        id = list[order[i]].id;
+        dummied_print_func("dll %d: %d bytes, %d refs", id,
+            (u32)list[order[i]].end - (u32)list[order[i]].exports + 0x18, list[order[i]].refCount);
+        if (sDLLStats != NULL && id < gDLLCount) {
+            dummied_print_func(", %d loads %d unloads %d us %d bytes read", sDLLStats[id].loadCount,
+                sDLLStats[id].unloadCount, sDLLStats[id].loadUs, sDLLStats[id].bytes);
+        }
+        dummied_print_func("\n");
+    }
+}
+
+#define DLL_LAZY_MAX_HANDLES 4
+#define DLL_LAZY_MAX_EXPORTS 16
+
+// Looks like a DLLInst from exports on, so callers can't tell the difference
+typedef struct DLLLazy {
+/*0000*/ u32 *exports; // The stub table until the first call
+/*0004*/ u32 *inst;    // &DLLInst.exports once loaded
+/*0008*/ u16 id;
+/*000A*/ u16 exportCount;
+} DLLLazy;
+
+typedef s64 (*DLLLazyFunc)(s32, s32, s32, s32, s32, s32, s32, s32);
+
+u32 *dll_load(u16 id, u16 exportCount, s32 arg2);
+
+static DLLLazy sDLLLazy[DLL_LAZY_MAX_HANDLES];
+static s32 sDLLLazyCount;
+
+static DLLLazyFunc dll_lazy_resolve(s32 h, s32 idx)
+{
+    DLLLazy *lazy;
+
+    lazy = &sDLLLazy[h];
+    if (lazy->inst == NULL)
+    {
+        lazy->inst = dll_load(lazy->id, lazy->exportCount, 1);
+        if (lazy->inst == NULL) {
+            return NULL;
+        }
+        // Every later call through the handle goes straight to the DLL
+        lazy->exports = *(u32**)lazy->inst;
+    }
+
+    return (DLLLazyFunc)lazy->exports[idx];
+}
+
+// Eight words covers a0-a3 plus four stack arguments. The return is s64 so both
+// v0 and v1 come back untouched, and float results in f0 pass through. Float
+// arguments in f12/f14 don't survive the first call, since the DLL's ctor runs
+// in between, so only bind DLLs lazily whose exports take integers and pointers.
+#define DLL_LAZY_STUB(h, idx) \
+    static s64 dll_lazy_stub_##h##_##idx(s32 a0, s32 a1, s32 a2, s32 a3, s32 a4, s32 a5, s32 a6, s32 a7) { \
+        return dll_lazy_resolve(h, idx)(a0, a1, a2, a3, a4, a5, a6, a7); \
+    }
+#define DLL_LAZY_STUBS(h) \
+    DLL_LAZY_STUB(h, 0) DLL_LAZY_STUB(h, 1) DLL_LAZY_STUB(h, 2) DLL_LAZY_STUB(h, 3) \
+    DLL_LAZY_STUB(h, 4) DLL_LAZY_STUB(h, 5) DLL_LAZY_STUB(h, 6) DLL_LAZY_STUB(h, 7) \
+    DLL_LAZY_STUB(h, 8) DLL_LAZY_STUB(h, 9) DLL_LAZY_STUB(h, 10) DLL_LAZY_STUB(h, 11) \
+    DLL_LAZY_STUB(h, 12) DLL_LAZY_STUB(h, 13) DLL_LAZY_STUB(h, 14) DLL_LAZY_STUB(h, 15)
+#define DLL_LAZY_TABLE(h) { \
+    (u32)dll_lazy_stub_##h##_0, (u32)dll_lazy_stub_##h##_1, (u32)dll_lazy_stub_##h##_2, (u32)dll_lazy_stub_##h##_3, \
+    (u32)dll_lazy_stub_##h##_4, (u32)dll_lazy_stub_##h##_5, (u32)dll_lazy_stub_##h##_6, (u32)dll_lazy_stub_##h##_7, \
+    (u32)dll_lazy_stub_##h##_8, (u32)dll_lazy_stub_##h##_9, (u32)dll_lazy_stub_##h##_10, (u32)dll_lazy_stub_##h##_11, \
+    (u32)dll_lazy_stub_##h##_12, (u32)dll_lazy_stub_##h##_13, (u32)dll_lazy_stub_##h##_14, (u32)dll_lazy_stub_##h##_15 }
+
+DLL_LAZY_STUBS(0)
+DLL_LAZY_STUBS(1)
+DLL_LAZY_STUBS(2)
+DLL_LAZY_STUBS(3)
+
+static u32 sDLLLazyStubs[DLL_LAZY_MAX_HANDLES][DLL_LAZY_MAX_EXPORTS] = {
+    DLL_LAZY_TABLE(0), DLL_LAZY_TABLE(1), DLL_LAZY_TABLE(2), DLL_LAZY_TABLE(3)
+};
+
+u32 *dll_load_lazy(u16 id, u16 exportCount)
+{
+    DLLLazy *lazy;
+
+    if (exportCount > DLL_LAZY_MAX_EXPORTS || sDLLLazyCount == DLL_LAZY_MAX_HANDLES) {
+        return dll_load(id, exportCount, 1);
+    }
+
+    lazy = &sDLLLazy[sDLLLazyCount];
+    lazy->exports = sDLLLazyStubs[sDLLLazyCount];
+    lazy->inst = NULL;
+    lazy->id = id;
+    lazy->exportCount = exportCount;
+    sDLLLazyCount++;
+
+    return (u32*)&lazy->exports;
+}
+
+void dbg_dll_preload_print(void)
+{
+    s32 i;
+
+    for (i = 0; i < sDLLPreloadCount; i++) {
+        dummied_print_func("dll %d: %d bytes, dma wait %d us, reloc %d us\n", sDLLPreloadTimes[i].id,
+            sDLLPreloadTimes[i].bytes, sDLLPreloadTimes[i].waitUs, sDLLPreloadTimes[i].relocUs);
+    }
+}
+#endif
+
 // Returns pointer to DLLInst exports field
 u32* dll_load(u16 id, u16 exportCount, s32 arg2)
 {
@@ -53,6 +751,10 @@ u32* dll_load(u16 id, u16 exportCount, s32 arg2)
     u32 i;
     u32 totalSize;
     u32* result;
+#ifdef NON_MATCHING
+    OSTime start;
+    s32 cached;
+#endif
 
     if (id >= 0x8000) {
         id -= 0x8000;
@@ -66,6 +768,13 @@ u32* dll_load(u16 id, u16 exportCount, s32 arg2)
     }
 
     // Check if DLL is already loaded, and if so, increment the reference count
+#ifdef NON_MATCHING
+    i = dll_index_find(id);
+    if (i != (u32)-1) {
+        ++gLoadedDLLList[i].refCount;
+        return &gLoadedDLLList[i].exports;
+    }
+#else
     for (i = 0; i < gLoadedDLLCount; i++)
     {
         if (id == gLoadedDLLList[i].id) {
@@ -73,18 +782,47 @@ u32* dll_load(u16 id, u16 exportCount, s32 arg2)
             return &gLoadedDLLList[i].exports;
         }
     }
+#endif
+
+#ifdef NON_MATCHING
+    // A mismatch seen once fails the same way again, so don't read and relocate it just to find out
+    if (dll_exports_short(id, exportCount)) {
+        return 0;
+    }
 
+    start = osGetTime();
+    dll = dll_cache_take(id, &totalSize);
+    cached = dll != NULL;
+    if (dll == NULL) {
+        dll = dll_load_from_tab(id, &totalSize);
+    }
+#else
     dll = dll_load_from_tab(id, &totalSize);
+#endif
     if (!dll) {
         return 0;
     }
 
+#ifdef NON_MATCHING
+    dll_note_export_count(id, dll);
+#endif
     if (dll->exportCount < exportCount) {
         free(dll);
         return 0;
     }
 
     // Find an open slot in the DLL list
+#ifdef NON_MATCHING
+    i = dll_index_alloc_slot();
+    if (i == (u32)-1) {
+        free(dll);
+        return 0;
+    }
+    dll_index_insert(id, i);
+    dll_cache_snapshot(id, dll, totalSize);
+    // Cache hits read nothing
+    dll_stats_note_load(id, cached ? 0 : totalSize, start);
+#else
     for (i = 0; i < (u32)gLoadedDLLCount; i++)
     {
         if (0xFFFFFFFF == gLoadedDLLList[i].id) {
@@ -101,6 +839,7 @@ u32* dll_load(u16 id, u16 exportCount, s32 arg2)
 
         ++gLoadedDLLCount;
     }
+#endif
 
     gLoadedDLLList[i].id = id;
     gLoadedDLLList[i].exports = dll->exports;
@@ -116,6 +855,7 @@ u32* dll_load(u16 id, u16 exportCount, s32 arg2)
 }
 
 // close
+#ifndef NON_MATCHING
 #if 1
 #pragma GLOBAL_ASM("asm/nonmatchings/dll/func_8000C0B8.s")
 #else
@@ -166,8 +906,49 @@ void _func_8000C0B8(u16 id, s32 arg1, s32 arg2, s32 arg3)
 
 }
 #endif
+#else
+/**
+ * Copies a DLL image from arg1 into a new allocation with arg3 bytes of .bss,
+ * relocates it and runs its constructor, unless id is already loaded.
+ * Built from C so the slot goes into the id index.
+ */
+void func_8000C0B8(u16 id, s32 arg1, s32 arg2, s32 arg3)
+{
+    DLLFile *dll;
+    s32 i;
+
+    if (dll_index_find(id) != -1) {
+        return;
+    }
+
+    dll = (DLLFile *)malloc(arg2 + arg3, 4, 0);
+    _bcopy((void *)arg1, (void *)dll, arg2);
+
+    if (arg3 != 0) {
+        bzero((void *)((u32)dll + arg2), arg3);
+    }
+
+    dll_relocate(dll);
+    osInvalICache(dll, 0x4000);
+    osInvalDCache(dll, 0x4000);
+
+    i = dll_index_alloc_slot();
+    if (i == -1) {
+        return;
+    }
+    dll_index_insert(id, i);
+
+    gLoadedDLLList[i].id = id;
+    gLoadedDLLList[i].exports = (u32 *)((u32)dll + 0x18);
+    gLoadedDLLList[i].end = (u32 *)(((u32)dll + arg2) + arg3);
+    gLoadedDLLList[i].refCount = 2;
+
+    dll->ctor((u32)dll);
+}
+#endif
 
 // close
+#ifndef NON_MATCHING
 #if 1
 #pragma GLOBAL_ASM("asm/nonmatchings/dll/func_8000C258.s")
 #else
@@ -220,10 +1001,61 @@ u32 _func_8000C258(u32 arg0)
     return gLoadedDLLCount;
 }
 #endif
+#else
+/**
+ * Drops a reference to the DLL whose exports field is at arg0, unloading it
+ * when that was the last one. Built from C so unloads reach the image cache.
+ *
+ * @returns TRUE if the DLL was unloaded.
+ */
+u32 func_8000C258(u32 arg0)
+{
+    DLLFile *dll;
+    u32 *exports;
+    u32 offset;
+    s32 slot;
+
+    offset = arg0 - (u32)gLoadedDLLList - 8;
+    if ((offset & 0xF) != 0) {
+        return FALSE;
+    }
+
+    slot = offset >> 4;
+    if (slot >= gLoadedDLLCount || gLoadedDLLList[slot].id == 0xFFFFFFFF) {
+        return FALSE;
+    }
+
+    if (--gLoadedDLLList[slot].refCount > 0) {
+        return FALSE;
+    }
+
+    dll = (DLLFile *)((u32)gLoadedDLLList[slot].exports - 0x18);
+    dll->dtor((s32)dll);
+    dll_stats_note_unload(gLoadedDLLList[slot].id);
+
+    // A cached image isn't poisoned, stale callers run the old code instead of faulting
+    if (!dll_cache_keep(gLoadedDLLList[slot].id, dll))
+    {
+        for (exports = gLoadedDLLList[slot].exports; exports < gLoadedDLLList[slot].end; exports++) {
+            *exports = 0x7000D;
+        }
+
+        free(dll);
+    }
+    dll_index_remove(slot);
+
+    while (gLoadedDLLCount != 0 && gLoadedDLLList[gLoadedDLLCount - 1].id == 0xFFFFFFFF) {
+        --gLoadedDLLCount;
+    }
+
+    return TRUE;
+}
+#endif
 
 #pragma GLOBAL_ASM("asm/nonmatchings/dll/dll_throw_fault.s")
 
 // close
+#ifndef NON_MATCHING
 #if 1
 #pragma GLOBAL_ASM("asm/nonmatchings/dll/dll_load_from_tab.s")
 #else
@@ -266,8 +1098,150 @@ DLLFile * _dll_load_from_tab(u16 idx, u32 *totalSize)
     return dll;
 }
 #endif
+#else
+DLLFile * dll_load_from_tab(u16 idx, u32 *totalSize)
+{
+    DLLTabEntry* entry;
+    s32 offset;
+    s32 bssSize;
+    u32 dataSize;
+    DLLFile *dll;
+
+    idx++;
+    entry = &gFile_DLLS_TAB->entries[idx] - 2;
+
+    offset = entry->offset;
+    bssSize = entry->bssSize;
+    dataSize = entry[1].offset - offset;
+
+    dll = malloc(dataSize + bssSize, 4, 0);
+    if (dll == NULL) {
+        return NULL;
+    }
+
+    read_file_region(DLLS_BIN, dll, offset, dataSize);
+    if (bssSize) {
+        bzero((u8*)dll + dataSize, bssSize);
+    }
+
+    // Calling through an import that never got patched would jump to 0
+    if (!dll_relocate_checked(dll)) {
+        free(dll);
+        return NULL;
+    }
+
+    osInvalICache(dll, 0x4000);
+    osInvalDCache(dll, 0x4000);
+
+    *totalSize = dataSize + bssSize;
+    return dll;
+}
+#endif
 
 void dll_relocate(DLLFile* dll);
+#ifdef NON_MATCHING
+/**
+ * Switches import lookups over to reading DLLSIMPORTTAB_BIN from ROM, and frees
+ * the resident copy init_dll_system loaded. Called by the first dll_relocate.
+ */
+static void dll_imports_open(void)
+{
+    u32 *resident;
+    s32 sr;
+
+    sr = func_with_status_reg();
+    if (sDLLImports.size != 0) {
+        set_status_reg(sr);
+        return;
+    }
+    rom_table_open(&sDLLImports, DLLSIMPORTTAB_BIN);
+    resident = gFile_DLLSIMPORTTAB;
+    gFile_DLLSIMPORTTAB = NULL;
+    set_status_reg(sr);
+
+    if (resident != NULL) {
+        free(resident);
+    }
+}
+
+// The three relocation lists come pre-grouped by type, and the import table
+// already holds absolute addresses, so each list is one pass with everything it
+// needs hoisted into registers. Going through the globals each time would mean a
+// reload per entry, since every patch store may alias them.
+//
+// Returns FALSE if an import couldn't be read from ROM, the DLL is unusable then.
+static s32 dll_relocate_checked(DLLFile* dll)
+{
+    u32 *target;
+    u32 *data;
+    u32 *exports;
+    u32 *fn;
+    u32 gotHi;
+    u32 gotLo;
+    s32 *relocations;
+    s32 *currRelocation;
+    s32 reloc;
+    u32 exportCount;
+
+    target = (u32*)((u8*)dll + dll->code);
+
+    *(u32*)&dll->ctor += (u32)target;
+    *(u32*)&dll->dtor += (u32)target;
+
+    exports = dll->exports;
+    for (exportCount = dll->exportCount; exportCount != 0; exportCount--)
+    {
+        *exports++ += (u32)target;
+    }
+
+    if (dll->rodata == -1) {
+        return TRUE;
+    }
+
+    dll_imports_open();
+    relocations = (s32*)((u8*)dll + dll->rodata);
+
+    // GOT
+    for (currRelocation = relocations; (reloc = *currRelocation) != -2; currRelocation++)
+    {
+        if (reloc < 0) {
+            // Import ids are 1-based
+            if (!rom_table_read_u32(&sDLLImports, (reloc & 0x7fffffff) - 1, (u32*)currRelocation)) {
+                return FALSE;
+            }
+        } else {
+            *currRelocation = reloc + (s32)target;
+        }
+    }
+    currRelocation++;
+
+    // $gp setup, a lui/ori pair per function
+    gotHi = (u32)relocations >> 16;
+    gotLo = (u32)relocations & 0xffff;
+    for (; (reloc = *currRelocation) != -3; currRelocation++)
+    {
+        fn = target + (u32)reloc / 4;
+        fn[0] |= gotHi;
+        fn[1] |= gotLo;
+    }
+    currRelocation++;
+
+    // Pointers in .data
+    data = (u32*)((u8*)dll + dll->data);
+    for (; (reloc = *currRelocation) != -1; currRelocation++)
+    {
+        data[(u32)reloc / 4] += (u32)data;
+    }
+
+    return TRUE;
+}
+
+// For func_8000C0B8, which has no way to fail
+void dll_relocate(DLLFile* dll)
+{
+    dll_relocate_checked(dll);
+}
+#else
 void dll_relocate(DLLFile* dll)
 {
     u32 *tmp_target;
@@ -330,6 +1304,7 @@ void dll_relocate(DLLFile* dll)
         }
     }
 }
+#endif
 
 void func_8000C648(void)
 {
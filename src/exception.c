@@ -8,6 +8,36 @@ void pi_manager_entry(void *arg);
 void crash_controller_getter();
 void check_video_mode_crash_and_clear_framebuffer();
 void some_crash_print(OSThread**, int, int);
+void crash_copy_control_inputs();
+
+#ifdef NON_MATCHING
+// Ticks between controller polls while browsing the crash screen, about a frame
+#define CRASH_POLL_TICKS (OS_CPU_COUNTER / 60)
+
+static void crash_browse_threads(OSThread *faulted);
+
+// Rows of gFramebufferCurrent drawn to since the last clear, see crash_mark_dirty
+static s32 sCrashDirtyTop = 0x7FFF;
+static s32 sCrashDirtyBottom = 0;
+
+// Zeroes count pixels from fb, two at a time where it's word aligned
+static void crash_clear_words(u16 *fb, s32 count) {
+    u32 *fbWord;
+
+    if (count != 0 && ((u32)fb & 3) != 0) {
+        *fb++ = 0;
+        count--;
+    }
+
+    for (fbWord = (u32 *)fb; count >= 2; count -= 2) {
+        *fbWord++ = 0;
+    }
+
+    if (count != 0) {
+        *(u16 *)fbWord = 0;
+    }
+}
+#endif
 
 #if 0
 #pragma GLOBAL_ASM("asm/nonmatchings/exception/update_pi_manager_array.s")
@@ -147,6 +177,52 @@ void crash_controller_getter() {
 
     // Print some crash info
     some_crash_print(&thread, 1, 0);
+
+#ifdef NON_MATCHING
+    crash_browse_threads(thread);
+#endif
+}
+#endif
+
+#ifdef NON_MATCHING
+/**
+ * Keeps the crash screen live once it's printed: D-pad down and up step through
+ * the active threads, printing each one's state in turn. Only the rows the last
+ * print drew to are cleared in between, so every step redraws in a frame or two.
+ */
+static void crash_browse_threads(OSThread *faulted) {
+    OSThread *thread = faulted;
+    OSThread *prev;
+    u32 start;
+
+    while (TRUE) {
+        start = osGetCount();
+        while (osGetCount() - start < CRASH_POLL_TICKS);
+
+        crash_copy_control_inputs();
+
+        if (gCrashButtons[0] & D_JPAD) {
+            thread = thread->tlnext->priority != -1 ? thread->tlnext : __osGetActiveQueue();
+        } else if (gCrashButtons[0] & U_JPAD) {
+            // The active queue only links forwards, and ends on the idle thread's -1
+            prev = __osGetActiveQueue();
+            if (prev == thread) {
+                while (prev->tlnext->priority != -1) {
+                    prev = prev->tlnext;
+                }
+            } else {
+                while (prev->tlnext != thread) {
+                    prev = prev->tlnext;
+                }
+            }
+            thread = prev;
+        } else {
+            continue;
+        }
+
+        crash_clear_dirty();
+        some_crash_print(&thread, 1, 0);
+    }
 }
 #endif
 
@@ -202,6 +278,7 @@ void check_video_mode_crash_and_clear_framebuffer() {
 }
 #endif
 
+#ifndef NON_MATCHING
 #if 1
 #pragma GLOBAL_ASM("asm/nonmatchings/exception/func_80062D38.s")
 #else
@@ -248,6 +325,57 @@ void _func_80062D38(s32 col, s32 row, u8 *param3) {
     } while (i--);
 }
 #endif
+#else
+/**
+ * Draws a 5 row glyph at col, row. Each glyph byte is a row of up to 4 pixels,
+ * 2 bits each from the low bits up, which index the current palette in D_800933C4.
+ * Pixels are doubled across, and down too with gSomeCrashVideoFlag. A row ends at
+ * its last non-zero pixel.
+ *
+ * Doubled pixels are the same in both halves of a word, so rows are drawn with
+ * one word write per pixel where the framebuffer position allows it.
+ */
+void func_80062D38(s32 col, s32 row, u8 *param3) {
+    u32 res = get_some_resolution_encoded();
+    s32 resWidth = res & 0xffff;
+    u16 *fb = &gFramebufferCurrent[(row * resWidth) + col];
+    u16 *palette = &D_800933C4[D_800937F0 << 2];
+    u32 words[4];
+    s32 lines = gSomeCrashVideoFlag != 0 ? 2 : 1;
+    s32 i;
+    s32 k;
+    u8 temp;
+
+    for (i = 0; i < 4; i++) {
+        words[i] = (palette[i] << 16) | palette[i];
+    }
+
+    crash_mark_dirty(row, row + 5 * lines);
+
+    for (i = 0; i < 5; i++, param3++) {
+        for (k = 0; k < lines; k++, fb += resWidth) {
+            temp = *param3;
+
+            if (((u32)fb & 3) == 0) {
+                u32 *fbWord = (u32 *)fb;
+
+                while (temp != 0) {
+                    *fbWord++ = words[temp & 3];
+                    temp >>= 2;
+                }
+            } else {
+                u16 *fbTemp = fb;
+
+                while (temp != 0) {
+                    fbTemp[0] = fbTemp[1] = palette[temp & 3];
+                    fbTemp += 2;
+                    temp >>= 2;
+                }
+            }
+        }
+    }
+}
+#endif
 
 #pragma GLOBAL_ASM("asm/nonmatchings/exception/func_80062E38.s")
 
@@ -266,10 +394,49 @@ void clear_framebuffer_current() {
     s32 valuesLeft = (/*hRes*/resEncoded & 0xffff) * (/*vRes*/(resEncoded >> 0x10) & 0xffff);
     u16 *framebufferPtr = gFramebufferCurrent;
 
+#ifdef NON_MATCHING
+    sCrashDirtyTop = 0x7FFF;
+    sCrashDirtyBottom = 0;
+    crash_clear_words(framebufferPtr, valuesLeft);
+#else
     while (valuesLeft--) {
         *framebufferPtr = 0;
         ++framebufferPtr;
     }
+#endif
+}
+#endif
+
+#ifdef NON_MATCHING
+/**
+ * Notes that rows top up to bottom of gFramebufferCurrent were drawn to, for
+ * crash_clear_dirty to clear.
+ */
+void crash_mark_dirty(s32 top, s32 bottom) {
+    if (top < sCrashDirtyTop) {
+        sCrashDirtyTop = top;
+    }
+    if (bottom > sCrashDirtyBottom) {
+        sCrashDirtyBottom = bottom;
+    }
+}
+
+/**
+ * Clears only the rows of gFramebufferCurrent text was drawn to since the last
+ * clear, so the crash screen can be redrawn without clearing all of it.
+ */
+void crash_clear_dirty() {
+    u32 resEncoded = get_some_resolution_encoded();
+    s32 width = resEncoded & 0xffff;
+    s32 height = (resEncoded >> 0x10) & 0xffff;
+    s32 bottom = sCrashDirtyBottom < height ? sCrashDirtyBottom : height;
+
+    if (sCrashDirtyTop < bottom) {
+        crash_clear_words(&gFramebufferCurrent[sCrashDirtyTop * width], (bottom - sCrashDirtyTop) * width);
+    }
+
+    sCrashDirtyTop = 0x7FFF;
+    sCrashDirtyBottom = 0;
 }
 #endif
 
@@ -56,4 +56,14 @@ void some_crash_print(OSThread**, int, int);
  */
 void check_video_mode_crash_and_clear_framebuffer();
 
+/**
+ * Notes that rows top up to bottom of the framebuffer were drawn to, see crash_clear_dirty.
+ */
+void crash_mark_dirty(s32 top, s32 bottom);
+
+/**
+ * Clears only the framebuffer rows drawn to since the last clear.
+ */
+void crash_clear_dirty();
+
 #endif
@@ -1,4 +1,5 @@
 #include "common.h"
+#include "filesystem.h"
 
 #define ROM_FILES_START 0xA4AA0
 
@@ -94,6 +95,573 @@ s32 _read_file_region(u32 id, void *dst, u32 offset, s32 size)
 }
 #endif
 
+#ifdef NON_MATCHING
+u32 get_file_rom_addr(u32 id, u32 offset)
+{
+    if (id > gFST[0]) {
+        return 0;
+    }
+
+    return ROM_FILES_START + gFST[id + 1] + offset;
+}
+
+s32 func_with_status_reg(void);
+void set_status_reg(s32);
+s32 get_file_size(u32 id);
+
+PiClientStats gPiClientStats[PI_CLIENT_COUNT];
+
+static OSMesgQueue sPiStreamSlots;
+static OSMesg sPiStreamSlotMesgs[PI_STREAM_SLOTS];
+
+void pi_arbiter_init(void)
+{
+    s32 i;
+
+    osCreateMesgQueue(&sPiStreamSlots, sPiStreamSlotMesgs, PI_STREAM_SLOTS);
+    for (i = 0; i < PI_STREAM_SLOTS; i++) {
+        osSendMesg(&sPiStreamSlots, NULL, OS_MESG_NOBLOCK);
+    }
+}
+
+static void pi_account(s32 client, u32 size)
+{
+    s32 sr;
+
+    sr = func_with_status_reg();
+    gPiClientStats[client].requests++;
+    gPiClientStats[client].bytes += size;
+    gPiClientStats[client].frameBytes += size;
+    set_status_reg(sr);
+}
+
+#define PI_TRACE_MAX 64
+
+static u32 sPiTrace[PI_TRACE_MAX];
+static s32 sPiTraceCount;
+static u32 sPiTraceNext;
+static s8 sPiTraceEnabled;
+u32 gPiTraceDropped;
+
+void pi_trace_set_enabled(s32 enabled)
+{
+    s32 sr;
+
+    sr = func_with_status_reg();
+    sPiTraceEnabled = enabled;
+    sPiTraceCount = 0;
+    sPiTraceNext = 0;
+    set_status_reg(sr);
+}
+
+// Only the first DMA of each run is kept, the chunks that continue it add nothing
+static void pi_trace(u32 devAddr, u32 size)
+{
+    s32 sr;
+
+    sr = func_with_status_reg();
+    if (devAddr != sPiTraceNext) {
+        if (sPiTraceCount < PI_TRACE_MAX) {
+            sPiTrace[sPiTraceCount++] = devAddr;
+        } else {
+            gPiTraceDropped++;
+        }
+    }
+    sPiTraceNext = devAddr + size;
+    set_status_reg(sr);
+}
+
+s32 pi_trace_take(u32 *out, s32 max)
+{
+    s32 count;
+    s32 sr;
+
+    sr = func_with_status_reg();
+    count = sPiTraceCount < max ? sPiTraceCount : max;
+    bcopy(sPiTrace, out, count * sizeof(u32));
+    sPiTraceCount = 0;
+    set_status_reg(sr);
+
+    return count;
+}
+
+s32 pi_stream_start(s32 client, OSIoMesg *mb, u32 devAddr, void *vAddr, u32 size, OSMesgQueue *mq, s32 block)
+{
+    if (osRecvMesg(&sPiStreamSlots, NULL, block ? OS_MESG_BLOCK : OS_MESG_NOBLOCK) == -1) {
+        gPiClientStats[client].deferred++;
+        return FALSE;
+    }
+
+    if (sPiTraceEnabled) {
+        pi_trace(devAddr, size);
+    }
+    pi_account(client, size);
+    osPiStartDma(mb, OS_MESG_PRI_NORMAL, OS_READ, devAddr, vAddr, size, mq);
+
+    return TRUE;
+}
+
+void pi_stream_done(void)
+{
+    osSendMesg(&sPiStreamSlots, NULL, OS_MESG_NOBLOCK);
+}
+
+void pi_audio_start(OSIoMesg *mb, u32 devAddr, void *vAddr, u32 size, OSMesgQueue *mq)
+{
+    pi_account(PI_CLIENT_AUDIO, size);
+    osPiStartDma(mb, OS_MESG_PRI_HIGH, OS_READ, devAddr, vAddr, size, mq);
+}
+
+void pi_arbiter_frame(void)
+{
+    PiClientStats *stats;
+    s32 sr;
+    s32 i;
+
+    sr = func_with_status_reg();
+    for (i = 0; i < PI_CLIENT_COUNT; i++)
+    {
+        stats = &gPiClientStats[i];
+        stats->lastFrameBytes = stats->frameBytes;
+        if (stats->frameBytes > stats->peakFrameBytes) {
+            stats->peakFrameBytes = stats->frameBytes;
+        }
+        stats->frameBytes = 0;
+    }
+    set_status_reg(sr);
+}
+
+void pi_reset_stats(void)
+{
+    s32 sr;
+
+    sr = func_with_status_reg();
+    bzero(gPiClientStats, sizeof(gPiClientStats));
+    set_status_reg(sr);
+}
+
+// Never more than the 16 messages init_filesystem gives the PI manager
+#define ROMCOPY_MAX_DEPTH 8
+
+s32 gRomcopyChunkSize = 0x5000;
+s32 gRomcopyDepth = 4;
+
+void romcopy_set_config(s32 chunkSize, s32 depth)
+{
+    if (chunkSize < 0x400) {
+        chunkSize = 0x400;
+    }
+    // Longer DMAs would hold audio up for longer than one slice
+    if (chunkSize > PI_STREAM_SLICE) {
+        chunkSize = PI_STREAM_SLICE;
+    }
+    if (depth < 1) {
+        depth = 1;
+    } else if (depth > ROMCOPY_MAX_DEPTH) {
+        depth = ROMCOPY_MAX_DEPTH;
+    }
+
+    gRomcopyChunkSize = chunkSize & ~0xF;
+    gRomcopyDepth = depth;
+}
+
+// Bytes per data cache line
+#define DCACHE_LINE_SIZE 16
+
+// Lines inside overwrite are left as they are: the caller promises to write every
+// byte of them before reading any, so whatever the DMA put there is never seen
+void dcache_inval_dma(void *dst, s32 size, void *overwrite, s32 overwriteSize)
+{
+    u32 start;
+    u32 end;
+    u32 skipStart;
+    u32 skipEnd;
+
+    if (size <= 0) {
+        return;
+    }
+
+    start = (u32)dst;
+    end = start + size;
+
+    // Only whole lines can be left alone, a partial one would mix in stale bytes
+    skipStart = ((u32)overwrite + DCACHE_LINE_SIZE - 1) & ~(DCACHE_LINE_SIZE - 1);
+    skipEnd = ((u32)overwrite + overwriteSize) & ~(DCACHE_LINE_SIZE - 1);
+    if (overwrite == NULL || overwriteSize <= 0 || skipStart >= skipEnd || skipEnd <= start || skipStart >= end) {
+        osInvalDCache(dst, size);
+        return;
+    }
+
+    // Partial edge lines are written back and invalidated by osInvalDCache itself
+    if (skipStart > start) {
+        osInvalDCache((void*)start, skipStart - start);
+    }
+    if (skipEnd < end) {
+        osInvalDCache((void*)skipEnd, end - skipEnd);
+    }
+}
+
+void romcopy_dma(u32 romAddr, u8 *dst, s32 size, void *overwrite, s32 overwriteSize)
+{
+    OSIoMesg ioMesgs[ROMCOPY_MAX_DEPTH];
+    OSMesg mesgs[ROMCOPY_MAX_DEPTH];
+    OSMesgQueue mq;
+    OSMesg mesg;
+    s32 chunkSize;
+    s32 depth;
+    s32 pending;
+    s32 next;
+
+    osCreateMesgQueue(&mq, mesgs, ROMCOPY_MAX_DEPTH);
+
+    chunkSize = gRomcopyChunkSize;
+    depth = gRomcopyDepth;
+    pending = 0;
+    next = 0;
+    while (size > 0 || pending != 0)
+    {
+        // Keep the PI manager's queue topped up so the bus never waits on us
+        while (size > 0 && pending < depth)
+        {
+            if (size < chunkSize) {
+                chunkSize = size;
+            }
+
+            // Just ahead of the chunk, so an aborted load leaves the rest of the cache alone
+            dcache_inval_dma(dst, chunkSize, overwrite, overwriteSize);
+            // Blocking on a slot while holding some could starve everyone, only
+            // wait for one when none of ours are out
+            if (!pi_stream_start(PI_CLIENT_ROMCOPY, &ioMesgs[next], romAddr, dst, chunkSize, &mq, pending == 0)) {
+                break;
+            }
+            // The PI manager completes in order, so the oldest slot is always free again
+            next = (next + 1) % depth;
+            pending++;
+
+            size -= chunkSize;
+            romAddr += chunkSize;
+            dst += chunkSize;
+        }
+
+        osRecvMesg(&mq, &mesg, OS_MESG_BLOCK);
+        pending--;
+        pi_stream_done();
+    }
+}
+
+static FileRead sFileReads[FILE_READ_MAX_ASYNC];
+
+// Only waits for a PI slot if wait is set and nothing of the read is in flight
+static void read_file_async_issue(FileRead *read, s32 wait)
+{
+    s32 chunkSize;
+
+    while (read->remaining > 0 && read->pending < FILE_READ_MAX_CHUNKS)
+    {
+        chunkSize = read->remaining < gRomcopyChunkSize ? read->remaining : gRomcopyChunkSize;
+
+        osInvalDCache(read->next, chunkSize);
+        if (!pi_stream_start(PI_CLIENT_ASYNC, &read->ioMesgs[read->nextMesg], read->romAddr,
+                read->next, chunkSize, &read->mq, wait && read->pending == 0)) {
+            break;
+        }
+        read->nextMesg = (read->nextMesg + 1) % FILE_READ_MAX_CHUNKS;
+        read->pending++;
+
+        read->remaining -= chunkSize;
+        read->romAddr += chunkSize;
+        read->next += chunkSize;
+    }
+}
+
+static void read_file_async_finish(s32 handle)
+{
+    FileRead *read;
+
+    read = &sFileReads[handle];
+    if (read->callback != NULL) {
+        read->callback(handle, read->dst, read->size);
+    }
+
+    read->used = FALSE;
+}
+
+s32 read_file_region_async(u32 id, void *dst, u32 offset, s32 size, FileReadCallback cb)
+{
+    FileRead *read;
+    s32 handle;
+    s32 sr;
+
+    if (size <= 0 || id > gFST[0]) {
+        return FILE_READ_INVALID_HANDLE;
+    }
+
+    sr = func_with_status_reg();
+    for (handle = 0; handle < FILE_READ_MAX_ASYNC; handle++)
+    {
+        if (!sFileReads[handle].used) {
+            sFileReads[handle].used = TRUE;
+            break;
+        }
+    }
+    set_status_reg(sr);
+
+    if (handle == FILE_READ_MAX_ASYNC) {
+        return FILE_READ_INVALID_HANDLE;
+    }
+
+    read = &sFileReads[handle];
+    osCreateMesgQueue(&read->mq, read->mesgs, FILE_READ_MAX_CHUNKS);
+    read->callback = cb;
+    read->dst = dst;
+    read->next = dst;
+    read->romAddr = ROM_FILES_START + gFST[id + 1] + offset;
+    read->size = size;
+    read->remaining = size;
+    read->pending = 0;
+    read->nextMesg = 0;
+
+    read_file_async_issue(read, FALSE);
+
+    return handle;
+}
+
+s32 read_file_async_poll(s32 handle)
+{
+    FileRead *read;
+
+    read = &sFileReads[handle];
+    while (read->pending != 0 && osRecvMesg(&read->mq, NULL, OS_MESG_NOBLOCK) != -1) {
+        read->pending--;
+        pi_stream_done();
+    }
+
+    read_file_async_issue(read, FALSE);
+    if (read->pending != 0 || read->remaining > 0) {
+        return FALSE;
+    }
+
+    read_file_async_finish(handle);
+    return TRUE;
+}
+
+void read_file_async_wait(s32 handle)
+{
+    FileRead *read;
+
+    read = &sFileReads[handle];
+    while (read->pending != 0 || read->remaining > 0)
+    {
+        if (read->pending != 0)
+        {
+            osRecvMesg(&read->mq, NULL, OS_MESG_BLOCK);
+            read->pending--;
+            pi_stream_done();
+        }
+        read_file_async_issue(read, TRUE);
+    }
+
+    read_file_async_finish(handle);
+}
+
+#define FILE_CACHE_ENTRIES 64
+
+// Rounds p up to a data cache line. IDO can't align statics for us, so the DMA
+// pools carry a line of slack and are aligned by hand.
+#define DCACHE_ALIGN(p) ((u8*)(((u32)(p) + DCACHE_LINE_SIZE - 1) & ~(DCACHE_LINE_SIZE - 1)))
+
+// A recently read header or index entry, keyed by file id and offset
+typedef struct FileCacheEntry {
+/*0000*/ u32 offset;
+/*0004*/ u32 lastUse;
+/*0008*/ u16 id;
+/*000A*/ u8 size;
+/*000B*/ u8 used;
+/*000C*/ u8 loading;    // Reserved by a read in flight
+} FileCacheEntry;
+
+static FileCacheEntry sFileCache[FILE_CACHE_ENTRIES];
+// The data is kept apart from the entries so each slot is whole cache lines
+static u8 sFileCacheData[FILE_CACHE_ENTRIES * FILE_CACHE_MAX_READ + DCACHE_LINE_SIZE];
+static u32 sFileCacheClock;
+
+s32 read_file_region_cached(u32 id, void *dst, u32 offset, s32 size)
+{
+    FileCacheEntry *entry;
+    FileCacheEntry *oldest;
+    u8 *data;
+    s32 sr;
+    s32 i;
+
+    if (size > FILE_CACHE_MAX_READ) {
+        return read_file_region(id, dst, offset, size);
+    }
+
+    sr = func_with_status_reg();
+    oldest = NULL;
+    for (i = 0; i < FILE_CACHE_ENTRIES; i++)
+    {
+        entry = &sFileCache[i];
+        if (entry->loading) {
+            continue;
+        }
+        if (entry->used && entry->id == id && entry->offset == offset && entry->size >= size) {
+            entry->lastUse = ++sFileCacheClock;
+            bcopy(DCACHE_ALIGN(sFileCacheData) + i * FILE_CACHE_MAX_READ, dst, size);
+            set_status_reg(sr);
+            return size;
+        }
+        if (oldest == NULL || !entry->used || (oldest->used && entry->lastUse < oldest->lastUse)) {
+            oldest = entry;
+        }
+    }
+
+    if (oldest == NULL) {
+        set_status_reg(sr);
+        return read_file_region(id, dst, offset, size);
+    }
+    // Nobody else can pick the slot while it's being read into
+    oldest->used = FALSE;
+    oldest->loading = TRUE;
+    set_status_reg(sr);
+
+    // DMA straight into the slot, dst may be anywhere
+    data = DCACHE_ALIGN(sFileCacheData) + (oldest - sFileCache) * FILE_CACHE_MAX_READ;
+    if (read_file_region(id, data, offset, size) == 0) {
+        oldest->loading = FALSE;
+        return 0;
+    }
+    bcopy(data, dst, size);
+
+    sr = func_with_status_reg();
+    oldest->id = id;
+    oldest->offset = offset;
+    oldest->size = size;
+    oldest->lastUse = ++sFileCacheClock;
+    oldest->used = TRUE;
+    oldest->loading = FALSE;
+    set_status_reg(sr);
+
+    return size;
+}
+
+// A page of a rom_table_open file, keyed by file id and page index
+typedef struct RomTablePage {
+/*0000*/ u32 page;
+/*0004*/ u32 lastUse;
+/*0008*/ u16 id;
+/*000A*/ u8 used;
+/*000B*/ u8 loading;    // Reserved by a read in flight
+} RomTablePage;
+
+static RomTablePage sRomTablePages[ROM_TABLE_PAGES];
+static u8 sRomTableData[ROM_TABLE_PAGES * ROM_TABLE_PAGE_SIZE + DCACHE_LINE_SIZE];
+static u32 sRomTableClock;
+
+void rom_table_open(RomTable *table, u32 id)
+{
+    table->id = id;
+    table->size = get_file_size(id);
+}
+
+// Copies size bytes at offset within one page out of the cache, reading the page in if needed
+static s32 rom_table_read_page(RomTable *table, u8 *dst, u32 offset, s32 size)
+{
+    RomTablePage *entry;
+    RomTablePage *oldest;
+    u8 *data;
+    u32 page;
+    s32 pageSize;
+    s32 sr;
+    s32 i;
+
+    page = offset / ROM_TABLE_PAGE_SIZE;
+    offset -= page * ROM_TABLE_PAGE_SIZE;
+
+    // The last page of the file may be short
+    pageSize = table->size - page * ROM_TABLE_PAGE_SIZE;
+    if (pageSize > ROM_TABLE_PAGE_SIZE) {
+        pageSize = ROM_TABLE_PAGE_SIZE;
+    }
+
+    sr = func_with_status_reg();
+    oldest = NULL;
+    for (i = 0; i < ROM_TABLE_PAGES; i++)
+    {
+        entry = &sRomTablePages[i];
+        if (entry->loading) {
+            continue;
+        }
+        if (entry->used && entry->id == table->id && entry->page == page) {
+            entry->lastUse = ++sRomTableClock;
+            bcopy(DCACHE_ALIGN(sRomTableData) + i * ROM_TABLE_PAGE_SIZE + offset, dst, size);
+            set_status_reg(sr);
+            return size;
+        }
+        if (oldest == NULL || !entry->used || (oldest->used && entry->lastUse < oldest->lastUse)) {
+            oldest = entry;
+        }
+    }
+
+    if (oldest == NULL) {
+        set_status_reg(sr);
+        return read_file_region(table->id, dst, page * ROM_TABLE_PAGE_SIZE + offset, size);
+    }
+    oldest->used = FALSE;
+    oldest->loading = TRUE;
+    set_status_reg(sr);
+
+    data = DCACHE_ALIGN(sRomTableData) + (oldest - sRomTablePages) * ROM_TABLE_PAGE_SIZE;
+    if (read_file_region(table->id, data, page * ROM_TABLE_PAGE_SIZE, pageSize) == 0) {
+        oldest->loading = FALSE;
+        return 0;
+    }
+    bcopy(data + offset, dst, size);
+
+    sr = func_with_status_reg();
+    oldest->id = table->id;
+    oldest->page = page;
+    oldest->lastUse = ++sRomTableClock;
+    oldest->used = TRUE;
+    oldest->loading = FALSE;
+    set_status_reg(sr);
+
+    return size;
+}
+
+s32 rom_table_read(RomTable *table, void *dst, u32 offset, s32 size)
+{
+    s32 read;
+    s32 n;
+
+    if (offset >= (u32)table->size) {
+        return 0;
+    }
+    if (size > table->size - (s32)offset) {
+        size = table->size - offset;
+    }
+
+    for (read = 0; read < size; read += n)
+    {
+        n = ROM_TABLE_PAGE_SIZE - (offset + read) % ROM_TABLE_PAGE_SIZE;
+        if (n > size - read) {
+            n = size - read;
+        }
+        if (rom_table_read_page(table, (u8*)dst + read, offset + read, n) == 0) {
+            return read;
+        }
+    }
+
+    return size;
+}
+
+s32 rom_table_read_u32(RomTable *table, u32 index, u32 *value)
+{
+    return rom_table_read(table, value, index * sizeof(u32), sizeof(u32)) == sizeof(u32);
+}
+
+#endif
+
 #pragma GLOBAL_ASM("asm/nonmatchings/filesystem/func_800372C8.s")
 
 #if 1
@@ -120,6 +688,7 @@ s32 _get_file_size(u32 arg0)
 #endif
 
 // stack
+#ifndef NON_MATCHING
 #if 1
 #pragma GLOBAL_ASM("asm/nonmatchings/filesystem/possible_romcopy.s")
 #else
@@ -148,3 +717,9 @@ void _possible_romcopy(u32 romAddr, u8* dst, s32 size)
     }
 }
 #endif
+#else
+void possible_romcopy(u32 romAddr, u8* dst, s32 size)
+{
+    romcopy_dma(romAddr, dst, size, NULL, 0);
+}
+#endif
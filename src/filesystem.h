@@ -0,0 +1,169 @@
+#ifndef FILESYSTEM_H
+#define FILESYSTEM_H
+
+#include "ultra64.h"
+
+#define FILE_READ_MAX_ASYNC 4
+// Chunks of one async read that can be queued on the PI manager at once
+#define FILE_READ_MAX_CHUNKS 4
+#define FILE_READ_INVALID_HANDLE -1
+// Reads up to this size go through read_file_region_cached's cache
+#define FILE_CACHE_MAX_READ 0x20
+
+typedef void (*FileReadCallback)(s32 handle, void *dst, s32 size);
+
+// The largest DMA streaming clients may queue, so audio never waits behind more
+#define PI_STREAM_SLICE 0x5000
+// Of the PI manager's 16 messages, the rest are left for audio
+#define PI_STREAM_SLOTS 12
+
+// Who a PI DMA is for, see gPiClientStats
+enum PiClient {
+    PI_CLIENT_AUDIO,
+    PI_CLIENT_ROMCOPY,  // possible_romcopy and everything reading through it
+    PI_CLIENT_ASYNC,    // read_file_region_async
+
+    PI_CLIENT_COUNT
+};
+
+typedef struct PiClientStats {
+/*0000*/ u32 bytes;          // Since pi_reset_stats
+/*0004*/ u32 requests;
+/*0008*/ u32 deferred;       // Non-blocking requests turned away for lack of a slot
+/*000C*/ u32 frameBytes;     // So far this frame
+/*0010*/ u32 lastFrameBytes;
+/*0014*/ u32 peakFrameBytes;
+} PiClientStats;
+
+extern PiClientStats gPiClientStats[PI_CLIENT_COUNT];
+
+typedef struct FileRead {
+/*0000*/ OSIoMesg ioMesgs[FILE_READ_MAX_CHUNKS];
+/*0060*/ OSMesgQueue mq;
+/*0078*/ OSMesg mesgs[FILE_READ_MAX_CHUNKS];
+/*0088*/ FileReadCallback callback;
+/*008C*/ u8 *dst;
+/*0090*/ u8 *next;
+/*0094*/ u32 romAddr;
+/*0098*/ s32 size;
+/*009C*/ s32 remaining;
+/*00A0*/ s8 pending;
+/*00A1*/ s8 nextMesg;
+/*00A2*/ u8 used;
+/*00A3*/ u8 unusedA3;
+} FileRead;
+
+/**
+ * Sets up the PI slots streaming clients share. Must run before the first ROM read.
+ */
+void pi_arbiter_init(void);
+
+/**
+ * Queues a streaming read on the PI manager once one of PI_STREAM_SLOTS is free,
+ * which keeps enough of the PI manager's queue clear that an audio DMA never
+ * blocks on it. Audio goes ahead of anything queued here, so it only ever waits
+ * for the one DMA in progress, at most PI_STREAM_SLICE bytes.
+ *
+ * @returns FALSE if block isn't set and no slot was free, the DMA wasn't started.
+ */
+s32 pi_stream_start(s32 client, OSIoMesg *mb, u32 devAddr, void *vAddr, u32 size, OSMesgQueue *mq, s32 block);
+
+/**
+ * Frees the slot of a pi_stream_start DMA once its message has been received.
+ */
+void pi_stream_done(void);
+
+/**
+ * Queues an audio read at high priority, ahead of all streaming.
+ */
+void pi_audio_start(OSIoMesg *mb, u32 devAddr, void *vAddr, u32 size, OSMesgQueue *mq);
+
+/**
+ * Moves this frame's byte counts into lastFrameBytes and the peaks. Called once per frame.
+ */
+void pi_arbiter_frame(void);
+
+void pi_reset_stats(void);
+
+// Trace DMAs lost because telemetry didn't collect them in time
+extern u32 gPiTraceDropped;
+
+/**
+ * Starts or stops recording the ROM address of every streaming DMA that doesn't
+ * continue the one before it, for telemetry to send to tools/asset_codec.py.
+ */
+void pi_trace_set_enabled(s32 enabled);
+
+/**
+ * Copies up to max addresses recorded since the last call into out.
+ *
+ * @returns How many were copied. The rest are dropped.
+ */
+s32 pi_trace_take(u32 *out, s32 max);
+
+/**
+ * Starts reading size bytes at offset in the file, without waiting for the DMA.
+ * The read is split into gRomcopyChunkSize chunks, several of which are queued
+ * on the PI manager at a time.
+ *
+ * The callback is run from read_file_async_poll or read_file_async_wait, on
+ * whichever thread calls them. dst must not be touched until then.
+ *
+ * @returns A handle, or FILE_READ_INVALID_HANDLE if the file doesn't exist or
+ * FILE_READ_MAX_ASYNC reads are already in progress.
+ */
+s32 read_file_region_async(u32 id, void *dst, u32 offset, s32 size, FileReadCallback cb);
+
+/**
+ * Queues more of the read's chunks as earlier ones land. Once it is complete,
+ * runs its callback and releases the handle.
+ *
+ * @returns TRUE if the read is complete (the handle is no longer valid).
+ */
+s32 read_file_async_poll(s32 handle);
+
+/**
+ * Blocks until the read is complete, then runs its callback and releases the handle.
+ */
+void read_file_async_wait(s32 handle);
+
+/**
+ * read_file_region for small, often repeated reads such as headers and index
+ * entries. Reads of up to FILE_CACHE_MAX_READ bytes are served from an LRU cache
+ * of recent (id, offset) reads when possible, larger ones go straight to ROM.
+ */
+s32 read_file_region_cached(u32 id, void *dst, u32 offset, s32 size);
+
+#define ROM_TABLE_PAGE_SIZE 0x100
+// Pages shared by every rom_table_open file
+#define ROM_TABLE_PAGES 8
+
+// A read-only table left in ROM and read through a small page cache, see rom_table_open
+typedef struct RomTable {
+/*0000*/ u32 id;
+/*0004*/ s32 size;
+} RomTable;
+
+/**
+ * Sets up reads of a read-only file that is too rarely used to keep in RAM.
+ * Nothing is read until rom_table_read asks for it.
+ */
+void rom_table_open(RomTable *table, u32 id);
+
+/**
+ * Copies size bytes at offset in the table to dst, from ROM_TABLE_PAGES cached
+ * pages of ROM_TABLE_PAGE_SIZE bytes, reading the pages that aren't cached.
+ * Safe to call from both the main and asset threads.
+ *
+ * @returns The bytes copied, short if the read runs past the end of the file.
+ */
+s32 rom_table_read(RomTable *table, void *dst, u32 offset, s32 size);
+
+/**
+ * Reads the index-th word of the table into value.
+ *
+ * @returns FALSE if it's past the end or couldn't be read.
+ */
+s32 rom_table_read_u32(RomTable *table, u32 index, u32 *value);
+
+#endif
@@ -1,5 +1,6 @@
 #include "common.h"
 #include "input.h"
+#include "crash.h"
 
 // NOTE: This size is NOT CONFIRMED YET
 #define CONTROLLER_THREAD_STACKSIZE 1152
@@ -279,6 +280,285 @@ void apply_controller_inputs() {
     osRecvMesg(&gContThreadInputsAppliedQueue, NULL, OS_MESG_BLOCK);
 }
 
+#ifdef NON_MATCHING
+/**
+ * Whether input_late_latch folds in snapshots collected after the inputs were applied.
+ */
+static u8 sLateLatch;
+/**
+ * gPrevContSnapshotsI as last seen, it changes whenever inputs are applied.
+ */
+static u8 sLatchBank;
+/**
+ * How many snapshots of the collecting bank input_late_latch has already folded in.
+ */
+static u8 sLatchedSnapshots;
+/**
+ * Presses and releases input_late_latch reported early. Since they stay in the
+ * collecting bank, the next apply reports them again.
+ */
+static u16 sLatchedPresses[MAXCONTROLLERS];
+static u16 sLatchedReleases[MAXCONTROLLERS];
+/**
+ * Presses and releases of the last apply that input_late_latch already reported,
+ * which the accessors hide.
+ */
+static u16 sRepeatedPresses[MAXCONTROLLERS];
+static u16 sRepeatedReleases[MAXCONTROLLERS];
+/**
+ * osGetCount when the inputs of this tick and the last one were sampled.
+ */
+static u32 sSampleTime;
+static u32 sPrevSampleTime;
+static u32 sInputToPhotonUsec;
+
+/**
+ * The recording being made or replayed, at most one of these is set.
+ */
+static InputRecording *sRecording;
+static InputRecording *sReplay;
+/**
+ * Ticks since the recording or replay started.
+ */
+static u32 sRecordingFrame;
+/**
+ * Index of the replay entry covering the current frame.
+ */
+static s32 sReplayCursor;
+
+/**
+ * Notices an apply since the last call and starts tracking the new collecting bank.
+ */
+static void input_latch_sync() {
+    int i;
+
+    if (gPrevContSnapshotsI == sLatchBank) {
+        return;
+    }
+
+    for (i = 0; i != MAXCONTROLLERS; ++i) {
+        sRepeatedPresses[i] = sLatchedPresses[i];
+        sRepeatedReleases[i] = sLatchedReleases[i];
+        sLatchedPresses[i] = 0;
+        sLatchedReleases[i] = 0;
+    }
+
+    sLatchBank = gPrevContSnapshotsI;
+    sLatchedSnapshots = 0;
+}
+
+void input_set_late_latch(s32 enable) {
+    sLateLatch = enable;
+}
+
+void input_late_latch() {
+    ControllersSnapshot *snaps;
+    u32 mask;
+    u16 presses;
+    u16 releases;
+    int count;
+    int i;
+    int k;
+
+    input_latch_sync();
+
+    sPrevSampleTime = sSampleTime;
+    sSampleTime = osGetCount();
+
+    // A replay's inputs are all in place already
+    if (!sLateLatch || sReplay != NULL) {
+        return;
+    }
+
+    // The controller thread bumps the count before it fills the snapshot in, so keep
+    // it from running in between. It runs at a higher priority than the game and
+    // can't be in the middle of one while this runs.
+    mask = osSetIntMask(OS_IM_NONE);
+
+    snaps = gContSnapshots[sLatchBank];
+    count = gNumBufContSnapshots[sLatchBank];
+
+    if (count > sLatchedSnapshots) {
+        for (i = 0; i != MAXCONTROLLERS; ++i) {
+            presses = 0;
+            releases = 0;
+
+            for (k = sLatchedSnapshots; k < count; ++k) {
+                presses |= snaps[k].buttonPresses[i];
+                releases |= snaps[k].buttonReleases[i];
+            }
+
+            // Held buttons and the stick come from the newest snapshot alone
+            gContPads[i].button = snaps[count - 1].pads[i].button;
+            gContPads[i].stick_x = snaps[count - 1].pads[i].stick_x;
+            gContPads[i].stick_y = snaps[count - 1].pads[i].stick_y;
+
+            gButtonPresses[i] |= presses;
+            gButtonReleases[i] |= releases;
+            sLatchedPresses[i] |= presses;
+            sLatchedReleases[i] |= releases;
+        }
+
+        sLatchedSnapshots = count;
+    }
+
+    osSetIntMask(mask);
+}
+
+void input_mark_frame_shown() {
+    // The frame that just went on screen was built last tick
+    sInputToPhotonUsec = OS_CYCLES_TO_USEC(osGetCount() - sPrevSampleTime);
+}
+
+u32 input_get_latency_usec() {
+    return sInputToPhotonUsec;
+}
+
+void input_record_start(InputRecording *rec) {
+    sReplay = NULL;
+    sRecording = rec;
+    sRecordingFrame = 0;
+    rec->count = 0;
+    rec->length = 0;
+}
+
+void input_replay_start(InputRecording *rec) {
+    sRecording = NULL;
+    sReplay = rec;
+    sRecordingFrame = 0;
+    sReplayCursor = 0;
+}
+
+void input_record_stop() {
+    sRecording = NULL;
+    sReplay = NULL;
+}
+
+s32 input_replay_is_running() {
+    return sReplay != NULL;
+}
+
+/**
+ * Adds the applied snapshots of virtual port 0 to the recording, unless they are
+ * the same as the last entry's, which then also covers this frame.
+ */
+static void input_record_frame(u8 port) {
+    ControllersSnapshot *snaps;
+    InputRecFrame frame;
+    InputRecFrame *last;
+    int i;
+
+    snaps = gContSnapshots[gPrevContSnapshotsI ^ 1];
+
+    bzero(&frame, sizeof(frame));
+    frame.frame = sRecordingFrame;
+    frame.count = gNumBufContSnapshots[gPrevContSnapshotsI ^ 1];
+
+    for (i = 0; i < frame.count; ++i) {
+        frame.snaps[i].button = snaps[i].pads[port].button;
+        frame.snaps[i].presses = snaps[i].buttonPresses[port];
+        frame.snaps[i].releases = snaps[i].buttonReleases[port];
+        frame.snaps[i].stickX = snaps[i].pads[port].stick_x;
+        frame.snaps[i].stickY = snaps[i].pads[port].stick_y;
+    }
+
+    if (sRecording->count != 0) {
+        last = &sRecording->frames[sRecording->count - 1];
+
+        if (last->count == frame.count &&
+            bcmp(last->snaps, frame.snaps, sizeof(frame.snaps)) == 0) {
+            return;
+        }
+    }
+
+    if (sRecording->count >= sRecording->capacity) {
+        // Out of room, keep what fits
+        sRecording = NULL;
+        return;
+    }
+
+    _bcopy(&frame, &sRecording->frames[sRecording->count++], sizeof(frame));
+}
+
+/**
+ * Replaces the applied snapshots and inputs of virtual port 0 with the entry
+ * covering this frame.
+ */
+static void input_replay_frame(u8 port) {
+    ControllersSnapshot *snaps;
+    InputRecFrame *frame;
+    int totalStickX;
+    int totalStickY;
+    int i;
+
+    while (sReplayCursor + 1 < sReplay->count &&
+           sReplay->frames[sReplayCursor + 1].frame <= sRecordingFrame) {
+        ++sReplayCursor;
+    }
+
+    frame = &sReplay->frames[sReplayCursor];
+    snaps = gContSnapshots[gPrevContSnapshotsI ^ 1];
+
+    gNumBufContSnapshots[gPrevContSnapshotsI ^ 1] = frame->count;
+
+    gContPads[port].button = 0;
+    gButtonPresses[port] = 0;
+    gButtonReleases[port] = 0;
+    totalStickX = 0;
+    totalStickY = 0;
+
+    // Combined the same way the controller thread combines them
+    for (i = 0; i < frame->count; ++i) {
+        snaps[i].pads[port].button = frame->snaps[i].button;
+        snaps[i].pads[port].stick_x = frame->snaps[i].stickX;
+        snaps[i].pads[port].stick_y = frame->snaps[i].stickY;
+        snaps[i].buttonPresses[port] = frame->snaps[i].presses;
+        snaps[i].buttonReleases[port] = frame->snaps[i].releases;
+
+        gContPads[port].button |= frame->snaps[i].button;
+        gButtonPresses[port] |= frame->snaps[i].presses;
+        gButtonReleases[port] |= frame->snaps[i].releases;
+        totalStickX += frame->snaps[i].stickX;
+        totalStickY += frame->snaps[i].stickY;
+    }
+
+    if (frame->count != 0) {
+        gContPads[port].stick_x = totalStickX / frame->count;
+        gContPads[port].stick_y = totalStickY / frame->count;
+    } else {
+        gContPads[port].stick_x = 0;
+        gContPads[port].stick_y = 0;
+    }
+
+    // None of these were reported early
+    sRepeatedPresses[port] = 0;
+    sRepeatedReleases[port] = 0;
+}
+
+void input_record_tick() {
+    u8 port = gVirtualContPortMap[0];
+
+    if (sRecording == NULL && sReplay == NULL) {
+        return;
+    }
+
+    input_latch_sync();
+
+    if (sRecording != NULL) {
+        input_record_frame(port);
+        sRecordingFrame++;
+        if (sRecording != NULL) {
+            sRecording->length = sRecordingFrame;
+        }
+    } else if (sRecordingFrame >= sReplay->length || sReplay->count == 0) {
+        sReplay = NULL;
+    } else {
+        input_replay_frame(port);
+        sRecordingFrame++;
+    }
+}
+#endif
+
 s32 init_controller_data() {
     s32 lastControllerIndex;
     s32 i;
@@ -348,6 +628,9 @@ void start_controller_thread(OSSched *scheduler) {
     );
 
     // Create and start controller thread
+#ifdef NON_MATCHING
+    stack_watch(CONTROLLER_THREAD_ID, &gControllerThreadStack[0], CONTROLLER_THREAD_STACKSIZE);
+#endif
     osCreateThread(
         /*t*/       &gControllerThread, 
         /*id*/      CONTROLLER_THREAD_ID, 
@@ -651,7 +934,12 @@ u16 get_masked_button_presses(int port) {
         return 0;
     }
 
+#ifdef NON_MATCHING
+    input_latch_sync();
+    return gButtonPresses[gVirtualContPortMap[port]] & ~sRepeatedPresses[gVirtualContPortMap[port]] & gButtonMask[port];
+#else
     return gButtonPresses[gVirtualContPortMap[port]] & gButtonMask[port];
+#endif
 }
 
 u16 get_button_presses(int port) {
@@ -659,7 +947,12 @@ u16 get_button_presses(int port) {
         return 0;
     }
 
+#ifdef NON_MATCHING
+    input_latch_sync();
+    return gButtonPresses[gVirtualContPortMap[port]] & ~sRepeatedPresses[gVirtualContPortMap[port]];
+#else
     return gButtonPresses[gVirtualContPortMap[port]];
+#endif
 }
 
 u16 get_masked_button_presses_from_buffer(int port, int buffer) {
@@ -686,7 +979,12 @@ u16 get_masked_button_releases(int port) {
         return 0;
     }
 
+#ifdef NON_MATCHING
+    input_latch_sync();
+    return gButtonReleases[gVirtualContPortMap[port]] & ~sRepeatedReleases[gVirtualContPortMap[port]] & gButtonMask[port];
+#else
     return gButtonReleases[gVirtualContPortMap[port]] & gButtonMask[port];
+#endif
 }
 
 u16 get_masked_button_releases_from_buffer(int port, int buffer) {
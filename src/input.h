@@ -5,6 +5,41 @@
 
 #define CONTROLLER_THREAD_ID 0x62
 
+// Controller snapshots a game tick can apply at once
+#define INPUT_REC_MAX_SNAPSHOTS 4
+
+/**
+ * One controller snapshot of an InputRecFrame.
+ */
+typedef struct InputRecSnapshot {
+/*0000*/ u16 button;
+/*0002*/ u16 presses;
+/*0004*/ u16 releases;
+/*0006*/ s8 stickX;
+/*0007*/ s8 stickY;
+} InputRecSnapshot;
+
+/**
+ * The snapshots of virtual port 0 applied on a game tick, which also stand for
+ * every following tick until the next frame's.
+ */
+typedef struct InputRecFrame {
+/*0000*/ u32 frame; // Ticks since the recording started
+/*0004*/ u8 count;
+/*0005*/ u8 unk5[3];
+/*0008*/ InputRecSnapshot snaps[INPUT_REC_MAX_SNAPSHOTS];
+} InputRecFrame;
+
+/**
+ * A controller input stream, see input_record_start. The frames buffer is the caller's.
+ */
+typedef struct InputRecording {
+/*0000*/ InputRecFrame *frames;
+/*0004*/ s32 capacity;
+/*0008*/ s32 count;
+/*000C*/ u32 length; // Ticks recorded
+} InputRecording;
+
 /**
  * Signals the controller thread to apply controller inputs to input related globals
  * used by normal gameplay functions the next time it handles controller input.
@@ -26,6 +61,69 @@ s32 init_controller_data();
 
 void start_controller_thread(OSSched *scheduler);
 
+/**
+ * Sets whether input_late_latch refreshes the inputs.
+ */
+void input_set_late_latch(s32 enable);
+
+/**
+ * Folds controller snapshots that came in after this tick's inputs were applied
+ * into gContPads, gButtonPresses and gButtonReleases, if late latching is on.
+ * 
+ * @details The stick and held buttons are replaced by the newest snapshot's, new
+ * presses and releases are added. Those are reported again by the next apply,
+ * where the press and release accessors hide them.
+ * 
+ * Also stamps when this tick's inputs were sampled, so call it once a tick just
+ * before the player and camera are updated.
+ */
+void input_late_latch();
+
+/**
+ * Records the frame built last tick as being on screen, see input_get_latency_usec.
+ */
+void input_mark_frame_shown();
+
+/**
+ * Gets how long it took from the inputs of the frame last shown being sampled
+ * until it went on screen, in microseconds.
+ */
+u32 input_get_latency_usec();
+
+/**
+ * Starts recording the snapshots applied each tick on virtual port 0 into rec.
+ * 
+ * @details Ticks whose snapshots are the same as the last recorded ones aren't
+ * stored. Recording stops early if rec runs out of room.
+ */
+void input_record_start(InputRecording *rec);
+
+/**
+ * Starts feeding rec back in place of the controller, from its first tick on.
+ * 
+ * @details The applied snapshots, gContPads, gButtonPresses and gButtonReleases
+ * of virtual port 0 are replaced each tick. Late latching is off during a replay.
+ * For a deterministic run, start it from the same state the recording started
+ * from, such as right after bench_start.
+ */
+void input_replay_start(InputRecording *rec);
+
+/**
+ * Stops recording or replaying.
+ */
+void input_record_stop();
+
+/**
+ * @returns TRUE until a replay has fed back every tick it recorded.
+ */
+s32 input_replay_is_running();
+
+/**
+ * Records or replays this tick's inputs. Call once a tick, after the inputs are
+ * applied and before anything reads them.
+ */
+void input_record_tick();
+
 /**
  * Gets a masked bitfield of held buttons on the given controller.
  * 
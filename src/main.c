@@ -2,13 +2,21 @@
 #include <PR/sched.h>
 #include "crash.h"
 #include "input.h"
+#include "memory.h"
+#include "queue.h"
+#include "filesystem.h"
+#include "video.h"
+#include "scheduler.h"
 
 void func_8001440C(s32 arg0);
 void clear_PlayerPosBuffer(void);
 void func_800483BC(f32, f32, s32);
+void func_800142A0(f32 arg0, f32 arg1, s32 arg2);
 void game_init(void);
+void game_tick(void);
 void init_bittable(void);
 struct UnkStruct80014614 **dll_load_deferred(s32, s32);
+void dummied_print_func(const char *fmt, ...);
 
 const char gameVer[] = "1.3623";
 const char curentTime[] = "01/12/00 09:19";
@@ -39,13 +47,1191 @@ void mainproc(void * arg)
 
 void osCreateScheduler(OSSched *s, void *stack, OSPri priority, u8 mode, u8 retreceCount);
 
+#ifdef NON_MATCHING
+enum BootStage {
+    BOOT_STAGE_MEMORY,
+    BOOT_STAGE_THREADS,
+    BOOT_STAGE_FILESYSTEM,
+    BOOT_STAGE_TEXTURES,
+    BOOT_STAGE_MAPS,
+    BOOT_STAGE_MODELS,
+    BOOT_STAGE_OBJECTS,
+    BOOT_STAGE_AUDIO,
+    BOOT_STAGE_DLLS,
+    BOOT_STAGE_FINISH,
+
+    BOOT_STAGE_COUNT
+};
+
+// Microseconds spent in each stage of game_init
+u32 gBootStageTimes[BOOT_STAGE_COUNT];
+static OSTime gBootStageStart;
+
+static void boot_timer_mark(s32 stage)
+{
+    OSTime now = osGetTime();
+
+    if (stage != BOOT_STAGE_MEMORY)
+        gBootStageTimes[stage - 1] = OS_CYCLES_TO_USEC(now - gBootStageStart);
+    if (stage != BOOT_STAGE_COUNT)
+        gBootStageStart = now;
+}
+
+void dbg_boot_times_print(void)
+{
+    u32 total = 0;
+    s32 i;
+
+    for (i = 0; i < BOOT_STAGE_COUNT; i++)
+        total += gBootStageTimes[i];
+
+    dummied_print_func("boot %d us: mem %d thr %d fs %d tex %d map %d mdl %d obj %d aud %d dll %d fin %d, "
+        "%d tables prefetched, %d us waiting on them\n",
+        total,
+        gBootStageTimes[BOOT_STAGE_MEMORY],
+        gBootStageTimes[BOOT_STAGE_THREADS],
+        gBootStageTimes[BOOT_STAGE_FILESYSTEM],
+        gBootStageTimes[BOOT_STAGE_TEXTURES],
+        gBootStageTimes[BOOT_STAGE_MAPS],
+        gBootStageTimes[BOOT_STAGE_MODELS],
+        gBootStageTimes[BOOT_STAGE_OBJECTS],
+        gBootStageTimes[BOOT_STAGE_AUDIO],
+        gBootStageTimes[BOOT_STAGE_DLLS],
+        gBootStageTimes[BOOT_STAGE_FINISH],
+        gBootPrefetchHits,
+        gBootPrefetchWaitUs);
+}
+
+// Everything the expansion pak path of game_init loads, see dll_preload
+static DLLPreload sBootDLLs[] = {
+    { 1, 0xF }, { 2, 0x17 }, { 0x17, 8 }, { 0x12, 0x16 }, { 3, 0x1D }, { 0x1C, 4 },
+    { 0x19, 0xE }, { 7, 0xF }, { 8, 0xC }, { 9, 8 }, { 0xA, 3 }, { 4, 0xD },
+    { 5, 0x24 }, { 6, 0x12 }, { 0xB, 7 }, { 0xD, 0xA }, { 0xE, 0xC }, { 0xF, 8 },
+    { 0x10, 3 }, { 0x11, 2 }, { 0x14, 3 }, { 0x15, 5 }, { 0x16, 7 }, { 0x18, 7 },
+    { 0x1A, 0x26 }, { 0x4A, 7 }, { 0x1B, 9 }, { 0x1D, 0x24 }, { 0x38, 0xA }, { 0x1E, 6 },
+    { 0x1F, 2 }, { 0x20, 6 }, { 0x21, 0x16 }, { 0x3B, 2 }, { 0x36, 0xC }, { 0x39, 4 },
+    { 0x3A, 2 }
+};
+
+// The tables the init_* steps of game_init load, in the order they load them
+static u8 sBootFiles[] = {
+    TEXTABLE_BIN, TEX0_TAB, TEX1_TAB,                           // init_textures
+    MAPS_TAB, BLOCKS_TAB, HITS_TAB, TRKBLK_BIN,                 // init_maps
+    MODELS_TAB,                                                 // init_models
+    DLLS_TAB, DLLSIMPORTTAB_BIN,                                // init_dll_system
+    OBJECTS_TAB, OBJINDEX_BIN, TABLES_TAB, TABLES_BIN,          // init_objects
+    FONTS_BIN                                                   // init_fonts
+};
+
+#define BOOT_TIMER_MARK(stage) boot_timer_mark(stage)
+
+// Microseconds game_tick spent building the last frame's lists, and then blocked in
+// video_func_returning_delay for the previous frame to be shown
+u32 gFrameBuildTime;
+u32 gFrameWaitTime;
+
+void dbg_frame_times_print(void)
+{
+    dummied_print_func("frame build %d us wait %d us\n", gFrameBuildTime, gFrameWaitTime);
+}
+
+// Retraces each simulation step covers in fixed timestep mode, 0 while it is off
+static u8 sFixedStep;
+// Steps one tick may take to catch up after a slow frame
+static u8 sFixedMaxSteps;
+// Retraces shown but not simulated yet, negative when the simulation is ahead
+static s8 sFixedBacklog;
+// How far the shown frame is past the last simulated step, as a fraction of a step
+f32 gSimInterpAlpha;
+
+/**
+ * Makes game_tick advance the simulation in whole steps of stepRetraces instead of
+ * by however many retraces the last frame took. Slow frames are caught up with
+ * at most maxSteps steps' worth at once, anything further behind is dropped and
+ * the game slows down rather than moving in larger steps.
+ *
+ * Pass 0 to go back to variable steps.
+ */
+void frame_pacing_set_fixed_step(u8 stepRetraces, u8 maxSteps)
+{
+    sFixedStep = stepRetraces;
+    sFixedMaxSteps = maxSteps != 0 ? maxSteps : 1;
+    sFixedBacklog = 0;
+    gSimInterpAlpha = 0.0f;
+}
+
+/**
+ * @returns The retraces to simulate this tick given the ones the last frame took.
+ */
+static u8 frame_pacing_step(u8 retraces)
+{
+    s32 backlog;
+    s32 steps;
+
+    if (sFixedStep == 0)
+        return retraces;
+
+    backlog = sFixedBacklog + retraces;
+    steps = backlog / sFixedStep;
+    // The simulation always moves, even if the frame came in under a step
+    if (steps < 1)
+        steps = 1;
+    else if (steps > sFixedMaxSteps)
+        steps = sFixedMaxSteps;
+
+    backlog -= steps * sFixedStep;
+    if (backlog > sFixedStep)
+        backlog = sFixedStep;
+    else if (backlog < -sFixedStep)
+        backlog = -sFixedStep;
+    sFixedBacklog = backlog;
+
+    gSimInterpAlpha = (f32)backlog / (f32)sFixedStep;
+
+    return steps * sFixedStep;
+}
+
+// Stages of game_tick the profiler times, each runs until the next one's mark
+enum ProfStage {
+    PROF_STAGE_SUBMIT,
+    PROF_STAGE_DL_SETUP,
+    PROF_STAGE_WORLD,
+    PROF_STAGE_LOGIC,
+    PROF_STAGE_DLL_8C974,
+    PROF_STAGE_SUBTITLES,
+    PROF_STAGE_OVERLAYS,
+    PROF_STAGE_FINISH,
+
+    PROF_STAGE_COUNT
+};
+
+// Frames of stage times kept for averaging
+#define PROF_HISTORY 16
+// Bar pixels per 1/60th of a second
+#define PROF_BAR_SCALE 100
+#define PROF_BAR_HEIGHT 4
+#define PROF_COUNTS_PER_FRAME (OS_CPU_COUNTER / 60)
+
+s8 gProfilerEnabled;
+// osGetCount ticks per stage, for the last PROF_HISTORY frames
+u32 gProfStageTimes[PROF_HISTORY][PROF_STAGE_COUNT];
+u32 gProfFrame;
+static u32 gProfStageStart;
+static s32 gProfStage = -1;
+
+static u16 sProfStageColors[PROF_STAGE_COUNT] = {
+    GPACK_RGBA5551(128, 128, 128, 1), // Submit
+    GPACK_RGBA5551(255, 255, 0, 1),   // Display list setup
+    GPACK_RGBA5551(0, 255, 0, 1),     // World
+    GPACK_RGBA5551(0, 128, 255, 1),   // Logic
+    GPACK_RGBA5551(255, 0, 255, 1),   // DLL
+    GPACK_RGBA5551(255, 255, 255, 1), // Subtitles
+    GPACK_RGBA5551(255, 128, 0, 1),   // Overlays
+    GPACK_RGBA5551(255, 0, 0, 1)      // Finish
+};
+
+/**
+ * Ends the current stage and starts the next one. Marking PROF_STAGE_COUNT
+ * ends the frame.
+ */
+static void prof_mark(s32 stage)
+{
+    u32 now = osGetCount();
+    u32 *times = gProfStageTimes[gProfFrame % PROF_HISTORY];
+
+    if (gProfStage >= 0)
+        times[gProfStage] = now - gProfStageStart;
+
+    if (stage == PROF_STAGE_COUNT)
+    {
+        gProfStage = -1;
+        gProfFrame++;
+        return;
+    }
+
+    if (stage == PROF_STAGE_SUBMIT)
+        bzero(times, sizeof(gProfStageTimes[0]));
+
+    gProfStage = stage;
+    gProfStageStart = now;
+}
+
+/**
+ * Draws each stage's average time over recent frames as one stacked bar near the
+ * bottom of the screen, with white ticks at 1/60th and 1/30th of a second.
+ */
+void prof_draw(Gfx **gdl)
+{
+    u32 wh = get_some_resolution_encoded();
+    s32 width = wh & 0xFFFF;
+    s32 y = (wh >> 16) - 24;
+    u32 total;
+    s32 x;
+    s32 w;
+    s32 i;
+    s32 j;
+
+    if (!gProfilerEnabled)
+        return;
+
+    gDPPipeSync((*gdl)++);
+    gDPSetCycleType((*gdl)++, G_CYC_FILL);
+    gDPSetRenderMode((*gdl)++, G_RM_NOOP, G_RM_NOOP2);
+
+    x = 16;
+    for (i = 0; i < PROF_STAGE_COUNT; i++)
+    {
+        total = 0;
+        for (j = 0; j < PROF_HISTORY; j++)
+            total += gProfStageTimes[j][i];
+
+        w = (total / PROF_HISTORY) * PROF_BAR_SCALE / PROF_COUNTS_PER_FRAME;
+        if (x + w > width - 16)
+            w = width - 16 - x;
+        if (w <= 0)
+            continue;
+
+        gDPSetFillColor((*gdl)++, (sProfStageColors[i] << 16) | sProfStageColors[i]);
+        gDPFillRectangle((*gdl)++, x, y, x + w - 1, y + PROF_BAR_HEIGHT - 1);
+        gDPPipeSync((*gdl)++);
+        x += w;
+    }
+
+    gDPSetFillColor((*gdl)++, (GPACK_RGBA5551(255, 255, 255, 1) << 16) | GPACK_RGBA5551(255, 255, 255, 1));
+    for (i = 1; i <= 2; i++)
+    {
+        x = 16 + PROF_BAR_SCALE * i;
+        if (x < width)
+            gDPFillRectangle((*gdl)++, x, y - 2, x, y + PROF_BAR_HEIGHT + 1);
+    }
+    gDPPipeSync((*gdl)++);
+}
+
+#define PROF_MARK(stage) prof_mark(stage)
+
+// Frames to let the map load and settle before a benchmark starts measuring
+#define BENCH_WARMUP_FRAMES 60
+#define BENCH_SLOW_USEC (1000000 / 30)
+
+BenchStats gBenchStats;
+static BenchPath *sBenchPath;
+static BenchPath sBenchRecording;
+static SRT sBenchCamera;
+static s32 sBenchKey;
+static s32 sBenchKeyFrame;
+static s32 sBenchWarmup;
+static s8 sBenchReport; // Set when a run ends, for telemetry_tick to send gBenchStats
+
+
+/**
+ * Starts replaying path: warps to its map, waits BENCH_WARMUP_FRAMES and then
+ * flies the camera through its keys, timing every frame into gBenchStats.
+ * The summary is printed when the path ends. path must stay valid until then.
+ */
+void bench_start(BenchPath *path)
+{
+    if (path->keyCount < 2)
+        return;
+
+    bzero(&gBenchStats, sizeof(gBenchStats));
+    sBenchPath = path;
+    sBenchKey = 0;
+    sBenchKeyFrame = 0;
+    sBenchWarmup = BENCH_WARMUP_FRAMES;
+
+    bcopy(&path->keys[0].srt, &sBenchCamera, sizeof(SRT));
+    camera_set_override(&sBenchCamera);
+    func_800142A0(path->mapX, path->mapZ, path->mapArg);
+}
+
+/**
+ * @returns TRUE while a benchmark is running.
+ */
+s32 bench_is_running(void)
+{
+    return sBenchPath != NULL;
+}
+
+/**
+ * Starts recording a path that begins with a warp to mapX, mapZ.
+ */
+void bench_record_begin(f32 mapX, f32 mapZ, s32 mapArg)
+{
+    bzero(&sBenchRecording, sizeof(sBenchRecording));
+    sBenchRecording.mapX = mapX;
+    sBenchRecording.mapZ = mapZ;
+    sBenchRecording.mapArg = mapArg;
+}
+
+/**
+ * Adds camera to the recording as a key the replay reaches frames frames after
+ * the previous one.
+ *
+ * @returns The recording, so it can be passed to bench_start or dumped.
+ */
+BenchPath *bench_record_key(SRT *camera, s32 frames)
+{
+    BenchKey *key;
+
+    if (sBenchRecording.keyCount < BENCH_MAX_KEYS)
+    {
+        if (sBenchRecording.keyCount != 0)
+            sBenchRecording.keys[sBenchRecording.keyCount - 1].frames = frames;
+
+        key = &sBenchRecording.keys[sBenchRecording.keyCount++];
+        bcopy(camera, &key->srt, sizeof(SRT));
+        key->frames = 0;
+    }
+
+    return &sBenchRecording;
+}
+
+static s16 bench_lerp_angle(s16 a, s16 b, f32 t)
+{
+    return a + (s16)(b - a) * t;
+}
+
+static void bench_print(void)
+{
+    u32 frames = gBenchStats.frames != 0 ? gBenchStats.frames : 1;
+
+    dummied_print_func("bench %d frames, %d slow: cpu %d/%d us rsp %d/%d us rdp %d/%d us (avg/max)\n",
+        gBenchStats.frames, gBenchStats.slowFrames,
+        gBenchStats.cpuTotal / frames, gBenchStats.cpuMax,
+        gBenchStats.rspTotal / frames, gBenchStats.rspMax,
+        gBenchStats.rdpTotal / frames, gBenchStats.rdpMax);
+}
+
+// Once per game_tick: records the last frame's times and moves the camera on
+static void bench_tick(void)
+{
+    SchedFrameTimes rcp;
+    BenchKey *key;
+    BenchKey *next;
+    u32 rsp;
+    u32 rdp;
+    f32 t;
+
+    if (sBenchPath == NULL)
+        return;
+
+    if (sBenchWarmup != 0)
+    {
+        sBenchWarmup--;
+        return;
+    }
+
+    if (sched_get_frame_times(0, &rcp))
+    {
+        rsp = OS_CYCLES_TO_USEC(rcp.rspGfx + rcp.rspAudio);
+        rdp = OS_CYCLES_TO_USEC(rcp.rdp);
+
+        gBenchStats.frames++;
+        gBenchStats.cpuTotal += gFrameBuildTime;
+        gBenchStats.rspTotal += rsp;
+        gBenchStats.rdpTotal += rdp;
+        if (gFrameBuildTime > gBenchStats.cpuMax)
+            gBenchStats.cpuMax = gFrameBuildTime;
+        if (rsp > gBenchStats.rspMax)
+            gBenchStats.rspMax = rsp;
+        if (rdp > gBenchStats.rdpMax)
+            gBenchStats.rdpMax = rdp;
+        if (gFrameBuildTime > BENCH_SLOW_USEC || rsp > BENCH_SLOW_USEC || rdp > BENCH_SLOW_USEC)
+            gBenchStats.slowFrames++;
+    }
+
+    // One step per tick however long the tick took, so every run draws the same views
+    key = &sBenchPath->keys[sBenchKey];
+    while (sBenchKeyFrame >= key->frames)
+    {
+        sBenchKey++;
+        sBenchKeyFrame = 0;
+        if (sBenchKey >= sBenchPath->keyCount - 1)
+        {
+            sBenchPath = NULL;
+            camera_set_override(NULL);
+            bench_print();
+            sBenchReport = TRUE;
+            return;
+        }
+        key = &sBenchPath->keys[sBenchKey];
+    }
+
+    next = key + 1;
+    t = (f32)sBenchKeyFrame / key->frames;
+    sBenchCamera.yaw = bench_lerp_angle(key->srt.yaw, next->srt.yaw, t);
+    sBenchCamera.pitch = bench_lerp_angle(key->srt.pitch, next->srt.pitch, t);
+    sBenchCamera.roll = bench_lerp_angle(key->srt.roll, next->srt.roll, t);
+    sBenchCamera.transl.x = key->srt.transl.x + (next->srt.transl.x - key->srt.transl.x) * t;
+    sBenchCamera.transl.y = key->srt.transl.y + (next->srt.transl.y - key->srt.transl.y) * t;
+    sBenchCamera.transl.z = key->srt.transl.z + (next->srt.transl.z - key->srt.transl.z) * t;
+    sBenchKeyFrame++;
+}
+
+// Telemetry packets, read by tools/telemetry_recv.py. All fields are big-endian u32s.
+#define TELEMETRY_MAGIC 0x44505431 // "DPT1"
+#define TELEMETRY_FRAME 0
+#define TELEMETRY_STREAM 1
+#define TELEMETRY_HEAP 2
+#define TELEMETRY_TRACE 3
+#define TELEMETRY_RENDER 4
+#define TELEMETRY_DL 5
+#define TELEMETRY_BENCH 6
+#define TELEMETRY_SAMPLES 7
+#define TELEMETRY_DLLS 8
+#define TELEMETRY_THREADS 9
+#define TELEMETRY_STACKS 10
+// Frames between the stream and heap packets, which cost more to gather
+#define TELEMETRY_SLOW_INTERVAL 30
+#define TELEMETRY_MAX_HEAPS 4
+#define TELEMETRY_MAX_TRACE 64
+#define TELEMETRY_MAX_SAMPLES 128
+#define TELEMETRY_MAX_DLLS 64
+#define TELEMETRY_MAX_THREADS 16
+#define TELEMETRY_MAX_STACKS 8
+// Display list capture, see telemetry_capture_dl
+#define TELEMETRY_DL_CHUNK 0x2000       // Most bytes of display list in one packet
+#define TELEMETRY_DL_CALLED 0xFF        // TelemetryDL tag of a list the frame's display list called
+#define TELEMETRY_MAX_CALLED 512
+#define TELEMETRY_MAX_CALLED_GFX 0x800
+// TELEMETRY_SINK_ISVIEWER lines are "@DPT", the packet in hex and a newline
+#define TELEMETRY_ISV_PREFIX 0x40445054 // "@DPT"
+
+// IS-Viewer 64 registers in cartridge space. Emulators print the bytes in the
+// buffer when the count of them is written to ISV_PUT_REG.
+#define ISV_PUT_REG 0x13FF0014
+#define ISV_BUFFER 0x13FF0020
+
+typedef struct TelemetryHeader {
+/*0000*/    u32 magic;
+/*0004*/    u16 type;
+/*0006*/    u16 size;       // Including this header, always a multiple of 8
+/*0008*/    u32 frame;
+} TelemetryHeader;
+
+typedef struct TelemetryFrame {
+/*0000*/    TelemetryHeader header;
+/*000C*/    u32 stages[PROF_STAGE_COUNT];   // osGetCount ticks
+/*002C*/    u32 cpuUsec;
+/*0030*/    u32 rspGfxUsec;
+/*0034*/    u32 rspAudioUsec;
+/*0038*/    u32 rdpUsec;
+/*003C*/    u32 dlUsed[DL_BUFFER_COUNT];
+/*004C*/    u32 piBytes[PI_CLIENT_COUNT];
+/*0058*/    u32 audioTasks;     // The rest are totals since the last reset
+/*005C*/    u32 audioLate;
+/*0060*/    u32 audioSlow;
+/*0064*/    u32 audioMaxRun;    // osGetCount ticks
+/*0068*/    u32 unused68;
+} TelemetryFrame;
+
+typedef struct TelemetryStreamStat {
+/*0000*/    u32 count;
+/*0004*/    u32 bytes;
+/*0008*/    u32 waitAvg;    // Microseconds
+/*000C*/    u32 waitMax;
+/*0010*/    u32 dmaAvg;
+/*0014*/    u32 dmaMax;
+/*0018*/    u32 inflateAvg;
+/*001C*/    u32 inflateMax;
+} TelemetryStreamStat;
+
+typedef struct TelemetryStream {
+/*0000*/    TelemetryHeader header;
+/*000C*/    TelemetryStreamStat stats[STREAM_STAT_COUNT];
+} TelemetryStream;
+
+typedef struct TelemetryHeap {
+/*0000*/    TelemetryHeader header;
+/*000C*/    u32 count;
+/*0010*/    struct {
+                u32 used;
+                u32 free;
+                u32 largestFree;
+                u32 freeRuns;
+            } heaps[TELEMETRY_MAX_HEAPS];
+} TelemetryHeap;
+
+// ROM addresses streaming DMAs started at, see pi_trace_set_enabled
+typedef struct TelemetryTrace {
+/*0000*/    TelemetryHeader header;
+/*000C*/    u32 count;
+/*0010*/    u32 dropped;    // Total since telemetry was enabled
+/*0014*/    u32 addrs[TELEMETRY_MAX_TRACE];
+} TelemetryTrace;
+
+// What the last frame's render list drew, sent ahead of its TELEMETRY_DL packets
+typedef struct TelemetryRender {
+/*0000*/    TelemetryHeader header;
+/*000C*/    u32 blockItems;
+/*0010*/    u32 actorItems;
+/*0014*/    u32 blocks;
+/*0018*/    u32 ranges;         // DLTag ranges the frame's display list was written in
+/*001C*/    u32 called;         // Lists those called, each sent once
+/*0020*/    u32 calledDropped;  // Calls to lists past TELEMETRY_MAX_CALLED
+} TelemetryRender;
+
+// A chunk of a captured display list, followed by its Gfx
+typedef struct TelemetryDL {
+/*0000*/    TelemetryHeader header;
+/*000C*/    u32 tag;        // DLTag of the range, or TELEMETRY_DL_CALLED
+/*0010*/    u32 range;      // Index of the range, or the called list's physical address
+/*0014*/    u32 offset;     // Of this chunk into the list, in bytes
+} TelemetryDL;
+
+// gBenchStats once a benchmark run ends
+typedef struct TelemetryBench {
+/*0000*/    TelemetryHeader header;
+/*000C*/    BenchStats stats;
+} TelemetryBench;
+
+// PCs prof_sampler caught, see prof_sampler_start
+typedef struct TelemetrySamples {
+/*0000*/    TelemetryHeader header;
+/*000C*/    u32 count;
+/*0010*/    u32 dropped;    // Total since the sampler started
+/*0014*/    ProfSample samples[TELEMETRY_MAX_SAMPLES];
+} TelemetrySamples;
+
+// Where the loaded DLLs are, sent whenever that changes so PC samples in DLL code
+// can be traced back to them
+typedef struct TelemetryDLLs {
+/*0000*/    TelemetryHeader header;
+/*000C*/    u32 total;      // Loaded DLLs, sent TELEMETRY_MAX_DLLS to a packet
+/*0010*/    u32 first;      // Index of the first one in this packet
+/*0014*/    u32 count;
+/*0018*/    struct {
+                u32 id;
+                u32 start;  // The DLLFile header, exports start 0x18 in
+                u32 end;
+            } dlls[TELEMETRY_MAX_DLLS];
+} TelemetryDLLs;
+
+// prof_sampler's per thread totals since it started, see prof_threads_get
+typedef struct TelemetryThreads {
+/*0000*/    TelemetryHeader header;
+/*000C*/    u32 usecPerSample;
+/*0010*/    u32 count;
+/*0014*/    ProfThreadStats threads[TELEMETRY_MAX_THREADS];
+} TelemetryThreads;
+
+// How deep each watched thread stack has gone, see stack_get_stats
+typedef struct TelemetryStacks {
+/*0000*/    TelemetryHeader header;
+/*000C*/    u32 count;
+/*0010*/    StackStats stacks[TELEMETRY_MAX_STACKS];
+} TelemetryStacks;
+
+#define TELEMETRY_SIZE(type) ((sizeof(type) + 7) & ~7)
+
+static union {
+    u64 align;
+    TelemetryFrame frame;
+    TelemetryStream stream;
+    TelemetryHeap heap;
+    TelemetryTrace trace;
+    TelemetryRender render;
+    TelemetryDL dl;
+    TelemetryBench bench;
+    TelemetrySamples samples;
+    TelemetryDLLs dlls;
+    TelemetryThreads threads;
+    TelemetryStacks stacks;
+    u8 bytes[TELEMETRY_SIZE(TelemetrySamples)];
+} sTelemetryPacket;
+static s8 sTelemetryEnabled;
+static s8 sTelemetrySink;
+static u32 sTelemetryIsvPut;
+static u32 sTelemetryFrame;
+static s32 sTelemetryCaptureFrames;
+static u32 sTelemetryCalled[TELEMETRY_MAX_CALLED];
+static s32 sTelemetryCalledCount;
+static u32 sTelemetryCalledDropped;
+static u32 sTelemetryDLLHash;
+
+/**
+ * Starts or stops streaming telemetry packets to the host with osWriteHost, or
+ * what telemetry_set_sink picked.
+ *
+ * @details osWriteHost waits for the host to read each packet, so this must only
+ * be enabled with a development host attached and reading.
+ */
+void telemetry_set_enabled(s32 enabled)
+{
+    sTelemetryEnabled = enabled;
+    sTelemetryFrame = 0;
+    sTelemetryDLLHash = 0;
+    gPiTraceDropped = 0;
+    pi_trace_set_enabled(enabled);
+}
+
+/**
+ * Sends the display list the last frame's render list drew along with telemetry,
+ * for each of the next frames frames, for tools/dl_stats.py to break down by
+ * command.
+ *
+ * @details The whole frame's display list is sent, by DLTag range, along with
+ * the lists it calls directly. Lists those call in turn aren't followed. Many
+ * packets are sent per captured frame, so their timings are off.
+ */
+void telemetry_capture_dl(s32 frames)
+{
+    sTelemetryCaptureFrames = frames;
+}
+
+/**
+ * Picks where telemetry packets go, one of enum TelemetrySink.
+ *
+ * @details TELEMETRY_SINK_ISVIEWER is for emulators, which don't implement
+ * osWriteHost but print what's written to the IS-Viewer. Writing a packet there
+ * takes a PI register write per 2 bytes, so the timings of frames sending display
+ * lists are off by more.
+ */
+void telemetry_set_sink(s32 sink)
+{
+    sTelemetrySink = sink;
+}
+
+s32 func_with_status_reg(void);
+void set_status_reg(s32);
+
+// A CPU write to cartridge space, once the PI is done with any DMA for another thread
+static void telemetry_isv_write(u32 addr, u32 word)
+{
+    s32 sr = func_with_status_reg();
+
+    while (*(vu32 *)OS_PHYSICAL_TO_K1(PI_STATUS_REG) & (PI_STATUS_DMA_BUSY | PI_STATUS_IO_BUSY));
+    *(vu32 *)OS_PHYSICAL_TO_K1(addr) = word;
+    set_status_reg(sr);
+}
+
+// Adds size bytes, an even count, to the IS-Viewer buffer as hex
+static void telemetry_isv_hex(u8 *data, u32 size)
+{
+    static const char digits[] = "0123456789ABCDEF";
+    u32 i;
+
+    for (i = 0; i < size; i += 2, sTelemetryIsvPut += 4)
+    {
+        telemetry_isv_write(ISV_BUFFER + sTelemetryIsvPut,
+            (digits[data[i] >> 4] << 24) | (digits[data[i] & 0xF] << 16) |
+            (digits[data[i + 1] >> 4] << 8) | digits[data[i + 1] & 0xF]);
+    }
+}
+
+// Sends size bytes of the packet, followed by dataSize bytes from data
+static void telemetry_send(u16 type, u16 size, void *data, u16 dataSize)
+{
+    TelemetryHeader *header = &sTelemetryPacket.frame.header;
+
+    header->magic = TELEMETRY_MAGIC;
+    header->type = type;
+    header->size = size + dataSize;
+    header->frame = sTelemetryFrame;
+
+    if (sTelemetrySink == TELEMETRY_SINK_ISVIEWER)
+    {
+        // One line per packet, TELEMETRY_DL_CHUNK keeps it inside the 64KB buffer
+        telemetry_isv_write(ISV_BUFFER, TELEMETRY_ISV_PREFIX);
+        sTelemetryIsvPut = 4;
+        telemetry_isv_hex((u8 *)&sTelemetryPacket, size);
+        if (dataSize != 0)
+            telemetry_isv_hex(data, dataSize);
+        telemetry_isv_write(ISV_BUFFER + sTelemetryIsvPut, '\n' << 24);
+        telemetry_isv_write(ISV_PUT_REG, sTelemetryIsvPut + 1);
+        return;
+    }
+
+    osWriteHost(&sTelemetryPacket, size);
+    if (dataSize != 0)
+        osWriteHost(data, dataSize);
+}
+
+// Notes the lists gSPDisplayList calls between start and end, once each
+static void telemetry_find_called(Gfx *start, Gfx *end)
+{
+    Gfx *gfx;
+    u32 addr;
+    s32 i;
+
+    for (gfx = start; gfx < end; gfx++)
+    {
+        if ((gfx->words.w0 >> 24) != G_DL || ((gfx->words.w0 >> 16) & 0xFF) != G_DL_PUSH)
+            continue;
+
+        // Segmented addresses would depend on the RSP's segment table
+        addr = gfx->words.w1;
+        if (addr >= osMemSize)
+            continue;
+
+        for (i = 0; i < sTelemetryCalledCount; i++)
+        {
+            if (sTelemetryCalled[i] == addr)
+                break;
+        }
+        if (i < sTelemetryCalledCount)
+            continue;
+
+        if (sTelemetryCalledCount == TELEMETRY_MAX_CALLED)
+            sTelemetryCalledDropped++;
+        else
+            sTelemetryCalled[sTelemetryCalledCount++] = addr;
+    }
+}
+
+// Just past the gSPEndDisplayList or gSPBranchList ending a called list
+static Gfx *telemetry_called_end(u32 addr)
+{
+    Gfx *gfx = (Gfx *)PHYS_TO_K0(addr);
+    Gfx *end = gfx + TELEMETRY_MAX_CALLED_GFX;
+    u32 op;
+
+    if ((u32)end > PHYS_TO_K0(osMemSize))
+        end = (Gfx *)PHYS_TO_K0(osMemSize & ~7);
+
+    for (; gfx < end; gfx++)
+    {
+        op = gfx->words.w0 >> 24;
+        if (op == G_ENDDL || (op == G_DL && ((gfx->words.w0 >> 16) & 0xFF) == G_DL_NOPUSH))
+            return gfx + 1;
+    }
+    return end;
+}
+
+static void telemetry_send_dl(u32 tag, u32 range, Gfx *start, Gfx *end)
+{
+    TelemetryDL *dl = &sTelemetryPacket.dl;
+    u32 bytes = (u8 *)end - (u8 *)start;
+    u32 offset;
+    u32 size;
+
+    osWritebackDCache(start, bytes);
+    for (offset = 0; offset < bytes; offset += size)
+    {
+        size = bytes - offset < TELEMETRY_DL_CHUNK ? bytes - offset : TELEMETRY_DL_CHUNK;
+        bzero(&sTelemetryPacket, TELEMETRY_SIZE(TelemetryDL));
+        dl->tag = tag;
+        dl->range = range;
+        dl->offset = offset;
+        telemetry_send(TELEMETRY_DL, TELEMETRY_SIZE(TelemetryDL), (u8 *)start + offset, size);
+    }
+}
+
+// The last frame's display list is still whole until this frame's is written over it
+static void telemetry_send_capture(void)
+{
+    TelemetryRender *render = &sTelemetryPacket.render;
+    Gfx *start;
+    Gfx *end;
+    s32 tag;
+    s32 blockItems;
+    s32 actorItems;
+    s32 blocks;
+    s32 ranges;
+    s32 i;
+
+    sTelemetryCalledCount = 0;
+    sTelemetryCalledDropped = 0;
+    for (ranges = 0; dl_tag_get_range(ranges, &start, &end, &tag); ranges++)
+        telemetry_find_called(start, end);
+
+    render_list_get_stats(&blockItems, &actorItems, &blocks);
+    bzero(&sTelemetryPacket, TELEMETRY_SIZE(TelemetryRender));
+    render->blockItems = blockItems;
+    render->actorItems = actorItems;
+    render->blocks = blocks;
+    render->ranges = ranges;
+    render->called = sTelemetryCalledCount;
+    render->calledDropped = sTelemetryCalledDropped;
+    telemetry_send(TELEMETRY_RENDER, TELEMETRY_SIZE(TelemetryRender), NULL, 0);
+
+    for (i = 0; i < ranges; i++)
+    {
+        dl_tag_get_range(i, &start, &end, &tag);
+        telemetry_send_dl(tag, i, start, end);
+    }
+    for (i = 0; i < sTelemetryCalledCount; i++)
+    {
+        start = (Gfx *)PHYS_TO_K0(sTelemetryCalled[i]);
+        telemetry_send_dl(TELEMETRY_DL_CALLED, sTelemetryCalled[i], start, telemetry_called_end(sTelemetryCalled[i]));
+    }
+}
+
+// Sends where the loaded DLLs are if any were loaded, unloaded or moved since last time
+static void telemetry_send_dlls(void)
+{
+    TelemetryDLLs *dlls = &sTelemetryPacket.dlls;
+    u32 hash = 1;
+    s32 loaded = 0;
+    s32 i;
+
+    for (i = 0; i < gLoadedDLLCount; i++)
+    {
+        if (gLoadedDLLList[i].id == 0xFFFFFFFF)
+            continue;
+        hash = hash * 31 + gLoadedDLLList[i].id;
+        hash = hash * 31 + (u32)gLoadedDLLList[i].exports;
+        loaded++;
+    }
+    if (hash == sTelemetryDLLHash)
+        return;
+    sTelemetryDLLHash = hash;
+
+    bzero(&sTelemetryPacket, TELEMETRY_SIZE(TelemetryDLLs));
+    dlls->total = loaded;
+    for (i = 0; i < gLoadedDLLCount; i++)
+    {
+        if (gLoadedDLLList[i].id == 0xFFFFFFFF)
+            continue;
+        dlls->dlls[dlls->count].id = gLoadedDLLList[i].id;
+        dlls->dlls[dlls->count].start = (u32)gLoadedDLLList[i].exports - 0x18;
+        dlls->dlls[dlls->count].end = (u32)gLoadedDLLList[i].end;
+        if (++dlls->count == TELEMETRY_MAX_DLLS)
+        {
+            telemetry_send(TELEMETRY_DLLS, TELEMETRY_SIZE(TelemetryDLLs), NULL, 0);
+            dlls->first += TELEMETRY_MAX_DLLS;
+            dlls->count = 0;
+        }
+    }
+    if (dlls->count != 0 || loaded == 0)
+        telemetry_send(TELEMETRY_DLLS, TELEMETRY_SIZE(TelemetryDLLs), NULL, 0);
+}
+
+static u32 telemetry_avg(StreamTimeStat *stat)
+{
+    return stat->samples != 0 ? stat->total / stat->samples : 0;
+}
+
+// Once per game_tick: sends the last frame's timings, and every so often the rest
+static void telemetry_tick(void)
+{
+    TelemetryFrame *frame = &sTelemetryPacket.frame;
+    TelemetryStream *stream = &sTelemetryPacket.stream;
+    TelemetryHeap *heap = &sTelemetryPacket.heap;
+    TelemetryTrace *trace = &sTelemetryPacket.trace;
+    TelemetrySamples *samples = &sTelemetryPacket.samples;
+    SchedFrameTimes rcp;
+    SchedAudioStats audio;
+    HeapStats heapStats;
+    s32 i;
+
+    if (!sTelemetryEnabled)
+        return;
+
+    bzero(&sTelemetryPacket, TELEMETRY_SIZE(TelemetryFrame));
+    bcopy(gProfStageTimes[(gProfFrame - 1) % PROF_HISTORY], frame->stages, sizeof(frame->stages));
+    frame->cpuUsec = gFrameBuildTime;
+    if (sched_get_frame_times(0, &rcp))
+    {
+        frame->rspGfxUsec = OS_CYCLES_TO_USEC(rcp.rspGfx);
+        frame->rspAudioUsec = OS_CYCLES_TO_USEC(rcp.rspAudio);
+        frame->rdpUsec = OS_CYCLES_TO_USEC(rcp.rdp);
+    }
+    for (i = 0; i < DL_BUFFER_COUNT; i++)
+        frame->dlUsed[i] = gDLBufferStats.used[i];
+    for (i = 0; i < PI_CLIENT_COUNT; i++)
+        frame->piBytes[i] = gPiClientStats[i].lastFrameBytes;
+    sched_get_audio_stats(&audio);
+    frame->audioTasks = audio.tasks;
+    frame->audioLate = audio.late;
+    frame->audioSlow = audio.slow;
+    frame->audioMaxRun = audio.maxRun;
+    telemetry_send(TELEMETRY_FRAME, TELEMETRY_SIZE(TelemetryFrame), NULL, 0);
+
+    bzero(&sTelemetryPacket, TELEMETRY_SIZE(TelemetryTrace));
+    trace->count = pi_trace_take(trace->addrs, TELEMETRY_MAX_TRACE);
+    trace->dropped = gPiTraceDropped;
+    if (trace->count != 0)
+        telemetry_send(TELEMETRY_TRACE, TELEMETRY_SIZE(TelemetryTrace), NULL, 0);
+
+    // Ahead of the samples, which may be in the DLLs loaded since the last ones
+    telemetry_send_dlls();
+    do
+    {
+        bzero(&sTelemetryPacket, TELEMETRY_SIZE(TelemetrySamples));
+        samples->count = prof_sampler_take(samples->samples, TELEMETRY_MAX_SAMPLES);
+        samples->dropped = gProfSamplerDropped;
+        if (samples->count == 0)
+            break;
+        // Only as long as the samples in it
+        telemetry_send(TELEMETRY_SAMPLES,
+            TELEMETRY_SIZE(TelemetrySamples) - (TELEMETRY_MAX_SAMPLES - samples->count) * sizeof(ProfSample),
+            NULL, 0);
+    } while (samples->count == TELEMETRY_MAX_SAMPLES);
+
+    if (sTelemetryFrame % TELEMETRY_SLOW_INTERVAL == 0)
+    {
+        bzero(&sTelemetryPacket, TELEMETRY_SIZE(TelemetryStream));
+        for (i = 0; i < STREAM_STAT_COUNT; i++)
+        {
+            stream->stats[i].count = gStreamStats[i].count;
+            stream->stats[i].bytes = gStreamStats[i].bytes;
+            stream->stats[i].waitAvg = telemetry_avg(&gStreamStats[i].wait);
+            stream->stats[i].waitMax = gStreamStats[i].wait.max;
+            stream->stats[i].dmaAvg = telemetry_avg(&gStreamStats[i].dma);
+            stream->stats[i].dmaMax = gStreamStats[i].dma.max;
+            stream->stats[i].inflateAvg = telemetry_avg(&gStreamStats[i].inflate);
+            stream->stats[i].inflateMax = gStreamStats[i].inflate.max;
+        }
+        telemetry_send(TELEMETRY_STREAM, TELEMETRY_SIZE(TelemetryStream), NULL, 0);
+
+        bzero(&sTelemetryPacket, TELEMETRY_SIZE(TelemetryHeap));
+        heap->count = gHeapBlkListSize < TELEMETRY_MAX_HEAPS ? gHeapBlkListSize : TELEMETRY_MAX_HEAPS;
+        for (i = 0; i < (s32)heap->count; i++)
+        {
+            heap_get_stats(i, &heapStats);
+            heap->heaps[i].used = heapStats.usedBytes;
+            heap->heaps[i].free = heapStats.freeBytes;
+            heap->heaps[i].largestFree = heapStats.largestFree;
+            heap->heaps[i].freeRuns = heapStats.freeRuns;
+        }
+        telemetry_send(TELEMETRY_HEAP, TELEMETRY_SIZE(TelemetryHeap), NULL, 0);
+
+        if (gProfSamplerUsec != 0)
+        {
+            bzero(&sTelemetryPacket, TELEMETRY_SIZE(TelemetryThreads));
+            sTelemetryPacket.threads.usecPerSample = gProfSamplerUsec;
+            sTelemetryPacket.threads.count = prof_threads_get(sTelemetryPacket.threads.threads, TELEMETRY_MAX_THREADS);
+            telemetry_send(TELEMETRY_THREADS, TELEMETRY_SIZE(TelemetryThreads), NULL, 0);
+        }
+
+        stack_scan();
+        bzero(&sTelemetryPacket, TELEMETRY_SIZE(TelemetryStacks));
+        sTelemetryPacket.stacks.count = stack_get_stats(sTelemetryPacket.stacks.stacks, TELEMETRY_MAX_STACKS);
+        telemetry_send(TELEMETRY_STACKS, TELEMETRY_SIZE(TelemetryStacks), NULL, 0);
+    }
+
+    if (sTelemetryCaptureFrames != 0)
+    {
+        sTelemetryCaptureFrames--;
+        telemetry_send_capture();
+    }
+
+    if (sBenchReport)
+    {
+        sBenchReport = FALSE;
+        bzero(&sTelemetryPacket, TELEMETRY_SIZE(TelemetryBench));
+        bcopy(&gBenchStats, &sTelemetryPacket.bench.stats, sizeof(BenchStats));
+        telemetry_send(TELEMETRY_BENCH, TELEMETRY_SIZE(TelemetryBench), NULL, 0);
+    }
+
+    sTelemetryFrame++;
+}
+
+#define BENCH_SCRIPT_MAGIC 0x44504253 // "DPBS"
+#define BENCH_SCRIPT_MAX_INPUTS 128
+
+// A benchmark to run from boot with no host attached. tools/bench_rom.py finds it
+// in a built ROM by its magic and fills it in.
+typedef struct BenchScript {
+/*0000*/    u32 magic;
+/*0004*/    u32 bootTicks;      // Game ticks to wait, 0 to not run
+/*0008*/    u32 sink;           // enum TelemetrySink
+/*000C*/    s32 inputCount;     // InputRecFrames to replay alongside the path, 0 for none
+/*0010*/    u32 inputLength;    // Ticks recorded
+/*0014*/    BenchPath path;
+/*01E4*/    InputRecFrame inputs[BENCH_SCRIPT_MAX_INPUTS];
+} BenchScript;
+
+// Only the magic is listed, so it goes through a union to leave the rest zero
+static union {
+    u32 magic;
+    BenchScript script;
+} sBenchScript = { BENCH_SCRIPT_MAGIC };
+static InputRecording sBenchScriptInputs;
+
+// Starts sBenchScript once its boot ticks have passed, with telemetry on
+static void bench_script_tick(void)
+{
+    if (sBenchScript.script.bootTicks == 0 || --sBenchScript.script.bootTicks != 0)
+        return;
+
+    telemetry_set_sink(sBenchScript.script.sink);
+    telemetry_set_enabled(TRUE);
+    bench_start(&sBenchScript.script.path);
+    if (sBenchScript.script.inputCount != 0)
+    {
+        sBenchScriptInputs.frames = sBenchScript.script.inputs;
+        sBenchScriptInputs.capacity = BENCH_SCRIPT_MAX_INPUTS;
+        sBenchScriptInputs.count = sBenchScript.script.inputCount;
+        sBenchScriptInputs.length = sBenchScript.script.inputLength;
+        input_replay_start(&sBenchScriptInputs);
+    }
+}
+
+// Each half of the double buffers, as four_mallocs allocates them
+#define DL_GFX_SIZE 0x8CA0
+#define DL_MTX_SIZE 0x11300
+#define DL_VTX_SIZE 0x12C0
+#define DL_6B0_SIZE 0x320
+// Chunks chained on from the frame arena once a buffer gets within its margin of full
+#define DL_CHUNK_SIZE 0x1000
+
+DLBufferStats gDLBufferStats;
+
+static u32 sDLBufferSizes[DL_BUFFER_COUNT] = { DL_GFX_SIZE, DL_MTX_SIZE, DL_VTX_SIZE, DL_6B0_SIZE };
+
+static u8 **sDLBufferPtrs[DL_BUFFER_COUNT] = {
+    (u8 **)&D_800AE680, (u8 **)&D_800AE690, (u8 **)&D_800AE6A0, &D_800AE6B0
+};
+// Most a buffer may grow between two dl_buffers_check calls
+static u16 sDLBufferMargins[DL_BUFFER_COUNT] = { 0x800, 0x800, 0x200, 0x40 };
+static s8 sDLChaining;
+static u8 *sDLChunkStart[DL_BUFFER_COUNT];
+static u8 *sDLChunkEnd[DL_BUFFER_COUNT];
+// Bytes filled in chunks this frame has already moved on from
+static u32 sDLChainedBytes[DL_BUFFER_COUNT];
+// Just past the gSPBranchList out of the gMainDL buffer, NULL if this frame hasn't chained
+static Gfx *sDLBaseEnd;
+static Gfx *sDLSubmitEnd;
+
+/**
+ * Lets dl_buffers_check chain frame arena chunks on to buffers that are about to
+ * fill up, instead of only counting the near overflow. The arena is only reserved
+ * the first time chaining is turned on.
+ */
+void dl_buffers_set_chaining(s32 enable)
+{
+    if (enable && gFrameArena.size == 0) {
+        arena_init(FRAME_ARENA_SIZE);
+    }
+    sDLChaining = enable;
+}
+
+// Once per game_tick, with the index of the buffers about to be filled
+static void dl_buffers_begin_frame(s32 buffer)
+{
+    s32 i;
+
+    sDLChunkStart[DL_BUFFER_GFX] = (u8 *)D_800AE678[buffer];
+    sDLChunkStart[DL_BUFFER_MTX] = (u8 *)D_800AE688[buffer];
+    sDLChunkStart[DL_BUFFER_VTX] = (u8 *)D_800AE698[buffer];
+    sDLChunkStart[DL_BUFFER_6B0] = (u8 *)D_800AE6A8[buffer];
+
+    for (i = 0; i < DL_BUFFER_COUNT; i++)
+    {
+        gDLBufferStats.size[i] = sDLBufferSizes[i];
+        sDLChunkEnd[i] = sDLChunkStart[i] + sDLBufferSizes[i];
+        sDLChainedBytes[i] = 0;
+    }
+
+    sDLBaseEnd = NULL;
+}
+
+/**
+ * Moves any buffer with less than its margin left on to a new chunk. gMainDL
+ * branches to the new chunk with gSPBranchList, the other buffers only hold
+ * data referenced by address, so they just carry on in it.
+ *
+ * @details Nothing checks the buffers as they are written, so this is called
+ * between game_tick's stages. A stage that writes more than the margin can
+ * still overflow.
+ */
+void dl_buffers_check(void)
+{
+    u8 *chunk;
+    u8 *cur;
+    s32 i;
+
+    for (i = 0; i < DL_BUFFER_COUNT; i++)
+    {
+        cur = *sDLBufferPtrs[i];
+        if (sDLChunkEnd[i] - cur >= sDLBufferMargins[i])
+            continue;
+
+        chunk = sDLChaining ? arena_alloc(DL_CHUNK_SIZE, 8) : NULL;
+        if (chunk == NULL)
+        {
+            gDLBufferStats.overflows++;
+            continue;
+        }
+
+        if (i == DL_BUFFER_GFX)
+        {
+            gSPBranchList((Gfx *)cur, OS_K0_TO_PHYSICAL(chunk));
+            cur += sizeof(Gfx);
+            dl_tag_continue((Gfx *)cur, (Gfx *)chunk);
+            if (sDLBaseEnd == NULL)
+                sDLBaseEnd = (Gfx *)cur;
+        }
+
+        sDLChainedBytes[i] += cur - sDLChunkStart[i];
+        sDLChunkStart[i] = chunk;
+        sDLChunkEnd[i] = chunk + DL_CHUNK_SIZE;
+        *sDLBufferPtrs[i] = chunk;
+        gDLBufferStats.chunks[i]++;
+    }
+}
+
+/**
+ * Records how much of each buffer the frame used, once its display list is ended.
+ */
+void dl_buffers_end_frame(void)
+{
+    u32 used;
+    s32 i;
+
+    for (i = 0; i < DL_BUFFER_COUNT; i++)
+    {
+        used = sDLChainedBytes[i] + (*sDLBufferPtrs[i] - sDLChunkStart[i]);
+        gDLBufferStats.used[i] = used;
+        if (used > gDLBufferStats.peak[i])
+            gDLBufferStats.peak[i] = used;
+    }
+
+    sDLSubmitEnd = sDLBaseEnd != NULL ? sDLBaseEnd : D_800AE680;
+}
+
+/**
+ * @returns The end of the last frame's list within the gMainDL buffer it started
+ * in. Once a list has chained, D_800AE680 points into another chunk.
+ */
+Gfx *dl_buffers_submit_end(void)
+{
+    return sDLSubmitEnd != NULL ? sDLSubmitEnd : D_800AE680;
+}
+
+void dl_buffers_reset_peaks(void)
+{
+    s32 i;
+
+    for (i = 0; i < DL_BUFFER_COUNT; i++)
+    {
+        gDLBufferStats.peak[i] = 0;
+        gDLBufferStats.chunks[i] = 0;
+    }
+
+    gDLBufferStats.overflows = 0;
+}
+
+void dbg_dl_buffers_print(void)
+{
+    dummied_print_func("dl gfx %x/%x mtx %x/%x vtx %x/%x 6b0 %x/%x (peak/size) chunks %d overflows %d\n",
+        gDLBufferStats.peak[DL_BUFFER_GFX], gDLBufferStats.size[DL_BUFFER_GFX],
+        gDLBufferStats.peak[DL_BUFFER_MTX], gDLBufferStats.size[DL_BUFFER_MTX],
+        gDLBufferStats.peak[DL_BUFFER_VTX], gDLBufferStats.size[DL_BUFFER_VTX],
+        gDLBufferStats.peak[DL_BUFFER_6B0], gDLBufferStats.size[DL_BUFFER_6B0],
+        gDLBufferStats.chunks[DL_BUFFER_GFX] + gDLBufferStats.chunks[DL_BUFFER_MTX] +
+            gDLBufferStats.chunks[DL_BUFFER_VTX] + gDLBufferStats.chunks[DL_BUFFER_6B0],
+        gDLBufferStats.overflows);
+}
+
+#define DL_TAG(tag) dl_tag(D_800AE680, tag, NULL)
+#else
+#define BOOT_TIMER_MARK(stage)
+#define PROF_MARK(stage)
+#define DL_TAG(tag)
+#endif
+
 void game_init(void) 
 {
     struct UnkStruct80014614 *temp_AMSEQ_DLL;
     s32 tvMode;
     struct UnkStruct80014614 **tmp3;
 
+    BOOT_TIMER_MARK(BOOT_STAGE_MEMORY);
     init_memory();
+    BOOT_TIMER_MARK(BOOT_STAGE_THREADS);
     three_more_mallocs();
     create_asset_thread();
 
@@ -60,6 +1246,10 @@ void game_init(void)
 
     osCreateScheduler(&osscheduler_, &ossceduler_stack, 0xD, tvMode, 1);
     start_pi_manager_thread();
+    BOOT_TIMER_MARK(BOOT_STAGE_FILESYSTEM);
+#ifdef NON_MATCHING
+    pi_arbiter_init();
+#endif
     init_filesystem();
     create_3_megs_quues(&osscheduler_);
     four_mallocs();
@@ -69,10 +1259,19 @@ void game_init(void)
     gLastInsertedControllerIndex = init_controller_data();
     start_controller_thread(&osscheduler_);
     start_crash_thread(&osscheduler_);
+    BOOT_TIMER_MARK(BOOT_STAGE_TEXTURES);
+#ifdef NON_MATCHING
+    // Read every table up front, each init step only waits for the ones it needs
+    // while the rest keep loading under it
+    boot_prefetch_start(sBootFiles, sizeof(sBootFiles) / sizeof(sBootFiles[0]));
+#endif
     init_textures();
+    BOOT_TIMER_MARK(BOOT_STAGE_MAPS);
     init_maps();
     func_8001CD00();
+    BOOT_TIMER_MARK(BOOT_STAGE_MODELS);
     init_models();
+    BOOT_TIMER_MARK(BOOT_STAGE_OBJECTS);
     init_dll_system();
     init_objects();
     func_80060A80();
@@ -81,8 +1280,13 @@ void game_init(void)
     func_8005C780();
     init_fonts();
     init_menu_related_globals();
+    BOOT_TIMER_MARK(BOOT_STAGE_AUDIO);
     init_audio(&osscheduler_, 0xE);
     init_global_map();
+#ifdef NON_MATCHING
+    boot_prefetch_end();
+#endif
+    BOOT_TIMER_MARK(BOOT_STAGE_DLLS);
     if (osMemSize != 0x800000) {
         temp_AMSEQ_DLL = dll_load_deferred(5, 0x24);
         gDLL_AMSEQ2 = gDLL_AMSEQ = temp_AMSEQ_DLL;
@@ -92,6 +1296,10 @@ void game_init(void)
         gDLL_savegame = dll_load_deferred(0x1F, 2);
         D_8008C974 = dll_load_deferred(0x1C, 4);
     } else {
+#ifdef NON_MATCHING
+        // Read and relocate them all in one pipelined pass, the loads below then hit the DLL cache
+        dll_preload(sBootDLLs, sizeof(sBootDLLs) / sizeof(sBootDLLs[0]));
+#endif
         D_8008C994 = dll_load_deferred(1, 0xF);
         D_8008C978 = dll_load_deferred(2, 0x17);
         D_8008C9D8 = dll_load_deferred(0x17, 8);
@@ -103,7 +1311,13 @@ void game_init(void)
         D_8008C984 = dll_load_deferred(8, 0xC);
         gDLL_newclouds = dll_load_deferred(9, 8);
         gDLL_newstars = dll_load_deferred(0xA, 3);
+#ifdef NON_MATCHING
+        // Only loaded if something actually calls into it
+        gDLL_minic = (struct UnkStruct80014614**)dll_load_lazy(0xC, 0xA);
+#else
         gDLL_minic = dll_load_deferred(0xC, 0xA);
+#endif
+        // Loaded up front, its exports take floats and the lazy stubs don't forward those
         gDLL_Race = dll_load_deferred(4, 0xD);
         temp_AMSEQ_DLL = dll_load_deferred(5, 0x24);
         gDLL_AMSEQ2 = gDLL_AMSEQ = temp_AMSEQ_DLL;
@@ -133,6 +1347,7 @@ void game_init(void)
         D_8008C9B0 = dll_load_deferred(0x3A, 2);
         (*D_8008C9FC)->unk4.asVoid();
     }
+    BOOT_TIMER_MARK(BOOT_STAGE_FINISH);
     init_bittable();
     alSynFlag = 1;
     start_alSyn_thread();
@@ -147,8 +1362,10 @@ void game_init(void)
     }
     func_80041D20(0);
     func_80041C6C(0);
+    BOOT_TIMER_MARK(BOOT_STAGE_COUNT);
 }
 
+#ifndef NON_MATCHING
 #if 1
 #pragma GLOBAL_ASM("asm/nonmatchings/main/game_tick.s")
 #else
@@ -227,6 +1444,140 @@ void _game_tick(void) {
 }
 #endif
 
+#else
+void dl_next_debug_info_set(void);
+void dl_add_debug_info(Gfx *gdl, u32 param_2, char *file, u32 param_4);
+void dl_segment(Gfx **gdl, u32 segment, void *base);
+void dl_set_all_dirty(void);
+void dl_pipe_sync_if_needed(Gfx **gdl);
+void tick_cameras(void);
+void write_c_file_label_pointers(char *cFileLabel, s32 a1);
+void func_80037780(Gfx *start, Gfx *end, s32 arg2);
+void func_8003E9F0(Gfx **gdl, s32 delay);
+void func_8003DB5C(void);
+void func_80037EC8(Gfx **gdl);
+s32 func_80041D5C(void);
+s32 func_80041D74(void);
+void func_80037A14(Gfx **gdl, Mtx **mtxs, s32 arg2);
+void func_80007178(void);
+void func_80013D80(void);
+void func_800121DC(void);
+void func_800129E4(void);
+void func_80060B94(Gfx **gdl);
+void func_80037924(void);
+void func_80020BB8(void);
+void update_mem_mon_values(void);
+void func_80001A3C(void);
+u8 video_func_returning_delay(s32 arg0);
+
+/**
+ * The draft above with the decompiled helpers' current names, built from C so
+ * per-frame work can be added to it.
+ */
+void game_tick(void)
+{
+    u8 buffer;
+    u8 delay;
+    s32 arg;
+
+    osSetTime(0);
+    PROF_MARK(PROF_STAGE_SUBMIT);
+    dl_next_debug_info_set();
+    // The RDP draws the list built last tick while this one builds the next
+    func_80037780((Gfx*)D_800AE678[D_800B09C1], dl_buffers_submit_end(), 0);
+    buffer = D_800B09C1 ^ 1;
+    D_800B09C1 = buffer;
+    D_800AE680 = (Gfx*)D_800AE678[buffer];
+    D_800AE690 = (Mtx*)D_800AE688[buffer];
+    D_800AE6A0 = (Vtx*)D_800AE698[buffer];
+    D_800AE6B0 = (u8*)D_800AE6A8[buffer];
+    dl_buffers_begin_frame(buffer);
+    arena_frame_begin(buffer);
+    heap_free_tick();
+    checksum_jobs_tick();
+    bench_script_tick();
+    bench_tick();
+    telemetry_tick();
+    video_dynamic_resolution_tick();
+    input_record_tick();
+    pi_arbiter_frame();
+    PROF_MARK(PROF_STAGE_DL_SETUP);
+    DL_TAG(DL_TAG_SETUP);
+    dl_add_debug_info(D_800AE680, 0, (char*)fileName, 0x28E);
+    dl_segment(&D_800AE680, 0, (void*)0x80000000);
+    dl_segment(&D_800AE680, 1, gFramebufferCurrent);
+    dl_segment(&D_800AE680, 2, D_800bccb4);
+    func_8003E9F0(&D_800AE680, delayByte);
+    dl_set_all_dirty();
+    func_8003DB5C();
+    dl_pipe_sync_if_needed(&D_800AE680);
+    gDPSetDepthImage(D_800AE680++, 0x02000000);
+    func_80037EC8(&D_800AE680);
+    if (func_80041D5C() == 0) {
+        arg = 0;
+    } else if (func_80041D74() == 0) {
+        arg = 3;
+    } else {
+        arg = 2;
+    }
+    input_late_latch();
+    PROF_MARK(PROF_STAGE_WORLD);
+    DL_TAG(DL_TAG_WORLD);
+    func_80037A14(&D_800AE680, &D_800AE690, arg);
+    dl_buffers_check();
+    PROF_MARK(PROF_STAGE_LOGIC);
+    func_80007178();
+    func_80013D80();
+    func_800121DC();
+    PROF_MARK(PROF_STAGE_DLL_8C974);
+    DL_TAG(DL_TAG_DLL);
+    (*D_8008C974)->unk4.withThreeArgs((s32)&D_800AE680, (s32)&D_800AE690, (s32)&D_800AE6A0);
+    particle_update(delayByte);
+    particle_draw(&D_800AE680, &D_800AE690, &D_800AE6A0);
+    dl_buffers_check();
+    PROF_MARK(PROF_STAGE_SUBTITLES);
+    DL_TAG(DL_TAG_SUBTITLES);
+    (*gDLL_subtitles)->unk1C(&D_800AE680);
+    PROF_MARK(PROF_STAGE_OVERLAYS);
+    DL_TAG(DL_TAG_OVERLAYS);
+    tick_cameras();
+    func_800129E4();
+    func_80060B94(&D_800AE680);
+    dl_buffers_check();
+    prof_draw(&D_800AE680);
+    PROF_MARK(PROF_STAGE_FINISH);
+    DL_TAG(DL_TAG_FINISH);
+    gDPFullSync(D_800AE680++);
+    gSPEndDisplayList(D_800AE680++);
+    dl_tag_end_frame(D_800AE680);
+    dl_buffers_end_frame();
+    func_80037924();
+    func_80020BB8();
+    update_mem_mon_values();
+    if (D_800B09C2 == 0) {
+        func_80001A3C();
+    }
+    // osSetTime(0) above makes this the time since the tick started
+    gFrameBuildTime = OS_CYCLES_TO_USEC(osGetTime());
+    delay = video_func_returning_delay(0);
+    gFrameWaitTime = OS_CYCLES_TO_USEC(osGetTime()) - gFrameBuildTime;
+    input_mark_frame_shown();
+    delayByte = delay;
+    if (delay >= 7) {
+        delayByte = 6;
+    }
+    delayByte = frame_pacing_step(delayByte);
+    delayFloat = delayByte;
+    inverseDelay = 1.0f / delayFloat;
+    delayByteMirror = delayByte;
+    delayFloatMirror = delayFloat;
+    inverseDelayMirror = 1.0f / delayFloatMirror;
+    func_80014074(&delayFloatMirror);
+    write_c_file_label_pointers((char*)fileName2, 0x37C);
+    PROF_MARK(PROF_STAGE_COUNT);
+}
+#endif
+
 #pragma GLOBAL_ASM("asm/nonmatchings/main/game_tick_no_expansion.s")
 
 #pragma GLOBAL_ASM("asm/nonmatchings/main/func_80013D80.s")
@@ -1,4 +1,6 @@
 #include "common.h"
+#include "queue.h"
+#include "filesystem.h"
 
 #define RGBA8(r, g, b, a) (((u32)(r) << 24) | ((u32)(g) << 16) | ((u32)(b) << 8) | (u32)(a))
 
@@ -387,6 +389,18 @@ void dl_set_fog_color(Gfx **gdl, u8 r, u8 g, u8 b, u8 a)
     }
 }
 
+#ifdef NON_MATCHING
+// The pipe sync game_tick emits before it sets the depth image
+void dl_pipe_sync_if_needed(Gfx **gdl)
+{
+    if (gDLBuilder->needsPipeSync)
+    {
+        gDLBuilder->needsPipeSync = FALSE;
+        gDPPipeSync((*gdl)++);
+    }
+}
+#endif
+
 #if 1
 #pragma GLOBAL_ASM("asm/nonmatchings/map/dl_triangles.s")
 #else
@@ -457,6 +471,29 @@ u32 func_80041DA4()
 
 #pragma GLOBAL_ASM("asm/nonmatchings/map/track_c_func.s")
 
+#ifdef NON_MATCHING
+/**
+ * Counts the last drawn render list's block and actor items and how many blocks
+ * they came from, for telemetry.
+ */
+void render_list_get_stats(s32 *blockItems, s32 *actorItems, s32 *blocks)
+{
+    s32 i;
+
+    *blockItems = 0;
+    *actorItems = 0;
+    for (i = 1; i < gRenderListLength; i++)
+    {
+        if (gRenderList[i] & 0x40) {
+            (*actorItems)++;
+        } else {
+            (*blockItems)++;
+        }
+    }
+    *blocks = gBlocksToDrawIdx;
+}
+#endif
+
 #if 1
 #pragma GLOBAL_ASM("asm/nonmatchings/map/draw_render_list.s")
 #else
@@ -748,6 +785,9 @@ void _block_add_to_render_list(Block *block, f32 x, f32 z)
 #pragma GLOBAL_ASM("asm/nonmatchings/map/func_8004478C.s")
 
 
+// gDecodedGlobalMap is not the whole global map, only a 16x16 window of 0x30 byte
+// cells around gMapCurrentStreamCoords/D_80092A6C that map_read_layout rebuilds
+// as streaming moves it, so it is already bounded to 12KB.
 #if 1
 #pragma GLOBAL_ASM("asm/nonmatchings/map/map_get_map_id_from_xz_ws.s")
 #else
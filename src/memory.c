@@ -1,21 +1,69 @@
 #include "common.h"
+#include "memory.h"
+#include "queue.h"
 
 #define ALIGN16(a) (((u32) (a) & ~0xF) + 0x10)
 
 s32  increment_heap_block(s32, s32, s32, s32);
 s32  find_heap_block(void *ptr);
 void set_heap_block(struct HeapBlock *heap, s32 size, s32 max);
+void func_8001753C(void *ptr);
+
+#ifdef NON_MATCHING
+void heap_class_init(void);
+void heap_addr_index_init(s32 heap);
+void heap_free_now(void *ptr);
+s32  heap_evict_all(void);
+s32  heap_addr_index_insert(s32 heap, void *ptr, s32 size, s32 tag);
+s32  heap_addr_index_remove(s32 heap, void *ptr, HeapAddrEntry *removed);
+s32  heap_addr_index_find(s32 heap, void *ptr);
+static HeapAddrEntry *heap_addr_index_lookup(s32 heap, void *ptr);
+void *heap_recycle_take(s32 size, s32 tag);
+#endif
+
+#ifdef NON_MATCHING
+static const QualityTier sQualityTiers[QUALITY_TIER_COUNT] = {
+    /* QUALITY_TIER_BASE */ {
+        { { 0, 0x802D4000, 1200 } }, 1,
+        128,
+        QUALITY_TIER_BASE
+    },
+    /* QUALITY_TIER_EXPANSION */ {
+        { { 0x8042C000, 0x80800000, 400 }, { 0x80245000, 0x8042C000, 800 }, { 0, 0x80119000, 1200 } }, 3,
+        256,
+        QUALITY_TIER_EXPANSION
+    }
+};
+
+const QualityTier *gQualityTier = &sQualityTiers[QUALITY_TIER_BASE];
+#endif
 
 void init_memory(void)
 {
     u32 addr = (u32)&bss_end;
+#ifdef NON_MATCHING
+    s32 i;
+    u32 start;
+#endif
 
+#if !defined(NON_MATCHING) || defined(_DEBUG)
     int *mem = (int *)addr;
+
     while ((u32)mem < osMemSize)
         *mem++ = -1;
+#endif
 
     gHeapBlkListSize = 0;
 
+#ifdef NON_MATCHING
+    gQualityTier = &sQualityTiers[osMemSize == EXPANSION_SIZE ? QUALITY_TIER_EXPANSION : QUALITY_TIER_BASE];
+
+    for (i = 0; i < gQualityTier->heapCount; i++)
+    {
+        start = gQualityTier->heaps[i].start != 0 ? gQualityTier->heaps[i].start : addr;
+        set_heap_block((void *)start, gQualityTier->heaps[i].end - start, gQualityTier->heaps[i].maxBlocks);
+    }
+#else
     if (osMemSize != EXPANSION_SIZE)
     {
         set_heap_block((void *)addr, 0x802D4000 - addr, 1200);
@@ -26,10 +74,21 @@ void init_memory(void)
         set_heap_block((void *)0x80245000, 0x1E7000, 800);
         set_heap_block((void *)addr, 0x80119000 - addr, 1200);
     }
+#endif
 
     func_80017254(2);
 
     pointerIntArrayCounter = 0;
+
+#ifdef NON_MATCHING
+    heap_class_init();
+
+    bzero(&gDeferredFrees, sizeof(gDeferredFrees));
+    gDeferredFrees.lastBuffer = D_800B09C1;
+
+    for (i = 0; i < gHeapBlkListSize; i++)
+        heap_addr_index_init(i);
+#endif
 }
 
 // - Needs to use a multiplication to address the heapblock array
@@ -72,6 +131,11 @@ void _set_heap_block(struct HeapBlock *heap, s32 size, s32 max) {
 #pragma GLOBAL_ASM("asm/nonmatchings/memory/set_heap_block.s")
 #endif
 
+#ifdef NON_MATCHING
+// Set while malloc retries after heap_evict_all
+static s32 sMallocRetrying = FALSE;
+#endif
+
 void *malloc(s32 arg0, s32 arg1, s32 arg2) {
     void *v1;
 
@@ -80,6 +144,29 @@ void *malloc(s32 arg0, s32 arg1, s32 arg2) {
         v1 = NULL;
         return v1;
     }
+#ifdef NON_MATCHING
+    if (gDeferredFrees.count != 0) {
+        heap_drain_deferred_frees(FALSE);
+    }
+    if (gHeapRecycledCount != 0 && arg0 > HEAP_CLASS_MAX_SIZE) {
+        v1 = heap_recycle_take(arg0, arg1);
+        if (v1 != NULL) {
+            return v1;
+        }
+    }
+    if (arg0 <= HEAP_CLASS_MAX_SIZE) {
+        if (gQualityTier->heapCount == 1) {
+            v1 = heap_class_alloc(HEAP_BLOCK_LARGE, arg0, arg1, arg2);
+        } else if (arg0 >= 0x400) {
+            v1 = heap_class_alloc(HEAP_BLOCK_MEDIUM, arg0, arg1, arg2);
+        } else {
+            v1 = heap_class_alloc(HEAP_BLOCK_SMALL, arg0, arg1, arg2);
+        }
+        if (v1 != NULL) {
+            return v1;
+        }
+    }
+#endif
     if ((arg0 >= 0x1194) || (osMemSize != 0x800000)) {
         v1 = increment_heap_block(0, arg0, arg1, arg2);
         if (v1 == NULL) {
@@ -95,9 +182,24 @@ void *malloc(s32 arg0, s32 arg1, s32 arg2) {
     } else {
         v1 = increment_heap_block(2, arg0, arg1, arg2);
     }
+#ifdef NON_MATCHING
+    if (v1 == NULL && !sMallocRetrying && heap_evict_all() != 0) {
+        // Something was released, try once more before giving up. Releasing
+        // again couldn't free anything the first pass didn't.
+        sMallocRetrying = TRUE;
+        v1 = malloc(arg0, arg1, arg2);
+        sMallocRetrying = FALSE;
+        return v1;
+    }
+#endif
     if (v1 == NULL) {
         get_stack_();
     }
+#ifdef NON_MATCHING
+    else {
+        heap_addr_index_insert(find_heap_block(v1), v1, arg0, arg1);
+    }
+#endif
     return v1;
 }
 
@@ -109,9 +211,25 @@ int func_80016E68(void *a0)
     s32 i;
     s32 tmp;
     s32 *ptr;
+#ifdef NON_MATCHING
+    HeapAddrEntry *entry;
+    HeapSlot *slot;
+#endif
 
     tmp = find_heap_block(a0);
 
+#ifdef NON_MATCHING
+    // The index holds the requested size, the slot's own can differ, so go
+    // through the slot the index remembers for the pointer
+    entry = heap_addr_index_lookup(tmp, a0);
+    if (entry != NULL && entry->slot != -1)
+    {
+        slot = &((HeapSlot *)gHeapBlkList[tmp].ptr)[entry->slot];
+        if (slot->data == a0)
+            return slot->size;
+    }
+#endif
+
     i = 0;
     tmp = (u32)gHeapBlkList[tmp].ptr;
 
@@ -121,7 +239,13 @@ int func_80016E68(void *a0)
         i = *((s16 *)ptr + 6);
 
         if (a0 == (s32 *)ptr[0])
+        {
+#ifdef NON_MATCHING
+            if (entry != NULL)
+                entry->slot = ((u32)ptr - tmp) / sizeof(HeapSlot);
+#endif
             return ptr[1];
+        }
 
         // repeated line
         i = *((s16 *)ptr + 6);
@@ -138,11 +262,22 @@ int func_80016E68(void *a0)
 
 void free(void* p) {
     s32 sp1C = func_with_status_reg();
+#ifdef NON_MATCHING
+    HeapAddrEntry entry;
+
+    heap_addr_index_remove(find_heap_block(p), p, &entry);
+    if (D_800B179C == 0) {
+        heap_free_now(p);
+    } else {
+        func_800175D4(p);
+    }
+#else
     if (D_800B179C == 0) {
         func_8001753C(p);
     } else {
         func_800175D4(p);
     }
+#endif
     set_status_reg(sp1C);
 }
 
@@ -150,6 +285,30 @@ void free(void* p) {
 
 #pragma GLOBAL_ASM("asm/nonmatchings/memory/func_8001753C.s")
 
+#ifdef NON_MATCHING
+void func_800175D4(s32 a0)
+{
+    DeferredFree *entry;
+
+    heap_poll_frame();
+
+    if (gDeferredFrees.count >= DEFERRED_FREE_MAX)
+    {
+        // Out of room, release the oldest entry early rather than leaking
+        gDeferredFrees.overflows++;
+        heap_free_now(gDeferredFrees.entries[gDeferredFrees.head].ptr);
+        gDeferredFrees.head = (gDeferredFrees.head + 1) % DEFERRED_FREE_MAX;
+        gDeferredFrees.count--;
+    }
+
+    entry = &gDeferredFrees.entries[(gDeferredFrees.head + gDeferredFrees.count) % DEFERRED_FREE_MAX];
+    entry->ptr = (void *)a0;
+    entry->frame = gDeferredFrees.frame + D_800B179C;
+    gDeferredFrees.count++;
+
+    heap_drain_deferred_frees(FALSE);
+}
+#else
 void func_800175D4(s32 a0)
 {
     s16 *ptr1 = &pointerIntArrayCounter;
@@ -157,6 +316,7 @@ void func_800175D4(s32 a0)
     pointerIntArray0[*ptr1].b[0] = D_800B179C;
     (*ptr1)++;
 }
+#endif
 
 s32 find_heap_block(void *ptr)
 {
@@ -229,6 +389,44 @@ u32 align_2(u32 a0) {
 
 s32 dbg_heap_print(s32 arg0)
 {
+#ifdef NON_MATCHING
+    // Memory held by size class runs but not handed out isn't in use
+    s32 used0 = memMonVal0 - gHeapSizeClasses[0].idleBytes;
+    s32 used1 = memMonVal1 - gHeapSizeClasses[1].idleBytes;
+    s32 used2 = memMonVal2 - gHeapSizeClasses[2].idleBytes;
+
+    dummied_print_func(
+        &D_800991E0, 
+        used0 / 0x400,
+        gHeapBlkList[0].memAllocated / 0x400, 
+        used1 / 0x400, 
+        gHeapBlkList[1].memAllocated / 0x400, 
+        used2 / 0x400, 
+        gHeapBlkList[2].memAllocated / 0x400, 
+        gHeapBlkList[0].itemCount - gHeapSizeClasses[0].runCount + gHeapSizeClasses[0].liveCount, 
+        gHeapBlkList[0].maxItems, 
+        gHeapBlkList[1].itemCount - gHeapSizeClasses[1].runCount + gHeapSizeClasses[1].liveCount, 
+        gHeapBlkList[1].maxItems, 
+        gHeapBlkList[2].itemCount - gHeapSizeClasses[2].runCount + gHeapSizeClasses[2].liveCount, 
+        gHeapBlkList[2].maxItems
+    );
+
+    if (gFrameArena.size != 0) {
+        dummied_print_func(
+            "arena %d/%d KB, peak %d KB\n",
+            gFrameArena.used / 0x400,
+            gFrameArena.size / 0x400,
+            gFrameArena.highWater / 0x400
+        );
+    }
+
+    dbg_heap_frag_print();
+    dbg_texture_transcode_print();
+    dbg_stream_stats_print();
+    dbg_boot_times_print();
+
+    return used0 + used1 + used2;
+#else
     dummied_print_func(
         &D_800991E0, 
         memMonVal0 / 0x400,
@@ -246,6 +444,7 @@ s32 dbg_heap_print(s32 arg0)
     );
 
     return memMonVal0 + memMonVal1 + memMonVal2;
+#endif
 }
 
 
@@ -255,6 +454,13 @@ extern u32 D_80099228;
 void *_alHeapAlloc(s32 arg0, s32 arg1, s32 arg2, s32 arg3, s32 arg4) {
     void *ptr;
 
+#ifdef NON_MATCHING
+    ptr = audio_pool_alloc(align_16(arg4 * arg3));
+    if (ptr != NULL) {
+        return ptr;
+    }
+#endif
+
     arg4 = ALIGN16((arg4 * arg3) + 0xF);
 
     // ??
@@ -266,3 +472,825 @@ void *_alHeapAlloc(s32 arg0, s32 arg1, s32 arg2, s32 arg3, s32 arg4) {
     return align_16(ptr);
 }
 
+
+#ifdef NON_MATCHING
+HeapSizeClasses gHeapSizeClasses[MAX_HEAP_BLOCKS];
+
+static HeapRun gHeapRunPool[HEAP_RUN_MAX];
+static HeapRun *gHeapRunPoolFree;
+// Tags of live size class objects, HeapRun.tags indexes this
+static s32 gHeapClassTags[HEAP_MAX_TAGS];
+static s32 gHeapClassTagCount;
+// All live runs, sorted by base address
+static HeapRun *gHeapRuns[HEAP_RUN_MAX];
+static s32 gHeapRunCount;
+
+void heap_class_init(void)
+{
+    s32 i;
+
+    bzero(gHeapSizeClasses, sizeof(gHeapSizeClasses));
+
+    gHeapRunPoolFree = NULL;
+    for (i = HEAP_RUN_MAX - 1; i >= 0; i--)
+    {
+        gHeapRunPool[i].next = gHeapRunPoolFree;
+        gHeapRunPoolFree = &gHeapRunPool[i];
+    }
+
+    gHeapRunCount = 0;
+    gHeapClassTagCount = 0;
+}
+
+// Returns the HeapRun.tags value for tag, or 0xFF if the table is full
+static u8 heap_class_tag_id(s32 tag)
+{
+    s32 i;
+
+    for (i = 0; i < gHeapClassTagCount; i++)
+    {
+        if (gHeapClassTags[i] == tag)
+            return i + 1;
+    }
+
+    if (gHeapClassTagCount == HEAP_MAX_TAGS)
+        return 0xFF;
+
+    gHeapClassTags[gHeapClassTagCount++] = tag;
+    return gHeapClassTagCount;
+}
+
+static s32 heap_class_index(s32 size)
+{
+    s32 sizeClass = 0;
+
+    size = (size - 1) >> HEAP_CLASS_MIN_SHIFT;
+    while (size != 0)
+    {
+        size >>= 1;
+        sizeClass++;
+    }
+
+    return sizeClass;
+}
+
+static void heap_class_link_partial(HeapRun *run)
+{
+    HeapRun **head = &gHeapSizeClasses[run->heap].partial[run->sizeClass];
+
+    run->prev = NULL;
+    run->next = *head;
+    if (*head != NULL)
+        (*head)->prev = run;
+    *head = run;
+}
+
+static void heap_class_unlink_partial(HeapRun *run)
+{
+    if (run->prev != NULL)
+        run->prev->next = run->next;
+    else
+        gHeapSizeClasses[run->heap].partial[run->sizeClass] = run->next;
+
+    if (run->next != NULL)
+        run->next->prev = run->prev;
+
+    run->prev = NULL;
+    run->next = NULL;
+}
+
+// Returns the index of the first run in gHeapRuns with a base address above ptr
+static s32 heap_class_upper_bound(void *ptr)
+{
+    s32 lo = 0;
+    s32 hi = gHeapRunCount;
+    s32 mid;
+
+    while (lo < hi)
+    {
+        mid = (lo + hi) >> 1;
+        if ((u32)gHeapRuns[mid]->base <= (u32)ptr)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    return lo;
+}
+
+HeapRun *heap_class_find_run(void *ptr)
+{
+    s32 i = heap_class_upper_bound(ptr) - 1;
+
+    if (i < 0)
+        return NULL;
+
+    if ((u32)ptr >= (u32)gHeapRuns[i]->base + HEAP_RUN_SIZE)
+        return NULL;
+
+    return gHeapRuns[i];
+}
+
+static HeapRun *heap_class_new_run(s32 heap, s32 sizeClass, s32 tag, s32 name)
+{
+    HeapRun *run;
+    u8 *base;
+    u8 *obj;
+    s32 objSize;
+    s32 i;
+    s32 pos;
+
+    if (gHeapRunPoolFree == NULL)
+        return NULL;
+
+    base = (u8 *)increment_heap_block(heap, HEAP_RUN_SIZE, tag, name);
+    if (base == NULL)
+        return NULL;
+
+    run = gHeapRunPoolFree;
+    gHeapRunPoolFree = run->next;
+
+    objSize = 1 << (sizeClass + HEAP_CLASS_MIN_SHIFT);
+
+    run->base = base;
+    run->freeList = NULL;
+    run->liveCount = 0;
+    run->sizeClass = sizeClass;
+    run->heap = heap;
+    bzero(run->tags, sizeof(run->tags));
+
+    for (obj = base + HEAP_RUN_SIZE - objSize; obj >= base; obj -= objSize)
+    {
+        *(void **)obj = run->freeList;
+        run->freeList = obj;
+    }
+
+    pos = heap_class_upper_bound(base);
+    for (i = gHeapRunCount; i > pos; i--)
+        gHeapRuns[i] = gHeapRuns[i - 1];
+    gHeapRuns[pos] = run;
+    gHeapRunCount++;
+
+    heap_class_link_partial(run);
+
+    gHeapSizeClasses[heap].runCount++;
+    gHeapSizeClasses[heap].idleBytes += HEAP_RUN_SIZE;
+
+    return run;
+}
+
+static void heap_class_destroy_run(HeapRun *run)
+{
+    s32 i;
+
+    heap_class_unlink_partial(run);
+
+    for (i = heap_class_upper_bound(run->base) - 1; i < gHeapRunCount - 1; i++)
+        gHeapRuns[i] = gHeapRuns[i + 1];
+    gHeapRunCount--;
+
+    gHeapSizeClasses[run->heap].runCount--;
+    gHeapSizeClasses[run->heap].idleBytes -= HEAP_RUN_SIZE;
+
+    func_8001753C(run->base);
+
+    run->next = gHeapRunPoolFree;
+    gHeapRunPoolFree = run;
+}
+
+static void heap_class_release(HeapRun *run, void *ptr)
+{
+    HeapSizeClasses *classes = &gHeapSizeClasses[run->heap];
+
+    *(void **)ptr = run->freeList;
+    if (run->freeList == NULL)
+        heap_class_link_partial(run);
+    run->freeList = ptr;
+    run->tags[((u8 *)ptr - run->base) >> (run->sizeClass + HEAP_CLASS_MIN_SHIFT)] = 0;
+
+    run->liveCount--;
+    classes->liveCount--;
+    classes->idleBytes += 1 << (run->sizeClass + HEAP_CLASS_MIN_SHIFT);
+
+    // Keep one empty run per size class around so that alloc/free pairs
+    // at the edge of a run don't keep hitting the heap
+    if (run->liveCount == 0 && (run->prev != NULL || run->next != NULL))
+        heap_class_destroy_run(run);
+}
+
+void *heap_class_alloc(s32 heap, s32 size, s32 tag, s32 name)
+{
+    HeapSizeClasses *classes;
+    HeapRun *run;
+    void *obj;
+    s32 sizeClass;
+    s32 intFlags;
+
+    if (size > HEAP_CLASS_MAX_SIZE || heap >= gHeapBlkListSize)
+        return NULL;
+
+    intFlags = func_with_status_reg();
+
+    sizeClass = heap_class_index(size);
+    classes = &gHeapSizeClasses[heap];
+
+    run = classes->partial[sizeClass];
+    if (run == NULL)
+    {
+        run = heap_class_new_run(heap, sizeClass, tag, name);
+        if (run == NULL)
+        {
+            set_status_reg(intFlags);
+            return NULL;
+        }
+    }
+
+    obj = run->freeList;
+    run->freeList = *(void **)obj;
+    if (run->freeList == NULL)
+        heap_class_unlink_partial(run);
+
+    run->tags[((u8 *)obj - run->base) >> (sizeClass + HEAP_CLASS_MIN_SHIFT)] = heap_class_tag_id(tag);
+
+    run->liveCount++;
+    classes->liveCount++;
+    classes->idleBytes -= 1 << (sizeClass + HEAP_CLASS_MIN_SHIFT);
+
+    set_status_reg(intFlags);
+
+    return obj;
+}
+
+s32 heap_class_free(void *ptr)
+{
+    HeapRun *run = heap_class_find_run(ptr);
+
+    if (run == NULL)
+        return FALSE;
+
+    heap_class_release(run, ptr);
+
+    return TRUE;
+}
+
+HeapAddrIndex gHeapAddrIndex[MAX_HEAP_BLOCKS];
+
+static u32 heap_addr_hash(void *ptr)
+{
+    // Allocations are 16-byte aligned, so the low bits carry no information
+    return ((u32)ptr >> 4) * 0x9E3779B1;
+}
+
+void heap_addr_index_init(s32 heap)
+{
+    HeapAddrIndex *index = &gHeapAddrIndex[heap];
+    s32 capacity;
+    s32 size;
+
+    index->entries = NULL;
+    index->mask = 0;
+    index->count = 0;
+
+    // Keep the load factor under 50% when every slot is used
+    capacity = 1;
+    while (capacity < gHeapBlkList[heap].maxItems * 2)
+        capacity <<= 1;
+
+    size = capacity * sizeof(HeapAddrEntry);
+    index->entries = (HeapAddrEntry *)increment_heap_block(heap, size, HEAP_TAG_SYSTEM, 0);
+    if (index->entries == NULL)
+        return;
+
+    bzero(index->entries, size);
+    index->mask = capacity - 1;
+}
+
+s32 heap_addr_index_insert(s32 heap, void *ptr, s32 size, s32 tag)
+{
+    HeapAddrIndex *index;
+    u32 i;
+
+    if (heap < 0)
+        return FALSE;
+
+    index = &gHeapAddrIndex[heap];
+
+    // Pointers missing from the index fall back to the slot chain walk
+    if (index->entries == NULL || index->count >= ((index->mask + 1) * 3) / 4)
+        return FALSE;
+
+    i = heap_addr_hash(ptr) & index->mask;
+    while (index->entries[i].ptr != NULL && index->entries[i].ptr != ptr)
+        i = (i + 1) & index->mask;
+
+    if (index->entries[i].ptr == NULL)
+        index->count++;
+
+    index->entries[i].ptr = ptr;
+    index->entries[i].size = size;
+    index->entries[i].tag = tag;
+    index->entries[i].slot = -1;
+
+    return TRUE;
+}
+
+static HeapAddrEntry *heap_addr_index_lookup(s32 heap, void *ptr)
+{
+    HeapAddrIndex *index;
+    u32 i;
+
+    if (heap < 0)
+        return NULL;
+
+    index = &gHeapAddrIndex[heap];
+    if (index->entries == NULL)
+        return NULL;
+
+    i = heap_addr_hash(ptr) & index->mask;
+    while (index->entries[i].ptr != NULL)
+    {
+        if (index->entries[i].ptr == ptr)
+            return &index->entries[i];
+
+        i = (i + 1) & index->mask;
+    }
+
+    return NULL;
+}
+
+s32 heap_addr_index_find(s32 heap, void *ptr)
+{
+    HeapAddrEntry *entry = heap_addr_index_lookup(heap, ptr);
+
+    return entry != NULL ? entry->size : -1;
+}
+
+s32 heap_addr_index_remove(s32 heap, void *ptr, HeapAddrEntry *removed)
+{
+    HeapAddrIndex *index;
+    HeapAddrEntry *entries;
+    u32 i;
+    u32 j;
+    u32 home;
+
+    if (heap < 0)
+        return FALSE;
+
+    index = &gHeapAddrIndex[heap];
+    entries = index->entries;
+    if (entries == NULL)
+        return FALSE;
+
+    i = heap_addr_hash(ptr) & index->mask;
+    while (entries[i].ptr != ptr)
+    {
+        if (entries[i].ptr == NULL)
+            return FALSE;
+
+        i = (i + 1) & index->mask;
+    }
+
+    *removed = entries[i];
+
+    // Shift following entries of the same probe run back into the hole,
+    // so that lookups never need tombstones
+    j = i;
+    while (TRUE)
+    {
+        entries[i].ptr = NULL;
+
+        do {
+            j = (j + 1) & index->mask;
+            if (entries[j].ptr == NULL)
+            {
+                index->count--;
+                return TRUE;
+            }
+
+            home = heap_addr_hash(entries[j].ptr) & index->mask;
+        } while (i <= j ? (i < home && home <= j) : (i < home || home <= j));
+
+        entries[i] = entries[j];
+        i = j;
+    }
+}
+
+s32 heap_get_alloc_size(void *ptr)
+{
+    HeapRun *run = heap_class_find_run(ptr);
+
+    if (run != NULL)
+        return 1 << (run->sizeClass + HEAP_CLASS_MIN_SHIFT);
+
+    return heap_addr_index_find(find_heap_block(ptr), ptr);
+}
+
+DeferredFreeRing gDeferredFrees;
+// Scratch space for the batch being released by heap_drain_deferred_frees
+static u32 gDeferredFreeBatch[DEFERRED_FREE_MAX];
+
+void heap_free_now(void *ptr)
+{
+    if (!heap_class_free(ptr))
+        func_8001753C(ptr);
+}
+
+void heap_poll_frame(void)
+{
+    // The display list buffers flip exactly once per frame. Missed flips only
+    // make frees wait longer, never shorter.
+    if (D_800B09C1 != gDeferredFrees.lastBuffer)
+    {
+        gDeferredFrees.lastBuffer = D_800B09C1;
+        gDeferredFrees.frame++;
+    }
+}
+
+void heap_drain_deferred_frees(s32 force)
+{
+    DeferredFree *entry;
+    u32 key;
+    s32 count;
+    s32 gap;
+    s32 i;
+    s32 j;
+    s32 intFlags;
+
+    intFlags = func_with_status_reg();
+
+    heap_poll_frame();
+
+    count = 0;
+    while (gDeferredFrees.count != 0)
+    {
+        entry = &gDeferredFrees.entries[gDeferredFrees.head];
+        if (!force && (s32)(gDeferredFrees.frame - entry->frame) < 0)
+            break;
+
+        gDeferredFreeBatch[count++] = (u32)entry->ptr;
+        gDeferredFrees.head = (gDeferredFrees.head + 1) % DEFERRED_FREE_MAX;
+        gDeferredFrees.count--;
+    }
+
+    // Heap blocks don't overlap, so sorting by address groups the batch by
+    // heap block and releases neighbouring slots back to back, letting each
+    // free merge with the run of slots released just before it
+    for (gap = count >> 1; gap > 0; gap >>= 1)
+    {
+        for (i = gap; i < count; i++)
+        {
+            key = gDeferredFreeBatch[i];
+            for (j = i; j >= gap && gDeferredFreeBatch[j - gap] > key; j -= gap)
+                gDeferredFreeBatch[j] = gDeferredFreeBatch[j - gap];
+            gDeferredFreeBatch[j] = key;
+        }
+    }
+
+    for (i = 0; i < count; i++)
+        heap_free_now((void *)gDeferredFreeBatch[i]);
+
+    set_status_reg(intFlags);
+}
+
+HeapRecycled gHeapRecycled[HEAP_RECYCLE_MAX];
+s32 gHeapRecycledCount;
+
+static void heap_recycle_release(s32 i)
+{
+    void *ptr = gHeapRecycled[i].ptr;
+
+    gHeapRecycledCount--;
+    for (; i < gHeapRecycledCount; i++)
+        gHeapRecycled[i] = gHeapRecycled[i + 1];
+
+    free(ptr);
+}
+
+void heap_recycle(void *ptr)
+{
+    HeapAddrEntry *entry;
+    s32 intFlags;
+
+    entry = heap_addr_index_lookup(find_heap_block(ptr), ptr);
+    if (entry == NULL || entry->size <= HEAP_CLASS_MAX_SIZE)
+    {
+        free(ptr);
+        return;
+    }
+
+    intFlags = func_with_status_reg();
+
+    if (gHeapRecycledCount == HEAP_RECYCLE_MAX)
+        heap_recycle_release(0);
+
+    heap_poll_frame();
+    gHeapRecycled[gHeapRecycledCount].ptr = ptr;
+    gHeapRecycled[gHeapRecycledCount].size = entry->size;
+    gHeapRecycled[gHeapRecycledCount].tag = entry->tag;
+    // Same delay free would have given it, in case a display list in flight uses it
+    gHeapRecycled[gHeapRecycledCount].readyFrame = gDeferredFrees.frame + D_800B179C;
+    gHeapRecycledCount++;
+
+    set_status_reg(intFlags);
+}
+
+void *heap_recycle_take(s32 size, s32 tag)
+{
+    void *ptr;
+    s32 intFlags;
+    s32 i;
+
+    intFlags = func_with_status_reg();
+    heap_poll_frame();
+
+    // Newest first, it is the likeliest to still be in the data cache
+    for (i = gHeapRecycledCount - 1; i >= 0; i--)
+    {
+        if (gHeapRecycled[i].size == size && gHeapRecycled[i].tag == tag &&
+            (s32)(gDeferredFrees.frame - gHeapRecycled[i].readyFrame) >= 0)
+        {
+            ptr = gHeapRecycled[i].ptr;
+            gHeapRecycledCount--;
+            for (; i < gHeapRecycledCount; i++)
+                gHeapRecycled[i] = gHeapRecycled[i + 1];
+
+            set_status_reg(intFlags);
+            return ptr;
+        }
+    }
+
+    set_status_reg(intFlags);
+    return NULL;
+}
+
+s32 heap_recycle_flush(void)
+{
+    s32 released = 0;
+
+    while (gHeapRecycledCount != 0)
+    {
+        released += gHeapRecycled[0].size;
+        heap_recycle_release(0);
+    }
+
+    return released;
+}
+
+void heap_free_tick(void)
+{
+    heap_poll_frame();
+
+    // Whatever wasn't reused within HEAP_RECYCLE_FRAMES goes back to the heap
+    while (gHeapRecycledCount != 0 &&
+        (s32)(gDeferredFrees.frame - gHeapRecycled[0].readyFrame) >= HEAP_RECYCLE_FRAMES)
+        heap_recycle_release(0);
+
+    heap_drain_deferred_frees(FALSE);
+}
+
+FrameArena gFrameArena;
+
+void arena_init(s32 size)
+{
+    u8 *mem = (u8 *)malloc(size * 2, HEAP_TAG_SYSTEM, 0);
+
+    gFrameArena.buffers[0] = mem;
+    gFrameArena.buffers[1] = mem != NULL ? mem + size : NULL;
+    gFrameArena.size = mem != NULL ? size : 0;
+    gFrameArena.used = 0;
+    gFrameArena.highWater = 0;
+    gFrameArena.current = D_800B09C1;
+    gFrameArena.frame = gDeferredFrees.frame;
+}
+
+void arena_frame_begin(s32 buffer)
+{
+    heap_poll_frame();
+
+    gFrameArena.current = buffer;
+    gFrameArena.used = 0;
+    gFrameArena.frame = gDeferredFrees.frame;
+}
+
+void *arena_alloc(s32 size, s32 align)
+{
+    s32 start;
+
+    // Only the compiled game_tick calls arena_frame_begin, so catch the flip here too
+    heap_poll_frame();
+    if (gFrameArena.frame != gDeferredFrees.frame)
+        arena_frame_begin(D_800B09C1);
+
+    start = (gFrameArena.used + (align - 1)) & ~(align - 1);
+
+    if (start + size > gFrameArena.highWater)
+        gFrameArena.highWater = start + size;
+
+    if (start + size > gFrameArena.size)
+        return NULL;
+
+    gFrameArena.used = start + size;
+
+    return gFrameArena.buffers[gFrameArena.current] + start;
+}
+void heap_get_stats(s32 heap, HeapStats *stats)
+{
+    HeapSlot *slots = (HeapSlot *)gHeapBlkList[heap].ptr;
+    s32 i = 0;
+    s32 steps = 0;
+    s32 run = 0;
+    s32 bucket;
+
+    bzero(stats, sizeof(HeapStats));
+
+    while (TRUE)
+    {
+        if (i != -1 && steps++ < gHeapBlkList[heap].maxItems && slots[i].tag == HEAP_TAG_FREE)
+        {
+            run += slots[i].size;
+        }
+        else
+        {
+            if (run != 0)
+            {
+                stats->freeBytes += run;
+                stats->freeRuns++;
+                if (run > stats->largestFree)
+                    stats->largestFree = run;
+
+                for (bucket = 0; bucket < HEAP_FRAG_BUCKETS - 1 && run >= (0x400 << bucket); bucket++);
+                stats->freeHistogram[bucket]++;
+
+                run = 0;
+            }
+
+            if (i == -1 || steps > gHeapBlkList[heap].maxItems)
+                break;
+
+            stats->usedBytes += slots[i].size;
+            stats->usedSlots++;
+        }
+
+        i = slots[i].next;
+    }
+}
+
+static s32 heap_tag_usage_add(HeapTagUsage *usage, s32 count, s32 max, s32 tag, s32 bytes)
+{
+    s32 j;
+
+    for (j = 0; j < count; j++)
+    {
+        if (usage[j].tag == tag)
+            break;
+    }
+
+    if (j == count)
+    {
+        if (count == max)
+            return count;
+
+        usage[j].tag = tag;
+        usage[j].bytes = 0;
+        usage[j].count = 0;
+        count++;
+    }
+
+    usage[j].bytes += bytes;
+    usage[j].count++;
+
+    return count;
+}
+
+s32 heap_get_tag_usage(HeapTagUsage *usage, s32 max)
+{
+    HeapSlot *slots;
+    HeapRun *run;
+    s32 count = 0;
+    s32 heap;
+    s32 steps;
+    s32 i;
+    s32 j;
+
+    for (heap = 0; heap < gHeapBlkListSize; heap++)
+    {
+        slots = (HeapSlot *)gHeapBlkList[heap].ptr;
+
+        for (i = 0, steps = 0; i != -1 && steps < gHeapBlkList[heap].maxItems; i = slots[i].next, steps++)
+        {
+            if (slots[i].tag == HEAP_TAG_FREE)
+                continue;
+
+            // A run's slot carries the tag of whoever caused it to be made,
+            // count its live objects under their own tags instead
+            run = heap_class_find_run(slots[i].data);
+            if (run == NULL || run->base != slots[i].data)
+            {
+                count = heap_tag_usage_add(usage, count, max, slots[i].tag, slots[i].size);
+                continue;
+            }
+
+            for (j = 0; j < HEAP_RUN_SIZE >> (run->sizeClass + HEAP_CLASS_MIN_SHIFT); j++)
+            {
+                if (run->tags[j] == 0)
+                    continue;
+
+                count = heap_tag_usage_add(usage, count, max,
+                    run->tags[j] != 0xFF ? gHeapClassTags[run->tags[j] - 1] : slots[i].tag,
+                    1 << (run->sizeClass + HEAP_CLASS_MIN_SHIFT));
+            }
+        }
+    }
+
+    return count;
+}
+
+void dbg_heap_frag_print(void)
+{
+    HeapStats stats;
+    HeapTagUsage usage[HEAP_MAX_TAGS];
+    s32 count;
+    s32 i;
+    s32 j;
+
+    for (i = 0; i < gHeapBlkListSize; i++)
+    {
+        heap_get_stats(i, &stats);
+
+        dummied_print_func("heap %d: used %d KB free %d KB in %d runs, largest %d KB\n",
+            i, stats.usedBytes / 0x400, stats.freeBytes / 0x400, stats.freeRuns, stats.largestFree / 0x400);
+
+        for (j = 0; j < HEAP_FRAG_BUCKETS; j++)
+            dummied_print_func(" %d", stats.freeHistogram[j]);
+        dummied_print_func("\n");
+    }
+
+    count = heap_get_tag_usage(usage, HEAP_MAX_TAGS);
+    for (i = 0; i < count; i++)
+        dummied_print_func("tag %x: %d KB in %d\n", usage[i].tag, usage[i].bytes / 0x400, usage[i].count);
+}
+s32 heap_evict_all(void)
+{
+    s32 released;
+    s32 count;
+    s32 overflows;
+    s32 appended;
+    s32 intFlags;
+
+    intFlags = func_with_status_reg();
+    count = gDeferredFrees.count;
+    overflows = gDeferredFrees.overflows;
+
+    released = heap_recycle_flush();
+
+    // Recycled memory only becomes usable once its deferred free is released,
+    // so release what was just freed now instead of frames from now.
+    // The display list in flight may still read one of them, but that is
+    // better than failing the allocation.
+    appended = gDeferredFrees.count - count + gDeferredFrees.overflows - overflows;
+    if (appended > gDeferredFrees.count)
+        appended = gDeferredFrees.count;
+
+    while (appended-- > 0)
+    {
+        gDeferredFrees.count--;
+        heap_free_now(gDeferredFrees.entries[(gDeferredFrees.head + gDeferredFrees.count) % DEFERRED_FREE_MAX].ptr);
+    }
+
+    set_status_reg(intFlags);
+
+    return released;
+}
+
+AudioPool gAudioPool;
+
+void *audio_pool_alloc(s32 size)
+{
+    u8 *chunk;
+    u8 *ptr;
+
+    // Large buffers get their own, exactly sized slot
+    if (size > AUDIO_POOL_CHUNK_SIZE / 4)
+        return NULL;
+
+    if (gAudioPool.current == NULL || gAudioPool.used + size > AUDIO_POOL_CHUNK_SIZE)
+    {
+        // Audio allocations are never freed, so chunks are never released either
+        chunk = (u8 *)malloc(AUDIO_POOL_CHUNK_SIZE, HEAP_TAG_AUDIO, (s32)&D_80099228);
+        if (chunk == NULL)
+            return NULL;
+
+        bzero(chunk, AUDIO_POOL_CHUNK_SIZE);
+
+        gAudioPool.wasted += gAudioPool.current != NULL ? AUDIO_POOL_CHUNK_SIZE - gAudioPool.used : 0;
+        gAudioPool.current = chunk;
+        gAudioPool.used = 0;
+        gAudioPool.chunkCount++;
+    }
+
+    ptr = gAudioPool.current + gAudioPool.used;
+    gAudioPool.used += size;
+
+    return ptr;
+}
+#endif
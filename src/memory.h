@@ -0,0 +1,335 @@
+#ifndef _MEMORY_H_
+#define _MEMORY_H_
+
+#include "ultra64.h"
+
+// The index of each heap block in gHeapBlkList when the expansion pak is present.
+// Without the expansion pak, only heap 0 exists.
+#define HEAP_BLOCK_LARGE 0
+#define HEAP_BLOCK_MEDIUM 1
+#define HEAP_BLOCK_SMALL 2
+
+#define MAX_HEAP_BLOCKS 3
+
+// Known malloc tags
+#define HEAP_TAG_FREE 0 // Free slots
+#define HEAP_TAG_SYSTEM 1
+#define HEAP_TAG_BLOCK 5
+#define HEAP_TAG_MODEL 9
+#define HEAP_TAG_AUDIO 0xB
+#define HEAP_TAG_FILE 0x7F7F7FFF
+
+// Number of free run size buckets in HeapStats: < 1 KB, then one per power of two up to >= 1 MB
+#define HEAP_FRAG_BUCKETS 12
+// The maximum number of distinct tags tracked by heap_get_tag_usage
+#define HEAP_MAX_TAGS 32
+
+/**
+ * A single slot in the table at the start of each heap block.
+ *
+ * @details Layout inferred from set_heap_block and func_80016E68. Slots are
+ * chained in address order through next, starting at slot 0.
+ */
+typedef struct HeapSlot {
+/*0000*/    void *data;
+/*0004*/    s32 size;
+/*0008*/    s32 tag; // HEAP_TAG_FREE if the slot is free
+/*000C*/    s16 next; // -1 at the end of the chain
+/*000E*/    s16 prev;
+/*0010*/    s16 index;
+/*0012*/    s16 unk_0x12;
+} HeapSlot;
+
+typedef struct HeapStats {
+/*0000*/    s32 usedBytes;
+/*0004*/    s32 freeBytes;
+/*0008*/    s32 largestFree; // The largest run of consecutive free slots
+/*000C*/    s32 freeRuns;
+/*0010*/    s32 usedSlots;
+/*0014*/    s32 freeHistogram[HEAP_FRAG_BUCKETS]; // Free run counts by size
+} HeapStats;
+
+typedef struct HeapTagUsage {
+/*0000*/    s32 tag;
+/*0004*/    s32 bytes;
+/*0008*/    s32 count;
+} HeapTagUsage;
+
+// The smallest size class is (1 << HEAP_CLASS_MIN_SHIFT) bytes
+#define HEAP_CLASS_MIN_SHIFT 4
+// Size classes are powers of two: 16, 32, 64, 128, 256, 512 and 1024 bytes
+#define HEAP_CLASS_COUNT 7
+#define HEAP_CLASS_MAX_SIZE (1 << (HEAP_CLASS_MIN_SHIFT + HEAP_CLASS_COUNT - 1))
+
+// The size of a single heap allocation that is carved into size class objects
+#define HEAP_RUN_SIZE 0x1000
+// The maximum number of runs that may exist at once, across all heap blocks
+#define HEAP_RUN_MAX 96
+// Objects in a run of the smallest size class
+#define HEAP_RUN_MAX_OBJECTS (HEAP_RUN_SIZE >> HEAP_CLASS_MIN_SHIFT)
+// The maximum number of frees that can be deferred at once
+#define DEFERRED_FREE_MAX 420
+// The maximum number of allocations heap_recycle keeps aside at once
+#define HEAP_RECYCLE_MAX 16
+// Frames a recycled allocation is kept for before it is freed
+#define HEAP_RECYCLE_FRAMES 30
+
+/**
+ * A single heap allocation of HEAP_RUN_SIZE bytes which is split into
+ * equally sized objects of one size class.
+ */
+typedef struct HeapRun {
+/*0000*/    u8 *base;
+/*0004*/    void *freeList; // Intrusive list of free objects in this run
+/*0008*/    struct HeapRun *prev; // Neighbours in the owning size class's list of runs with free objects
+/*000C*/    struct HeapRun *next;
+/*0010*/    u16 liveCount;
+/*0012*/    u8 sizeClass;
+/*0013*/    u8 heap;
+/*0014*/    u8 tags[HEAP_RUN_MAX_OBJECTS]; // Per object, 0 if free, else one more than its tag's index in the class tag table
+} HeapRun;
+
+/**
+ * Segregated size class free lists carried alongside each entry of gHeapBlkList.
+ */
+typedef struct HeapSizeClasses {
+/*0000*/    HeapRun *partial[HEAP_CLASS_COUNT]; // Runs with at least one free object
+/*001C*/    s32 idleBytes; // Bytes held by runs that are not handed out
+/*0020*/    s16 runCount;
+/*0022*/    s16 liveCount;
+} HeapSizeClasses;
+
+/**
+ * An entry in a heap block's address index.
+ */
+typedef struct HeapAddrEntry {
+/*0000*/    void *ptr; // NULL if the entry is empty
+/*0004*/    s32 size;
+/*0008*/    s32 tag;
+/*000C*/    s16 slot; // In the heap block's HeapSlot table, -1 until func_80016E68 has walked to it
+} HeapAddrEntry;
+
+/**
+ * An open addressing hash table of the live allocations of one heap block.
+ */
+typedef struct HeapAddrIndex {
+/*0000*/    HeapAddrEntry *entries;
+/*0004*/    u16 mask; // Capacity - 1, capacity is a power of two
+/*0006*/    u16 count;
+} HeapAddrIndex;
+
+typedef struct DeferredFree {
+/*0000*/    void *ptr;
+/*0004*/    u32 frame; // The frame from which ptr may be released
+} DeferredFree;
+
+/**
+ * An allocation kept aside by heap_recycle.
+ */
+typedef struct HeapRecycled {
+/*0000*/    void *ptr;
+/*0004*/    s32 size;
+/*0008*/    s32 tag;
+/*000C*/    u32 readyFrame; // The frame from which it may be handed out again
+} HeapRecycled;
+
+/**
+ * The ring of frees made while D_800B179C is set.
+ *
+ * @details Entries are kept in the order they were freed and are released
+ * D_800B179C frames later.
+ */
+typedef struct DeferredFreeRing {
+/*0000*/    DeferredFree entries[DEFERRED_FREE_MAX];
+/*0D20*/    s16 head;
+/*0D22*/    s16 count;
+/*0D24*/    u32 frame; // Counts flips of D_800B09C1
+/*0D28*/    s32 overflows; // Entries released early because the ring was full
+/*0D2C*/    u8 lastBuffer;
+} DeferredFreeRing;
+
+// The size of each chunk that small audio buffers are carved from
+#define AUDIO_POOL_CHUNK_SIZE 0x8000
+
+/**
+ * Bump allocator serving _alHeapAlloc, which never frees.
+ *
+ * @details Chunks are 16-byte aligned and zeroed up front, so buffers need no
+ * slack for alignment and don't each use up a heap slot.
+ */
+typedef struct AudioPool {
+/*0000*/    u8 *current;
+/*0004*/    s32 used;
+/*0008*/    s32 chunkCount;
+/*000C*/    s32 wasted; // Bytes left unused at the ends of full chunks
+} AudioPool;
+
+enum QualityTierId {
+    QUALITY_TIER_BASE,          // 4 MB
+    QUALITY_TIER_EXPANSION,     // 8 MB, with the expansion pak
+
+    QUALITY_TIER_COUNT
+};
+
+#define QUALITY_TIER_MAX_HEAPS 3
+
+/**
+ * Everything sized by how much RAM there is, picked once by init_memory. Tune
+ * a tier here rather than checking osMemSize where the value is used.
+ */
+typedef struct QualityTier {
+/*0000*/    struct {
+                u32 start;      // 0 for bss_end
+                u32 end;
+                s32 maxBlocks;
+            } heaps[QUALITY_TIER_MAX_HEAPS]; // In set_heap_block order
+/*0024*/    s32 heapCount;
+/*0028*/    s32 particleCap;        // Live particles at once, at most PARTICLE_CAPACITY
+/*002C*/    u8 id;
+} QualityTier;
+
+// The tier init_memory picked
+extern const QualityTier *gQualityTier;
+
+// The size of each of the two frame arena buffers
+#define FRAME_ARENA_SIZE 0x8000
+
+/**
+ * A linear allocator for data that only needs to live until the end of the frame.
+ *
+ * Two buffers are used so that data referenced by the display list of the
+ * frame being drawn is not overwritten while the next frame is built.
+ */
+typedef struct FrameArena {
+/*0000*/    u8 *buffers[2];
+/*0008*/    s32 size; // Size of each buffer
+/*000C*/    s32 used; // Bytes used in the current buffer
+/*0010*/    s32 highWater; // Most bytes requested in a single frame, including failed requests
+/*0014*/    u8 current;
+/*0018*/    u32 frame; // gDeferredFrees.frame the current buffer was started on
+} FrameArena;
+
+extern HeapSizeClasses gHeapSizeClasses[MAX_HEAP_BLOCKS];
+extern HeapAddrIndex gHeapAddrIndex[MAX_HEAP_BLOCKS];
+extern DeferredFreeRing gDeferredFrees;
+extern HeapRecycled gHeapRecycled[HEAP_RECYCLE_MAX];
+extern s32 gHeapRecycledCount;
+extern FrameArena gFrameArena;
+extern AudioPool gAudioPool;
+
+/**
+ * Walks the slot chain of the given heap block and collects fragmentation stats.
+ */
+void heap_get_stats(s32 heap, HeapStats *stats);
+
+/**
+ * Walks the slot chains of all heap blocks and totals the used bytes per malloc tag.
+ * Size class runs are split up by the tags of their live objects.
+ *
+ * @param usage Receives up to max entries, in the order tags were first seen.
+ * @returns The number of entries written.
+ */
+s32 heap_get_tag_usage(HeapTagUsage *usage, s32 max);
+
+/**
+ * Prints heap_get_stats for every heap block and heap_get_tag_usage to the debug overlay.
+ */
+void dbg_heap_frag_print(void);
+
+/**
+ * Allocates an object of at least the given size from the size class free lists.
+ *
+ * @returns NULL if size is larger than HEAP_CLASS_MAX_SIZE or no run could be allocated,
+ * in which case the caller should fall back to increment_heap_block.
+ */
+void *heap_class_alloc(s32 heap, s32 size, s32 tag, s32 name);
+
+/**
+ * Releases an object previously returned from heap_class_alloc.
+ *
+ * @returns FALSE if ptr is not a size class object.
+ */
+s32 heap_class_free(void *ptr);
+
+/**
+ * Gets the run containing the given pointer, or NULL if it is not a size class object.
+ */
+HeapRun *heap_class_find_run(void *ptr);
+
+/**
+ * Gets the size that was requested for the allocation starting at ptr, without
+ * walking the heap block's slot chain.
+ *
+ * @returns -1 if ptr is not the start of a live allocation.
+ */
+s32 heap_get_alloc_size(void *ptr);
+
+/**
+ * Releases every deferred free whose delay has passed, sorted by address in one batch.
+ *
+ * @param force If TRUE, releases all deferred frees regardless of their delay.
+ * Only safe when no display list in flight can reference them.
+ */
+void heap_drain_deferred_frees(s32 force);
+
+/**
+ * Releases expired deferred frees and recycled allocations. Should be called once per frame.
+ */
+void heap_free_tick(void);
+
+/**
+ * Frees ptr, but keeps allocations larger than HEAP_CLASS_MAX_SIZE aside for
+ * HEAP_RECYCLE_FRAMES, so a malloc of the same size and tag in the meantime
+ * gets them back without going through the heap block.
+ *
+ * @details For objects that are destroyed and created again in bursts, such as
+ * the model instances of identical actors.
+ */
+void heap_recycle(void *ptr);
+
+/**
+ * Frees every recycled allocation.
+ *
+ * @returns The number of bytes released.
+ */
+s32 heap_recycle_flush(void);
+
+/**
+ * Allocates a zeroed, 16-byte aligned buffer for the audio library.
+ *
+ * @returns NULL for sizes too large for the pool, which should get their own heap slot.
+ */
+void *audio_pool_alloc(s32 size);
+
+/**
+ * Advances the frame clock used by deferred frees when the display list buffers have flipped.
+ */
+void heap_poll_frame(void);
+
+
+/**
+ * Allocates both frame arena buffers of the given size from the heap. Until it is
+ * called every arena_alloc fails.
+ */
+void arena_init(s32 size);
+
+/**
+ * Switches to the given frame arena buffer and discards everything allocated in it.
+ *
+ * @details Called once per frame with the same index as the display list buffers
+ * (D_800B09C1), or by the first arena_alloc of a frame if nothing did.
+ */
+void arena_frame_begin(s32 buffer);
+
+/**
+ * Allocates size bytes from the current frame arena buffer.
+ *
+ * @details There is no way to free individual allocations. Memory remains valid until
+ * the buffer is reused two frames later.
+ *
+ * @param align Alignment in bytes, must be a power of two.
+ * @returns NULL if the buffer is out of space.
+ */
+void *arena_alloc(s32 size, s32 align);
+
+#endif
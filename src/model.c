@@ -1,4 +1,6 @@
 #include "common.h"
+#include "memory.h"
+#include "filesystem.h"
 
 #define ALIGN8(a) (((u32) (a) & ~0x7) + 0x8)
 #define ALIGN16(a) (((u32) (a) & ~0xF) + 0x10)
@@ -421,6 +423,7 @@ void load_model_display_list2(Model *model, ModelInstance *modelInst)
     }
 }
 
+#ifndef NON_MATCHING
 #if 1
 #pragma GLOBAL_ASM("asm/nonmatchings/model/destroy_model_instance.s")
 #else
@@ -466,6 +469,51 @@ void _destroy_model_instance(ModelInstance *modelInst)
     }
 }
 #endif
+#else
+extern s32 *gFreeModelSlots;
+extern s32 gNumFreeModelSlots;
+extern ModelSlot *gLoadedModels;
+extern s32 gNumLoadedModels;
+void model_destroy(Model *model);
+void destroy_model_instance(ModelInstance *modelInst)
+{
+    Model *model;
+    s32 slot;
+
+    if (modelInst == NULL) {
+        return;
+    }
+
+    model = modelInst->model;
+
+    // The next instance of the same model and flags is the same size, so keep these for it
+    if (model->displayList != modelInst->displayList) {
+        heap_recycle(modelInst->displayList);
+    }
+    heap_recycle(modelInst);
+
+    if (--model->refCount <= 0)
+    {
+        for (slot = 0; slot < gNumLoadedModels; slot++) {
+            if (gLoadedModels[slot].model == model) {
+                break;
+            }
+        }
+
+        if (slot == gNumLoadedModels)
+        {
+            *(u8*)0x0 = 0; // CRASH!
+        }
+        else
+        {
+            gFreeModelSlots[gNumFreeModelSlots++] = slot;
+            gLoadedModels[slot].id = -1;
+            gLoadedModels[slot].model = (Model *)-1;
+            model_destroy(model);
+        }
+    }
+}
+#endif
 
 // very close
 #if 1
@@ -1,17 +1,23 @@
 #include "common.h"
 #include "queue.h"
+#include "memory.h"
+#include "crash.h"
+#include "filesystem.h"
 
 struct UnkStruct8000ADF0 {
     s16 unk0;
 };
 extern struct UnkStruct8000ADF0 *D_800ACBC8;
 struct UnkStruct8000ADF0 *func_8000ADF0(s32 *, s32 *, s32, s32);
+s32 func_8000AFF8(struct UnkStruct8000ADF0 *);
+void func_8000AF0C(struct UnkStruct8000ADF0 *, void *);
 
 struct UnkStruct8000B010 {
     s16 unk0;
 };
 extern struct UnkStruct8000B010 *D_800AE1D0;
 struct UnkStruct8000B010 *func_8000B010(s32 *, s32 *, s32, s32);
+void func_8000B124(struct UnkStruct8000B010 *, void *);
 
 extern u8 gDisableObjectStreamingFlag;
 
@@ -24,12 +30,80 @@ extern s32 *D_800ACBB8, *D_800ACBD0;
 extern s32 *D_800AE1C0, *D_800AE1D8;
 
 extern u64 *D_800AC910; // end of stack
+// Only as much of it as is sure to be stack, the rest of the bss below is unnamed
+#define ASSET_THREAD_STACKSIZE 0x1000
+
+s32 func_with_status_reg(void);
+void set_status_reg(s32);
+s32 get_file_size(u32 id);
+void dummied_print_func(const char *fmt, ...);
 extern OSThread *D_800AC918;
+MtxF *func_8000389c(void);
+
+#ifdef NON_MATCHING
+static OSTime sQueueSyncSubmitTime;
+#define QUEUE_MARK_SUBMIT() (sQueueSyncSubmitTime = osGetTime())
+#else
+#define QUEUE_MARK_SUBMIT()
+#endif
+
+#ifdef NON_MATCHING
+static void queue_rings_init(void);
+
+void spsc_init(SPSCRing *ring, void *entries, s32 entrySize, s32 capacity) {
+    ring->head = 0;
+    ring->tail = 0;
+    ring->entries = entries;
+    ring->entrySize = entrySize;
+    ring->mask = capacity - 1;
+}
+
+void *spsc_reserve(SPSCRing *ring) {
+    u32 tail;
+
+    tail = ring->tail;
+    if (tail - ring->head > ring->mask) {
+        return NULL;
+    }
+
+    return ring->entries + (tail & ring->mask) * ring->entrySize;
+}
+
+void spsc_push(SPSCRing *ring) {
+    ring->tail = ring->tail + 1;
+}
+
+void *spsc_peek(SPSCRing *ring, s32 i) {
+    u32 head;
+
+    head = ring->head;
+    if (ring->tail - head <= (u32)i) {
+        return NULL;
+    }
+
+    return ring->entries + ((head + i) & ring->mask) * ring->entrySize;
+}
+
+void spsc_pop(SPSCRing *ring) {
+    ring->head = ring->head + 1;
+}
+
+s32 spsc_count(SPSCRing *ring) {
+    return ring->tail - ring->head;
+}
+#endif
 
 void create_asset_thread(void) {
     gDisableObjectStreamingFlag = 0;
+#ifdef NON_MATCHING
+    // Before the asset thread exists, so neither side has to check
+    queue_rings_init();
+#endif
     D_800ACBC8 = func_8000ADF0(&D_800ACBB8, &D_800ACBD0, 0x64, 0x1C);
     D_800AE1D0 = func_8000B010(&D_800AE1C0, &D_800AE1D8, 5, 0x14);
+#ifdef NON_MATCHING
+    stack_watch(0x63, (u8 *)&D_800AC910 - ASSET_THREAD_STACKSIZE, ASSET_THREAD_STACKSIZE);
+#endif
     osCreateThread(&D_800AC918, 0x63, &asset_thread_main, 0, &D_800AC910, 0xB);
     osStartThread(&D_800AC918);
 }
@@ -62,6 +136,7 @@ void queue_alloc_load_file(s32 arg0, s32 arg1) {
     D_800AE270.loadType = QUEUE_FILE;
     D_800AE270.unk4 = arg1;
     D_800AE270.unk8 = arg0;
+    QUEUE_MARK_SUBMIT();
     osSendMesg(&D_800ACB48, &D_800AE270, 0);
     osRecvMesg(&D_800ACB98, 0, 1);
 }
@@ -71,6 +146,7 @@ void queue_load_file_to_ptr(s32 arg0, s32 arg1) {
     D_800AE270.loadType = QUEUE_ALLOCATED_FILE;
     D_800AE270.unk4 = arg1;
     D_800AE270.unk8 = arg0;
+    QUEUE_MARK_SUBMIT();
     osSendMesg(&D_800ACB48, &D_800AE270, 0);
     osRecvMesg(&D_800ACB98, 0, 1);
 }
@@ -82,6 +158,7 @@ void queue_load_file_region_to_ptr(s32 arg0, s32 arg1, s32 arg2, s32 arg3) {
     D_800AE270.unk4 = arg1;
     D_800AE270.unk8 = arg0;
     D_800AE270.unk10 = arg2;
+    QUEUE_MARK_SUBMIT();
     osSendMesg(&D_800ACB48, &D_800AE270, 0);
     osRecvMesg(&D_800ACB98, 0, 1);
 }
@@ -96,6 +173,7 @@ void queue_load_map_object(s32 arg0, s32 arg1, s32 arg2, s32 arg3, s32 arg4, s32
     D_800AE270.unk14 = arg5;
     D_800AE270.unk28 = arg6;
     D_800AE270.unk8 = arg0;
+    QUEUE_MARK_SUBMIT();
     osSendMesg(&D_800ACB48, &D_800AE270, 0);
     osRecvMesg(&D_800ACB98, 0, 1);
 }
@@ -105,6 +183,7 @@ void queue_load_texture(s32 *arg0, s32 arg1) {
     D_800AE270.loadType = QUEUE_TEXTURE;
     D_800AE270.unk4 = arg1;
     D_800AE270.unk8 = arg0;
+    QUEUE_MARK_SUBMIT();
     osSendMesg(&D_800ACB48, &D_800AE270, 0);
     osRecvMesg(&D_800ACB98, 0, 1);
 }
@@ -115,6 +194,7 @@ void queue_load_dll(s32 arg0, s32 arg1, s32 arg2) {
     D_800AE270.unk4 = arg1;
     D_800AE270.unk8 = arg0;
     D_800AE270.unkC = arg2;
+    QUEUE_MARK_SUBMIT();
     osSendMesg(&D_800ACB48, &D_800AE270, 0);
     osRecvMesg(&D_800ACB98, 0, 1);
 }
@@ -125,6 +205,7 @@ void queue_load_model(s32 arg0, s32 arg1, s32 arg2) {
     D_800AE270.unk4 = arg1;
     D_800AE270.unk8 = arg0;
     D_800AE270.unkC = arg2;
+    QUEUE_MARK_SUBMIT();
     osSendMesg(&D_800ACB48, &D_800AE270, 0);
     osRecvMesg(&D_800ACB98, 0, 1);
 }
@@ -139,6 +220,7 @@ void queue_load_anim(s32 arg0, s16 arg1, s16 arg2, s32 arg3, s32 arg4) {
     D_800AE270.unk8 = arg0;
     D_800AE270.unkC = arg2;
     D_800AE270.unk24 = arg4;
+    QUEUE_MARK_SUBMIT();
     osSendMesg(&D_800ACB48, &D_800AE270, 0);
     osRecvMesg(&D_800ACB98, 0, 1);
 }
@@ -174,13 +256,213 @@ struct UnkStructFunc80012A4C {
     u32 unkC;
     u32 unk10;
 };
+#ifdef NON_MATCHING
+s32 gQueueCompletionBudget = QUEUE_COMPLETIONS_PER_FRAME;
+s32 gQueueCompletionBudgetUs = QUEUE_COMPLETION_BUDGET_US;
+s32 gQueueSpawnBudget = QUEUE_SPAWNS_PER_FRAME;
+
+// Head is only written by the main thread and tail only by the asset thread,
+// so neither side needs to mask interrupts.
+static SPSCRing sQueueCompletionRing;
+static struct UnkStructFunc80012A4C sQueueCompletions[QUEUE_COMPLETION_RING_SIZE];
+// Only sent to while the producer is blocked on a full ring
+static OSMesgQueue sQueueCompletionSpace;
+static OSMesg sQueueCompletionSpaceMesg;
+static volatile u8 sQueueCompletionWaiting;
+
+// Rate limited object streaming, sQueueStreamRate objects per second or 0 for no limit
+static s32 sQueueStreamRate;
+static u32 sQueueStreamCredit; // CPU counter cycles saved up towards the next activations
+static u32 sQueueStreamLastCount;
+static s32 sQueueSpawnLimit;
+
+static void queue_rings_init(void) {
+    spsc_init(&sQueueCompletionRing, sQueueCompletions, sizeof(struct UnkStructFunc80012A4C), QUEUE_COMPLETION_RING_SIZE);
+    osCreateMesgQueue(&sQueueCompletionSpace, &sQueueCompletionSpaceMesg, 1);
+}
+
+void queue_completion_push(u8 type, u32 *dst, u32 value, u32 argC, u32 arg10) {
+    struct UnkStructFunc80012A4C *entry;
+
+    if ((entry = spsc_reserve(&sQueueCompletionRing)) == NULL) {
+        // Flag first, so room made after the check still rings
+        sQueueCompletionWaiting = TRUE;
+        while ((entry = spsc_reserve(&sQueueCompletionRing)) == NULL) {
+            osRecvMesg(&sQueueCompletionSpace, NULL, OS_MESG_BLOCK);
+        }
+        sQueueCompletionWaiting = FALSE;
+    }
+
+    entry->unk0 = type;
+    entry->unk4 = dst;
+    entry->unk8 = value;
+    entry->unkC = argC;
+    entry->unk10 = arg10;
+    spsc_push(&sQueueCompletionRing);
+}
+
+void queue_set_object_stream_rate(s32 perSecond) {
+    sQueueStreamRate = perSecond > 0 ? perSecond : QUEUE_STREAM_UNLIMITED;
+    sQueueStreamCredit = 0;
+    sQueueStreamLastCount = osGetCount();
+}
+
+s32 queue_get_object_stream_rate(void) {
+    return sQueueStreamRate;
+}
+
+s32 queue_get_pending_object_count(void) {
+    struct UnkStructFunc80012A4C *entry;
+    s32 count;
+    s32 i;
+
+    count = 0;
+    for (i = 0; (entry = spsc_peek(&sQueueCompletionRing, i)) != NULL; i++) {
+        if (entry->unk0 == 5) {
+            count++;
+        }
+    }
+
+    return count;
+}
+
+// How many objects this call of func_80012A4C may activate
+static s32 queue_stream_allowance(void) {
+    u32 now;
+    u32 elapsed;
+    u32 cost;
+    u32 cap;
+
+    if (sQueueStreamRate == QUEUE_STREAM_UNLIMITED) {
+        return gQueueSpawnBudget;
+    }
+
+    // osGetTime is reset every tick, the counter isn't
+    now = osGetCount();
+    cost = OS_CPU_COUNTER / sQueueStreamRate;
+    cap = cost * gQueueSpawnBudget;
+    elapsed = now - sQueueStreamLastCount;
+    sQueueStreamLastCount = now;
+    // Saving up is capped so a burst is never bigger than gQueueSpawnBudget
+    if (elapsed >= cap - sQueueStreamCredit) {
+        sQueueStreamCredit = cap;
+    } else {
+        sQueueStreamCredit += elapsed;
+    }
+
+    return sQueueStreamCredit / cost;
+}
+
+static void queue_stream_charge(s32 spawned) {
+    if (sQueueStreamRate != QUEUE_STREAM_UNLIMITED) {
+        sQueueStreamCredit -= spawned * (OS_CPU_COUNTER / sQueueStreamRate);
+    }
+}
+
+// TRUE if the streamed object's origin is in front of the camera
+static s32 queue_object_in_front(TActor *actor) {
+    MtxF *viewProj;
+    Vec3f *pos;
+
+    if (actor == NULL) {
+        return FALSE;
+    }
+
+    // Clip space w, positive in front of the near plane's side of the camera
+    viewProj = func_8000389c();
+    pos = &actor->srt.transl;
+    return pos->x * viewProj->m[0][3] + pos->y * viewProj->m[1][3] + pos->z * viewProj->m[2][3] +
+        viewProj->m[3][3] > 0.0f;
+}
+
+/**
+ * While streaming is rate limited, moves an object in front of the camera to
+ * the head if the head object isn't. Only the run of object entries at the head
+ * is searched, so other completions keep their order relative to the objects.
+ */
+static void queue_prioritize_objects(struct UnkStructFunc80012A4C *first) {
+    struct UnkStructFunc80012A4C swap;
+    struct UnkStructFunc80012A4C *entry;
+    s32 i;
+
+    if (queue_object_in_front((TActor *)first->unk4)) {
+        return;
+    }
+
+    for (i = 1; i < QUEUE_STREAM_PRIORITY_SCAN && (entry = spsc_peek(&sQueueCompletionRing, i)) != NULL; i++) {
+        if (entry->unk0 != 5) {
+            return;
+        }
+        if (queue_object_in_front((TActor *)entry->unk4)) {
+            // Pushed entries are the consumer's until popped
+            swap = *first;
+            *first = *entry;
+            *entry = swap;
+            return;
+        }
+    }
+}
+
+// Legacy D_800AE1D0 entries are always drained fully, ring entries up to the budgets
+static s32 queue_next_completion(struct UnkStructFunc80012A4C *out, s32 *drained, s32 *spawned, OSTime start) {
+    struct UnkStructFunc80012A4C *entry;
+
+    if (D_800AE1D0->unk0 != 0) {
+        func_8000B124(D_800AE1D0, out);
+        return TRUE;
+    }
+
+    entry = spsc_peek(&sQueueCompletionRing, 0);
+    if (entry == NULL || *drained >= gQueueCompletionBudget) {
+        return FALSE;
+    }
+    if (*drained != 0 && OS_CYCLES_TO_USEC(osGetTime() - start) >= (u32)gQueueCompletionBudgetUs) {
+        return FALSE;
+    }
+
+    if (entry->unk0 == 5) {
+        // Entering a populated area shouldn't activate every object on one frame
+        if (*spawned >= sQueueSpawnLimit) {
+            return FALSE;
+        }
+        if (sQueueStreamRate != QUEUE_STREAM_UNLIMITED) {
+            queue_prioritize_objects(entry);
+        }
+        (*spawned)++;
+    }
+
+    *out = *entry;
+    spsc_pop(&sQueueCompletionRing);
+    (*drained)++;
+
+    if (sQueueCompletionWaiting) {
+        osSendMesg(&sQueueCompletionSpace, NULL, OS_MESG_NOBLOCK);
+    }
+
+    return TRUE;
+}
+#endif
+
 void func_80012A4C(void) {
     struct UnkStructFunc80012A4C sp24;
+#ifdef NON_MATCHING
+    s32 drained;
+    s32 spawned;
+    OSTime start;
+#endif
 
     while (osRecvMesg(&D_800ACB68, NULL, 0) != -1);
 
+#ifdef NON_MATCHING
+    drained = 0;
+    spawned = 0;
+    sQueueSpawnLimit = queue_stream_allowance();
+    start = osGetTime();
+    while (queue_next_completion(&sp24, &drained, &spawned, start)) {
+#else
     while (D_800AE1D0->unk0 != 0) {
         func_8000B124(D_800AE1D0, &sp24);
+#endif
 
         switch (sp24.unk0) {
             case 5:
@@ -205,6 +487,10 @@ void func_80012A4C(void) {
                 break;
         }
     }
+
+#ifdef NON_MATCHING
+    queue_stream_charge(spawned);
+#endif
 }
 
 // TODO: struct
@@ -314,10 +600,130 @@ void _asset_thread_main(s32 arg0) {
 }
 #endif
 
+#ifdef NON_MATCHING
+StreamStat gStreamStats[STREAM_STAT_COUNT];
+
+static const char *sStreamStatNames[STREAM_STAT_COUNT] = {
+    "file", "file->ptr", "region", "texture", "object", "dll", "model", "anim",
+    "s.common", "s.block", "s.2", "s.texture", "s.4", "s.object", "s.6"
+};
+
+static void stream_stat_add(StreamTimeStat *stat, OSTime time) {
+    u32 us;
+    s32 bucket;
+
+    us = OS_CYCLES_TO_USEC(time);
+
+    if (stat->samples == 0 || us < stat->min) {
+        stat->min = us;
+    }
+    if (us > stat->max) {
+        stat->max = us;
+    }
+    stat->total += us;
+    stat->samples++;
+
+    bucket = 0;
+    while (bucket < STREAM_STAT_BUCKETS - 1 && (us >> (bucket + 1)) != 0) {
+        bucket++;
+    }
+    if (stat->histogram[bucket] != 0xFFFF) {
+        stat->histogram[bucket]++;
+    }
+}
+
+u32 stream_stat_p95(StreamTimeStat *stat) {
+    u32 target;
+    u32 seen;
+    u32 top;
+    s32 i;
+
+    target = stat->samples - stat->samples / 20;
+    seen = 0;
+    for (i = 0; i < STREAM_STAT_BUCKETS; i++) {
+        seen += stat->histogram[i];
+        if (seen >= target) {
+            break;
+        }
+    }
+
+    top = (2 << i) - 1;
+    return top < stat->max ? top : stat->max;
+}
+
+// wait is 0 when the submit time isn't known (legacy ring entries)
+static void stream_stats_record(s32 slot, OSTime wait, OSTime start, u32 bytes) {
+    StreamStat *stat;
+    OSTime inflateTotal;
+    OSTime elapsed;
+    u32 inflateBytes;
+
+    if (slot < 0 || slot >= STREAM_STAT_COUNT) {
+        return;
+    }
+
+    elapsed = osGetTime() - start;
+    inflate_get_timing(&inflateTotal, &inflateBytes);
+
+    stat = &gStreamStats[slot];
+    stat->count++;
+    if (wait != 0) {
+        stream_stat_add(&stat->wait, wait);
+    }
+
+    // Everything but decompressing is treated as DMA
+    if (inflateTotal != 0) {
+        stream_stat_add(&stat->dma, elapsed - inflateTotal);
+        stream_stat_add(&stat->inflate, inflateTotal);
+        stat->bytes += inflateBytes;
+    } else {
+        stream_stat_add(&stat->dma, elapsed);
+        stat->bytes += bytes;
+    }
+}
+
+static void dbg_stream_time_print(const char *label, StreamTimeStat *stat) {
+    if (stat->samples == 0) {
+        return;
+    }
+
+    dummied_print_func("  %s %d/%d/%d/%d us\n", label, stat->min, stat->total / stat->samples,
+        stream_stat_p95(stat), stat->max);
+}
+
+void dbg_stream_stats_print(void) {
+    StreamStat *stat;
+    s32 i;
+
+    dummied_print_func("stream: min/mean/p95/max\n");
+    for (i = 0; i < STREAM_STAT_COUNT; i++) {
+        stat = &gStreamStats[i];
+        if (stat->count == 0) {
+            continue;
+        }
+
+        dummied_print_func("%s: %d loads, %d KB\n", sStreamStatNames[i], stat->count, stat->bytes / 0x400);
+        dbg_stream_time_print("wait", &stat->wait);
+        dbg_stream_time_print("dma", &stat->dma);
+        dbg_stream_time_print("inflate", &stat->inflate);
+    }
+}
+#endif
+
+#ifdef NON_MATCHING
+// The asm side passes the destination as a plain word
+#define QUEUE_EMPLACE(type, dst, value, argC, arg10) queue_completion_push(type, (u32*)(dst), value, argC, arg10)
+#else
+#define QUEUE_EMPLACE queue_block_emplace
+#endif
+
 void asset_thread_load_single(void) {
     struct UnkStructAssetThreadSingle sp2C;
     s32 sp28;
     s32 tmp;
+#ifdef NON_MATCHING
+    OSTime start;
+#endif
 
     sp28 = func_with_status_reg();
     if (func_8000AFF8(D_800ACBC8) == 0) {
@@ -325,37 +731,261 @@ void asset_thread_load_single(void) {
         D_800AE29D = 1;
         D_800AE29E = sp2C.unk0;
         set_status_reg(sp28);
+#ifdef NON_MATCHING
+        start = osGetTime();
+        inflate_reset_timing();
+#endif
         switch (sp2C.unk0) {
             case 5:
-                queue_block_emplace(5, objSetupObjectActual(sp2C.unk8, 1, sp2C.unkC, sp2C.unk10, sp2C.unk14, sp2C.unk18), 1, 0, 0);
+                QUEUE_EMPLACE(5, objSetupObjectActual(sp2C.unk8, 1, sp2C.unkC, sp2C.unk10, sp2C.unk14, sp2C.unk18), 1, 0, 0);
                 break;
             case 3:
                 tmp = texture_load(sp2C.unk8, 0);
                 if (sp2C.unk4 != 0) {
-                    queue_block_emplace(3, sp2C.unk4, tmp, 0, 0);
+                    QUEUE_EMPLACE(3, sp2C.unk4, tmp, 0, 0);
                 }
                 break;
             case 1:
                 block_load(sp2C.unk8, sp2C.unkC, sp2C.unk10, 1);
                 break;
             case 0:
-                queue_block_emplace(0, sp2C.unk4, func_80007468(sp2C.unk8, sp2C.unkC, sp2C.unk10, sp2C.unk14), 0, 0);
+                QUEUE_EMPLACE(0, sp2C.unk4, func_80007468(sp2C.unk8, sp2C.unkC, sp2C.unk10, sp2C.unk14), 0, 0);
                 break;
             case 6:
-                queue_block_emplace(6, sp2C.unk4, func_80007620(sp2C.unk8, sp2C.unkC), 0, 0);
+                QUEUE_EMPLACE(6, sp2C.unk4, func_80007620(sp2C.unk8, sp2C.unkC), 0, 0);
                 break;
             default:
                 break;
         }
+#ifdef NON_MATCHING
+        stream_stats_record(STREAM_STAT_SINGLE + sp2C.unk0, 0, start, 0);
+#endif
         osSendMesg(&D_800ACB68, NULL, 0);
         return;
     }
     set_status_reg(sp28);
 } 
 
+#ifdef NON_MATCHING
+typedef struct BootPrefetch {
+/*0000*/ void *data;
+/*0004*/ s32 handle;    // FILE_READ_INVALID_HANDLE while not reading
+/*0008*/ u16 id;
+/*000A*/ u8 issued;
+/*000B*/ u8 done;
+/*000C*/ u8 claimed;
+} BootPrefetch;
+
+static BootPrefetch sBootPrefetches[BOOT_PREFETCH_MAX];
+static s32 sBootPrefetchCount;
+static s32 sBootPrefetchNext;   // Next one to issue, they're read in the order given
+// The main thread hands the prefetches to the asset thread once they're set up.
+// A take in progress owns them, so an end during one leaves the cleanup to it.
+static s32 sBootPrefetchTaking;
+static s32 sBootPrefetchEnding;
+static s32 sBootPrefetchTotal;  // The count as set up, it outlives the end
+
+u32 gBootPrefetchWaitUs;
+u32 gBootPrefetchHits;
+
+// Moves the reads in flight along, then starts as many more as there are slots for
+static void boot_prefetch_pump(void) {
+    BootPrefetch *prefetch;
+    s32 i;
+
+    for (i = 0; i < sBootPrefetchNext; i++) {
+        prefetch = &sBootPrefetches[i];
+        if (prefetch->issued && !prefetch->done && read_file_async_poll(prefetch->handle)) {
+            prefetch->done = TRUE;
+            prefetch->handle = FILE_READ_INVALID_HANDLE;
+        }
+    }
+
+    while (sBootPrefetchNext < sBootPrefetchCount) {
+        prefetch = &sBootPrefetches[sBootPrefetchNext];
+        if (prefetch->data != NULL && !prefetch->done) {
+            prefetch->handle = read_file_region_async(prefetch->id, prefetch->data, 0, get_file_size(prefetch->id), NULL);
+            if (prefetch->handle == FILE_READ_INVALID_HANDLE) {
+                break;
+            }
+            prefetch->issued = TRUE;
+        }
+        sBootPrefetchNext++;
+    }
+}
+
+static void boot_prefetch_wait(BootPrefetch *prefetch) {
+    BootPrefetch *inflight;
+    s32 i;
+
+    while (!prefetch->done) {
+        inflight = prefetch;
+        if (!prefetch->issued) {
+            // Out of read slots, finish the oldest one in flight to free one
+            for (i = 0; i < sBootPrefetchNext; i++) {
+                if (sBootPrefetches[i].issued && !sBootPrefetches[i].done) {
+                    break;
+                }
+            }
+
+            if (i == sBootPrefetchNext) {
+                // Every slot is someone else's
+                read_file(prefetch->id, prefetch->data);
+                prefetch->done = TRUE;
+                break;
+            }
+            inflight = &sBootPrefetches[i];
+        }
+
+        read_file_async_wait(inflight->handle);
+        inflight->done = TRUE;
+        inflight->handle = FILE_READ_INVALID_HANDLE;
+        boot_prefetch_pump();
+    }
+}
+
+void boot_prefetch_start(const u8 *ids, s32 count) {
+    BootPrefetch *prefetch;
+    s32 sr;
+    s32 i;
+
+    if (count > BOOT_PREFETCH_MAX) {
+        count = BOOT_PREFETCH_MAX;
+    }
+
+    for (i = 0; i < count; i++) {
+        prefetch = &sBootPrefetches[i];
+        bzero(prefetch, sizeof(BootPrefetch));
+        prefetch->id = ids[i];
+        prefetch->handle = FILE_READ_INVALID_HANDLE;
+        // Same as read_alloc_file, so the init steps can keep or free it as they would theirs
+        prefetch->data = malloc(get_file_size(ids[i]), 0x7F7F7FFF, NULL);
+        // One that can't be allocated is left to the normal load
+        prefetch->claimed = prefetch->data == NULL;
+    }
+
+    // The asset thread can't see any of them until the count is set
+    sBootPrefetchTotal = count;
+    sBootPrefetchNext = 0;
+    sBootPrefetchTaking = FALSE;
+    sBootPrefetchEnding = FALSE;
+    gBootPrefetchWaitUs = 0;
+    gBootPrefetchHits = 0;
+    boot_prefetch_pump();
+
+    sr = func_with_status_reg();
+    sBootPrefetchCount = count;
+    set_status_reg(sr);
+}
+
+/**
+ * Asset thread side of QUEUE_FILE.
+ *
+ * @returns The prefetched copy of id once it's all read, or NULL if it wasn't
+ * prefetched.
+ */
+static void boot_prefetch_release(void);
+
+static void *boot_prefetch_take(u32 id) {
+    BootPrefetch *prefetch;
+    OSTime start;
+    s32 sr;
+    s32 i;
+
+    sr = func_with_status_reg();
+    for (i = 0; i < sBootPrefetchCount; i++) {
+        prefetch = &sBootPrefetches[i];
+        if (prefetch->id == id && !prefetch->claimed) {
+            break;
+        }
+    }
+
+    if (i == sBootPrefetchCount) {
+        set_status_reg(sr);
+        return NULL;
+    }
+    sBootPrefetchTaking = TRUE;
+    set_status_reg(sr);
+
+    boot_prefetch_pump();
+    if (!prefetch->done) {
+        start = osGetTime();
+        boot_prefetch_wait(prefetch);
+        gBootPrefetchWaitUs += OS_CYCLES_TO_USEC(osGetTime() - start);
+    }
+
+    prefetch->claimed = TRUE;
+    gBootPrefetchHits++;
+
+    sr = func_with_status_reg();
+    sBootPrefetchTaking = FALSE;
+    if (sBootPrefetchEnding) {
+        set_status_reg(sr);
+        boot_prefetch_release();
+    } else {
+        set_status_reg(sr);
+    }
+
+    return prefetch->data;
+}
+
+// Only run by whichever thread owns the prefetches once they've been ended
+static void boot_prefetch_release(void) {
+    BootPrefetch *prefetch;
+    s32 i;
+
+    for (i = 0; i < sBootPrefetchNext; i++) {
+        prefetch = &sBootPrefetches[i];
+        if (prefetch->issued && !prefetch->done) {
+            read_file_async_wait(prefetch->handle);
+        }
+    }
+    for (i = 0; i < sBootPrefetchTotal; i++) {
+        prefetch = &sBootPrefetches[i];
+        if (!prefetch->claimed) {
+            free(prefetch->data);
+        }
+    }
+
+    sBootPrefetchTotal = 0;
+    sBootPrefetchNext = 0;
+    sBootPrefetchEnding = FALSE;
+}
+
+void boot_prefetch_end(void) {
+    s32 sr;
+
+    // No take can start once the count is cleared
+    sr = func_with_status_reg();
+    sBootPrefetchCount = 0;
+    if (sBootPrefetchTaking) {
+        sBootPrefetchEnding = TRUE;
+        set_status_reg(sr);
+        return;
+    }
+    set_status_reg(sr);
+
+    boot_prefetch_release();
+}
+#endif
+
 void asset_thread_load_asset(struct UnkMesg800AE270 *arg0) {
+#ifdef NON_MATCHING
+    void *prefetched;
+    OSTime start;
+    u32 bytes;
+
+    start = osGetTime();
+    inflate_reset_timing();
+#endif
     switch (arg0->loadType) {
         case QUEUE_FILE:
+#ifdef NON_MATCHING
+            if (sBootPrefetchCount != 0 && (prefetched = boot_prefetch_take(arg0->unk4)) != NULL) {
+                *arg0->unk8 = (s32)prefetched;
+                break;
+            }
+#endif
             *arg0->unk8 = read_alloc_file(arg0->unk4, 0);
             break;
         case QUEUE_ALLOCATED_FILE:
@@ -379,6 +1009,15 @@ void asset_thread_load_asset(struct UnkMesg800AE270 *arg0) {
         case QUEUE_ANIMATION:
             *arg0->unk8 = anim_load((s16) arg0->unk4, (s16) arg0->unkC, arg0->unk20, arg0->unk24);
     }
+#ifdef NON_MATCHING
+    bytes = 0;
+    if (arg0->loadType == QUEUE_FILE || arg0->loadType == QUEUE_ALLOCATED_FILE) {
+        bytes = get_file_size(arg0->unk4);
+    } else if (arg0->loadType == QUEUE_FILE_REGION) {
+        bytes = arg0->unkC;
+    }
+    stream_stats_record(arg0->loadType, start - sQueueSyncSubmitTime, start, bytes);
+#endif
     osSendMesg(&D_800ACB98, NULL, 0);
 }
 
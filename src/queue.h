@@ -40,6 +40,173 @@ extern OSMesgQueue D_800ACB48, D_800ACB68, D_800ACB98;
 #define QUEUE_MODEL 6
 #define QUEUE_ANIMATION 7
 
+/**
+ * A ring of fixed size entries passed from one producer thread to one consumer
+ * thread without masking interrupts. head is only written by the consumer and
+ * tail only by the producer, each with a single store once it is done with the
+ * entry. The CPU is in order and there is only one of it, so that store is seen
+ * after the entry's; spsc_push and spsc_pop being calls keeps the compiler from
+ * moving the entry's accesses past it.
+ */
+typedef struct SPSCRing {
+/*0000*/ volatile u32 head;
+/*0004*/ volatile u32 tail;
+/*0008*/ u8 *entries;
+/*000C*/ u16 entrySize;
+/*000E*/ u16 mask; // Capacity - 1
+} SPSCRing;
+
+/**
+ * @param capacity Entries in the entries buffer, must be a power of two.
+ */
+void spsc_init(SPSCRing *ring, void *entries, s32 entrySize, s32 capacity);
+
+/**
+ * Producer side.
+ *
+ * @returns The entry to write next, or NULL if the ring is full.
+ */
+void *spsc_reserve(SPSCRing *ring);
+
+/**
+ * Producer side. Hands the entry from spsc_reserve over to the consumer.
+ */
+void spsc_push(SPSCRing *ring);
+
+/**
+ * Consumer side. Entries up to spsc_count can be read and rewritten in place,
+ * the producer doesn't touch them again.
+ *
+ * @returns The i-th oldest entry, or NULL if there aren't that many.
+ */
+void *spsc_peek(SPSCRing *ring, s32 i);
+
+/**
+ * Consumer side. Hands the oldest entry's slot back to the producer.
+ */
+void spsc_pop(SPSCRing *ring);
+
+s32 spsc_count(SPSCRing *ring);
+
+// Most files boot_prefetch_start reads ahead
+#define BOOT_PREFETCH_MAX 16
+
+/**
+ * Starts reading the files in ids, in that order, into buffers allocated the way
+ * read_alloc_file does. A queue_alloc_load_file of one of them then waits for
+ * its read, if it hasn't finished already, and hands over the buffer instead of
+ * reading the file again. Files past BOOT_PREFETCH_MAX are read normally.
+ * Not for use while other loads are queued.
+ */
+void boot_prefetch_start(const u8 *ids, s32 count);
+
+/**
+ * Frees whatever boot_prefetch_start read that nothing asked for, and stops
+ * queue_alloc_load_file looking for prefetches.
+ */
+void boot_prefetch_end(void);
+
+// Microseconds the asset thread spent waiting on prefetched files since boot_prefetch_start
+extern u32 gBootPrefetchWaitUs;
+// Files handed over by queue_alloc_load_file since boot_prefetch_start
+extern u32 gBootPrefetchHits;
+
+// Must be a power of two
+#define QUEUE_COMPLETION_RING_SIZE 64
+#define QUEUE_COMPLETIONS_PER_FRAME 8
+#define QUEUE_COMPLETION_BUDGET_US 2000
+#define QUEUE_SPAWNS_PER_FRAME 4
+
+/**
+ * The most completions func_80012A4C applies from the completion ring per call.
+ * Leftovers are applied on the following frames.
+ */
+extern s32 gQueueCompletionBudget;
+
+/**
+ * Once func_80012A4C has spent this long applying ring completions (block
+ * emplacement and vertex colors included) it leaves the rest for the next frame.
+ * At least one completion is always applied.
+ */
+extern s32 gQueueCompletionBudgetUs;
+
+/**
+ * The most streamed objects func_80012A4C activates (func_80021A84) per call.
+ * Completions behind an object that is over budget wait with it, so everything
+ * still lands in the order it was loaded.
+ */
+extern s32 gQueueSpawnBudget;
+
+#define QUEUE_STREAM_UNLIMITED 0
+// Object completions searched for one in front of the camera while rate limited
+#define QUEUE_STREAM_PRIORITY_SCAN 8
+
+/**
+ * Limits object streaming to activating at most perSecond streamed objects a
+ * second, on top of gQueueSpawnBudget. Objects in front of the camera are
+ * activated first. QUEUE_STREAM_UNLIMITED (0) lifts the limit.
+ *
+ * @details Unlike func_800129D4, which stops object streaming outright, loads
+ * carry on in the background and only their activation is paced, so cutscenes
+ * and menus can keep the world filling in without hitches.
+ */
+void queue_set_object_stream_rate(s32 perSecond);
+
+/**
+ * @returns The objects per second limit, or QUEUE_STREAM_UNLIMITED.
+ */
+s32 queue_get_object_stream_rate(void);
+
+/**
+ * @returns How many loaded objects are waiting in the completion ring to be
+ * activated.
+ */
+s32 queue_get_pending_object_count(void);
+
+// Streaming stats slots: QUEUE_* types, then single-load types offset by STREAM_STAT_SINGLE
+#define STREAM_STAT_SINGLE 8
+#define STREAM_STAT_SINGLE_TYPES 7
+#define STREAM_STAT_COUNT (STREAM_STAT_SINGLE + STREAM_STAT_SINGLE_TYPES)
+// log2 microsecond buckets, the last one also takes everything above it
+#define STREAM_STAT_BUCKETS 20
+
+typedef struct StreamTimeStat {
+/*0000*/ u32 min; // Microseconds
+/*0004*/ u32 max;
+/*0008*/ u32 total;
+/*000C*/ u32 samples;
+/*0010*/ u16 histogram[STREAM_STAT_BUCKETS];
+} StreamTimeStat;
+
+typedef struct StreamStat {
+/*0000*/ u32 count;
+/*0004*/ u32 bytes; // Read from ROM
+/*0008*/ StreamTimeStat wait; // Submitted until the asset thread picked it up
+/*0040*/ StreamTimeStat dma; // Waiting on PI DMA
+/*0078*/ StreamTimeStat inflate; // Decompressing
+} StreamStat;
+
+extern StreamStat gStreamStats[STREAM_STAT_COUNT];
+
 void queue_load_texture(s32 *arg0, s32 arg1);
 
+/**
+ * @returns The 95th percentile of the samples in microseconds, rounded up to the
+ * top of its histogram bucket but never above the observed maximum.
+ */
+u32 stream_stat_p95(StreamTimeStat *stat);
+
+/**
+ * Prints min/mean/p95/max of each timing and the bytes moved per load type.
+ */
+void dbg_stream_stats_print(void);
+
+/**
+ * Hands a finished load back to the main thread, like queue_block_emplace but
+ * through a lock-free single-producer/single-consumer ring. Only the asset
+ * thread may call this. Blocks while the ring is full rather than dropping
+ * the completion.
+ */
+void queue_completion_push(u8 type, u32 *dst, u32 value, u32 argC, u32 arg10);
+
 #endif
@@ -3,6 +3,7 @@
 
 #include "common.h"
 #include "scheduler.h"
+#include "crash.h"
 
 #define VIDEO_MSG       666
 #define RSP_DONE_MSG    667
@@ -72,6 +73,173 @@ void __scExec(OSSched *sc, OSScTask *sp, OSScTask *dp);
 void __scYield(OSSched *sc);
 s32 __scSchedule(OSSched *sc, OSScTask **sp, OSScTask **dp, s32 availRCP);
 
+#ifdef NON_MATCHING
+static SchedFrameTimes gSchedFrameTimes[SCHED_TIMES_HISTORY];
+// Index of the frame currently being accumulated
+static u32 gSchedFrame;
+static u16 gSchedRSPHistogram[SCHED_HISTOGRAM_BUCKETS];
+static u16 gSchedRDPHistogram[SCHED_HISTOGRAM_BUCKETS];
+// When the current RSP and RDP tasks started
+static u32 gSchedRSPStart;
+static u32 gSchedRDPStart;
+
+static void sched_histogram_add(u16 *histogram, u32 ticks)
+{
+    u32 bucket = OS_CYCLES_TO_USEC(ticks) / SCHED_HISTOGRAM_BUCKET_USEC;
+
+    if (bucket >= SCHED_HISTOGRAM_BUCKETS)
+        bucket = SCHED_HISTOGRAM_BUCKETS - 1;
+    if (histogram[bucket] != 0xFFFF)
+        histogram[bucket]++;
+}
+
+// The RDP finished a frame's last task, start the next frame
+static void sched_end_frame(void)
+{
+    SchedFrameTimes *times = &gSchedFrameTimes[gSchedFrame % SCHED_TIMES_HISTORY];
+
+    sched_histogram_add(gSchedRSPHistogram, times->rspGfx + times->rspAudio);
+    sched_histogram_add(gSchedRDPHistogram, times->rdp);
+
+    gSchedFrame++;
+    bzero(&gSchedFrameTimes[gSchedFrame % SCHED_TIMES_HISTORY], sizeof(SchedFrameTimes));
+}
+
+s32 sched_get_frame_times(s32 framesAgo, SchedFrameTimes *out)
+{
+    if (framesAgo < 0 || framesAgo >= SCHED_TIMES_HISTORY - 1 || (u32)framesAgo >= gSchedFrame)
+        return FALSE;
+
+    bcopy(&gSchedFrameTimes[(gSchedFrame - 1 - framesAgo) % SCHED_TIMES_HISTORY], out, sizeof(SchedFrameTimes));
+    return TRUE;
+}
+
+void sched_get_busy_histograms(u16 *rsp, u16 *rdp)
+{
+    if (rsp != NULL)
+        bcopy(gSchedRSPHistogram, rsp, sizeof(gSchedRSPHistogram));
+    if (rdp != NULL)
+        bcopy(gSchedRDPHistogram, rdp, sizeof(gSchedRDPHistogram));
+}
+
+void sched_reset_histograms(void)
+{
+    bzero(gSchedRSPHistogram, sizeof(gSchedRSPHistogram));
+    bzero(gSchedRDPHistogram, sizeof(gSchedRDPHistogram));
+}
+
+// Sent to the interrupt queue like the audio thread's own wake up, see func_8003B9C0
+#define SCHED_AUDIO_CHECK_MSG 0x63
+
+static s8 gSchedAudioAdaptive;
+static u32 gSchedAudioMargin = OS_USEC_TO_CYCLES(2000);
+static u32 gSchedAudioDeadline = OS_USEC_TO_CYCLES(16666);
+// The longest recent audio task, decaying so one slow task doesn't count forever
+static u32 gSchedAudioTaskTicks;
+// When the waiting audio task arrived
+static u32 gSchedAudioReadyAt;
+static s8 gSchedAudioWaiting;
+static s8 gSchedAudioTimerArmed;
+static OSTimer gSchedAudioTimer;
+
+void sched_set_audio_policy(s32 adaptive, u32 marginUsec, u32 deadlineUsec)
+{
+    gSchedAudioAdaptive = adaptive;
+    gSchedAudioMargin = OS_USEC_TO_CYCLES(marginUsec);
+    gSchedAudioDeadline = OS_USEC_TO_CYCLES(deadlineUsec);
+}
+
+static SchedAudioStats gSchedAudioStats;
+static u32 gSchedAudioFrameBudget = OS_USEC_TO_CYCLES(16666);
+static u32 gSchedAudioLateThreshold = OS_USEC_TO_CYCLES(8000);
+// When the oldest queued audio task was queued
+static u32 gSchedAudioQueuedAt;
+
+void sched_set_audio_budget(u32 frameUsec, u32 lateUsec)
+{
+    gSchedAudioFrameBudget = OS_USEC_TO_CYCLES(frameUsec);
+    gSchedAudioLateThreshold = OS_USEC_TO_CYCLES(lateUsec);
+}
+
+void sched_get_audio_stats(SchedAudioStats *out)
+{
+    bcopy(&gSchedAudioStats, out, sizeof(SchedAudioStats));
+}
+
+void sched_reset_audio_stats(void)
+{
+    bzero(&gSchedAudioStats, sizeof(SchedAudioStats));
+}
+
+static void sched_audio_task_queued(OSSched *sc)
+{
+    if (sc->audioListHead != NULL || (sc->curRSPTask != NULL && sc->curRSPTask->list.t.type == M_AUDTASK))
+        gSchedAudioStats.overruns++;
+    if (sc->audioListHead == NULL)
+        gSchedAudioQueuedAt = osGetCount();
+}
+
+static void sched_audio_task_started(void)
+{
+    u32 wait = osGetCount() - gSchedAudioQueuedAt;
+
+    if (wait > gSchedAudioStats.maxWait)
+        gSchedAudioStats.maxWait = wait;
+    if (wait > gSchedAudioLateThreshold)
+        gSchedAudioStats.late++;
+    // The next one queued behind it has been waiting since now
+    gSchedAudioQueuedAt = osGetCount();
+}
+
+static void sched_audio_task_done(u32 ticks)
+{
+    gSchedAudioStats.tasks++;
+    if (ticks > gSchedAudioStats.maxRun)
+        gSchedAudioStats.maxRun = ticks;
+    if (ticks > gSchedAudioFrameBudget)
+        gSchedAudioStats.slow++;
+
+    gSchedAudioTaskTicks -= gSchedAudioTaskTicks >> 4;
+    if (ticks > gSchedAudioTaskTicks)
+        gSchedAudioTaskTicks = ticks;
+}
+
+/**
+ * @returns TRUE if the running graphics task may keep the RSP for now, in which
+ * case a check is scheduled for when it no longer may.
+ */
+static s32 sched_audio_can_wait(OSSched *sc)
+{
+    u32 now = osGetCount();
+    u32 slack;
+    u32 waited;
+
+    if (!gSchedAudioAdaptive)
+        return FALSE;
+
+    if (!gSchedAudioWaiting)
+    {
+        gSchedAudioWaiting = TRUE;
+        gSchedAudioReadyAt = now;
+    }
+
+    if (gSchedAudioDeadline <= gSchedAudioTaskTicks + gSchedAudioMargin)
+        return FALSE;
+
+    slack = gSchedAudioDeadline - gSchedAudioTaskTicks - gSchedAudioMargin;
+    waited = now - gSchedAudioReadyAt;
+    if (waited >= slack)
+        return FALSE;
+
+    if (gSchedAudioTimerArmed)
+        osStopTimer(&gSchedAudioTimer);
+    osSetTimer(&gSchedAudioTimer, slack - waited, 0, &sc->interruptQ, (OSMesg)SCHED_AUDIO_CHECK_MSG);
+    gSchedAudioTimerArmed = TRUE;
+
+    return TRUE;
+}
+#endif
+
 void osCreateScheduler(OSSched *s, void *stack, OSPri priority, u8 mode, u8 retraceCount) {
     // Initialize scheduler structure
     s->curRSPTask       = NULL;
@@ -103,6 +271,9 @@ void osCreateScheduler(OSSched *s, void *stack, OSPri priority, u8 mode, u8 retr
     osViSetEvent(&s->interruptQ, (OSMesg)VIDEO_MSG, retraceCount);
 
     // Create and start scheduler thread
+#ifdef NON_MATCHING
+    stack_watch(OS_SCHEDULER_THREAD_ID, (u8 *)stack - OS_SC_STACKSIZE, OS_SC_STACKSIZE);
+#endif
     osCreateThread(&s->thread, OS_SCHEDULER_THREAD_ID, &__scMain, (void*)s, stack, priority);
     osStartThread(&s->thread);
 }
@@ -226,6 +397,11 @@ void func_8003B9C0(OSSched *sc) {
     }
 
     if (sc->unk0x304 != 0 && sc->curRSPTask) {
+#ifdef NON_MATCHING
+        if (sc->curRSPTask->list.t.type == M_GFXTASK && sched_audio_can_wait(sc)) {
+            return;
+        }
+#endif
         __scYield(sc);
         return;
     }
@@ -271,9 +447,24 @@ void __scHandleRSP(OSSched *sc) {
     t = sc->curRSPTask;
     sc->curRSPTask = 0;
 
+#ifdef NON_MATCHING
+    {
+        SchedFrameTimes *times = &gSchedFrameTimes[gSchedFrame % SCHED_TIMES_HISTORY];
+
+        if (t->list.t.type == M_AUDTASK) {
+            times->rspAudio += osGetCount() - gSchedRSPStart;
+        } else {
+            times->rspGfx += osGetCount() - gSchedRSPStart;
+        }
+    }
+#endif
+
     if (t->list.t.type == M_AUDTASK) {
         countRegB = osGetCount();
 
+#ifdef NON_MATCHING
+        sched_audio_task_done(countRegB - countRegA);
+#endif
         floatTimer3 = ((countRegB - countRegA) * 60.0f) / D_8009A344;
         floatTimer1 += floatTimer3;
 
@@ -336,6 +527,13 @@ void __scHandleRDP(OSSched *sc) {
 
     t->state &= ~OS_SC_NEEDS_RDP;
 
+#ifdef NON_MATCHING
+    gSchedFrameTimes[gSchedFrame % SCHED_TIMES_HISTORY].rdp += osGetCount() - gSchedRDPStart;
+    if (t->flags & OS_SC_LAST_TASK) {
+        sched_end_frame();
+    }
+#endif
+
     __scTaskComplete(sc, t);
 
     state = ((sc->curRSPTask == 0) << 1) | (sc->curRDPTask == 0);
@@ -401,6 +599,9 @@ void __scAppendList(OSSched *s, OSScTask *t) {
     u32 type = t->list.t.type;
 
     if (type == M_AUDTASK) {
+#ifdef NON_MATCHING
+        sched_audio_task_queued(s);
+#endif
         if (s->audioListTail) {
             s->audioListTail->next = t;
         } else {
@@ -427,8 +628,27 @@ void __scExec(OSSched *sc, OSScTask *sp, OSScTask *dp) {
         if (sp->list.t.type == M_AUDTASK) {
             osWritebackDCacheAll(); // flush the cache
             countRegA = osGetCount();
+#ifdef NON_MATCHING
+            sched_audio_task_started();
+            gSchedAudioWaiting = FALSE;
+            if (gSchedAudioTimerArmed) {
+                osStopTimer(&gSchedAudioTimer);
+                gSchedAudioTimerArmed = FALSE;
+            }
+#endif
         }
 
+#ifdef NON_MATCHING
+        gSchedRSPStart = osGetCount();
+        // A resumed task's RDP work started before it yielded
+        if (!(sp->state & OS_SC_YIELDED)) {
+            gSchedFrameTimes[gSchedFrame % SCHED_TIMES_HISTORY].tasks++;
+            if (sp == dp) {
+                gSchedRDPStart = gSchedRSPStart;
+            }
+        }
+#endif
+
         sp->state &= ~(OS_SC_YIELD | OS_SC_YIELDED);
 
         osSpTaskLoad(&sp->list);
@@ -446,6 +666,9 @@ void __scExec(OSSched *sc, OSScTask *sp, OSScTask *dp) {
 
     if (dp && (dp != sp)) {
         osDpSetNextBuffer(dp->list.t.output_buff, *dp->list.t.output_buff_size);
+#ifdef NON_MATCHING
+        gSchedRDPStart = osGetCount();
+#endif
 
         sc->curRDPTask = dp;
     }
@@ -456,6 +679,9 @@ void __scYield(OSSched *sc) {
         sc->curRSPTask->state |= OS_SC_YIELD;
 
         D_800B4988 = osGetTime();
+#ifdef NON_MATCHING
+        gSchedFrameTimes[gSchedFrame % SCHED_TIMES_HISTORY].yields++;
+#endif
 
         osSpTaskYield();
     }
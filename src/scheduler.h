@@ -4,10 +4,73 @@
 #include "ultra64.h"
 
 #define OS_SCHEDULER_THREAD_ID 5
+// From osscheduler_ up to ossceduler_stack, the end of the stack main gives osCreateScheduler
+#define OS_SC_STACKSIZE 0x2000
 
 /**
  * @returns The address of s->interruptQ.
  */
 OSMesgQueue *get_sched_interrupt_queue(OSSched *s);
 
+// Frames of task timings kept, see sched_get_frame_times
+#define SCHED_TIMES_HISTORY 16
+#define SCHED_HISTOGRAM_BUCKETS 12
+// Busy time each histogram bucket covers, the last one also counts anything longer
+#define SCHED_HISTOGRAM_BUCKET_USEC 2000
+
+// How long the RCP was busy with one frame's tasks, in osGetCount ticks
+typedef struct SchedFrameTimes {
+/*0000*/ u32 rspGfx;
+/*0004*/ u32 rspAudio;
+/*0008*/ u32 rdp;      // From the RDP being given the list until it signals done
+/*000C*/ u16 yields;   // Graphics tasks that yielded to audio
+/*000E*/ u16 tasks;
+} SchedFrameTimes;
+
+/**
+ * Copies the timings of the frame framesAgo frames before the last one whose
+ * final graphics task the RDP finished (0 for that frame itself).
+ *
+ * @returns FALSE if framesAgo is outside the history.
+ */
+s32 sched_get_frame_times(s32 framesAgo, SchedFrameTimes *out);
+
+/**
+ * Copies how many frames had RSP (graphics and audio) and RDP busy times falling in
+ * each SCHED_HISTOGRAM_BUCKET_USEC wide bucket since the last sched_reset_histograms.
+ * Either array may be NULL.
+ */
+void sched_get_busy_histograms(u16 *rsp, u16 *rdp);
+
+void sched_reset_histograms(void);
+
+/**
+ * Sets when a running graphics task yields the RSP to a waiting audio task.
+ *
+ * Normally it yields as soon as the audio task arrives. In adaptive mode it keeps
+ * running until the audio task's deadline, deadlineUsec after it arrived, minus
+ * the longest recent audio task and marginUsec.
+ */
+void sched_set_audio_policy(s32 adaptive, u32 marginUsec, u32 deadlineUsec);
+
+// Audio task counts since the last sched_reset_audio_stats, in osGetCount ticks
+typedef struct SchedAudioStats {
+/*0000*/ u32 tasks;
+/*0004*/ u32 overruns;   // Audio tasks queued while the previous one hadn't finished
+/*0008*/ u32 late;       // Waited longer than the late threshold for the RSP
+/*000C*/ u32 slow;       // Ran longer than the frame budget
+/*0010*/ u32 maxWait;
+/*0014*/ u32 maxRun;
+} SchedAudioStats;
+
+/**
+ * Sets what sched_get_audio_stats counts as late and slow: an audio task that
+ * waits more than lateUsec for the RSP, or runs longer than frameUsec.
+ */
+void sched_set_audio_budget(u32 frameUsec, u32 lateUsec);
+
+void sched_get_audio_stats(SchedAudioStats *out);
+
+void sched_reset_audio_stats(void);
+
 #endif
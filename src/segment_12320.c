@@ -1,4 +1,5 @@
 #include "common.h"
+#include "filesystem.h"
 
 #pragma GLOBAL_ASM("asm/nonmatchings/segment_12320/init_audio.s")
 
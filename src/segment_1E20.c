@@ -1,4 +1,5 @@
 #include "common.h"
+#include "memory.h"
 
 #define CAMERA_COUNT 12
 
@@ -92,6 +93,53 @@ void matrix_perspective(MtxF *mf, u16 *perspNorm, f32 fovy, f32 aspect, f32 near
 
 #pragma GLOBAL_ASM("asm/nonmatchings/segment_1E20/MusPtrBankGetCurrent.s")
 
+#ifdef NON_MATCHING
+// What gProjectionMtx was last built from, see projection_is_current
+static f32 sProjectionFovY;
+static f32 sProjectionAspect;
+static f32 sProjectionNear;
+static f32 sProjectionFar;
+static s8 sProjectionValid;
+
+/**
+ * @returns TRUE if gProjectionMtx is already the perspective for the current
+ * FOV, aspect and planes, otherwise remembers them for the rebuild that follows.
+ */
+static s32 projection_is_current(void)
+{
+    if (sProjectionValid && sProjectionFovY == gFovY && sProjectionAspect == gAspect &&
+        sProjectionNear == gNearPlane && sProjectionFar == gFarPlane) {
+        return TRUE;
+    }
+
+    sProjectionFovY = gFovY;
+    sProjectionAspect = gAspect;
+    sProjectionNear = gNearPlane;
+    sProjectionFar = gFarPlane;
+    sProjectionValid = TRUE;
+    return FALSE;
+}
+
+// For projections not built from gFovY and the rest
+static void projection_invalidate(void)
+{
+    sProjectionValid = FALSE;
+}
+
+// Replaces the active camera's position and angles while not NULL, see camera_set_override
+static SRT *sCameraOverride;
+
+/**
+ * Makes setup_rsp_camera_matrices place the active camera at srt (ignoring its
+ * scale) instead of wherever it was updated to, until called with NULL.
+ * srt is read every frame and must stay valid.
+ */
+void camera_set_override(SRT *srt)
+{
+    sCameraOverride = srt;
+}
+#endif
+
 f32 get_fov_y()
 {
     return gFovY;
@@ -107,6 +155,12 @@ void set_fov_y(f32 fovY)
 
     gFovY = fovY;
 
+#ifdef NON_MATCHING
+    if (projection_is_current()) {
+        return;
+    }
+#endif
+
     matrix_perspective(&gProjectionMtx, &gPerspNorm, gFovY, gAspect, gNearPlane, gFarPlane, 1.0f);
     matrix_f2l(&gProjectionMtx, &gRSPProjectionMtx);
     FLOAT_8008c52c = gProjectionMtx.m[0][0];
@@ -114,12 +168,20 @@ void set_fov_y(f32 fovY)
 
 void set_ortho_projection_matrix(f32 l, f32 r, f32 b, f32 t)
 {
+#ifdef NON_MATCHING
+    projection_invalidate();
+#endif
     guOrthoF(&gProjectionMtx, l, r, b, t, 0.0f, 400.0f, 20.0f);
 }
 
 void set_aspect(f32 aspect)
 {
     gAspect = aspect;
+#ifdef NON_MATCHING
+    if (projection_is_current()) {
+        return;
+    }
+#endif
     matrix_perspective(&gProjectionMtx, &gPerspNorm, gFovY, gAspect, gNearPlane, gFarPlane, 1.0f);
     matrix_f2l(&gProjectionMtx, &gRSPProjectionMtx);
     FLOAT_8008c52c = gProjectionMtx.m[0][0];
@@ -129,6 +191,11 @@ void set_aspect(f32 aspect)
 void set_near_plane(f32 near)
 {
     gNearPlane = near;
+#ifdef NON_MATCHING
+    if (projection_is_current()) {
+        return;
+    }
+#endif
     matrix_perspective(&gProjectionMtx, &gPerspNorm, gFovY, gAspect, gNearPlane, gFarPlane, 1.0f);
     matrix_f2l(&gProjectionMtx, &gRSPProjectionMtx);
     FLOAT_8008c52c = gProjectionMtx.m[0][0];
@@ -151,6 +218,9 @@ void func_800016B8()
 
 void func_80001708()
 {
+#ifdef NON_MATCHING
+    projection_invalidate();
+#endif
     matrix_perspective(&gProjectionMtx, &gPerspNorm, 60.0f, 4.0f / 3.0f, gNearPlane, gFarPlane, 1.0f);
     matrix_f2l(&gProjectionMtx, &gRSPProjectionMtx);
 }
@@ -491,6 +561,7 @@ void _func_80002490(Gfx **gdl)
 }
 #endif
 
+#ifndef NON_MATCHING
 #if 1
 #pragma GLOBAL_ASM("asm/nonmatchings/segment_1E20/setup_rsp_camera_matrices.s")
 #else
@@ -569,6 +640,92 @@ void _setup_rsp_camera_matrices(Gfx **gdl, Mtx **rspMtxs)
     }
 }
 #endif
+#else
+extern u32 UINT_800a6a54;
+extern u32 UINT_ARRAY_800a7bb0[28];
+void func_80046B58(f32 x, f32 y, f32 z);
+void update_camera_for_actor(Camera *camera);
+void setup_rsp_camera_matrices(Gfx **gdl, Mtx **rspMtxs)
+{
+    s32 cameraSel;
+    Camera *camera;
+    Vec3f v;
+    s32 i;
+
+    cameraSel = gCameraSelector;
+
+    gSPPerspNormalize((*gdl)++, gPerspNorm);
+
+    if (gUseAlternateCamera) {
+        gCameraSelector += 4;
+        cameraSel = gCameraSelector;
+    }
+    camera = &gCameras[cameraSel];
+
+    update_camera_for_actor(camera);
+
+    // The view is built from what update_camera_for_actor worked out, not camera->srt
+    if (sCameraOverride != NULL)
+    {
+        camera->yaw = sCameraOverride->yaw;
+        camera->pitch = sCameraOverride->pitch;
+        camera->roll = sCameraOverride->roll;
+        camera->tx = sCameraOverride->transl.x;
+        camera->ty = sCameraOverride->transl.y;
+        camera->tz = sCameraOverride->transl.z;
+    }
+
+    if (gCameraSelector == 4) {
+        func_80046B58(camera->tx, camera->ty, camera->tz);
+    }
+
+    v.x = camera->tx - gWorldX;
+    v.y = camera->ty;
+    v.z = camera->tz - gWorldZ;
+
+    if (v.x > 32767.0f || v.x < -32767.0f || v.z > 32767.0f || v.z < -32767.0f) {
+        return;
+    }
+
+    gCameraSRT.yaw = camera->yaw - 0x8000;
+    gCameraSRT.pitch = camera->pitch + camera->dpitch;
+    gCameraSRT.roll = camera->roll;
+    gCameraSRT.transl.x = -v.x;
+    gCameraSRT.transl.y = -v.y;
+    gCameraSRT.transl.z = -v.z;
+    if (UINT_800a6a54 != 0) {
+        gCameraSRT.transl.y -= camera->dty;
+    }
+
+    matrix_from_srt_reversed(&gViewMtx, &gCameraSRT);
+    matrix_concat(&gViewMtx, &gProjectionMtx, &gViewProjMtx);
+    matrix_f2l(&gViewProjMtx, *rspMtxs);
+
+    gRSPMtxList = *rspMtxs;
+
+    gSPMatrix((*gdl)++, OS_K0_TO_PHYSICAL((*rspMtxs)++), G_MTX_PROJECTION | G_MTX_LOAD);
+
+    gCameraSRT.yaw = -0x8000 - camera->yaw;
+    gCameraSRT.pitch = -(camera->pitch + camera->dpitch);
+    gCameraSRT.roll = -camera->roll;
+    gCameraSRT.scale = 1.0f;
+    gCameraSRT.transl.y = v.y;
+    if (UINT_800a6a54 != 0) {
+        gCameraSRT.transl.y += camera->dty;
+    }
+    gCameraSRT.transl.x = v.x;
+    gCameraSRT.transl.z = v.z;
+    matrix_from_srt(&gViewMtx2, &gCameraSRT);
+    matrix_f2l(&gViewMtx2, &gRSPViewMtx2);
+
+    gRSPMatrices[0] = NULL;
+    gRSPMatrices[1] = NULL;
+
+    for (i = 0; i < 28; i++) {
+        UINT_ARRAY_800a7bb0[i] = 0;
+    }
+}
+#endif
 
 #pragma GLOBAL_ASM("asm/nonmatchings/segment_1E20/func_800029C4.s")
 
@@ -1296,3 +1453,305 @@ void _transform_point_by_actor_matrix(Vec3f *v, Vec3f *ov, s8 matrixIdx)
 #pragma GLOBAL_ASM("asm/nonmatchings/segment_1E20/fbSetBg.s")
 
 #pragma GLOBAL_ASM("asm/nonmatchings/segment_1E20/func_80004A4C.s")
+
+#ifdef NON_MATCHING
+// The pool, the quality tier's particleCap of it is used
+#define PARTICLE_CAPACITY 256
+#define PARTICLE_MAX_EMITTERS 32
+// Quads per gSPVertex, 4 vertices each in the 32 vertex buffer
+#define PARTICLE_QUADS_PER_LOAD 8
+
+typedef struct
+{
+/*0000*/    Gfx *setup;     // Render state for all of the emitter's particles, called once per frame
+/*0004*/    Vec3f origin;   // Where its vertices are relative to, for the s16 range
+/*0010*/    Vec3f accel;    // Given to each particle it spawns, e.g. gravity
+/*001C*/    u8 priority;
+/*001D*/    u8 active;
+/*001E*/    u16 count;      // Live particles, see particle_draw
+} ParticleEmitter;
+
+// The pool, dense from 0 to sParticleCount so the updates can go through the batch kernels
+static f32 sParticleX[PARTICLE_CAPACITY];
+static f32 sParticleY[PARTICLE_CAPACITY];
+static f32 sParticleZ[PARTICLE_CAPACITY];
+static f32 sParticleVX[PARTICLE_CAPACITY];
+static f32 sParticleVY[PARTICLE_CAPACITY];
+static f32 sParticleVZ[PARTICLE_CAPACITY];
+static f32 sParticleAX[PARTICLE_CAPACITY];
+static f32 sParticleAY[PARTICLE_CAPACITY];
+static f32 sParticleAZ[PARTICLE_CAPACITY];
+static f32 sParticleSize[PARTICLE_CAPACITY];
+static u32 sParticleColor[PARTICLE_CAPACITY];
+static s16 sParticleLife[PARTICLE_CAPACITY];
+static u8 sParticleEmitter[PARTICLE_CAPACITY];
+// The emitter's, so that culling only scans this
+static u8 sParticlePriority[PARTICLE_CAPACITY];
+static s32 sParticleCount;
+
+static ParticleEmitter sParticleEmitters[PARTICLE_MAX_EMITTERS];
+// Particle indices grouped by emitter, built by particle_draw
+static u8 sParticleOrder[PARTICLE_CAPACITY];
+
+/**
+ * Adds an emitter whose particles are drawn after the setup display list, which
+ * should set the combiner, render mode and texture for all of them. When the pool
+ * is full, particles of lower priority emitters are culled for new ones first.
+ *
+ * @returns The emitter's id, or -1 if there are already PARTICLE_MAX_EMITTERS.
+ */
+s32 particle_emitter_add(Gfx *setup, s32 priority, Vec3f *accel)
+{
+    ParticleEmitter *emitter;
+    s32 i;
+
+    for (i = 0; i < PARTICLE_MAX_EMITTERS; i++)
+    {
+        emitter = &sParticleEmitters[i];
+        if (emitter->active)
+            continue;
+
+        emitter->setup = setup;
+        emitter->origin.x = 0.0f;
+        emitter->origin.y = 0.0f;
+        emitter->origin.z = 0.0f;
+        emitter->accel.x = accel->x;
+        emitter->accel.y = accel->y;
+        emitter->accel.z = accel->z;
+        emitter->priority = priority;
+        emitter->active = TRUE;
+        emitter->count = 0;
+        return i;
+    }
+
+    return -1;
+}
+
+// Moves where an emitter's vertices are relative to, which should be near its particles
+void particle_emitter_set_origin(s32 id, Vec3f *origin)
+{
+    sParticleEmitters[id].origin.x = origin->x;
+    sParticleEmitters[id].origin.y = origin->y;
+    sParticleEmitters[id].origin.z = origin->z;
+}
+
+static void particle_remove(s32 i)
+{
+    s32 last;
+
+    last = --sParticleCount;
+    sParticleX[i] = sParticleX[last];
+    sParticleY[i] = sParticleY[last];
+    sParticleZ[i] = sParticleZ[last];
+    sParticleVX[i] = sParticleVX[last];
+    sParticleVY[i] = sParticleVY[last];
+    sParticleVZ[i] = sParticleVZ[last];
+    sParticleAX[i] = sParticleAX[last];
+    sParticleAY[i] = sParticleAY[last];
+    sParticleAZ[i] = sParticleAZ[last];
+    sParticleSize[i] = sParticleSize[last];
+    sParticleColor[i] = sParticleColor[last];
+    sParticleLife[i] = sParticleLife[last];
+    sParticleEmitter[i] = sParticleEmitter[last];
+    sParticlePriority[i] = sParticlePriority[last];
+}
+
+// Removes an emitter and its particles
+void particle_emitter_remove(s32 id)
+{
+    s32 i;
+
+    for (i = sParticleCount - 1; i >= 0; i--)
+    {
+        if (sParticleEmitter[i] == id)
+            particle_remove(i);
+    }
+
+    sParticleEmitters[id].active = FALSE;
+}
+
+/**
+ * Spawns a particle of an emitter that lives for life ticks. If the pool is full,
+ * the particle of the lowest priority emitter with the least life left makes room,
+ * as long as its emitter's priority isn't above this one's.
+ *
+ * @param color RGBA8.
+ * @returns The particle's index until the next particle_update, or -1 if there was no room.
+ */
+s32 particle_spawn(s32 id, Vec3f *pos, Vec3f *vel, f32 size, s32 life, u32 color)
+{
+    ParticleEmitter *emitter;
+    s32 i;
+    s32 k;
+
+    emitter = &sParticleEmitters[id];
+
+    if (sParticleCount < gQualityTier->particleCap)
+    {
+        i = sParticleCount++;
+    }
+    else
+    {
+        i = 0;
+        for (k = 1; k < sParticleCount; k++)
+        {
+            if (sParticlePriority[k] < sParticlePriority[i] ||
+                (sParticlePriority[k] == sParticlePriority[i] && sParticleLife[k] < sParticleLife[i]))
+                i = k;
+        }
+
+        if (sParticlePriority[i] > emitter->priority)
+            return -1;
+    }
+
+    sParticleX[i] = pos->x;
+    sParticleY[i] = pos->y;
+    sParticleZ[i] = pos->z;
+    sParticleVX[i] = vel->x;
+    sParticleVY[i] = vel->y;
+    sParticleVZ[i] = vel->z;
+    sParticleAX[i] = emitter->accel.x;
+    sParticleAY[i] = emitter->accel.y;
+    sParticleAZ[i] = emitter->accel.z;
+    sParticleSize[i] = size;
+    sParticleColor[i] = color;
+    sParticleLife[i] = life;
+    sParticleEmitter[i] = id;
+    sParticlePriority[i] = emitter->priority;
+    return i;
+}
+
+/**
+ * Ages every particle by ticks, removing those that ran out, then moves the rest
+ * with two batch passes over the whole pool: acceleration into velocity, and
+ * velocity into position.
+ */
+void particle_update(s32 ticks)
+{
+    s32 i;
+
+    for (i = sParticleCount - 1; i >= 0; i--)
+    {
+        sParticleLife[i] -= ticks;
+        if (sParticleLife[i] <= 0)
+            particle_remove(i);
+    }
+
+    vec3_batch_add_with_scale(sParticleVX, sParticleVY, sParticleVZ,
+        sParticleAX, sParticleAY, sParticleAZ, ticks, sParticleCount);
+    vec3_batch_add_with_scale(sParticleX, sParticleY, sParticleZ,
+        sParticleVX, sParticleVY, sParticleVZ, ticks, sParticleCount);
+}
+
+// s and t in texels, for a 32x32 texture
+static void particle_vertex(Vtx *vtx, f32 x, f32 y, f32 z, s32 s, s32 t, u32 color)
+{
+    vtx->v.ob[0] = x;
+    vtx->v.ob[1] = y;
+    vtx->v.ob[2] = z;
+    vtx->v.flag = 0;
+    vtx->v.tc[0] = s << 5;
+    vtx->v.tc[1] = t << 5;
+    vtx->v.cn[0] = color >> 24;
+    vtx->v.cn[1] = color >> 16;
+    vtx->v.cn[2] = color >> 8;
+    vtx->v.cn[3] = color;
+}
+
+/**
+ * Draws the particles as camera facing quads, grouped by emitter: each emitter's
+ * setup list and origin matrix once, then its quads PARTICLE_QUADS_PER_LOAD at a
+ * time. Expects the camera's matrices to be loaded.
+ */
+void particle_draw(Gfx **gdl, Mtx **rspMtxs, Vtx **vtxs)
+{
+    ParticleEmitter *emitter;
+    MtxF mf;
+    Vtx *vtx;
+    f32 rx, ry, rz;
+    f32 ux, uy, uz;
+    f32 x, y, z;
+    f32 size;
+    u32 color;
+    s32 offsets[PARTICLE_MAX_EMITTERS];
+    s32 id;
+    s32 i;
+    s32 k;
+    s32 n;
+    s32 end;
+
+    if (sParticleCount == 0)
+        return;
+
+    // The camera's right and up in world space
+    rx = gViewMtx.m[0][0];
+    ry = gViewMtx.m[1][0];
+    rz = gViewMtx.m[2][0];
+    ux = gViewMtx.m[0][1];
+    uy = gViewMtx.m[1][1];
+    uz = gViewMtx.m[2][1];
+
+    for (id = 0; id < PARTICLE_MAX_EMITTERS; id++)
+        sParticleEmitters[id].count = 0;
+    for (i = 0; i < sParticleCount; i++)
+        sParticleEmitters[sParticleEmitter[i]].count++;
+    n = 0;
+    for (id = 0; id < PARTICLE_MAX_EMITTERS; id++)
+    {
+        offsets[id] = n;
+        n += sParticleEmitters[id].count;
+    }
+    for (i = 0; i < sParticleCount; i++)
+        sParticleOrder[offsets[sParticleEmitter[i]]++] = i;
+
+    k = 0;
+    for (id = 0; id < PARTICLE_MAX_EMITTERS; id++)
+    {
+        emitter = &sParticleEmitters[id];
+        if (emitter->count == 0)
+            continue;
+
+        if (emitter->setup != NULL)
+            gSPDisplayList((*gdl)++, OS_K0_TO_PHYSICAL(emitter->setup));
+        matrix_translation(&mf, emitter->origin.x - gWorldX, emitter->origin.y, emitter->origin.z - gWorldZ);
+        matrix_f2l_4x3(&mf, *rspMtxs);
+        gSPMatrix((*gdl)++, OS_K0_TO_PHYSICAL((*rspMtxs)++), G_MTX_LOAD);
+
+        end = k + emitter->count;
+        while (k < end)
+        {
+            vtx = *vtxs;
+            n = 0;
+            for (; k < end && n < PARTICLE_QUADS_PER_LOAD; k++)
+            {
+                i = sParticleOrder[k];
+                x = sParticleX[i] - emitter->origin.x;
+                y = sParticleY[i] - emitter->origin.y;
+                z = sParticleZ[i] - emitter->origin.z;
+                // Too far from the origin for the vertices
+                if (x > 32000.0f || x < -32000.0f || y > 32000.0f || y < -32000.0f ||
+                    z > 32000.0f || z < -32000.0f)
+                    continue;
+
+                size = sParticleSize[i];
+                color = sParticleColor[i];
+                particle_vertex(&vtx[0], x - (rx + ux) * size, y - (ry + uy) * size, z - (rz + uz) * size, 0, 32, color);
+                particle_vertex(&vtx[1], x + (rx - ux) * size, y + (ry - uy) * size, z + (rz - uz) * size, 32, 32, color);
+                particle_vertex(&vtx[2], x + (rx + ux) * size, y + (ry + uy) * size, z + (rz + uz) * size, 32, 0, color);
+                particle_vertex(&vtx[3], x - (rx - ux) * size, y - (ry - uy) * size, z - (rz - uz) * size, 0, 0, color);
+                vtx += 4;
+                n++;
+            }
+
+            if (n == 0)
+                break;
+
+            gSPVertex((*gdl)++, OS_K0_TO_PHYSICAL(*vtxs), n * 4, 0);
+            for (i = 0; i < n; i++)
+                gSP2Triangles((*gdl)++, i * 4, i * 4 + 1, i * 4 + 2, 0, i * 4, i * 4 + 2, i * 4 + 3, 0);
+            *vtxs = vtx;
+        }
+        k = end;
+    }
+}
+#endif
@@ -1,4 +1,5 @@
 #include "common.h"
+#include "filesystem.h"
 
 #pragma GLOBAL_ASM("asm/nonmatchings/segment_38380/func_80037780.s")
 
@@ -94,13 +95,822 @@ void queue_load_file_region_to_ptr(u32,s32,s32,s32);
 void func_8003A418(s32);
 u32 read_file_8bytes(s32 arg0, s32 arg1, s32 arg2) {
     if (arg2 != 0) {
+#ifdef NON_MATCHING
+        read_file_region_cached(arg0, D_800918B4, arg1, 8);
+#else
         read_file_region(arg0, D_800918B4, arg1, 8);
+#endif
     } else {
         queue_load_file_region_to_ptr(D_800918B4, arg0, arg1, 8);
     }
     return read_le32(D_800918B4);
 }
 
+#ifndef NON_MATCHING
 #pragma GLOBAL_ASM("asm/nonmatchings/segment_38380/inflate.s")
+#endif
 
 #pragma GLOBAL_ASM("asm/nonmatchings/segment_38380/func_8003A534.s")
+
+#ifdef NON_MATCHING
+// DEFLATE decoder that never assumes slack in the output buffer. The input is a
+// buffer that may overlap the output (inflate_buffer), in which case every
+// write is checked against the unread input instead of relying on padding.
+// Codes are decoded with lookup tables from a 32-bit bit buffer, and matches
+// are copied a word at a time where the distance allows. It also stands in for
+// the asm inflate the block and model loads call.
+//
+// A stream starting with INFLATE_LZ_MARKER is in the byte aligned LZ format
+// tools/asset_codec.py writes for assets that should load faster, see inflate_lz.
+
+#define INFLATE_MAX_BITS 15
+#define INFLATE_MAX_LCODES 286
+#define INFLATE_MAX_DCODES 30
+#define INFLATE_FIX_LCODES 288
+#define INFLATE_CODE_CODES 19
+// A DEFLATE block of the reserved type 3, so no DEFLATE stream starts with it
+#define INFLATE_LZ_MARKER 0x06
+#define INFLATE_LZ_MIN_MATCH 4
+
+// Codes are decoded with two level tables: the first root bits index the root
+// table, and codes longer than that continue in a subtable after it. u16 entries:
+// an op in the top 2 bits, then a bit count, then a symbol or subtable offset.
+#define INFLATE_LEN_ROOT 9
+#define INFLATE_DIST_ROOT 6
+#define INFLATE_CODE_ROOT 7
+// Largest tables those roots can need for codes of up to 15 bits, as worked out by zlib's enough
+#define INFLATE_LEN_ENOUGH 852
+#define INFLATE_DIST_ENOUGH 592
+
+#define INFLATE_OP_SYMBOL 0   // Bit count is the whole code's length
+#define INFLATE_OP_LINK 1     // Bit count is the subtable's index bits
+#define INFLATE_OP_INVALID 2  // Not a code, only in incomplete codes
+#define INFLATE_ENTRY(op, bits, val) (((op) << 14) | ((bits) << 10) | (val))
+#define INFLATE_ENTRY_OP(e) ((e) >> 14)
+#define INFLATE_ENTRY_BITS(e) (((e) >> 10) & 0xF)
+#define INFLATE_ENTRY_VAL(e) ((e) & 0x3FF)
+
+typedef struct InflateTable {
+/*0000*/ u16 *entries;
+/*0004*/ s32 root;
+} InflateTable;
+
+typedef struct InflateState {
+/*0000*/ u8 *in;
+/*0004*/ u8 *inEnd;
+/*0008*/ u8 *out;
+/*000C*/ u8 *outStart;
+/*0010*/ u8 *outEnd;
+/*0014*/ u32 bitBuf;
+/*0018*/ s32 bitCount;
+/*001C*/ s8 error;
+/*001D*/ s8 unchecked; // Sizes unknown, see inflate
+} InflateState;
+
+s32 func_with_status_reg(void);
+void set_status_reg(s32);
+
+static const u16 sInflateLenBase[29] = {
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+    35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+static const u8 sInflateLenExtra[29] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+    3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+static const u16 sInflateDistBase[30] = {
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+    257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+};
+static const u8 sInflateDistExtra[30] = {
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+    7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+static const u8 sInflateCodeOrder[19] = {
+    16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15
+};
+
+// Everything below is shared between threads and guarded by sInflateLock
+static u16 sInflateLenEntries[INFLATE_LEN_ENOUGH];
+static u16 sInflateDistEntries[INFLATE_DIST_ENOUGH];
+static u16 sInflateCodeEntries[1 << INFLATE_CODE_ROOT];
+static u16 sInflateFixedLenEntries[1 << INFLATE_LEN_ROOT];
+static u16 sInflateFixedDistEntries[1 << INFLATE_DIST_ROOT];
+static InflateTable sInflateLenCode = { sInflateLenEntries, INFLATE_LEN_ROOT };
+static InflateTable sInflateDistCode = { sInflateDistEntries, INFLATE_DIST_ROOT };
+static InflateTable sInflateCodeCode = { sInflateCodeEntries, INFLATE_CODE_ROOT };
+static InflateTable sInflateFixedLenCode = { sInflateFixedLenEntries, INFLATE_LEN_ROOT };
+static InflateTable sInflateFixedDistCode = { sInflateFixedDistEntries, INFLATE_DIST_ROOT };
+static u8 sInflateLengths[INFLATE_MAX_LCODES + INFLATE_MAX_DCODES];
+static s8 sInflateFixedBuilt;
+
+static OSMesgQueue sInflateLock;
+static OSMesg sInflateLockMesg;
+static s8 sInflateInitialised;
+
+// Accumulated by inflate since inflate_reset_timing, used by the streaming stats
+static OSTime sInflateTotal;
+static u32 sInflateBytesIn;
+
+static void inflate_lock(void)
+{
+    s32 sr;
+
+    sr = func_with_status_reg();
+    if (!sInflateInitialised) {
+        osCreateMesgQueue(&sInflateLock, &sInflateLockMesg, 1);
+        osSendMesg(&sInflateLock, NULL, OS_MESG_NOBLOCK);
+        sInflateInitialised = TRUE;
+    }
+    set_status_reg(sr);
+
+    osRecvMesg(&sInflateLock, NULL, OS_MESG_BLOCK);
+}
+
+static void inflate_unlock(void)
+{
+    osSendMesg(&sInflateLock, NULL, OS_MESG_NOBLOCK);
+}
+
+// Tops the bit buffer up to more than 24 bits. While the input has 4 bytes
+// left they're taken without checks, past that one at a time so the end of the
+// stream only ever leaves the buffer short instead of failing.
+static void inflate_fill(InflateState *s)
+{
+    u32 bitBuf;
+    s32 bitCount;
+    u8 *in;
+
+    bitBuf = s->bitBuf;
+    bitCount = s->bitCount;
+    in = s->in;
+
+    if (s->inEnd - in >= 4) {
+        while (bitCount <= 24) {
+            bitBuf |= (u32)*in++ << bitCount;
+            bitCount += 8;
+        }
+    } else {
+        while (bitCount <= 24 && in != s->inEnd) {
+            bitBuf |= (u32)*in++ << bitCount;
+            bitCount += 8;
+        }
+    }
+
+    s->bitBuf = bitBuf;
+    s->bitCount = bitCount;
+    s->in = in;
+}
+
+static u32 inflate_bits(InflateState *s, s32 need)
+{
+    u32 val;
+
+    if (s->bitCount < need) {
+        inflate_fill(s);
+        if (s->bitCount < need) {
+            s->error = TRUE;
+            return 0;
+        }
+    }
+
+    val = s->bitBuf & ((1 << need) - 1);
+    s->bitBuf >>= need;
+    s->bitCount -= need;
+
+    return val;
+}
+
+// Returns FALSE if writing len bytes would run past the output or over input
+// that has not been consumed yet.
+static s32 inflate_check(InflateState *s, s32 len)
+{
+    u8 *end;
+
+    if (s->unchecked) {
+        return TRUE;
+    }
+
+    end = s->out + len;
+    if (end > s->outEnd || (s->in < s->inEnd && end > s->in && s->out < s->inEnd)) {
+        s->error = TRUE;
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+static s32 inflate_decode(InflateState *s, InflateTable *t)
+{
+    u32 entry;
+    s32 bits;
+
+    if (s->bitCount < INFLATE_MAX_BITS) {
+        inflate_fill(s);
+    }
+
+    entry = t->entries[s->bitBuf & ((1 << t->root) - 1)];
+    if (INFLATE_ENTRY_OP(entry) == INFLATE_OP_LINK) {
+        entry = t->entries[INFLATE_ENTRY_VAL(entry) +
+            ((s->bitBuf >> t->root) & ((1 << INFLATE_ENTRY_BITS(entry)) - 1))];
+    }
+
+    // Also catches a code cut short by the end of the stream
+    bits = INFLATE_ENTRY_BITS(entry);
+    if (INFLATE_ENTRY_OP(entry) != INFLATE_OP_SYMBOL || bits > s->bitCount) {
+        s->error = TRUE;
+        return -1;
+    }
+
+    s->bitBuf >>= bits;
+    s->bitCount -= bits;
+
+    return INFLATE_ENTRY_VAL(entry);
+}
+
+/**
+ * Builds the decode table of the canonical code with the given lengths.
+ * Lengths up to the table's root fill every root entry ending in them, longer
+ * ones go in subtables sized the way zlib's inflate_table sizes them, just big
+ * enough for the codes sharing each root prefix.
+ *
+ * @returns < 0 if the lengths are over-subscribed, 0 for a complete code and
+ * > 0 for an incomplete one.
+ */
+static s32 inflate_table(InflateTable *t, u8 *lengths, s32 n)
+{
+    s16 counts[INFLATE_MAX_BITS + 1];
+    s16 offs[INFLATE_MAX_BITS + 1];
+    s16 sorted[INFLATE_FIX_LCODES];
+    u16 *sub;
+    u16 entry;
+    s32 rootSize;
+    s32 subBits;
+    s32 subLeft;
+    s32 prefix;
+    s32 next;
+    s32 symbol;
+    s32 code;
+    s32 rev;
+    s32 bit;
+    s32 left;
+    s32 max;
+    s32 len;
+    s32 i;
+
+    for (len = 0; len <= INFLATE_MAX_BITS; len++) {
+        counts[len] = 0;
+    }
+    for (symbol = 0; symbol < n; symbol++) {
+        counts[lengths[symbol]]++;
+    }
+
+    rootSize = 1 << t->root;
+    for (i = 0; i < rootSize; i++) {
+        t->entries[i] = INFLATE_ENTRY(INFLATE_OP_INVALID, 0, 0);
+    }
+    if (counts[0] == n) {
+        return 0;
+    }
+
+    left = 1;
+    for (len = 1; len <= INFLATE_MAX_BITS; len++) {
+        left <<= 1;
+        left -= counts[len];
+        if (left < 0) {
+            return left;
+        }
+    }
+
+    offs[1] = 0;
+    for (len = 1; len < INFLATE_MAX_BITS; len++) {
+        offs[len + 1] = offs[len] + counts[len];
+    }
+    for (symbol = 0; symbol < n; symbol++) {
+        if (lengths[symbol] != 0) {
+            sorted[offs[lengths[symbol]]++] = symbol;
+        }
+    }
+
+    max = INFLATE_MAX_BITS;
+    while (counts[max] == 0) {
+        max--;
+    }
+
+    // Codes in canonical order, each one the last plus one, shifted up by length
+    sub = NULL;
+    subBits = 0;
+    prefix = -1;
+    next = rootSize;
+    code = 0;
+    i = 0;
+    for (len = 1; len <= max; len++, code <<= 1) {
+        while (counts[len] != 0) {
+            symbol = sorted[i++];
+
+            // DEFLATE sends codes from their top bit, so tables are indexed bit reversed
+            rev = 0;
+            for (bit = 0; bit < len; bit++) {
+                rev |= ((code >> bit) & 1) << (len - 1 - bit);
+            }
+            entry = INFLATE_ENTRY(INFLATE_OP_SYMBOL, len, symbol);
+
+            if (len <= t->root) {
+                for (; rev < rootSize; rev += 1 << len) {
+                    t->entries[rev] = entry;
+                }
+            } else {
+                if ((rev & (rootSize - 1)) != prefix) {
+                    // Grow the subtable until the codes left at each length no longer fit in it
+                    prefix = rev & (rootSize - 1);
+                    subBits = len - t->root;
+                    subLeft = 1 << subBits;
+                    while (subBits + t->root < max) {
+                        subLeft -= counts[subBits + t->root];
+                        if (subLeft <= 0) {
+                            break;
+                        }
+                        subBits++;
+                        subLeft <<= 1;
+                    }
+
+                    sub = &t->entries[next];
+                    for (bit = 0; bit < (1 << subBits); bit++) {
+                        sub[bit] = INFLATE_ENTRY(INFLATE_OP_INVALID, 0, 0);
+                    }
+                    t->entries[prefix] = INFLATE_ENTRY(INFLATE_OP_LINK, subBits, next);
+                    next += 1 << subBits;
+                }
+
+                for (rev >>= t->root; rev < (1 << subBits); rev += 1 << (len - t->root)) {
+                    sub[rev] = entry;
+                }
+            }
+
+            counts[len]--;
+            code++;
+        }
+    }
+
+    return left;
+}
+
+static void inflate_stored(InflateState *s)
+{
+    s32 len;
+    s32 n;
+    u8 *src;
+
+    // Whole bytes still in the bit buffer are the start of the block
+    s->bitBuf >>= s->bitCount & 7;
+    s->bitCount &= ~7;
+
+    len = inflate_bits(s, 16);
+    n = inflate_bits(s, 16);
+    if (s->error || len != (~n & 0xFFFF)) {
+        s->error = TRUE;
+        return;
+    }
+
+    while (len > 0 && s->bitCount != 0) {
+        if (!inflate_check(s, 1)) {
+            return;
+        }
+        *s->out++ = s->bitBuf;
+        s->bitBuf >>= 8;
+        s->bitCount -= 8;
+        len--;
+    }
+
+    while (len > 0) {
+        if (s->in == s->inEnd) {
+            s->error = TRUE;
+            return;
+        }
+
+        n = s->inEnd - s->in;
+        if (n > len) {
+            n = len;
+        }
+
+        src = s->in;
+        s->in += n;
+        if (!inflate_check(s, n)) {
+            return;
+        }
+
+        len -= n;
+        while (n-- > 0) {
+            *s->out++ = *src++;
+        }
+    }
+}
+
+// A match, a word at a time once the output is aligned if the source is too
+static u8 *inflate_copy(u8 *out, u32 dist, s32 len)
+{
+    u8 *src;
+    u32 word;
+
+    src = out - dist;
+    if (len >= 8) {
+        if (dist >= 4) {
+            while ((u32)out & 3) {
+                *out++ = *src++;
+                len--;
+            }
+            if (((u32)src & 3) == 0) {
+                while (len >= 4) {
+                    *(u32*)out = *(u32*)src;
+                    out += 4;
+                    src += 4;
+                    len -= 4;
+                }
+            }
+        } else if (dist == 1) {
+            // A run of one byte
+            word = *src;
+            while ((u32)out & 3) {
+                *out++ = word;
+                len--;
+            }
+            word |= word << 8;
+            word |= word << 16;
+            while (len >= 4) {
+                *(u32*)out = word;
+                out += 4;
+                len -= 4;
+            }
+            src = out - 1;
+        }
+    }
+
+    while (len-- > 0) {
+        *out++ = *src++;
+    }
+
+    return out;
+}
+
+static void inflate_codes(InflateState *s, InflateTable *lenCode, InflateTable *distCode)
+{
+    s32 symbol;
+    s32 len;
+    u32 dist;
+
+    do {
+        symbol = inflate_decode(s, lenCode);
+        if (symbol < 0) {
+            return;
+        }
+
+        if (symbol < 256) {
+            if (!inflate_check(s, 1)) {
+                return;
+            }
+            *s->out++ = symbol;
+        } else if (symbol > 256) {
+            symbol -= 257;
+            if (symbol >= 29) {
+                s->error = TRUE;
+                return;
+            }
+            len = sInflateLenBase[symbol] + inflate_bits(s, sInflateLenExtra[symbol]);
+
+            symbol = inflate_decode(s, distCode);
+            if (symbol < 0 || symbol >= 30) {
+                s->error = TRUE;
+                return;
+            }
+            dist = sInflateDistBase[symbol] + inflate_bits(s, sInflateDistExtra[symbol]);
+            if (dist > (u32)(s->out - s->outStart) || !inflate_check(s, len)) {
+                s->error = TRUE;
+                return;
+            }
+
+            s->out = inflate_copy(s->out, dist, len);
+            symbol = 0;
+        }
+    } while (symbol != 256 && !s->error);
+}
+
+static void inflate_fixed(InflateState *s)
+{
+    s32 symbol;
+
+    if (!sInflateFixedBuilt) {
+        for (symbol = 0; symbol < 144; symbol++) {
+            sInflateLengths[symbol] = 8;
+        }
+        for (; symbol < 256; symbol++) {
+            sInflateLengths[symbol] = 9;
+        }
+        for (; symbol < 280; symbol++) {
+            sInflateLengths[symbol] = 7;
+        }
+        for (; symbol < INFLATE_FIX_LCODES; symbol++) {
+            sInflateLengths[symbol] = 8;
+        }
+        inflate_table(&sInflateFixedLenCode, sInflateLengths, INFLATE_FIX_LCODES);
+
+        for (symbol = 0; symbol < INFLATE_MAX_DCODES; symbol++) {
+            sInflateLengths[symbol] = 5;
+        }
+        inflate_table(&sInflateFixedDistCode, sInflateLengths, INFLATE_MAX_DCODES);
+
+        sInflateFixedBuilt = TRUE;
+    }
+
+    inflate_codes(s, &sInflateFixedLenCode, &sInflateFixedDistCode);
+}
+
+// Lengths of codes that take part in a code, which inflate_table doesn't count
+static s32 inflate_used(u8 *lengths, s32 n)
+{
+    s32 used;
+
+    used = 0;
+    while (n-- > 0) {
+        if (lengths[n] != 0) {
+            used++;
+        }
+    }
+
+    return used;
+}
+
+static void inflate_dynamic(InflateState *s)
+{
+    s32 nlen;
+    s32 ndist;
+    s32 ncode;
+    s32 index;
+    s32 symbol;
+    s32 len;
+    s32 err;
+
+    nlen = inflate_bits(s, 5) + 257;
+    ndist = inflate_bits(s, 5) + 1;
+    ncode = inflate_bits(s, 4) + 4;
+    if (nlen > INFLATE_MAX_LCODES || ndist > INFLATE_MAX_DCODES) {
+        s->error = TRUE;
+        return;
+    }
+
+    for (index = 0; index < ncode; index++) {
+        sInflateLengths[sInflateCodeOrder[index]] = inflate_bits(s, 3);
+    }
+    for (; index < INFLATE_CODE_CODES; index++) {
+        sInflateLengths[sInflateCodeOrder[index]] = 0;
+    }
+    if (inflate_table(&sInflateCodeCode, sInflateLengths, INFLATE_CODE_CODES) != 0) {
+        s->error = TRUE;
+        return;
+    }
+
+    index = 0;
+    while (index < nlen + ndist) {
+        symbol = inflate_decode(s, &sInflateCodeCode);
+        if (symbol < 0) {
+            return;
+        }
+
+        if (symbol < 16) {
+            sInflateLengths[index++] = symbol;
+            continue;
+        }
+
+        len = 0;
+        if (symbol == 16) {
+            if (index == 0) {
+                s->error = TRUE;
+                return;
+            }
+            len = sInflateLengths[index - 1];
+            symbol = 3 + inflate_bits(s, 2);
+        } else if (symbol == 17) {
+            symbol = 3 + inflate_bits(s, 3);
+        } else {
+            symbol = 11 + inflate_bits(s, 7);
+        }
+
+        if (index + symbol > nlen + ndist) {
+            s->error = TRUE;
+            return;
+        }
+        while (symbol--) {
+            sInflateLengths[index++] = len;
+        }
+    }
+
+    if (sInflateLengths[256] == 0) {
+        s->error = TRUE;
+        return;
+    }
+
+    // Incomplete codes are only allowed for a single length/distance code
+    err = inflate_table(&sInflateLenCode, sInflateLengths, nlen);
+    if (err < 0 || (err > 0 && inflate_used(sInflateLengths, nlen) != 1)) {
+        s->error = TRUE;
+        return;
+    }
+    err = inflate_table(&sInflateDistCode, sInflateLengths + nlen, ndist);
+    if (err < 0 || (err > 0 && inflate_used(sInflateLengths + nlen, ndist) != 1)) {
+        s->error = TRUE;
+        return;
+    }
+
+    inflate_codes(s, &sInflateLenCode, &sInflateDistCode);
+}
+
+static s32 inflate_lz_byte(InflateState *s)
+{
+    if (s->in == s->inEnd) {
+        s->error = TRUE;
+        return 0;
+    }
+
+    return *s->in++;
+}
+
+// A 4 bit length of 15 continues in bytes, added up until one isn't 255
+static s32 inflate_lz_length(InflateState *s, s32 len)
+{
+    s32 b;
+
+    if (len == 15) {
+        do {
+            b = inflate_lz_byte(s);
+            len += b;
+        } while (b == 255 && !s->error);
+    }
+
+    return len;
+}
+
+/**
+ * Decodes the LZ format: after the marker, sequences of a token byte, whose top
+ * 4 bits are a literal count and bottom 4 bits a match length less
+ * INFLATE_LZ_MIN_MATCH, the literals, then the match's u16 little-endian
+ * distance. A distance of 0 ends the stream. No bit unpacking or Huffman
+ * decoding, so it decodes several times faster than DEFLATE for a larger file.
+ */
+static void inflate_lz(InflateState *s)
+{
+    s32 token;
+    s32 len;
+    s32 n;
+    u32 dist;
+    u8 *src;
+
+    s->in++;
+    while (!s->error) {
+        token = inflate_lz_byte(s);
+        len = inflate_lz_length(s, token >> 4);
+
+        // Literals straight from the input
+        while (len > 0) {
+            if (s->in == s->inEnd) {
+                s->error = TRUE;
+                return;
+            }
+
+            n = s->inEnd - s->in;
+            if (n > len) {
+                n = len;
+            }
+
+            src = s->in;
+            s->in += n;
+            if (!inflate_check(s, n)) {
+                return;
+            }
+
+            len -= n;
+            bcopy(src, s->out, n);
+            s->out += n;
+        }
+
+        dist = inflate_lz_byte(s);
+        dist |= inflate_lz_byte(s) << 8;
+        if (dist == 0 || s->error) {
+            break;
+        }
+
+        len = inflate_lz_length(s, token & 0xF) + INFLATE_LZ_MIN_MATCH;
+        if (s->error || dist > (u32)(s->out - s->outStart) || !inflate_check(s, len)) {
+            s->error = TRUE;
+            return;
+        }
+
+        s->out = inflate_copy(s->out, dist, len);
+    }
+}
+
+static s32 inflate_run(InflateState *s)
+{
+    s32 last;
+
+    // Assets tools/asset_codec.py recompressed
+    if (s->in < s->inEnd && *s->in == INFLATE_LZ_MARKER) {
+        inflate_lz(s);
+    } else {
+        do {
+            last = inflate_bits(s, 1);
+            switch (inflate_bits(s, 2)) {
+                case 0:
+                    inflate_stored(s);
+                    break;
+                case 1:
+                    inflate_fixed(s);
+                    break;
+                case 2:
+                    inflate_dynamic(s);
+                    break;
+                default:
+                    s->error = TRUE;
+                    break;
+            }
+        } while (!last && !s->error);
+    }
+
+    if (s->error) {
+        return -1;
+    }
+
+    return s->out - s->outStart;
+}
+
+/**
+ * Inflates a raw DEFLATE stream from src into dst.
+ *
+ * The buffers may overlap (e.g. compressed data loaded into the tail of the
+ * output buffer). Instead of relying on padding, each write is checked against
+ * the unread input and the call fails if it would clobber it.
+ *
+ * Returns the number of bytes written, or -1 on a corrupt stream/overrun.
+ */
+s32 inflate_buffer(u8 *src, s32 srcSize, u8 *dst, s32 dstSize)
+{
+    InflateState s;
+    s32 ret;
+
+    bzero(&s, sizeof(InflateState));
+    s.in = src;
+    s.inEnd = src + srcSize;
+    s.out = dst;
+    s.outStart = dst;
+    s.outEnd = dst + dstSize;
+
+    inflate_lock();
+    ret = inflate_run(&s);
+    inflate_unlock();
+
+    return ret;
+}
+
+/**
+ * Replaces the asm inflate, which the block and model loads call on compressed
+ * data they loaded into the tail of the output buffer. It isn't given either
+ * size, so like the asm it doesn't check writes: the loads leave enough room
+ * past the output that it never reaches input that hasn't been read yet.
+ */
+void inflate(void *src, void *dest)
+{
+    InflateState s;
+    OSTime start;
+
+    bzero(&s, sizeof(InflateState));
+    s.in = src;
+    s.inEnd = (u8*)-1;
+    s.out = dest;
+    s.outStart = dest;
+    s.outEnd = (u8*)-1;
+    s.unchecked = TRUE;
+
+    inflate_lock();
+    start = osGetTime();
+
+    inflate_run(&s);
+
+    sInflateTotal += osGetTime() - start;
+    sInflateBytesIn += s.in - (u8*)src;
+    inflate_unlock();
+}
+
+void inflate_reset_timing(void)
+{
+    sInflateTotal = 0;
+    sInflateBytesIn = 0;
+}
+
+/**
+ * Reports the time inflate spent decoding and the compressed bytes it read
+ * since inflate_reset_timing.
+ */
+void inflate_get_timing(OSTime *total, u32 *bytesIn)
+{
+    *total = sInflateTotal;
+    *bytesIn = sInflateBytesIn;
+}
+#endif
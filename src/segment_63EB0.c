@@ -15,6 +15,195 @@ extern DLDebugInfo *gDLDebugInfos[2]; // There are two sets of 128 infos each.
 extern u32 gDLDebugInfoIdx;
 extern s32 gDLDebugInfoLengths[2];
 
+void dummied_print_func(const char *fmt, ...);
+
+#ifdef NON_MATCHING
+// Power of two, at least twice MAX_DL_DEBUG_INFO_LENGTH
+#define DL_DEBUG_INFO_HASH_SIZE 256
+#define DL_DEBUG_INFO_HASH(gdl) ((((u32)(gdl) >> 3) * 0x9E3779B1) >> 24)
+
+// Index + 1 of the first info of each gdl in the set, 0 for an empty slot
+static s16 sDLDebugInfoHash[2][DL_DEBUG_INFO_HASH_SIZE];
+
+static void dl_debug_info_hash_insert(s32 set, Gfx *gdl, s32 index)
+{
+    u32 slot = DL_DEBUG_INFO_HASH(gdl);
+
+    while (sDLDebugInfoHash[set][slot] != 0)
+    {
+        // An earlier info for the same gdl wins, like the linear search
+        if (gDLDebugInfos[set][sDLDebugInfoHash[set][slot] - 1].gdl == gdl) {
+            return;
+        }
+        slot = (slot + 1) & (DL_DEBUG_INFO_HASH_SIZE - 1);
+    }
+
+    sDLDebugInfoHash[set][slot] = index + 1;
+}
+
+static DLDebugInfo *dl_debug_info_find(s32 set, Gfx *gdl)
+{
+    u32 slot = DL_DEBUG_INFO_HASH(gdl);
+    DLDebugInfo *info;
+
+    if (gDLDebugInfos[set] == NULL) {
+        return NULL;
+    }
+
+    while (sDLDebugInfoHash[set][slot] != 0)
+    {
+        info = &gDLDebugInfos[set][sDLDebugInfoHash[set][slot] - 1];
+        if (info->gdl == gdl) {
+            return info;
+        }
+        slot = (slot + 1) & (DL_DEBUG_INFO_HASH_SIZE - 1);
+    }
+
+    return NULL;
+}
+
+// Bytes of display list each DLTag produced last frame
+u32 gDLTagBytes[DL_TAG_COUNT];
+
+typedef struct
+{
+/*0000*/    Gfx *start;
+/*0004*/    char *file; // From dl_add_debug_info, NULL if none
+/*0008*/    u8 tag;
+/*000C*/    Gfx *end;   // Where the range was closed, which a chunk branch moves away from the next start
+} DLTagRange;
+
+static DLTagRange sDLTagRanges[2][DL_TAG_MAX_RANGES];
+static s32 sDLTagRangeCounts[2];
+static s32 sDLTagSet;
+static u32 sDLTagBytes[DL_TAG_COUNT];
+static Gfx *sDLTagStart;
+static char *sDLTagFile;
+static s8 sDLTag = -1;
+// The open tag's range, NULL if the set was full
+static DLTagRange *sDLTagRange;
+
+static void dl_tag_close(Gfx *gdl)
+{
+    if (sDLTag >= 0) {
+        sDLTagBytes[sDLTag] += (u8 *)gdl - (u8 *)sDLTagStart;
+    }
+    if (sDLTagRange != NULL) {
+        sDLTagRange->end = gdl;
+        sDLTagRange = NULL;
+    }
+}
+
+static void dl_tag_open(Gfx *gdl, s32 tag, char *file)
+{
+    DLTagRange *range;
+
+    sDLTag = tag;
+    sDLTagStart = gdl;
+    sDLTagFile = file;
+
+    if (sDLTagRangeCounts[sDLTagSet] < DL_TAG_MAX_RANGES)
+    {
+        range = &sDLTagRanges[sDLTagSet][sDLTagRangeCounts[sDLTagSet]++];
+        range->start = gdl;
+        range->file = file;
+        range->tag = tag;
+        range->end = gdl;
+        sDLTagRange = range;
+    }
+}
+
+/**
+ * Attributes everything written to the display list from gdl on to tag, until
+ * the next dl_tag. This is only an add and a few stores, so it stays on outside
+ * of debug builds too.
+ */
+void dl_tag(Gfx *gdl, s32 tag, char *file)
+{
+    dl_tag_close(gdl);
+    dl_tag_open(gdl, tag, file);
+}
+
+/**
+ * Carries the open tag over to a chunk the display list branched to.
+ */
+void dl_tag_continue(Gfx *from, Gfx *to)
+{
+    if (sDLTag >= 0)
+    {
+        dl_tag_close(from);
+        dl_tag_open(to, sDLTag, sDLTagFile);
+    }
+}
+
+/**
+ * Closes the frame's last tag at gdl, the end of its display list, and publishes
+ * the frame's counts in gDLTagBytes.
+ */
+void dl_tag_end_frame(Gfx *gdl)
+{
+    s32 i;
+
+    dl_tag_close(gdl);
+    sDLTag = -1;
+
+    for (i = 0; i < DL_TAG_COUNT; i++)
+    {
+        gDLTagBytes[i] = sDLTagBytes[i];
+        sDLTagBytes[i] = 0;
+    }
+
+    sDLTagSet ^= 1;
+    sDLTagRangeCounts[sDLTagSet] = 0;
+}
+
+/**
+ * Gets the index-th tagged range of the last finished frame's display list, in
+ * the order they were written. Returns FALSE once index is past the last one.
+ */
+s32 dl_tag_get_range(s32 index, Gfx **start, Gfx **end, s32 *tag)
+{
+    DLTagRange *range;
+
+    if (index < 0 || index >= sDLTagRangeCounts[sDLTagSet ^ 1]) {
+        return FALSE;
+    }
+
+    range = &sDLTagRanges[sDLTagSet ^ 1][index];
+    *start = range->start;
+    *end = range->end;
+    *tag = range->tag;
+    return TRUE;
+}
+
+void dbg_dl_tags_print(void)
+{
+    DLTagRange *ranges;
+    Gfx *end;
+    u32 bytes;
+    s32 count;
+    s32 i;
+
+    dummied_print_func("dl setup %d world %d dll %d sub %d overlay %d finish %d (gfx)\n",
+        gDLTagBytes[DL_TAG_SETUP] / sizeof(Gfx), gDLTagBytes[DL_TAG_WORLD] / sizeof(Gfx),
+        gDLTagBytes[DL_TAG_DLL] / sizeof(Gfx), gDLTagBytes[DL_TAG_SUBTITLES] / sizeof(Gfx),
+        gDLTagBytes[DL_TAG_OVERLAYS] / sizeof(Gfx), gDLTagBytes[DL_TAG_FINISH] / sizeof(Gfx));
+
+    // The last finished frame's ranges
+    ranges = sDLTagRanges[sDLTagSet ^ 1];
+    count = sDLTagRangeCounts[sDLTagSet ^ 1];
+    for (i = 0; i < count; i++)
+    {
+        if (ranges[i].file == NULL) {
+            continue;
+        }
+        end = ranges[i].end;
+        bytes = (u8 *)end - (u8 *)ranges[i].start;
+        dummied_print_func("dl %s: %d gfx\n", ranges[i].file, bytes / sizeof(Gfx));
+    }
+}
+#endif
+
 void dl_init_debug_infos()
 {
     gDLDebugInfos[0] = malloc(MAX_DL_DEBUG_INFO_LENGTH * sizeof(DLDebugInfo), 0xffffff, NULL);
@@ -25,6 +214,9 @@ void dl_next_debug_info_set()
 {
     gDLDebugInfoIdx = 1 - gDLDebugInfoIdx;
     gDLDebugInfoLengths[gDLDebugInfoIdx] = 0;
+#ifdef NON_MATCHING
+    bzero(sDLDebugInfoHash[gDLDebugInfoIdx], sizeof(sDLDebugInfoHash[0]));
+#endif
 }
 
 void dl_add_debug_info(Gfx *gdl, u32 param_2, char *file, u32 param_4)
@@ -36,10 +228,19 @@ void dl_add_debug_info(Gfx *gdl, u32 param_2, char *file, u32 param_4)
         gDLDebugInfos[gDLDebugInfoIdx][gDLDebugInfoLengths[gDLDebugInfoIdx]].file = file;
         gDLDebugInfos[gDLDebugInfoIdx][gDLDebugInfoLengths[gDLDebugInfoIdx]].unk_0xc = param_4;
         gDLDebugInfos[gDLDebugInfoIdx][gDLDebugInfoLengths[gDLDebugInfoIdx]].unk_0x10 = -1;
+#ifdef NON_MATCHING
+        dl_debug_info_hash_insert(gDLDebugInfoIdx, gdl, gDLDebugInfoLengths[gDLDebugInfoIdx]);
+#endif
         gDLDebugInfoLengths[gDLDebugInfoIdx]++;
     }
+
+#ifdef NON_MATCHING
+    // Whatever follows is the file's, under the tag that is open
+    dl_tag(gdl, sDLTag >= 0 ? sDLTag : DL_TAG_SETUP, file);
+#endif
 }
 
+#ifndef NON_MATCHING
 #if 1
 #pragma GLOBAL_ASM("asm/nonmatchings/segment_63EB0/dl_get_debug_info_for_gdl.s")
 #else
@@ -74,5 +275,23 @@ void _dl_get_debug_info_for_gdl(Gfx *gdl, char **file, u32 *param_3, u32 *param_
     }
 }
 #endif
+#else
+void dl_get_debug_info_for_gdl(Gfx *gdl, char **file, u32 *param_3, u32 *param_4)
+{
+    DLDebugInfo *info;
+
+    *file = NULL;
+
+    info = dl_debug_info_find(gDLDebugInfoIdx, gdl);
+    if (info == NULL) {
+        info = dl_debug_info_find(1 - gDLDebugInfoIdx, gdl);
+    }
+    if (info != NULL) {
+        *file = info->file;
+        *param_3 = info->unk_0xc;
+        *param_4 = info->unk_0x4;
+    }
+}
+#endif
 
 #pragma GLOBAL_ASM("asm/nonmatchings/segment_63EB0/dl_get_debug_info2.s")
@@ -1,5 +1,6 @@
 #include "common.h"
 #include "queue.h"
+#include "memory.h"
 #include "video.h"
 
 // Definitely something like rand_i2
@@ -31,6 +32,247 @@ s32 queue_load_texture_proxy(s32 param) {
 #pragma GLOBAL_ASM("asm/nonmatchings/texture/texture_load.s")
 
 void load_texture_to_tmem2(Gfx **gdl, Texture *texture, u32 tile, u32 tmem, u32 palette);
+
+#ifdef NON_MATCHING
+// Smaller textures aren't worth looking at every pixel of
+#define TEXTURE_TRANSCODE_MIN_PIXELS 1024
+
+void dummied_print_func(const char *fmt, ...);
+
+s8 gTextureTranscode = TEXTURE_TRANSCODE_OFF;
+TextureTranscodeStats gTextureTranscodeStats;
+
+/**
+ * Textures are stored for gDPLoadBlock without dxt, so each odd row has the two
+ * words of every 64-bit word swapped the way TMEM wants them.
+ *
+ * @returns Where pixel x of row y is, in pixels from the start of the data.
+ */
+static s32 texture_texel_index(s32 width, s32 x, s32 y, s32 bits)
+{
+    if (y & 1) {
+        x ^= 32 / bits;
+    }
+
+    return y * width + x;
+}
+
+// The RDP widens 5-bit channels by repeating their top bits
+#define TEXEL_5_TO_8(v) (((v) << 3) | ((v) >> 2))
+
+/**
+ * @returns How many colors the pixels use, or 17 for more than 16, with the
+ * first 16 of them in palette. grey is cleared unless they are all opaque greys.
+ */
+static s32 texture_rgba16_palette(u16 *texels, s32 count, u16 *palette, s32 *grey)
+{
+    s32 colors;
+    s32 i;
+    s32 j;
+    u16 c;
+
+    colors = 0;
+    *grey = TRUE;
+    for (i = 0; i < count; i++)
+    {
+        c = texels[i];
+        if (*grey && (!(c & 1) || ((c >> 11) & 0x1f) != ((c >> 6) & 0x1f) || ((c >> 11) & 0x1f) != ((c >> 1) & 0x1f))) {
+            *grey = FALSE;
+        }
+
+        if (colors > 16) {
+            if (!*grey) {
+                break;
+            }
+            continue;
+        }
+
+        for (j = 0; j < colors; j++)
+        {
+            if (palette[j] == c) {
+                break;
+            }
+        }
+        if (j == colors && colors++ < 16) {
+            palette[j] = c;
+        }
+    }
+
+    return colors;
+}
+
+/**
+ * Whether an RGBA32 texture would fit in CI4 or I8 without losing anything:
+ * 16 or fewer colors that are exact in RGBA16, or only opaque greys.
+ */
+static s32 texture_rgba32_fits(u32 *texels, s32 count)
+{
+    u32 palette[16];
+    s32 colors;
+    s32 exact;
+    s32 grey;
+    s32 i;
+    s32 j;
+    u32 c;
+
+    colors = 0;
+    exact = TRUE;
+    grey = TRUE;
+    for (i = 0; i < count && (grey || (exact && colors <= 16)); i++)
+    {
+        c = texels[i];
+        if ((c & 0xff) != 0xff || (c >> 24) != ((c >> 16) & 0xff) || (c >> 24) != ((c >> 8) & 0xff)) {
+            grey = FALSE;
+        }
+        if ((c & 0x07070700) != 0 || ((c & 0xff) != 0 && (c & 0xff) != 0xff)) {
+            exact = FALSE;
+        }
+
+        for (j = 0; j < colors && j < 16; j++)
+        {
+            if (palette[j] == c) {
+                break;
+            }
+        }
+        if (j == colors && colors++ < 16) {
+            palette[j] = c;
+        }
+    }
+
+    return grey || (exact && colors <= 16);
+}
+
+/**
+ * Rewrites a large RGBA16 texture in place as CI4 if it has 16 colors or fewer,
+ * or as I8 if it only has opaque greys, for a quarter or half the TMEM load
+ * and texel fetches. Nothing is lost either way. RGBA32 textures that could
+ * be are only counted.
+ *
+ * Called by load_texture_to_tmem, before the texture's load list is built.
+ */
+static void texture_transcode(Texture *texture)
+{
+    u16 palette[16];
+    u16 *src;
+    u8 *dst;
+    s32 width;
+    s32 height;
+    s32 colors;
+    s32 grey;
+    s32 x;
+    s32 y;
+    u16 c;
+    u8 lo;
+    u8 hi;
+
+    // Same exclusions as atlases, these build loads of their own
+    if ((texture->flags & (0xc000 | 0x100 | 0x40)) || texture->levels != 0 || texture->next != NULL) {
+        return;
+    }
+
+    width = texture->width | (texture->unk_0x1b & 0xf0) << 4;
+    height = texture->height | (texture->unk_0x1b & 0xf) << 8;
+    if (width * height < TEXTURE_TRANSCODE_MIN_PIXELS) {
+        return;
+    }
+
+    src = (u16*)((u8*)texture + sizeof(Texture));
+    gTextureTranscodeStats.seen++;
+
+    if ((texture->format & 0xf) == 0)
+    {
+        if (texture_rgba32_fits((u32*)src, width * height)) {
+            gTextureTranscodeStats.rgba32++;
+        }
+        return;
+    }
+
+    if ((texture->format & 0xf) != 1) {
+        return;
+    }
+
+    colors = texture_rgba16_palette(src, width * height, palette, &grey);
+    dst = (u8*)src;
+
+    // CI4 rows must be whole TMEM words
+    if (colors <= 16 && (width & 0xf) == 0)
+    {
+        gTextureTranscodeStats.ci4++;
+        gTextureTranscodeStats.bytesSaved += width * height * 2 - (width * height / 2 + sizeof(palette));
+        if (gTextureTranscode != TEXTURE_TRANSCODE_ON) {
+            return;
+        }
+
+        // Both texels of a byte are read before it's written, and writes never
+        // get ahead of reads, so this can go in place
+        for (y = 0; y < height; y++)
+        {
+            for (x = 0; x < width; x += 2)
+            {
+                c = src[texture_texel_index(width, x, y, 16)];
+                for (hi = 0; palette[hi] != c; hi++) {}
+                c = src[texture_texel_index(width, x + 1, y, 16)];
+                for (lo = 0; palette[lo] != c; lo++) {}
+                dst[texture_texel_index(width, x, y, 4) / 2] = (hi << 4) | lo;
+            }
+        }
+
+        // The TLUT goes right after the texels, where load_texture_to_tmem2 loads it from
+        bcopy(palette, dst + width * height / 2, sizeof(palette));
+        texture->format = (texture->format & 0xf0) | 7;
+        osWritebackDCache(dst, width * height / 2 + sizeof(palette));
+    }
+    else if (grey && (width & 0x7) == 0)
+    {
+        gTextureTranscodeStats.i8++;
+        gTextureTranscodeStats.bytesSaved += width * height;
+        if (gTextureTranscode != TEXTURE_TRANSCODE_ON) {
+            return;
+        }
+
+        for (y = 0; y < height; y++)
+        {
+            for (x = 0; x < width; x++)
+            {
+                c = (src[texture_texel_index(width, x, y, 16)] >> 11) & 0x1f;
+                dst[texture_texel_index(width, x, y, 8)] = TEXEL_5_TO_8(c);
+            }
+        }
+
+        texture->format = (texture->format & 0xf0) | 2;
+        osWritebackDCache(dst, width * height);
+    }
+    else
+    {
+        return;
+    }
+
+    // load_texture_to_tmem2 marks RGBA textures like this by their format, which is gone now
+    if ((texture->format >> 4) == 0 || (texture->format >> 4) == 2) {
+        texture->flags |= 0x4;
+    }
+}
+
+void dbg_texture_transcode_print(void)
+{
+    dummied_print_func("transcode: %d large textures, %d fit CI4 %d fit I8 %d RGBA32 could, %d KB of TMEM loads %s\n",
+        gTextureTranscodeStats.seen,
+        gTextureTranscodeStats.ci4,
+        gTextureTranscodeStats.i8,
+        gTextureTranscodeStats.rgba32,
+        gTextureTranscodeStats.bytesSaved / 1024,
+        gTextureTranscode == TEXTURE_TRANSCODE_ON ? "saved" : "to save");
+}
+#endif
+
+/**
+ * Builds the texture's load list into gdl, once, when the texture is loaded.
+ * Draws only branch to it from set_textures_on_gdl.
+ *
+ * The list loads the texture into tile 0 at TMEM 0, or tile 1 at 0x100 for
+ * 0x8000 textures. Textures with flag 0x40 follow that, from gdlIdx on, with a
+ * second load into tile 1 that set_textures_on_gdl can branch to by itself.
+ */
 Gfx *load_texture_to_tmem(Texture *texture, Gfx *gdl)
 {
     Gfx *mygdl;
@@ -40,6 +282,12 @@ Gfx *load_texture_to_tmem(Texture *texture, Gfx *gdl)
     mygdl = gdl;
     texture->gdl = gdl;
 
+#ifdef NON_MATCHING
+    if (gTextureTranscode != TEXTURE_TRANSCODE_OFF) {
+        texture_transcode(texture);
+    }
+#endif
+
     if (texture->flags & 0x8000) {
         tile = 1;
         tmem = 0x100;
@@ -524,6 +772,48 @@ void func_8003EBD4(s32 hOffset) {
  * NOTE: Please see the note in the implementation, this function also reads 
  * undefined stack memory, which affects the copied values.
  */
+#ifdef NON_MATCHING
+// Stands in for the stack buffer, which still held the previous line's result on
+// each call from func_8003EBD4, so every line is blended with the one above it
+static u16 sResizeLine[644];
+
+void weird_resize_copy(u16 *src, s32 srcWidth, s32 destWidth, u16 *dest) {
+    u16 *line;
+    s32 step;
+    s32 frac;
+    s32 acc;
+    u16 value;
+    s32 i;
+
+    if (destWidth <= 0) {
+        return;
+    }
+    if (destWidth > (s32)(sizeof(sResizeLine) / sizeof(u16))) {
+        destWidth = sizeof(sResizeLine) / sizeof(u16);
+    }
+
+    // Same stepping as below, with the division hoisted and at most one carry per pixel
+    step = srcWidth / destWidth;
+    frac = srcWidth % destWidth;
+    acc = 0;
+    line = sResizeLine;
+    dest += destWidth;
+
+    for (i = 0; i < destWidth; i++)
+    {
+        value = ((*src & -0x843) >> 1) + ((*line & -0x843) >> 1);
+        *line++ = value;
+        *dest++ = value;
+
+        acc += frac;
+        if (acc > destWidth) {
+            acc -= destWidth;
+            src++;
+        }
+        src += step;
+    }
+}
+#else
 void weird_resize_copy(u16 *src, s32 srcWidth, s32 destWidth, u16 *dest) {
     u16 buffer[644];
 
@@ -553,6 +843,7 @@ void weird_resize_copy(u16 *src, s32 srcWidth, s32 destWidth, u16 *dest) {
     _bcopy(&buffer[0], destWidth + dest, destWidth << 1);
 }
 #endif
+#endif
 
 #pragma GLOBAL_ASM("asm/nonmatchings/texture/func_8003F2C4.s")
 
@@ -115,3 +115,35 @@ void vec3_reflect(Vec3f *v1, Vec3f *v2, Vec3f *result) {
     result->y = v2->y + result->y;
     result->z = v2->z + result->z;
 }
+
+#ifdef NON_MATCHING
+/**
+ * Adds v * scale to count points, with both stored as separate x, y and z arrays.
+ * 
+ * p = p + (scale * v)
+ */
+void vec3_batch_add_with_scale(f32 *x, f32 *y, f32 *z, f32 *vx, f32 *vy, f32 *vz, f32 scale, s32 count) {
+    s32 i;
+
+    for (i = 0; i + 3 < count; i += 4) {
+        x[i] += scale * vx[i];
+        y[i] += scale * vy[i];
+        z[i] += scale * vz[i];
+        x[i + 1] += scale * vx[i + 1];
+        y[i + 1] += scale * vy[i + 1];
+        z[i + 1] += scale * vz[i + 1];
+        x[i + 2] += scale * vx[i + 2];
+        y[i + 2] += scale * vy[i + 2];
+        z[i + 2] += scale * vz[i + 2];
+        x[i + 3] += scale * vx[i + 3];
+        y[i + 3] += scale * vy[i + 3];
+        z[i + 3] += scale * vz[i + 3];
+    }
+
+    for (; i < count; i++) {
+        x[i] += scale * vx[i];
+        y[i] += scale * vy[i];
+        z[i] += scale * vz[i];
+    }
+}
+#endif
@@ -1,5 +1,7 @@
 #include "common.h"
 #include "video.h"
+#include "memory.h"
+#include "scheduler.h"
 
 // func_8005BC38 is from segment_5C470
 /**
@@ -261,6 +263,31 @@ OSMesgQueue *get_addr_of_OSMesgQueue_8005D670() {
 }
 #endif
 
+#ifdef NON_MATCHING
+// Width frames are drawn at while dynamic resolution is on, 0 while it is off
+static u32 sDynResWidth;
+// Width of the framebuffer last swapped on screen, 0 if it is the full width
+static u32 sDynResShownWidth;
+
+/**
+ * Narrows the VI mode to scan out sDynResShownWidth pixels a line and stretch
+ * them back over the full picture.
+ */
+static void dynres_scale_vi_mode(OSViMode *mode)
+{
+    u32 full = mode->comRegs.width;
+    u32 width = sDynResShownWidth;
+
+    if (width == 0 || width >= full)
+        return;
+
+    mode->comRegs.xScale = (mode->comRegs.xScale & ~0xFFF) | ((mode->comRegs.xScale & 0xFFF) * width / full);
+    mode->fldRegs[0].origin = mode->fldRegs[0].origin * width / full;
+    mode->fldRegs[1].origin = mode->fldRegs[1].origin * width / full;
+    mode->comRegs.width = width;
+}
+#endif
+
 #if 0
 #pragma GLOBAL_ASM("asm/nonmatchings/video/set_current_resolution_from_video_mode.s")
 #else
@@ -275,6 +302,10 @@ void set_current_resolution_from_video_mode(int framebufferIndex) {
     //       2 integers, which are likely for each framebuffer.
     gCurrentResolutionH[framebufferIndex] = gResolutionArray[gVideoMode & 7].h;
     gCurrentResolutionV[framebufferIndex] = gResolutionArray[gVideoMode & 7].v;
+#ifdef NON_MATCHING
+    if (sDynResWidth != 0)
+        gCurrentResolutionH[framebufferIndex] = sDynResWidth;
+#endif
 }
 #endif
 
@@ -367,6 +398,9 @@ void set_custom_vi_mode() {
     gOSViModeCustom.fldRegs[1].vStart += gVScaleMod * 0x2;
     gOSViModeCustom.comRegs.hStart += gHStartMod * 0x20000;
     gOSViModeCustom.comRegs.hStart += gHStartMod * 0x2;
+#ifdef NON_MATCHING
+    dynres_scale_vi_mode(&gOSViModeCustom);
+#endif
 
     // Use the custom VI mode and set some special features
     osViSetMode(&gOSViModeCustom);
@@ -466,6 +500,133 @@ s32 func_8005DC7C() {
 }
 #endif
 
+#ifdef NON_MATCHING
+// Pixels the render width moves by at a time, a multiple of 4 keeps lines 8 byte aligned
+#define DYNRES_STEP 16
+#define DYNRES_MIN_WIDTH 192
+// Frames of RDP time averaged for each decision
+#define DYNRES_SAMPLES 4
+// Frames in a row that must have room to spare before the width steps back up
+#define DYNRES_RAISE_FRAMES 30
+// Frames to wait after a step until the frames measured are drawn at the new width,
+// one for the buffer already being drawn and one for the frame the RDP is finishing
+#define DYNRES_SETTLE_FRAMES (DYNRES_SAMPLES + 2)
+
+// RDP time per frame the width is kept under, in osGetCount ticks, 0 while off
+static u32 sDynResBudget;
+static u8 sDynResCalm;
+static u8 sDynResSettle;
+
+/**
+ * Turns dynamic resolution on or off. While it is on, video_dynamic_resolution_tick
+ * narrows the width frames are drawn at whenever the RDP takes longer than
+ * budgetUsec a frame, and the VI stretches them back over the whole screen.
+ */
+void video_set_dynamic_resolution(s32 enable, u32 budgetUsec)
+{
+    if (enable)
+    {
+        sDynResBudget = OS_USEC_TO_CYCLES(budgetUsec);
+        if (sDynResWidth == 0)
+            sDynResWidth = gResolutionArray[gVideoMode & 7].h;
+    }
+    else
+    {
+        // The next swap puts the full width back, and the VI follows once it is shown
+        sDynResBudget = 0;
+        sDynResWidth = 0;
+    }
+
+    sDynResCalm = 0;
+    sDynResSettle = DYNRES_SETTLE_FRAMES;
+}
+
+/**
+ * Picks the width the next frame is drawn at from the RDP times the scheduler
+ * measured. Steps down as soon as the budget is exceeded, but only steps back up
+ * once the wider frame is expected to fit with an eighth of the budget to spare.
+ */
+void video_dynamic_resolution_tick(void)
+{
+    SchedFrameTimes times;
+    u32 full;
+    u32 width;
+    u32 rdp;
+    s32 i;
+
+    if (sDynResBudget == 0)
+        return;
+
+    full = gResolutionArray[gVideoMode & 7].h;
+    width = sDynResWidth;
+    if (width > full || full <= DYNRES_MIN_WIDTH)
+        width = full;
+
+    if (sDynResSettle != 0)
+    {
+        sDynResSettle--;
+        sDynResWidth = width;
+        return;
+    }
+
+    rdp = 0;
+    for (i = 0; i < DYNRES_SAMPLES; i++)
+    {
+        if (!sched_get_frame_times(i, &times))
+            return;
+        rdp += times.rdp;
+    }
+    rdp /= DYNRES_SAMPLES;
+
+    if (rdp > sDynResBudget)
+    {
+        sDynResCalm = 0;
+        if (width > DYNRES_MIN_WIDTH)
+        {
+            width -= DYNRES_STEP;
+            sDynResSettle = DYNRES_SETTLE_FRAMES;
+        }
+    }
+    else if (width < full && rdp * (width + DYNRES_STEP) / width < sDynResBudget - (sDynResBudget >> 3))
+    {
+        if (++sDynResCalm >= DYNRES_RAISE_FRAMES)
+        {
+            sDynResCalm = 0;
+            width += DYNRES_STEP;
+            sDynResSettle = DYNRES_SETTLE_FRAMES;
+        }
+    }
+    else
+    {
+        sDynResCalm = 0;
+    }
+
+    sDynResWidth = width;
+}
+
+/**
+ * Gives the buffer about to be drawn the current render width, and has the VI
+ * rescaled if the buffer going on screen was drawn at a different width than the
+ * last one.
+ */
+static void dynres_swap(void)
+{
+    u32 full = gResolutionArray[gVideoMode & 7].h;
+    u32 shown = gCurrentResolutionH[gFramebufferChoice ^ 1];
+
+    if (shown >= full)
+        shown = 0;
+
+    if (shown != sDynResShownWidth)
+    {
+        sDynResShownWidth = shown;
+        modify_vi_mode(1, gHStartMod, gVScaleMod);
+    }
+
+    gCurrentResolutionH[gFramebufferChoice] = sDynResWidth != 0 ? sDynResWidth : full;
+}
+#endif
+
 #if 0
 #pragma GLOBAL_ASM("asm/nonmatchings/video/swap_framebuffer_pointers.s")
 #else
@@ -488,6 +649,10 @@ void swap_framebuffer_pointers() {
     //   1 ^ 1 = 0
     gFramebufferChoice = gFramebufferChoice ^ 1;
 
+#ifdef NON_MATCHING
+    dynres_swap();
+#endif
+
     // Set next framebuffer to the swapped index
     gFramebufferNext = gFramebufferPointers[gFramebufferChoice];
 
@@ -648,6 +813,9 @@ void modify_vi_mode(u8 a0, s8 hStartMod, s8 vScaleMod) {
     gOSViModeCustom.fldRegs[1].vStart += gVScaleMod * 0x2;
     gOSViModeCustom.comRegs.hStart += gHStartMod * 0x20000;
     gOSViModeCustom.comRegs.hStart += gHStartMod * 0x2;
+#ifdef NON_MATCHING
+    dynres_scale_vi_mode(&gOSViModeCustom);
+#endif
 
     D_80093060 = 3;
 }
@@ -182,4 +182,21 @@ s32 get_video_mode();
  */
 u32 get_some_resolution_encoded();
 
+/**
+ * Sets up gOSViModeCustom for the current video mode with the given offsets.
+ * If a0 is 0, only the offsets are stored.
+ */
+void modify_vi_mode(u8 a0, s8 hStartMod, s8 vScaleMod);
+
+/**
+ * Turns dynamic resolution on or off. While it is on, frames are drawn narrower
+ * whenever the RDP takes longer than budgetUsec a frame.
+ */
+void video_set_dynamic_resolution(s32 enable, u32 budgetUsec);
+
+/**
+ * Picks the width the next frame is drawn at, call once a frame.
+ */
+void video_dynamic_resolution_tick(void);
+
 #endif
@@ -1,15 +1,25 @@
 #!/usr/bin/env python3
 import sys
 import os
+import re
 import shlex
+import shutil
+import hashlib
 import subprocess
 import tempfile
-import asm_processor
 
 dir_path = os.path.dirname(os.path.realpath(__file__))
 prelude = os.path.join(dir_path, "prelude.inc")
 
 all_args = sys.argv[1:]
+
+# --cache DIR keeps every object built by its inputs' contents, so a rebuild of
+# a file whose source, headers and GLOBAL_ASM files are all unchanged is a copy
+cache_dir = None
+if all_args[:1] == ['--cache']:
+    cache_dir = all_args[1] or None
+    all_args = all_args[2:]
+
 sep1 = all_args.index('--')
 sep2 = all_args.index('--', sep1+1)
 
@@ -29,6 +39,46 @@ del compile_args[out_ind]
 in_dir = os.path.split(os.path.realpath(in_file))[0]
 opt_flags = [x for x in compile_args if x in ['-g3', '-g', '-O1', '-O2', '-framepointer']]
 
+def hash_file(h, path):
+    h.update(path.encode() + b'\0')
+    with open(path, 'rb') as f:
+        h.update(f.read())
+
+def cache_key():
+    # Headers come from the .d file the Makefile's syntax check writes next to
+    # the object, so without one there is nothing safe to key on
+    dep_file = os.path.splitext(out_file)[0] + '.d'
+    if not os.path.isfile(dep_file):
+        return None
+    with open(dep_file) as f:
+        deps = f.read().replace('\\\n', ' ').split()
+    deps = sorted(set(d for d in deps if not d.endswith(':') and os.path.isfile(d)))
+
+    with open(in_file, 'rb') as f:
+        source = f.read()
+    asm_files = sorted(set(m.decode() for m in re.findall(rb'#pragma\s+GLOBAL_ASM\(\s*"([^"]+)"', source)))
+
+    h = hashlib.sha1()
+    h.update(repr(sys.argv[1:]).encode())
+    for tool in [os.path.realpath(__file__), os.path.join(dir_path, 'asm_processor.py'), prelude]:
+        hash_file(h, tool)
+    st = os.stat(shutil.which(compiler[0]) or compiler[0])
+    h.update(repr((st.st_size, st.st_mtime)).encode())
+    for path in [in_file] + deps + asm_files:
+        if not os.path.isfile(path):
+            return None
+        hash_file(h, path)
+    return h.hexdigest()
+
+key = cache_key() if cache_dir else None
+if key is not None:
+    cached = os.path.join(cache_dir, key[:2], key + '.o')
+    if os.path.isfile(cached):
+        shutil.copyfile(cached, out_file)
+        sys.exit(0)
+
+import asm_processor
+
 preprocessed_file = tempfile.NamedTemporaryFile(prefix='preprocessed', suffix='.c', delete=False)
 
 try:
@@ -48,5 +98,12 @@ try:
         # os._exit(1)
 
     asm_processor.run(asmproc_flags + ['--post-process', out_file, '--assembler', assembler_sh, '--asm-prelude', prelude])
+
+    if key is not None:
+        os.makedirs(os.path.dirname(cached), exist_ok=True)
+        # Parallel builds may race on the same key, so only ever rename a whole file in
+        tmp = cached + '.%d' % os.getpid()
+        shutil.copyfile(out_file, tmp)
+        os.replace(tmp, cached)
 finally:
     os.remove(preprocessed_file.name)
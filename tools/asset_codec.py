@@ -0,0 +1,299 @@
+#!/usr/bin/env python3
+
+# Recompresses the split BLOCKS and MODELS entries that should load faster in
+# the LZ format inflate_lz in src/segment_38380.c decodes, keeping DEFLATE for
+# the rest.
+#
+# For each entry the load time of both codecs is estimated from the PI DMA rate
+# and each decoder's cost per output byte. LZ is used where it comes out faster
+# by at least --min-gain, for the entries streamed in the --trace captures (or
+# every entry with --all), until --max-growth bytes of ROM are spent.
+#
+# The payload (from byte 4 of a block, byte 8 of a model) is replaced and the
+# header before it kept. The files grow, so the tabs get new offsets and the
+# file table in bin/ucode.bin is moved along for every file after them. Run this
+# after split, and only for NON_MATCHING builds: the matching inflate doesn't
+# know the LZ format.
+#
+# The loads decode in place from the tail of the output buffer, so LZ is only
+# used where the decoder never writes over input it hasn't read yet.
+
+import argparse
+import bisect
+import os
+import struct
+import sys
+import zlib
+
+from telemetry_recv import read_packets, TYPE_TRACE
+
+ROM_FILES_START = 0xA4AA0
+
+LZ_MARKER = 0x06
+LZ_MIN_MATCH = 4
+LZ_MAX_DIST = 0xFFFF
+LZ_HASH_DEPTH = 32
+
+# Offset of the file table (ROM 0xA4970) in the ucode split, which starts at 0xA4550
+FST_OFFSET = 0xA4970 - 0xA4550
+
+# name: (file id, bin, tab, payload offset, slack)
+# Slack is the least the load allocates past the inflated size, less the 0x10
+# it leaves after the entry and up to 15 more it aligns the entry down by:
+# block_load adds 8 and the hits (taken as none), the model load adds 500 and
+# the animation remap (also taken as none).
+FILES = {
+    "BLOCKS": (0x29, "BLOCKS.bin", "BLOCKS_tab.bin", 4, 8 - 0x10 - 15),
+    "MODELS": (0x2F, "MODELS.bin", "MODELS_tab.bin", 8, 500 - 0x10 - 15),
+}
+
+def read_traces(paths):
+    """Yields every traced ROM address, in the order the game read them."""
+    for path in paths:
+        with open(path, "rb") as f:
+            for kind, frame, body in read_packets(f):
+                if kind != TYPE_TRACE:
+                    continue
+                count = struct.unpack_from(">I", body)[0]
+                yield from struct.unpack_from(f">{count}I", body, 8)
+
+def lz_length(out, extra):
+    while extra >= 255:
+        out.append(255)
+        extra -= 255
+    out.append(extra)
+
+def lz_compress(data):
+    """Greedy LZ with hash chains over a 64KB window."""
+    out = bytearray([LZ_MARKER])
+    chains = {}
+    literals = bytearray()
+    i = 0
+    n = len(data)
+
+    def emit(dist, length):
+        lit = len(literals)
+        token = (min(lit, 15) << 4) | (min(length - LZ_MIN_MATCH, 15) if dist else 0)
+        out.append(token)
+        if lit >= 15:
+            lz_length(out, lit - 15)
+        out.extend(literals)
+        out.extend(struct.pack("<H", dist))
+        if dist and length - LZ_MIN_MATCH >= 15:
+            lz_length(out, length - LZ_MIN_MATCH - 15)
+        literals.clear()
+
+    while i < n:
+        best_len = 0
+        best_dist = 0
+        if i + LZ_MIN_MATCH <= n:
+            key = data[i:i + LZ_MIN_MATCH]
+            chain = chains.get(key)
+            if chain:
+                for j in reversed(chain):
+                    if i - j > LZ_MAX_DIST:
+                        break
+                    length = LZ_MIN_MATCH
+                    while i + length < n and data[j + length] == data[i + length]:
+                        length += 1
+                    if length > best_len:
+                        best_len = length
+                        best_dist = i - j
+            chain = chains.setdefault(key, [])
+            chain.append(i)
+            if len(chain) > LZ_HASH_DEPTH:
+                del chain[0]
+
+        if best_len >= LZ_MIN_MATCH:
+            emit(best_dist, best_len)
+            for k in range(i + 1, min(i + best_len, n - LZ_MIN_MATCH + 1)):
+                chain = chains.setdefault(data[k:k + LZ_MIN_MATCH], [])
+                chain.append(k)
+                if len(chain) > LZ_HASH_DEPTH:
+                    del chain[0]
+            i += best_len
+        else:
+            literals.append(data[i])
+            i += 1
+
+    emit(0, 0)
+    return bytes(out)
+
+def lz_decompress(data, in_at=None):
+    """The same as inflate_lz, to check every entry before it's written.
+
+    With in_at, the input is taken to start that many bytes after the output in
+    the same buffer, and ValueError is raised if a write would reach input that
+    hasn't been read yet.
+    """
+    out = bytearray()
+    i = 1
+
+    def length(value):
+        nonlocal i
+        if value == 15:
+            while True:
+                b = data[i]
+                i += 1
+                value += b
+                if b != 255:
+                    break
+        return value
+
+    while True:
+        token = data[i]
+        i += 1
+        lit = length(token >> 4)
+        out += data[i:i + lit]
+        i += lit
+        if in_at is not None and len(out) > in_at + i:
+            raise ValueError("literals overwrite unread input")
+        dist = struct.unpack_from("<H", data, i)[0]
+        i += 2
+        if dist == 0:
+            return bytes(out)
+        count = length(token & 0xF) + LZ_MIN_MATCH
+        if in_at is not None and len(out) + count > in_at + i:
+            raise ValueError("match overwrites unread input")
+        for _ in range(count):
+            out.append(out[-dist])
+
+def inflate(payload):
+    d = zlib.decompressobj(-15)
+    out = d.decompress(payload)
+    if not d.eof:
+        raise ValueError("truncated DEFLATE stream")
+    return out
+
+def streamed(entries, rom_start, addrs):
+    """Entries some traced DMA started in, the captures must be of the current layout."""
+    filled = [entry for entry in entries if entry[2] > entry[1]]
+    starts = [start for i, start, end in filled]
+    hot = set()
+    for addr in addrs:
+        k = bisect.bisect_right(starts, addr - rom_start) - 1
+        if k >= 0 and addr - rom_start < filled[k][2]:
+            hot.add(filled[k][0])
+    return hot
+
+def load_time(size, out_size, decode_cycles, args):
+    return size * args.dma_cycles + out_size * decode_cycles
+
+def recompress(name, entries, data, hot, args, budget):
+    file_id, bin_name, tab_name, payload_at, slack = FILES[name]
+    new = {}
+    spent = 0
+    for i, start, end in entries:
+        if end == start or (not args.all and i not in hot):
+            continue
+
+        entry = data[start:end]
+        try:
+            raw = inflate(entry[payload_at:])
+        except (ValueError, zlib.error) as e:
+            print(f"Warning: {name} {i}: {e}, kept", file=sys.stderr)
+            continue
+
+        lz = lz_compress(raw)
+        assert lz_decompress(lz) == raw
+        # The whole entry ends slack bytes past the output, the payload after its header
+        try:
+            lz_decompress(lz, len(raw) + slack - len(lz))
+        except ValueError:
+            continue
+        deflate_time = load_time(len(entry), len(raw), args.deflate_cycles, args)
+        lz_time = load_time(payload_at + len(lz), len(raw), args.lz_cycles, args)
+        growth = payload_at + len(lz) - len(entry)
+        if lz_time > deflate_time * (1 - args.min_gain) or spent + max(growth, 0) > budget:
+            continue
+
+        new[i] = entry[:payload_at] + lz
+        spent += max(growth, 0)
+
+    return new, spent
+
+def main():
+    parser = argparse.ArgumentParser(description="Picks DEFLATE or LZ for each BLOCKS and MODELS entry")
+    parser.add_argument("--assets", default="bin/assets", help="Split files, rewritten in place")
+    parser.add_argument("--fst", default="bin/ucode.bin", help="Split file holding the file table")
+    parser.add_argument("--trace", action="append", default=[],
+        help="Telemetry capture whose streamed entries should load faster")
+    parser.add_argument("--all", action="store_true", help="Consider every entry")
+    parser.add_argument("--files", default=",".join(FILES), help="Which files to recompress")
+    parser.add_argument("--max-growth", type=int, default=0x100000, help="ROM bytes LZ may add in total")
+    parser.add_argument("--min-gain", type=float, default=0.25,
+        help="Fraction of the load time LZ has to save to be used")
+    parser.add_argument("--dma-cycles", type=float, default=19.0, help="CPU cycles per byte of PI DMA")
+    parser.add_argument("--deflate-cycles", type=float, default=60.0, help="CPU cycles per byte inflated")
+    parser.add_argument("--lz-cycles", type=float, default=12.0, help="CPU cycles per byte of LZ decoded")
+    parser.add_argument("--dry-run", action="store_true", help="Only print what would change")
+    args = parser.parse_args()
+
+    if not args.all and not args.trace:
+        parser.error("Pass --trace captures or --all")
+
+    with open(args.fst, "rb") as f:
+        fst_file = bytearray(f.read())
+    count = struct.unpack_from(">I", fst_file, FST_OFFSET)[0]
+    fst = list(struct.unpack_from(f">{count + 1}I", fst_file, FST_OFFSET + 4))
+    addrs = list(read_traces(args.trace))
+    budget = args.max_growth
+
+    for name in args.files.split(","):
+        if name not in FILES:
+            parser.error(f"Unknown file {name}")
+        file_id, bin_name, tab_name, payload_at, slack = FILES[name]
+        bin_path = os.path.join(args.assets, bin_name)
+        tab_path = os.path.join(args.assets, tab_name)
+
+        with open(bin_path, "rb") as f:
+            data = f.read()
+        with open(tab_path, "rb") as f:
+            tab = f.read()
+
+        words = len(tab) // 4
+        offsets = list(struct.unpack(f">{words}I", tab[:words * 4]))
+        end = offsets[-1]
+        entries = [(i, offsets[i], offsets[i + 1]) for i in range(words - 1)]
+
+        align = 8
+        while align > 1 and any(start % align for i, start, e in entries if e > start):
+            align //= 2
+
+        hot = streamed(entries, ROM_FILES_START + fst[file_id], addrs)
+
+        new, spent = recompress(name, entries, data, hot, args, budget)
+        budget -= spent
+
+        out = bytearray()
+        new_offsets = list(offsets)
+        for i, start, e in entries:
+            new_offsets[i] = len(out)
+            out += new.get(i, data[start:e])
+            out += b"\0" * (-len(out) % align)
+        out += data[end:]
+        new_end = len(out) - (len(data) - end)
+        new_offsets[-1] = new_end
+        # Keeps the files after this one as aligned as they were
+        out += b"\0" * (-(len(out) - len(data)) % 8)
+        delta = len(out) - len(data)
+
+        print(f"{name}: {len(new)} entries to LZ, {delta:+d} bytes")
+        if args.dry_run:
+            continue
+
+        with open(bin_path, "wb") as f:
+            f.write(out)
+        with open(tab_path, "wb") as f:
+            f.write(struct.pack(f">{words}I", *new_offsets) + tab[words * 4:])
+
+        # Every file after this one moves by the growth
+        for i in range(file_id + 1, count + 1):
+            fst[i] += delta
+    if not args.dry_run:
+        struct.pack_into(f">{count + 1}I", fst_file, FST_OFFSET + 4, *fst)
+        with open(args.fst, "wb") as f:
+            f.write(fst_file)
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,266 @@
+#!/usr/bin/env python3
+
+# Runs a benchmark on a built ROM in an emulator and compares it to a baseline.
+#
+# The script, a JSON file, is written into the BenchScript sBenchScript in
+# src/main.c of a copy of the ROM, which the game starts by itself a number of
+# ticks after boot: it flies the camera along the script's bench path (see
+# bench_start), replays its inputs with it, and sends telemetry as IS-Viewer
+# lines. The copy gets a new header checksum, so it boots like a real cartridge.
+#
+# The emulator runs until the TELEMETRY_BENCH packet of the finished run comes
+# in. Its totals and the percentiles of the frames it timed are compared against
+# the baseline, by default the script's name with .baseline.json, and any that
+# got worse by more than --tolerance fail the run. --update writes the baseline
+# instead. Only NON_MATCHING builds have sBenchScript, and the timings are only
+# as good as the emulator's: use a cycle-accurate one.
+#
+# Script format, angles in the game's 16-bit units and inputs optional:
+#   {
+#     "map": [x, z, arg],
+#     "keys": [{"yaw": 0, "pitch": 0, "roll": 0, "pos": [x, y, z], "frames": 120}, ...],
+#     "boot_ticks": 600,
+#     "inputs": {"length": 300, "frames": [{"frame": 0, "snaps": [[button, presses, releases, x, y]]}]}
+#   }
+
+import argparse
+import json
+import os
+import shlex
+import struct
+import subprocess
+import sys
+import tempfile
+import threading
+import zlib
+
+from telemetry_recv import read_packets, IsViewerReader, TYPE_FRAME, TYPE_BENCH, FRAME_FIELDS, STAGES
+
+SCRIPT_MAGIC = b"DPBS"
+SINK_ISVIEWER = 1
+MAX_KEYS = 16           # BENCH_MAX_KEYS
+MAX_INPUTS = 128        # BENCH_SCRIPT_MAX_INPUTS
+MAX_SNAPSHOTS = 4       # INPUT_REC_MAX_SNAPSHOTS
+SCRIPT_SIZE = 0x1E4 + MAX_INPUTS * 0x28
+
+# TelemetryFrame fields, after the stage times
+FRAME_CPU = len(STAGES)
+FRAME_RSP_GFX = len(STAGES) + 1
+FRAME_RDP = len(STAGES) + 3
+
+# name, how much worse than the baseline is still noise on top of --tolerance
+METRICS = [
+    ("slow_frames", 1),
+    ("cpu_avg_us", 20),
+    ("cpu_p95_us", 50),
+    ("cpu_max_us", 200),
+    ("rsp_avg_us", 20),
+    ("rsp_p95_us", 50),
+    ("rsp_max_us", 200),
+    ("rdp_avg_us", 20),
+    ("rdp_p95_us", 50),
+    ("rdp_max_us", 200),
+]
+
+# The header checksum, as the CIC checks it on boot. Seeds by CIC, which is told
+# apart by the CRC32 of its boot code.
+CRC_START = 0x1000
+CRC_END = CRC_START + 0x100000
+CIC_BOOT_CRCS = {0x6170A4A1: 6101, 0x90BB6CB5: 6102, 0x0B050EE0: 6103, 0x98BC2C86: 6105, 0xACC8580A: 6106}
+CIC_SEEDS = {6101: 0xF8CA4DDC, 6102: 0xF8CA4DDC, 6103: 0xA3886759, 6105: 0xDF26F436, 6106: 0x1FEA617A}
+M = 0xFFFFFFFF
+
+def rom_checksum(rom, cic):
+    t1 = t2 = t3 = t4 = t5 = t6 = CIC_SEEDS[cic]
+    words = struct.unpack_from(f">{(CRC_END - CRC_START) // 4}I", rom, CRC_START)
+    boot = struct.unpack_from(">64I", rom, 0x40 + 0x710)
+    for k, d in enumerate(words):
+        t6 = (t6 + d) & M
+        if t6 < d:
+            t4 = (t4 + 1) & M
+        t3 ^= d
+        shift = d & 0x1F
+        r = ((d << shift) | (d >> (32 - shift))) & M
+        t5 = (t5 + r) & M
+        t2 ^= r if t2 > d else t6 ^ d
+        if cic == 6105:
+            t1 = (t1 + (boot[k & 0x3F] ^ d)) & M
+        else:
+            t1 = (t1 + (t5 ^ d)) & M
+    if cic == 6103:
+        return ((t6 ^ t4) + t3) & M, ((t5 ^ t2) + t1) & M
+    if cic == 6106:
+        return (t6 * t4 + t3) & M, (t5 * t2 + t1) & M
+    return t6 ^ t4 ^ t3, t5 ^ t2 ^ t1
+
+def pack_script(script):
+    keys = script["keys"]
+    if not 2 <= len(keys) <= MAX_KEYS:
+        raise ValueError(f"a path needs 2 to {MAX_KEYS} keys")
+    x, z, arg = script["map"]
+    out = bytearray(SCRIPT_MAGIC)
+    inputs = script.get("inputs", {"length": 0, "frames": []})
+    frames = inputs["frames"]
+    if len(frames) > MAX_INPUTS:
+        raise ValueError(f"at most {MAX_INPUTS} input frames fit")
+    out += struct.pack(">IIiI", script.get("boot_ticks", 600), SINK_ISVIEWER, len(frames), inputs["length"])
+
+    # BenchPath
+    out += struct.pack(">ffii", x, z, arg, len(keys))
+    for i in range(MAX_KEYS):
+        if i < len(keys):
+            key = keys[i]
+            out += struct.pack(">hhhhf3fHH", key.get("yaw", 0), key.get("pitch", 0), key.get("roll", 0), 0,
+                1.0, *key["pos"], key.get("frames", 0), 0)
+        else:
+            out += bytes(0x1C)
+
+    # InputRecFrames
+    for i in range(MAX_INPUTS):
+        if i >= len(frames):
+            out += bytes(0x28)
+            continue
+        snaps = frames[i]["snaps"]
+        if not snaps or len(snaps) > MAX_SNAPSHOTS:
+            raise ValueError(f"input frames need 1 to {MAX_SNAPSHOTS} snapshots")
+        out += struct.pack(">IB3x", frames[i]["frame"], len(snaps))
+        for k in range(MAX_SNAPSHOTS):
+            out += struct.pack(">HHHbb", *snaps[k]) if k < len(snaps) else bytes(8)
+
+    assert len(out) == SCRIPT_SIZE
+    return bytes(out)
+
+def patch_rom(rom, script, cic=None):
+    at = rom.find(SCRIPT_MAGIC)
+    while at >= 0 and at % 4:
+        at = rom.find(SCRIPT_MAGIC, at + 1)
+    if at < 0:
+        raise ValueError("no sBenchScript in the ROM, build it with NON_MATCHING")
+    if rom.find(SCRIPT_MAGIC, at + 4) >= 0:
+        raise ValueError("more than one sBenchScript magic in the ROM")
+
+    cic = cic or CIC_BOOT_CRCS.get(zlib.crc32(rom[0x40:0x1000]))
+    if cic is None:
+        raise ValueError("unknown CIC boot code, pass --cic to fix the header checksum")
+
+    rom = bytearray(rom)
+    rom[at:at + SCRIPT_SIZE] = pack_script(script)
+    struct.pack_into(">II", rom, 0x10, *rom_checksum(rom, cic))
+    return bytes(rom)
+
+def percentile(values, p):
+    values = sorted(values)
+    return values[min(len(values) - 1, int(len(values) * p))] if values else 0
+
+def run(rom_path, emu, timeout):
+    cmd = [arg.replace("{rom}", rom_path) for arg in shlex.split(emu)]
+    proc = subprocess.Popen(cmd, stdout=subprocess.PIPE, stdin=subprocess.DEVNULL)
+    timer = threading.Timer(timeout, proc.kill)
+    timer.start()
+    frames = []
+    stats = None
+    try:
+        for kind, frame, body in read_packets(IsViewerReader(proc.stdout)):
+            if kind == TYPE_FRAME:
+                frames.append(struct.unpack_from(f">{FRAME_FIELDS}I", body))
+            elif kind == TYPE_BENCH:
+                stats = struct.unpack_from(">8I", body)
+                break
+    finally:
+        timed_out = not timer.is_alive()
+        timer.cancel()
+        proc.kill()
+        proc.wait()
+    if stats is None:
+        raise RuntimeError("the emulator timed out" if timed_out else "the emulator exited before the run ended")
+    return frames, stats
+
+def results(frames, stats):
+    count, slow, cpu, cpu_max, rsp, rsp_max, rdp, rdp_max = stats
+    n = max(count, 1)
+    # The run's frames are the last ones before its TELEMETRY_BENCH packet
+    timed = frames[-count:] if count else []
+    return {
+        "frames": count,
+        "slow_frames": slow,
+        "cpu_avg_us": cpu // n,
+        "cpu_p95_us": percentile([f[FRAME_CPU] for f in timed], 0.95),
+        "cpu_max_us": cpu_max,
+        "rsp_avg_us": rsp // n,
+        "rsp_p95_us": percentile([f[FRAME_RSP_GFX] for f in timed], 0.95),
+        "rsp_max_us": rsp_max,
+        "rdp_avg_us": rdp // n,
+        "rdp_p95_us": percentile([f[FRAME_RDP] for f in timed], 0.95),
+        "rdp_max_us": rdp_max,
+    }
+
+def compare(new, base, tolerance):
+    if new["frames"] != base["frames"]:
+        print(f"Error: {new['frames']} frames timed, the baseline has {base['frames']}", file=sys.stderr)
+        return False
+    ok = True
+    print(f"{'':14} {'base':>8} {'new':>8} {'change':>8}")
+    for key, slack in METRICS:
+        old = base.get(key, 0)
+        value = new[key]
+        change = (value - old) / old * 100 if old else 0.0
+        worse = value > old * (1 + tolerance / 100) + slack
+        print(f"{key:14} {old:8} {value:8} {change:+7.1f}%{'  FAIL' if worse else ''}")
+        ok = ok and not worse
+    return ok
+
+def main():
+    parser = argparse.ArgumentParser(description="Benchmarks a built ROM in an emulator against a baseline")
+    parser.add_argument("script", help="Benchmark script, see the top of this file")
+    parser.add_argument("--rom", default="build/dino.z64", help="NON_MATCHING ROM to run")
+    parser.add_argument("--emu", required=True,
+        help="Emulator command printing IS-Viewer output to stdout, {rom} is replaced by the ROM")
+    parser.add_argument("--baseline", help="Results to compare against (default: SCRIPT.baseline.json)")
+    parser.add_argument("--update", action="store_true", help="Write the results as the baseline")
+    parser.add_argument("--tolerance", type=float, default=2.0, help="Percent a metric may get worse")
+    parser.add_argument("--timeout", type=float, default=900.0, help="Seconds to wait for the run to end")
+    parser.add_argument("--cic", type=int, choices=sorted(CIC_SEEDS),
+        help="CIC to checksum the header for (default: told by the boot code)")
+    parser.add_argument("--keep-rom", metavar="PATH", help="Also write the patched ROM here")
+    args = parser.parse_args()
+
+    baseline = args.baseline or os.path.splitext(args.script)[0] + ".baseline.json"
+    with open(args.script) as f:
+        script = json.load(f)
+    with open(args.rom, "rb") as f:
+        rom = f.read()
+
+    try:
+        patched = patch_rom(rom, script, args.cic)
+    except (ValueError, KeyError) as e:
+        print(f"Error: {e}", file=sys.stderr)
+        sys.exit(1)
+    if args.keep_rom:
+        with open(args.keep_rom, "wb") as f:
+            f.write(patched)
+
+    with tempfile.TemporaryDirectory() as tmp:
+        rom_path = os.path.join(tmp, "bench.z64")
+        with open(rom_path, "wb") as f:
+            f.write(patched)
+        try:
+            frames, stats = run(rom_path, args.emu, args.timeout)
+        except (OSError, RuntimeError) as e:
+            print(f"Error: {e}", file=sys.stderr)
+            sys.exit(1)
+
+    new = results(frames, stats)
+    if args.update or not os.path.exists(baseline):
+        with open(baseline, "w") as f:
+            json.dump(new, f, indent=2)
+            f.write("\n")
+        print(f"Wrote {baseline}")
+        print(json.dumps(new, indent=2))
+        return
+
+    with open(baseline) as f:
+        base = json.load(f)
+    sys.exit(0 if compare(new, base, args.tolerance) else 1)
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,202 @@
+#!/usr/bin/env python3
+
+# Breaks the display lists captured with telemetry_capture_dl (see src/main.c)
+# down by command, to measure render list changes on real scenes.
+#
+# Each captured frame is the whole frame's display list, split into the DLTag
+# ranges it was written in, plus the lists those ranges call with
+# gSPDisplayList. Calls to a captured list are counted as if the list was
+# inline, so the triangles in a block's shape lists count towards the world
+# tag. Lists called from called lists weren't captured, and only count as a
+# call.
+#
+# With --compare the averages of two captures are printed side by side, e.g. a
+# capture of the same bench path (see bench_start) before and after a change.
+
+import argparse
+import struct
+import sys
+
+from telemetry_recv import read_packets, TYPE_RENDER, TYPE_DL
+
+# enum DLTag in include/variables.h
+TAGS = ["setup", "world", "dll", "subtitles", "overlays", "finish"]
+TAG_CALLED = 0xFF
+RENDER_LIST_TAGS = ("world",)
+
+# F3DEX2 opcodes, from include/PR/gbi.h
+OPS = {
+    0x00: "G_NOOP", 0x01: "G_VTX", 0x02: "G_MODIFYVTX", 0x03: "G_CULLDL", 0x04: "G_BRANCH_Z",
+    0x05: "G_TRI1", 0x06: "G_TRI2", 0x07: "G_QUAD", 0x08: "G_LINE3D",
+    0xD7: "G_TEXTURE", 0xD8: "G_POPMTX", 0xD9: "G_GEOMETRYMODE", 0xDA: "G_MTX", 0xDB: "G_MOVEWORD",
+    0xDC: "G_MOVEMEM", 0xDD: "G_LOAD_UCODE", 0xDE: "G_DL", 0xDF: "G_ENDDL", 0xE0: "G_SPNOOP",
+    0xE1: "G_RDPHALF_1", 0xE2: "G_SETOTHERMODE_L", 0xE3: "G_SETOTHERMODE_H", 0xE4: "G_TEXRECT",
+    0xE5: "G_TEXRECTFLIP", 0xE6: "G_RDPLOADSYNC", 0xE7: "G_RDPPIPESYNC", 0xE8: "G_RDPTILESYNC",
+    0xE9: "G_RDPFULLSYNC", 0xEA: "G_SETKEYGB", 0xEB: "G_SETKEYR", 0xEC: "G_SETCONVERT",
+    0xED: "G_SETSCISSOR", 0xEE: "G_SETPRIMDEPTH", 0xEF: "G_RDPSETOTHERMODE", 0xF0: "G_LOADTLUT",
+    0xF1: "G_RDPHALF_2", 0xF2: "G_SETTILESIZE", 0xF3: "G_LOADBLOCK", 0xF4: "G_LOADTILE",
+    0xF5: "G_SETTILE", 0xF6: "G_FILLRECT", 0xF7: "G_SETFILLCOLOR", 0xF8: "G_SETFOGCOLOR",
+    0xF9: "G_SETBLENDCOLOR", 0xFA: "G_SETPRIMCOLOR", 0xFB: "G_SETENVCOLOR", 0xFC: "G_SETCOMBINE",
+    0xFD: "G_SETTIMG", 0xFE: "G_SETZIMG", 0xFF: "G_SETCIMG",
+}
+G_DL = 0xDE
+G_ENDDL = 0xDF
+G_DL_NOPUSH = 0x01
+
+# Totals printed for each frame and compared, and the commands each adds up
+SUMMARY = [
+    ("commands", None),
+    ("tris", None),
+    ("vertices", None),
+    ("tex_loads", ("G_LOADBLOCK", "G_LOADTILE", "G_LOADTLUT")),
+    ("pipe_syncs", ("G_RDPPIPESYNC",)),
+    ("tile_syncs", ("G_RDPTILESYNC",)),
+    ("load_syncs", ("G_RDPLOADSYNC",)),
+    ("matrices", ("G_MTX",)),
+    ("dl_calls", ("G_DL",)),
+    ("other_modes", ("G_SETOTHERMODE_L", "G_SETOTHERMODE_H", "G_RDPSETOTHERMODE")),
+    ("combines", ("G_SETCOMBINE",)),
+    ("colors", ("G_SETPRIMCOLOR", "G_SETENVCOLOR", "G_SETBLENDCOLOR", "G_SETFOGCOLOR")),
+]
+
+# Call depth past which a called list is only counted as a call, in case of a cycle
+MAX_DEPTH = 8
+
+class Frame:
+    def __init__(self, frame, body):
+        self.frame = frame
+        (self.block_items, self.actor_items, self.blocks, self.num_ranges,
+            self.num_called, self.called_dropped) = struct.unpack_from(">6I", body)
+        self.ranges = {}
+        self.called = {}
+
+    def add_dl(self, body):
+        tag, index, offset = struct.unpack_from(">3I", body)
+        data = body[12:]
+        if tag == TAG_CALLED:
+            chunks = self.called.setdefault(index, bytearray())
+        else:
+            chunks = self.ranges.setdefault(index, (tag, bytearray()))[1]
+        if len(chunks) < offset:
+            chunks += b"\0" * (offset - len(chunks))
+        chunks[offset:offset + len(data)] = data
+
+    def complete(self):
+        return len(self.ranges) == self.num_ranges and len(self.called) == self.num_called
+
+def read_frames(path):
+    frames = []
+    with open(path, "rb") as f:
+        current = None
+        for kind, frame, body in read_packets(f):
+            if kind == TYPE_RENDER:
+                current = Frame(frame, body)
+                frames.append(current)
+            elif kind == TYPE_DL and current is not None and frame == current.frame:
+                current.add_dl(body)
+    return frames
+
+def count_commands(data, called, counts, depth):
+    for i in range(0, len(data) - 7, 8):
+        w0, w1 = struct.unpack_from(">II", data, i)
+        op = w0 >> 24
+        name = OPS.get(op, f"0x{op:02X}")
+        counts[name] = counts.get(name, 0) + 1
+        counts["commands"] = counts.get("commands", 0) + 1
+
+        if name == "G_TRI1":
+            counts["tris"] = counts.get("tris", 0) + 1
+        elif name in ("G_TRI2", "G_QUAD"):
+            counts["tris"] = counts.get("tris", 0) + 2
+        elif name == "G_VTX":
+            counts["vertices"] = counts.get("vertices", 0) + ((w0 >> 12) & 0xFF)
+        elif op == G_DL:
+            # A branch only continues another list in one that was called
+            branch = (w0 >> 16) & 0xFF == G_DL_NOPUSH
+            if w1 in called and depth < MAX_DEPTH and (not branch or depth > 0):
+                count_commands(called[w1], called, counts, depth + 1)
+            if branch:
+                return
+        elif op == G_ENDDL and depth > 0:
+            return
+
+def frame_counts(frame, tags):
+    counts = {}
+    for index in sorted(frame.ranges):
+        tag, data = frame.ranges[index]
+        name = TAGS[tag] if tag < len(TAGS) else f"tag{tag}"
+        if tags is None or name in tags:
+            count_commands(data, frame.called, counts, 0)
+    totals = {}
+    for key, ops in SUMMARY:
+        totals[key] = counts.get(key, 0) if ops is None else sum(counts.get(op, 0) for op in ops)
+    return totals, counts
+
+def average(frames, tags):
+    totals = {}
+    counts = {}
+    for frame in frames:
+        t, c = frame_counts(frame, tags)
+        for key, value in t.items():
+            totals[key] = totals.get(key, 0) + value / len(frames)
+        for key, value in c.items():
+            counts[key] = counts.get(key, 0) + value / len(frames)
+    return totals, counts
+
+def load(path):
+    frames = read_frames(path)
+    incomplete = [f.frame for f in frames if not f.complete()]
+    if incomplete:
+        print(f"Warning: {path}: frames {incomplete} are missing packets, left out", file=sys.stderr)
+    frames = [f for f in frames if f.complete()]
+    if not frames:
+        print(f"Error: {path}: no captured frames", file=sys.stderr)
+        sys.exit(1)
+    return frames
+
+def main():
+    parser = argparse.ArgumentParser(description="Counts commands in display lists captured with telemetry")
+    parser.add_argument("capture", help="Telemetry capture with TELEMETRY_DL packets")
+    parser.add_argument("--compare", metavar="BASE", help="Capture to compare the averages against")
+    parser.add_argument("--tags", default=",".join(RENDER_LIST_TAGS),
+        help="DLTags to count, 'all' for the whole frame (default: world, which has the render list)")
+    parser.add_argument("--commands", action="store_true", help="Also list every command's average count")
+    parser.add_argument("--fail-over", type=float, metavar="PCT",
+        help="With --compare, exit with 1 if any total grew by more than PCT percent")
+    args = parser.parse_args()
+
+    tags = None if args.tags == "all" else set(args.tags.split(","))
+    frames = load(args.capture)
+
+    if args.compare is None:
+        print(",".join(["frame", "block_items", "actor_items", "blocks"] + [key for key, ops in SUMMARY]))
+        for frame in frames:
+            totals, counts = frame_counts(frame, tags)
+            print(",".join(str(v) for v in [frame.frame, frame.block_items, frame.actor_items, frame.blocks]
+                + [round(totals[key], 1) for key, ops in SUMMARY]))
+        if args.commands:
+            totals, counts = average(frames, tags)
+            for name in sorted(OPS.values()):
+                if counts.get(name):
+                    print(f"# {name} {counts[name]:.1f}")
+        return
+
+    base = load(args.compare)
+    base_totals, base_counts = average(base, tags)
+    totals, counts = average(frames, tags)
+    print(f"{'':20} {'base':>10} {'new':>10} {'change':>8}   ({len(base)} and {len(frames)} frames)")
+    rows = [key for key, ops in SUMMARY]
+    if args.commands:
+        rows += sorted(name for name in OPS.values() if base_counts.get(name) or counts.get(name))
+    failed = False
+    for key in rows:
+        old = base_totals.get(key, base_counts.get(key, 0))
+        new = totals.get(key, counts.get(key, 0))
+        change = (new - old) / old * 100 if old else 0.0
+        print(f"{key:20} {old:10.1f} {new:10.1f} {change:+7.1f}%")
+        if args.fail_over is not None and key in base_totals and change > args.fail_over:
+            failed = True
+    sys.exit(1 if failed else 0)
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,348 @@
+// Times the host build's hot routines. Each benchmark is run once to print a
+// checksum of its output, so a change that alters results shows up next to its
+// timing, then repeatedly for at least the given time.
+//
+// Usage: bench [-t seconds] [-a assets] [name...]
+//
+// The inflate benchmarks decode every entry of BLOCKS and MODELS from -a (the
+// split bin/assets) with inflate_buffer.
+// The others use generated inputs of the sizes the game uses.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "host.h"
+
+#define BENCH_VECS 4096
+#define BENCH_FB_WIDTH 320
+#define BENCH_FB_HEIGHT 240
+#define BENCH_INFLATE_MAX (1 << 20)
+
+typedef struct Bench {
+    const char *name;
+    s32 (*setup)(void);
+    void (*run)(void);
+    u32 (*checksum)(void);
+    const char *unit;
+    double items;
+} Bench;
+
+typedef struct BenchAsset {
+    u8 *data;
+    u32 size;
+    u32 *offsets;
+    u32 *sizes;
+    s32 count;
+    u32 payloadAt;
+    double bytesOut;
+    s32 missing;    // Already reported, the other benchmarks using it skip quietly
+} BenchAsset;
+
+static const char *sAssetDir;
+static u32 sSeed = 1;
+
+static f32 sX[BENCH_VECS], sY[BENCH_VECS], sZ[BENCH_VECS];
+static f32 sVX[BENCH_VECS], sVY[BENCH_VECS], sVZ[BENCH_VECS];
+static f32 sOut[BENCH_VECS];
+static Vec3f sVecs[BENCH_VECS];
+static u16 sFb1[BENCH_FB_WIDTH * BENCH_FB_HEIGHT];
+static u16 sFb2[BENCH_FB_WIDTH * BENCH_FB_HEIGHT];
+static u8 sInflateOut[BENCH_INFLATE_MAX];
+static u32 sInflateSum;
+static BenchAsset sBlocks = { NULL, 0, NULL, NULL, 0, 4, 0.0, 0 };
+static BenchAsset sModels = { NULL, 0, NULL, NULL, 0, 8, 0.0, 0 };
+
+static double now(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static u32 rand_u32(void) {
+    sSeed = sSeed * 1664525 + 1013904223;
+    return sSeed;
+}
+
+static f32 rand_f32(void) {
+    return (f32)(rand_u32() >> 8) / (f32)(1 << 24) * 2.0f - 1.0f;
+}
+
+static u32 fnv(u32 hash, const void *data, u32 size) {
+    const u8 *p = data;
+
+    while (size-- != 0) {
+        hash = (hash ^ *p++) * 16777619;
+    }
+    return hash;
+}
+
+static s32 setup_vecs(void) {
+    s32 i;
+
+    sSeed = 1;
+    for (i = 0; i < BENCH_VECS; i++) {
+        sX[i] = rand_f32() * 1000.0f;
+        sY[i] = rand_f32() * 1000.0f;
+        sZ[i] = rand_f32() * 1000.0f;
+        sVX[i] = rand_f32();
+        sVY[i] = rand_f32();
+        sVZ[i] = rand_f32();
+        sVecs[i].x = sX[i];
+        sVecs[i].y = sY[i];
+        sVecs[i].z = sZ[i];
+    }
+    return 1;
+}
+
+static u32 checksum_vecs(void) {
+    u32 hash;
+
+    hash = fnv(2166136261u, sX, sizeof(sX));
+    hash = fnv(hash, sY, sizeof(sY));
+    hash = fnv(hash, sZ, sizeof(sZ));
+    hash = fnv(hash, sOut, sizeof(sOut));
+    return fnv(hash, sVecs, sizeof(sVecs));
+}
+
+static void run_vec3_normalize(void) {
+    s32 i;
+
+    for (i = 0; i < BENCH_VECS; i++) {
+        sOut[i] = vec3_normalize(&sVecs[i]);
+    }
+}
+
+static void run_vec3_batch_add_with_scale(void) {
+    vec3_batch_add_with_scale(sX, sY, sZ, sVX, sVY, sVZ, 1.0f / 60.0f, BENCH_VECS);
+}
+
+static s32 setup_fb(void) {
+    s32 i;
+
+    sSeed = 1;
+    for (i = 0; i < BENCH_FB_WIDTH * BENCH_FB_HEIGHT; i++) {
+        sFb1[i] = rand_u32() >> 16;
+        sFb2[i] = rand_u32() >> 16;
+    }
+    return 1;
+}
+
+static u32 checksum_fb(void) {
+    return fnv(fnv(2166136261u, sFb1, sizeof(sFb1)), sFb2, sizeof(sFb2));
+}
+
+// Every line of a frame, the way func_8003EBD4 warps the framebuffer
+static void run_weird_resize_copy(void) {
+    s32 y;
+
+    for (y = 1; y < BENCH_FB_HEIGHT; y++) {
+        weird_resize_copy(&sFb1[y * BENCH_FB_WIDTH], BENCH_FB_WIDTH, BENCH_FB_WIDTH - 40,
+            &sFb2[(y - 1) * BENCH_FB_WIDTH]);
+    }
+}
+
+static u8 *read_file(const char *name, u32 *size) {
+    char path[1024];
+    FILE *f;
+    long len;
+    u8 *data;
+
+    snprintf(path, sizeof(path), "%s/%s", sAssetDir, name);
+    f = fopen(path, "rb");
+    if (f == NULL) {
+        return NULL;
+    }
+
+    fseek(f, 0, SEEK_END);
+    len = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    data = malloc(len > 0 ? len : 1);
+    if (data != NULL && fread(data, 1, len, f) != (size_t)len) {
+        free(data);
+        data = NULL;
+    }
+    fclose(f);
+
+    *size = len;
+    return data;
+}
+
+static u32 read_be32(const u8 *b) {
+    return ((u32)b[0] << 24) | ((u32)b[1] << 16) | ((u32)b[2] << 8) | b[3];
+}
+
+static s32 load_asset(BenchAsset *asset, const char *binName, const char *tabName) {
+    u8 *tab;
+    u32 tabSize;
+    u32 end;
+    u32 next;
+    s32 i;
+
+    if (asset->data != NULL) {
+        return 1;
+    }
+    if (asset->missing) {
+        return 0;
+    }
+    asset->missing = 1;
+    if (sAssetDir == NULL) {
+        fprintf(stderr, "No -a, %s skipped\n", binName);
+        return 0;
+    }
+
+    asset->data = read_file(binName, &asset->size);
+    tab = read_file(tabName, &tabSize);
+    if (asset->data == NULL || tab == NULL || tabSize < 8) {
+        fprintf(stderr, "%s/%s or %s missing, skipped\n", sAssetDir, binName, tabName);
+        free(asset->data);
+        free(tab);
+        asset->data = NULL;
+        return 0;
+    }
+    asset->missing = 0;
+
+    asset->count = tabSize / 4 - 1;
+    asset->offsets = malloc(asset->count * sizeof(u32));
+    asset->sizes = malloc(asset->count * sizeof(u32));
+    end = read_be32(tab + asset->count * 4);
+    if (end > asset->size) {
+        end = asset->size;
+    }
+    for (i = 0; i < asset->count; i++) {
+        asset->offsets[i] = read_be32(tab + i * 4);
+        next = read_be32(tab + (i + 1) * 4);
+        if (next > end) {
+            next = end;
+        }
+        asset->sizes[i] = next > asset->offsets[i] ? next - asset->offsets[i] : 0;
+    }
+    free(tab);
+    return 1;
+}
+
+static void inflate_asset(BenchAsset *asset) {
+    s32 i;
+    s32 size;
+    s32 ret;
+
+    sInflateSum = 2166136261u;
+    asset->bytesOut = 0.0;
+    for (i = 0; i < asset->count; i++) {
+        size = asset->sizes[i];
+        if (size <= (s32)asset->payloadAt) {
+            continue;
+        }
+
+        ret = inflate_buffer(asset->data + asset->offsets[i] + asset->payloadAt, size - asset->payloadAt,
+            sInflateOut, BENCH_INFLATE_MAX);
+
+        if (ret > 0) {
+            asset->bytesOut += ret;
+            sInflateSum = fnv(sInflateSum, sInflateOut, ret);
+        } else {
+            sInflateSum = fnv(sInflateSum, &i, sizeof(i));
+        }
+    }
+}
+
+static s32 setup_blocks(void) {
+    return load_asset(&sBlocks, "BLOCKS.bin", "BLOCKS_tab.bin");
+}
+
+static s32 setup_models(void) {
+    return load_asset(&sModels, "MODELS.bin", "MODELS_tab.bin");
+}
+
+static void run_inflate_buffer_blocks(void) {
+    inflate_asset(&sBlocks);
+}
+
+static void run_inflate_buffer_models(void) {
+    inflate_asset(&sModels);
+}
+
+static u32 checksum_inflate(void) {
+    return sInflateSum;
+}
+
+static Bench sBenches[] = {
+    { "vec3_normalize", setup_vecs, run_vec3_normalize, checksum_vecs, "vec", BENCH_VECS },
+    { "vec3_batch_add_with_scale", setup_vecs, run_vec3_batch_add_with_scale, checksum_vecs, "vec", BENCH_VECS },
+    { "weird_resize_copy", setup_fb, run_weird_resize_copy, checksum_fb, "line", BENCH_FB_HEIGHT - 1 },
+    // Items are the bytes inflated, filled in by the first run
+    { "inflate_buffer_blocks", setup_blocks, run_inflate_buffer_blocks, checksum_inflate, "B", 0 },
+    { "inflate_buffer_models", setup_models, run_inflate_buffer_models, checksum_inflate, "B", 0 },
+};
+
+static s32 selected(const char *name, char **filters, s32 count) {
+    s32 i;
+
+    if (count == 0) {
+        return 1;
+    }
+    for (i = 0; i < count; i++) {
+        if (strstr(name, filters[i]) != NULL) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void run_bench(Bench *bench, double minTime) {
+    double start;
+    double elapsed;
+    double items;
+    u32 checksum;
+    long runs;
+
+    if (!bench->setup()) {
+        printf("%-28s skipped\n", bench->name);
+        return;
+    }
+
+    bench->run();
+    checksum = bench->checksum();
+    items = bench->items;
+    if (items == 0.0) {
+        items = strstr(bench->name, "blocks") != NULL ? sBlocks.bytesOut : sModels.bytesOut;
+    }
+
+    runs = 0;
+    start = now();
+    do {
+        bench->run();
+        runs++;
+        elapsed = now() - start;
+    } while (elapsed < minTime);
+
+    printf("%-28s %10ld runs %12.1f us/run %10.2f ns/%-4s %08x\n", bench->name, runs,
+        elapsed / runs * 1e6, items > 0.0 ? elapsed / runs / items * 1e9 : 0.0, bench->unit, checksum);
+}
+
+int main(int argc, char **argv) {
+    double minTime = 0.5;
+    s32 first = 1;
+    u32 i;
+
+    while (first < argc && argv[first][0] == '-') {
+        if (strcmp(argv[first], "-t") == 0 && first + 1 < argc) {
+            minTime = atof(argv[first + 1]);
+        } else if (strcmp(argv[first], "-a") == 0 && first + 1 < argc) {
+            sAssetDir = argv[first + 1];
+        } else {
+            fprintf(stderr, "Usage: %s [-t seconds] [-a assets] [name...]\n", argv[0]);
+            return 1;
+        }
+        first += 2;
+    }
+
+    for (i = 0; i < sizeof(sBenches) / sizeof(sBenches[0]); i++) {
+        if (selected(sBenches[i].name, argv + first, argc - first)) {
+            run_bench(&sBenches[i], minTime);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,32 @@
+#ifndef _HOST_H
+#define _HOST_H
+
+// Shared by the host stubs and benchmarks. These are built against the host's
+// libc rather than include/, so the game types and prototypes they need are
+// repeated here with host types of the same size.
+
+typedef unsigned char u8;
+typedef unsigned short u16;
+typedef unsigned int u32;
+typedef int s32;
+typedef float f32;
+typedef unsigned long long OSTime;
+
+typedef struct Vec3f {
+    f32 x, y, z;
+} Vec3f;
+
+// Counter rate osGetTime reports in, the same as on console
+#define HOST_COUNTER_HZ 46875000ULL
+
+// src/segment_38380.c
+s32 inflate_buffer(u8 *src, s32 srcSize, u8 *dst, s32 dstSize);
+
+// src/vec3.c
+f32 vec3_normalize(Vec3f *v);
+void vec3_batch_add_with_scale(f32 *x, f32 *y, f32 *z, f32 *vx, f32 *vy, f32 *vz, f32 scale, s32 count);
+
+// src/texture.c
+void weird_resize_copy(u16 *src, s32 srcWidth, s32 destWidth, u16 *dest);
+
+#endif
@@ -0,0 +1,48 @@
+// Stands in for the OS, libultra and asm functions the host build's C calls.
+// Everything runs on one thread, so message queues never block.
+
+#include <math.h>
+#include <string.h>
+#include <time.h>
+
+#include "host.h"
+
+s32 osCreateMesgQueue(void *mq, void *msg, s32 count) {
+    return 0;
+}
+
+s32 osSendMesg(void *mq, void *msg, s32 flag) {
+    return 0;
+}
+
+s32 osRecvMesg(void *mq, void *msg, s32 flag) {
+    return 0;
+}
+
+OSTime osGetTime(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (OSTime)ts.tv_sec * HOST_COUNTER_HZ + (OSTime)ts.tv_nsec * HOST_COUNTER_HZ / 1000000000ULL;
+}
+
+void osInvalDCache(void *vaddr, s32 nbytes) {
+}
+
+void osWritebackDCache(void *vaddr, s32 nbytes) {
+}
+
+s32 func_with_status_reg(void) {
+    return 0;
+}
+
+void set_status_reg(s32 status) {
+}
+
+f32 _sqrtf(f32 f) {
+    return sqrtf(f);
+}
+
+void _bcopy(const void *src, void *dst, s32 size) {
+    memmove(dst, src, size);
+}
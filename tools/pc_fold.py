@@ -0,0 +1,135 @@
+#!/usr/bin/env python3
+
+# Turns PC samples into folded stacks for flamegraph.pl, speedscope and the like:
+# one "thread;subsystem;file;function count" line per place samples landed.
+#
+# Samples come from telemetry captures of prof_sampler (see src/crash.c), or with
+# --raw from text files of hex PCs, one per line and optionally followed by a
+# thread id. PCs are resolved against build/dino.map as tools/pc_profile.py does,
+# and the map's object file gives the source file and, through SUBSYSTEMS, the
+# subsystem. PCs in DLL code are put down to the DLL whose gLoadedDLLList entry
+# held them at the time, from the TELEMETRY_DLLS packets; raw samples have no DLL
+# list, so theirs stay unresolved.
+#
+# The sampler only catches PCs, not call stacks, so every stack is that flat
+# path. Use --summary for totals per subsystem, file and DLL instead.
+
+import argparse
+import os
+import sys
+
+import pc_profile
+
+# By source file name, the rest are "game". libultra is its own.
+SUBSYSTEMS = {
+    "main": "frame",
+    "boot": "frame",
+    "scheduler": "os",
+    "exception": "debug",
+    "crash": "debug",
+    "dll": "dll",
+    "memory": "memory",
+    "queue": "streaming",
+    "filesystem": "streaming",
+    "segment_38380": "streaming",
+    "map": "world",
+    "model": "render",
+    "texture": "render",
+    "video": "render",
+    "object": "objects",
+    "input": "input",
+    "vec3": "math",
+}
+
+def source_file(objfile):
+    """build/src/map.o -> src/map.c, build/asm/x.o -> asm/x.s"""
+    path = objfile
+    if path.startswith("build/"):
+        path = path[len("build/"):]
+    stem, ext = os.path.splitext(path)
+    return stem + (".s" if stem.startswith("asm/") else ".c")
+
+def subsystem(path):
+    if "libultra" in path.split("/"):
+        return "libultra"
+    return SUBSYSTEMS.get(os.path.splitext(os.path.basename(path))[0], "game")
+
+def frames(pc, thread, dlls, text, dll_bucket):
+    thread_part = pc_profile.thread_name(thread).replace(" ", "_")
+    found = text.lookup(pc)
+    if found:
+        path = source_file(found[0])
+        return [thread_part, subsystem(path), path, found[1]]
+    dll = pc_profile.find_dll(dlls, pc)
+    if dll:
+        dll_id, offset = dll
+        stack = [thread_part, "dll_code", f"DLL_{dll_id}"]
+        if dll_bucket:
+            stack.append(f"DLL_{dll_id}+0x{offset - offset % dll_bucket:X}")
+        return stack
+    return [thread_part, "unknown", f"0x{pc & ~0xFFFF:08X}"]
+
+def read_raw(paths):
+    samples = []
+    for path in paths:
+        with open(path) as f:
+            for line in f:
+                fields = line.split()
+                if not fields or fields[0].startswith("#"):
+                    continue
+                pc = int(fields[0], 16)
+                thread = int(fields[1], 0) if len(fields) > 1 else 3
+                samples.append((pc, thread, []))
+    return samples
+
+def main():
+    parser = argparse.ArgumentParser(description="Folds PC samples into flamegraph stacks")
+    parser.add_argument("inputs", nargs="+", help="Telemetry captures, or with --raw text files of PCs")
+    parser.add_argument("--map", default="build/dino.map", help="Linker map of the ROM that was sampled")
+    parser.add_argument("--raw", action="store_true", help="Inputs are hex PCs, one per line")
+    parser.add_argument("--isviewer", action="store_true", help="Captures are emulator output with IS-Viewer lines")
+    parser.add_argument("--thread", type=lambda s: int(s, 0), help="Only this thread id's samples (main is 3)")
+    parser.add_argument("--dll-bucket", type=lambda s: int(s, 0), default=0x100, metavar="BYTES",
+        help="Split DLLs into ranges of this size, 0 to keep each whole (default: 0x100)")
+    parser.add_argument("--summary", action="store_true", help="Print totals per subsystem, file and DLL instead")
+    args = parser.parse_args()
+
+    text = pc_profile.TextMap(args.map)
+    if not text.addrs:
+        print(f"Error: no .text symbols in {args.map}", file=sys.stderr)
+        sys.exit(1)
+    if args.raw:
+        samples = read_raw(args.inputs)
+    else:
+        samples, dropped = pc_profile.read_samples(args.inputs, args.isviewer)
+        if dropped:
+            print(f"Warning: {dropped} samples were dropped on the console", file=sys.stderr)
+    if args.thread is not None:
+        samples = [s for s in samples if s[1] == args.thread]
+    if not samples:
+        print("Error: no PC samples", file=sys.stderr)
+        sys.exit(1)
+
+    stacks = {}
+    for pc, thread, dlls in samples:
+        key = ";".join(frames(pc, thread, dlls, text, args.dll_bucket))
+        stacks[key] = stacks.get(key, 0) + 1
+
+    if not args.summary:
+        for key in sorted(stacks):
+            print(f"{key} {stacks[key]}")
+        return
+
+    # Stack levels 1 and 2 are subsystem and file or DLL, across threads
+    for level, title in ((1, "subsystem"), (2, "file / DLL")):
+        totals = {}
+        for key, count in stacks.items():
+            name = key.split(";")[level]
+            totals[name] = totals.get(name, 0) + count
+        print(f"{'%':>7} {'samples':>8}  {title}")
+        for name, count in sorted(totals.items(), key=lambda t: -t[1]):
+            print(f"{count * 100 / len(samples):7.2f} {count:8}  {name}")
+        print()
+
+if __name__ == "__main__":
+    main()
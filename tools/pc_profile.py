@@ -0,0 +1,208 @@
+#!/usr/bin/env python3
+
+# Turns the PC samples prof_sampler (see src/crash.c) sends with telemetry into
+# a flat profile, by resolving each PC to the function in build/dino.map it's in.
+#
+# Every sample is the PC of the thread that was running when the sampler's timer
+# went off, so a function's share of the samples is its share of the CPU time.
+# PCs outside the .text the map lists are mostly in DLLs, which are loaded to
+# wherever the heap had room. Those are put down to the DLL the last
+# TELEMETRY_DLLS packet before them placed there, and the rest grouped by 64KB
+# region.
+#
+# With --threads it prints the per thread totals the sampler keeps instead: how
+# much of the time each thread ran, was ready but preempted, or was blocked and on
+# which message queue, and how often it was blocked while a lower priority thread
+# ran, the sign of a priority inversion.
+
+import argparse
+import bisect
+import re
+import struct
+import sys
+
+from telemetry_recv import read_packets, IsViewerReader, TYPE_SAMPLES, TYPE_DLLS, TYPE_THREADS, \
+    decode_threads, format_thread
+
+# Thread ids from the osCreateThread calls
+THREADS = {0: "pimgr", 1: "idle", 3: "main", 5: "scheduler", 0x62: "controller", 0x63: "asset",
+    0x64: "crash", 0xFFFFFFFF: "fault"}
+
+SECTION = re.compile(r"^ (\.\S+)(?:\s+0x([0-9a-fA-F]+)\s+0x([0-9a-fA-F]+)\s+(\S+))?\s*$")
+SECTION_CONT = re.compile(r"^\s+0x([0-9a-fA-F]+)\s+0x([0-9a-fA-F]+)\s+(\S+)\s*$")
+SYMBOL = re.compile(r"^\s+0x([0-9a-fA-F]+)\s+([A-Za-z_.$][\w.$]*)\s*$")
+
+class TextMap:
+    """The functions in the .text input sections of a GNU ld map, and the object
+    file each is in, found the way diff.py's search_map_file finds them."""
+
+    def __init__(self, path):
+        symbols = {}
+        every = {}
+        self.ranges = []
+        section = None
+        in_text = False
+        objfile = None
+        with open(path) as f:
+            for line in f:
+                m = SECTION.match(line)
+                cont = None if m else SECTION_CONT.match(line)
+                if m and not m.group(2):
+                    section = m.group(1)
+                    in_text = False
+                    continue
+                if m or (cont and section is not None):
+                    if m:
+                        section, start, size, objfile = m.group(1), m.group(2), m.group(3), m.group(4)
+                    else:
+                        start, size, objfile = cont.groups()
+                    start, size = int(start, 16), int(size, 16)
+                    in_text = section.startswith(".text") and size > 0
+                    if in_text:
+                        self.ranges.append((start, start + size, objfile))
+                    section = None
+                    continue
+                m = SYMBOL.match(line)
+                if m:
+                    every.setdefault(int(m.group(1), 16), m.group(2))
+                if m and in_text:
+                    symbols.setdefault(int(m.group(1), 16), m.group(2))
+
+        self.ranges.sort()
+        self.addrs = sorted(symbols)
+        self.names = [symbols[a] for a in self.addrs]
+        self.every_addrs = sorted(every)
+        self.every_names = [every[a] for a in self.every_addrs]
+
+    def lookup(self, pc):
+        """The object file and function pc is in, or None if it's in no .text."""
+        k = bisect.bisect_right(self.ranges, (pc, 0xFFFFFFFF)) - 1
+        if k < 0 or pc >= self.ranges[k][1]:
+            return None
+        start, end, objfile = self.ranges[k]
+        i = bisect.bisect_right(self.addrs, pc) - 1
+        name = self.names[i] if i >= 0 and self.addrs[i] >= start else f"0x{pc:08X}"
+        return objfile, name
+
+    def describe(self, addr):
+        """The symbol addr is in any section, as name+offset, e.g. to name a message queue."""
+        i = bisect.bisect_right(self.every_addrs, addr) - 1
+        if i < 0 or addr - self.every_addrs[i] >= 0x1000:
+            return f"0x{addr:08X}"
+        offset = addr - self.every_addrs[i]
+        return self.every_names[i] + (f"+0x{offset:X}" if offset else "")
+
+def find_dll(dlls, pc):
+    """The id and offset into the DLL pc is in, from a TELEMETRY_DLLS list."""
+    for dll_id, start, end in dlls:
+        if start <= pc < end:
+            return dll_id, pc - start
+    return None
+
+def read_samples(paths, isviewer):
+    """(pc, thread, loaded DLLs) for every sample, with the DLLs loaded when it was taken."""
+    samples = []
+    dropped = 0
+    for path in paths:
+        dlls = []
+        pending = []
+        with open(path, "rb") as f:
+            source = IsViewerReader(f) if isviewer else f
+            for kind, frame, body in read_packets(source):
+                if kind == TYPE_DLLS:
+                    total, first, count = struct.unpack_from(">3I", body)
+                    if first == 0:
+                        pending = []
+                    pending += struct.iter_unpack(">3I", body[12:12 + count * 12])
+                    if len(pending) >= total:
+                        dlls = pending
+                elif kind == TYPE_SAMPLES:
+                    count, total_dropped = struct.unpack_from(">2I", body)
+                    samples += [(pc, thread, dlls) for pc, thread in struct.iter_unpack(">II", body[8:8 + count * 8])]
+                    dropped = max(dropped, total_dropped)
+    return samples, dropped
+
+def resolve(pc, text, dlls):
+    found = text.lookup(pc)
+    if found:
+        return found[1]
+    dll = find_dll(dlls, pc)
+    if dll:
+        return f"[DLL {dll[0]}]"
+    return f"[0x{pc & ~0xFFFF:08X} region]"
+
+def read_threads(paths, isviewer):
+    """The last TELEMETRY_THREADS totals in the captures."""
+    last = (0, [])
+    for path in paths:
+        with open(path, "rb") as f:
+            source = IsViewerReader(f) if isviewer else f
+            for kind, frame, body in read_packets(source):
+                if kind == TYPE_THREADS:
+                    last = decode_threads(body)
+    return last
+
+def print_threads(paths, isviewer, text):
+    """Per thread totals, the threads blocked most while lower priority ones ran first."""
+    usec, threads = read_threads(paths, isviewer)
+    if not threads:
+        print("Error: no TELEMETRY_THREADS packets in the captures", file=sys.stderr)
+        sys.exit(1)
+    print(f"# {usec} us per sample")
+    for thread in sorted(threads, key=lambda t: (-t["inverted"], -t["priority"])):
+        name = thread_name(thread["id"])
+        queue = text.describe(thread["queue"]) if thread["queue"] else "nothing"
+        print(f"{name:10} {format_thread(thread, usec, queue)}")
+
+def thread_name(thread):
+    return THREADS.get(thread, f"thread {thread}")
+
+def main():
+    parser = argparse.ArgumentParser(description="Prints a flat profile of prof_sampler's PC samples")
+    parser.add_argument("captures", nargs="+", help="Telemetry captures with TELEMETRY_SAMPLES packets")
+    parser.add_argument("--map", default="build/dino.map", help="Linker map of the ROM that was sampled")
+    parser.add_argument("--isviewer", action="store_true", help="Captures are emulator output with IS-Viewer lines")
+    parser.add_argument("--thread", type=lambda s: int(s, 0), help="Only this thread id's samples (main is 3)")
+    parser.add_argument("--top", type=int, default=40, help="Functions to list, 0 for all")
+    parser.add_argument("--threads", action="store_true",
+        help="Print each thread's run, ready and blocked time and priority inversions instead")
+    args = parser.parse_args()
+
+    text = TextMap(args.map)
+    if not text.addrs:
+        print(f"Error: no .text symbols in {args.map}", file=sys.stderr)
+        sys.exit(1)
+    if args.threads:
+        print_threads(args.captures, args.isviewer, text)
+        return
+    samples, dropped = read_samples(args.captures, args.isviewer)
+    if not samples:
+        print("Error: no PC samples in the captures, was prof_sampler_start called?", file=sys.stderr)
+        sys.exit(1)
+
+    threads = {}
+    for pc, thread, dlls in samples:
+        threads[thread] = threads.get(thread, 0) + 1
+    print(f"# {len(samples)} samples, {dropped} dropped")
+    for thread, count in sorted(threads.items(), key=lambda t: -t[1]):
+        print(f"# {thread_name(thread):10} {count * 100 / len(samples):6.2f}%")
+
+    if args.thread is not None:
+        samples = [s for s in samples if s[1] == args.thread]
+    counts = {}
+    for pc, thread, dlls in samples:
+        name = resolve(pc, text, dlls)
+        counts[name] = counts.get(name, 0) + 1
+
+    rows = sorted(counts.items(), key=lambda c: -c[1])
+    if args.top:
+        rows = rows[:args.top]
+    total = max(len(samples), 1)
+    cumulative = 0
+    print(f"{'self %':>7} {'cum %':>7} {'samples':>8}  function")
+    for name, count in rows:
+        cumulative += count
+        print(f"{count * 100 / total:7.2f} {cumulative * 100 / total:7.2f} {count:8}  {name}")
+
+if __name__ == "__main__":
+    main()
@@ -8,7 +8,9 @@ from segtypes.n64.palette import N64SegPalette
 from segtypes.n64.ci4 import N64SegCi4
 from segtypes.n64.rgba32 import N64SegRgba32
 
+import hashlib
 import json
+import multiprocessing
 import png
 import os
 from pathlib import Path, PurePath
@@ -206,6 +208,7 @@ class CodeSubsegment(Subsegment):
 
                 with open(outpath, "w", newline="\n") as f:
                     f.write("\n".join(out_lines))
+                segment.note_written(outpath)
 
 class DataSubsegment(Subsegment):
     def split_inner(self, segment, rom_bytes, base_path, generic_out_path):
@@ -219,6 +222,7 @@ class DataSubsegment(Subsegment):
             if file_text:
                 with open(outpath, "w", newline="\n") as f:
                     f.write(file_text)
+                segment.note_written(outpath)
 
 class BssSubsegment(DataSubsegment):
     def __init__(self, start, end, name, type, vram, args):
@@ -231,6 +235,7 @@ class BinSubsegment(Subsegment):
         Path(generic_out_path).parent.mkdir(parents=True, exist_ok=True)
         with open(generic_out_path, "wb") as f:
             f.write(rom_bytes[self.rom_start : self.rom_end])
+        segment.note_written(generic_out_path)
 
 class PaletteSubsegment(Subsegment):
     def should_run(self, options):
@@ -262,6 +267,13 @@ class RGBA32Subsegment(Subsegment):
         with open(generic_out_path, "wb") as f:
             w.write_array(f, image)
 
+# The segment and ROM a forked split worker works on
+_split_job = None
+
+def _split_subsegments(indices):
+    segment, rom_bytes, base_path = _split_job
+    return {i: segment.split_subsegment(i, rom_bytes, base_path) for i in indices}
+
 class N64SegCode(N64Segment):
     palettes = {}
 
@@ -322,6 +334,11 @@ class N64SegCode(N64Segment):
         self.jtbl_jumps = {}
         self.jumptables = {}
 
+        # What the subsegment being split looks up, touches and writes, see split_subsegment
+        self.looked_up = None
+        self.touched = None
+        self.written = None
+
     @staticmethod
     def get_default_name(addr):
         return f"code_{addr:X}"
@@ -379,6 +396,9 @@ class N64SegCode(N64Segment):
         ret = None
         rom = None
 
+        if self.looked_up is not None:
+            self.looked_up.add(addr)
+
         in_segment = self.contains_vram(addr)
 
         if in_segment:
@@ -413,6 +433,8 @@ class N64SegCode(N64Segment):
                 ret.defined = True
             if reference:
                 ret.referenced = True
+            if self.touched is not None:
+                self.touched[id(ret)] = ret
 
         return ret
 
@@ -911,6 +933,8 @@ class N64SegCode(N64Segment):
                 for symbol in self.seg_symbols[func_addr]:
                     if symbol.name == func_name:
                         symbol.defined = True
+                        if self.touched is not None:
+                            self.touched[id(symbol)] = symbol
                         found = True
                         break
                 if found:
@@ -929,6 +953,7 @@ class N64SegCode(N64Segment):
 
         with open(outpath, "w", newline="\n") as f:
             f.write("\n".join(out_lines))
+        self.note_written(outpath)
         self.log(f"Disassembled {func_name} to {outpath}")
 
     def create_c_file(self, funcs_text, sub, asm_out_dir, base_path, c_path):
@@ -947,11 +972,108 @@ class N64SegCode(N64Segment):
         Path(c_path).parent.mkdir(parents=True, exist_ok=True)
         with open(c_path, "w") as f:
             f.write("\n".join(c_lines))
+        self.note_written(c_path)
         print(f"Wrote {sub.name} to {c_path}")
 
+    def note_written(self, path):
+        if self.written is not None:
+            self.written.append(str(path))
+
+    def sub_cache_key(self, sub, rom_bytes, refs):
+        h = hashlib.sha1()
+        h.update(repr((sub.rom_start, sub.rom_end, sub.vram_start, sub.name, sub.type, sub.args)).encode())
+        h.update(rom_bytes[sub.rom_start : sub.rom_end])
+
+        # Names given to anything inside it, or that its last split looked up
+        addrs = set(refs)
+        addrs.update(a for a in self.given_symbols if sub.contains_vram(a))
+        for addr in sorted(addrs):
+            syms = self.given_symbols.get(addr, [])
+            h.update(repr((addr, sorted((s.name, s.type, s.size, s.rom) for s in syms))).encode())
+
+        h.update(repr(sorted((s.vram_start, s.name, s.type, s.size, s.rom) for s in self.symbol_ranges)).encode())
+
+        # Functions already decompiled don't get asm
+        generic_out_path = sub.get_generic_out_path(self.base_path, self.options)
+        if sub.type == "c" and os.path.exists(generic_out_path):
+            h.update(repr(sorted(CodeSubsegment.get_funcs_defined_in_c(generic_out_path))).encode())
+
+        return h.hexdigest()
+
+    def split_subsegment(self, i, rom_bytes, base_path):
+        """
+        Splits one subsegment, returning what replay_symbols needs to recreate its
+        effect on the symbols, the addresses it looked up, the files it wrote and
+        the warnings it raised.
+        """
+        self.looked_up = set()
+        self.touched = {}
+        self.written = []
+        warning_count = len(self.warnings)
+
+        self.subsegments[i].split(self, rom_bytes, base_path)
+
+        records = [(s.vram_start, s.type, s.defined, s.referenced) for s in self.touched.values()]
+        result = (records, sorted(self.looked_up), self.written, self.warnings[warning_count:])
+
+        self.looked_up = None
+        self.touched = None
+        self.written = None
+
+        return result
+
+    def replay_symbols(self, records):
+        for addr, type, defined, referenced in records:
+            self.get_symbol(addr, type=type, create=True, define=defined, reference=referenced)
+
     def split(self, rom_bytes, base_path):
-        for sub in self.subsegments:
-            sub.split(self, rom_bytes, base_path)
+        # options["sub_cache"] maps each subsegment to its last split, to skip ones
+        # nothing has changed for, and options["jobs"] splits code in parallel
+        sub_cache = self.options.get("sub_cache", None)
+        jobs = self.options.get("jobs", 1)
+        self.base_path = base_path
+
+        self.given_symbols = {}
+        for sym in self.all_symbols:
+            if sym.given_name:
+                self.given_symbols.setdefault(sym.vram_start, []).append(sym)
+
+        todo = []
+        for i, sub in enumerate(self.subsegments):
+            if not sub.should_run(self.options) or sub.name.startswith("."):
+                continue
+
+            cached = sub_cache.get(f"{self.unique_id()}/{sub.name}") if sub_cache is not None else None
+            if cached is not None and all(os.path.exists(p) for p in cached[3]) and \
+                    cached[0] == self.sub_cache_key(sub, rom_bytes, cached[1]):
+                self.replay_symbols(cached[2])
+                continue
+
+            todo.append(i)
+
+        # Code subsegments only share symbols, which the parent replays from each
+        # worker's records. Everything else stays here, in order.
+        results = {}
+        parallel = [i for i in todo if type(self.subsegments[i]) is CodeSubsegment]
+        if jobs > 1 and len(parallel) > 1:
+            global _split_job
+            _split_job = (self, rom_bytes, base_path)
+            with multiprocessing.get_context("fork").Pool(jobs) as pool:
+                for chunk in pool.map(_split_subsegments, [parallel[k::jobs] for k in range(jobs)]):
+                    results.update(chunk)
+            _split_job = None
+
+        for i in todo:
+            sub = self.subsegments[i]
+            if i in results:
+                records, refs, written, warnings = results[i]
+                self.replay_symbols(records)
+                self.warnings.extend(warnings)
+            else:
+                records, refs, written, warnings = self.split_subsegment(i, rom_bytes, base_path)
+
+            if sub_cache is not None:
+                sub_cache[f"{self.unique_id()}/{sub.name}"] = (self.sub_cache_key(sub, rom_bytes, refs), refs, records, written)
 
         for image_name in self.palettes:
             for sub in self.subsegments:
@@ -24,6 +24,8 @@ parser.add_argument("--verbose", action="store_true",
                     help="Enable debug logging")
 parser.add_argument("--new", action="store_true",
                     help="Only split changed segments in config")
+parser.add_argument("--jobs", type=int, default=1,
+                    help="Worker processes to disassemble code subsegments with")
 
 sym_isolated_map = {}
 
@@ -249,7 +251,7 @@ def get_segment_symbols(segment, all_symbols, all_segments):
 
     return seg_syms, other_syms
 
-def main(config_path, out_dir, target_path, modes, verbose, ignore_cache=False):
+def main(config_path, out_dir, target_path, modes, verbose, ignore_cache=False, jobs=1):
     # Load config
     with open(config_path) as f:
         config = yaml.safe_load(f.read())
@@ -257,6 +259,7 @@ def main(config_path, out_dir, target_path, modes, verbose, ignore_cache=False):
     options = config.get("options")
     options["modes"] = modes
     options["verbose"] = verbose
+    options["jobs"] = jobs
 
     if not out_dir:
         out_dir = options.get("out_dir", None)
@@ -301,6 +304,10 @@ def main(config_path, out_dir, target_path, modes, verbose, ignore_cache=False):
     except Exception:
         cache = {}
 
+    # Code segments cache each subsegment by its contents and the symbols it uses
+    sub_cache = cache.setdefault("subsegments", {})
+    options["sub_cache"] = {} if ignore_cache else sub_cache
+
     # Initialize segments
     all_segments = initialize_segments(options, config_path, config["segments"])
 
@@ -328,7 +335,7 @@ def main(config_path, out_dir, target_path, modes, verbose, ignore_cache=False):
             if segment.should_run():
                 # Check cache
                 cached = segment.cache()
-                if not ignore_cache and cached == cache.get(segment.unique_id()):
+                if not ignore_cache and cached == cache.get(segment.unique_id()) and type(segment) != N64SegCode:
                     # Cache hit
                     seg_cached[typ] += 1
                 else:
@@ -410,6 +417,8 @@ def main(config_path, out_dir, target_path, modes, verbose, ignore_cache=False):
     log.write(f"{'unknown':>20}: {fmt_size(unk_size):>8} ({unk_ratio:.2%}) from unknown bin files")
 
     # Save cache
+    if ignore_cache:
+        cache["subsegments"] = options["sub_cache"]
     if cache != {}:
         if verbose:
             print("Writing cache")
@@ -420,5 +429,5 @@ def main(config_path, out_dir, target_path, modes, verbose, ignore_cache=False):
 
 if __name__ == "__main__":
     args = parser.parse_args()
-    error_code = main(args.config, args.outdir, args.rom, args.modes, args.verbose, not args.new)
+    error_code = main(args.config, args.outdir, args.rom, args.modes, args.verbose, not args.new, args.jobs)
     exit(error_code)
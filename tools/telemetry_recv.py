@@ -0,0 +1,218 @@
+#!/usr/bin/env python3
+
+# Reads the telemetry packets telemetry_tick in src/main.c sends with osWriteHost
+# and prints them as CSV, one row per frame, with the periodic stream and heap
+# packets summarized in between. The DMA trace packets are for tools/asset_codec.py
+# and only counted, the display list captures are for tools/dl_stats.py and only
+# their render summary is printed, and the PC samples and DLL lists are for
+# tools/pc_profile.py and only the samples counted. The stack packets give how
+# deep each thread stack stack_watch poisoned has gone, to size them by.
+#
+# Every packet starts with a 12-byte header: the "DPT1" magic, a u16 type, the
+# u16 size of the whole packet and the u32 frame it was sent on. Everything is
+# big-endian. Input is whatever the host side of the development channel
+# captured, a file or stdin, or with --isviewer the log of an emulator the game
+# sent them to as TELEMETRY_SINK_ISVIEWER lines.
+
+import argparse
+import struct
+import sys
+
+MAGIC = b"DPT1"
+HEADER = struct.Struct(">4sHHI")
+
+TYPE_FRAME = 0
+TYPE_STREAM = 1
+TYPE_HEAP = 2
+TYPE_TRACE = 3
+TYPE_RENDER = 4
+TYPE_DL = 5
+TYPE_BENCH = 6
+TYPE_SAMPLES = 7
+TYPE_DLLS = 8
+TYPE_THREADS = 9
+TYPE_STACKS = 10
+
+STAGES = ["submit", "dl_setup", "world", "logic", "dll", "subtitles", "overlays", "finish"]
+DL_BUFFERS = ["gfx", "mtx", "vtx", "6b0"]
+PI_CLIENTS = ["audio", "romcopy", "async"]
+STREAM_TYPES = ["file", "allocated_file", "file_region", "texture", "object", "dll",
+    "model", "animation"] + [f"single{i}" for i in range(7)]
+
+# CPU counter ticks per microsecond, half the 93.75 MHz CPU clock
+COUNTS_PER_USEC = 46.875
+
+FRAME_FIELDS = len(STAGES) + 4 + len(DL_BUFFERS) + len(PI_CLIENTS) + 5
+
+def frame_columns():
+    return ([f"{s}_us" for s in STAGES] + ["cpu_us", "rsp_gfx_us", "rsp_audio_us", "rdp_us"]
+        + [f"dl_{b}" for b in DL_BUFFERS] + [f"pi_{c}" for c in PI_CLIENTS]
+        + ["audio_tasks", "audio_late", "audio_slow", "audio_max_run_us"])
+
+def decode_frame(body):
+    values = list(struct.unpack_from(f">{FRAME_FIELDS}I", body))
+    stages = [round(v / COUNTS_PER_USEC) for v in values[:len(STAGES)]]
+    rest = values[len(STAGES):-1]
+    rest[-1] = round(rest[-1] / COUNTS_PER_USEC)
+    return stages + rest
+
+def print_stream(frame, body, out):
+    for i, name in enumerate(STREAM_TYPES):
+        count, size, wait_avg, wait_max, dma_avg, dma_max, inflate_avg, inflate_max = \
+            struct.unpack_from(">8I", body, i * 32)
+        if count == 0:
+            continue
+        print(f"# {frame} stream {name}: {count} loads {size} bytes, wait {wait_avg}/{wait_max} us "
+            f"dma {dma_avg}/{dma_max} us inflate {inflate_avg}/{inflate_max} us (avg/max)", file=out)
+
+def print_heap(frame, body, out):
+    count = struct.unpack_from(">I", body)[0]
+    for i in range(count):
+        used, free, largest, runs = struct.unpack_from(">4I", body, 4 + i * 16)
+        print(f"# {frame} heap {i}: used {used // 1024} KB free {free // 1024} KB in {runs} runs, "
+            f"largest {largest // 1024} KB", file=out)
+
+def print_trace(frame, body, out):
+    count, dropped = struct.unpack_from(">2I", body)
+    print(f"# {frame} trace: {count} DMAs, {dropped} dropped so far", file=out)
+
+def print_render(frame, body, out):
+    block_items, actor_items, blocks, ranges, called, dropped = struct.unpack_from(">6I", body)
+    print(f"# {frame} render: {block_items} block items from {blocks} blocks, {actor_items} actor items, "
+        f"{ranges} ranges calling {called} lists "
+        f"({dropped} calls dropped)", file=out)
+
+def print_samples(frame, body, out):
+    count, dropped = struct.unpack_from(">2I", body)
+    print(f"# {frame} samples: {count} PCs, {dropped} dropped so far", file=out)
+
+THREAD_FIELDS = ("id", "priority", "running", "ready", "blocked", "switches", "inverted", "queue")
+
+def decode_threads(body):
+    """The microseconds per sample and a dict of ProfThreadStats fields per thread."""
+    usec, count = struct.unpack_from(">2I", body)
+    threads = []
+    for i in range(count):
+        values = struct.unpack_from(">IiIIIIII", body, 8 + i * 32)
+        threads.append(dict(zip(THREAD_FIELDS, values)))
+    return usec, threads
+
+def format_thread(thread, usec, queue_name=None):
+    seen = max(thread["running"] + thread["ready"] + thread["blocked"], 1)
+    queue = queue_name or f"0x{thread['queue']:08X}"
+    return (f"thread {thread['id']} pri {thread['priority']}: run {thread['running'] * 100 / seen:.1f}% "
+        f"({thread['running'] * usec // 1000} ms) ready {thread['ready'] * 100 / seen:.1f}% "
+        f"blocked {thread['blocked'] * 100 / seen:.1f}% inverted {thread['inverted'] * 100 / seen:.1f}%, "
+        f"{thread['switches']} switches, last blocked on {queue}")
+
+def print_threads(frame, body, out):
+    usec, threads = decode_threads(body)
+    for thread in threads:
+        print(f"# {frame} {format_thread(thread, usec)}", file=out)
+
+def print_stacks(frame, body, out):
+    count = struct.unpack_from(">I", body)[0]
+    for i in range(count):
+        thread, size, peak = struct.unpack_from(">3I", body, 4 + i * 12)
+        warning = ", all of it, it may have overflowed" if peak == size else ""
+        print(f"# {frame} stack of thread {thread}: peak {peak} of {size} bytes "
+            f"({peak * 100 / max(size, 1):.0f}%){warning}", file=out)
+
+def print_bench(frame, body, out):
+    frames, slow, cpu, cpu_max, rsp, rsp_max, rdp, rdp_max = struct.unpack_from(">8I", body)
+    n = max(frames, 1)
+    print(f"# {frame} bench: {frames} frames, {slow} slow, cpu {cpu // n}/{cpu_max} us "
+        f"rsp {rsp // n}/{rsp_max} us rdp {rdp // n}/{rdp_max} us (avg/max)", file=out)
+
+class IsViewerReader:
+    """Reads the packets in lines of emulator output as if they were a capture."""
+
+    PREFIX = b"@DPT"
+
+    def __init__(self, f):
+        self.f = f
+
+    def read(self, size):
+        while True:
+            line = self.f.readline()
+            if not line:
+                return b""
+            start = line.find(self.PREFIX)
+            if start < 0:
+                continue
+            digits = line[start + len(self.PREFIX):].strip()
+            try:
+                return bytes.fromhex(digits.decode("ascii"))
+            except ValueError:
+                # Cut off or mixed with other output, read_packets skips to the next one
+                continue
+
+def read_packets(f):
+    data = b""
+    while True:
+        chunk = f.read(0x1000)
+        if not chunk:
+            break
+        data += chunk
+
+        while len(data) >= HEADER.size:
+            magic, kind, size, frame = HEADER.unpack_from(data)
+            if magic != MAGIC or size < HEADER.size:
+                # Lost sync, look for the next packet
+                skip = data.find(MAGIC, 1)
+                data = data[skip:] if skip >= 0 else data[-(len(MAGIC) - 1):]
+                continue
+            if len(data) < size:
+                break
+            yield kind, frame, data[HEADER.size:size]
+            data = data[size:]
+
+def main():
+    parser = argparse.ArgumentParser(description="Prints telemetry captured from the game's host channel")
+    parser.add_argument("input", nargs="?", default="-", help="Captured packets, - for stdin")
+    parser.add_argument("--frames-only", action="store_true", help="Leave out the stream and heap summaries")
+    parser.add_argument("--isviewer", action="store_true", help="Input is emulator output with IS-Viewer lines")
+    args = parser.parse_args()
+
+    f = sys.stdin.buffer if args.input == "-" else open(args.input, "rb")
+    source = IsViewerReader(f) if args.isviewer else f
+    out = sys.stdout
+
+    print(",".join(["frame"] + frame_columns()), file=out)
+    try:
+        for kind, frame, body in read_packets(source):
+            if kind == TYPE_FRAME:
+                print(",".join(str(v) for v in [frame] + decode_frame(body)), file=out)
+            elif args.frames_only:
+                continue
+            elif kind == TYPE_STREAM:
+                print_stream(frame, body, out)
+            elif kind == TYPE_HEAP:
+                print_heap(frame, body, out)
+            elif kind == TYPE_TRACE:
+                print_trace(frame, body, out)
+            elif kind == TYPE_RENDER:
+                print_render(frame, body, out)
+            elif kind == TYPE_DL:
+                continue
+            elif kind == TYPE_BENCH:
+                print_bench(frame, body, out)
+            elif kind == TYPE_SAMPLES:
+                print_samples(frame, body, out)
+            elif kind == TYPE_DLLS:
+                continue
+            elif kind == TYPE_THREADS:
+                print_threads(frame, body, out)
+            elif kind == TYPE_STACKS:
+                print_stacks(frame, body, out)
+            else:
+                print(f"Warning: unknown packet type {kind} on frame {frame}", file=sys.stderr)
+            out.flush()
+    except KeyboardInterrupt:
+        pass
+    finally:
+        if f is not sys.stdin.buffer:
+            f.close()
+
+if __name__ == "__main__":
+    main()